@@ -0,0 +1,69 @@
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "zc.h"
+
+/*
+ * The descriptor goes in the ancillary data (control message) of type SCM_RIGHTS. The kernel installs a new
+ * descriptor in the receiving process referring to the same open file, the number itself may differ. See
+ * Chapter 6's 7.passing_file_descriptor for the details of msghdr, cmsghdr and the CMSG_* macros.
+ *
+ * Unlike that one, the descriptor travels together with real data (the zc_ctl), so there's no need for the
+ * "null byte" convention: the receiver always gets the data, and a descriptor if there was one.
+*/
+int send_fd (int sockfd, int fd, const void *buf, int len) {
+  struct iovec    iov[1];
+  struct msghdr   msg;
+  struct cmsghdr  *cmsg;
+  char            control[CMSG_SPACE(sizeof(int))];
+
+  memset(&msg, 0, sizeof(msg));
+  iov[0].iov_base = (void *) buf;
+  iov[0].iov_len  = len;
+  msg.msg_iov     = iov;
+  msg.msg_iovlen  = 1;
+
+  if (fd >= 0) {
+    memset(control, 0, sizeof(control));
+    msg.msg_control     = control;
+    msg.msg_controllen  = sizeof(control);
+    cmsg                = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level    = SOL_SOCKET;
+    cmsg->cmsg_type     = SCM_RIGHTS;
+    cmsg->cmsg_len      = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+
+  return (int) sendmsg(sockfd, &msg, 0);
+}
+
+int recv_fd (int sockfd, int *fd, void *buf, int len) {
+  struct iovec    iov[1];
+  struct msghdr   msg;
+  struct cmsghdr  *cmsg;
+  char            control[CMSG_SPACE(sizeof(int))];
+  int             n;
+
+  memset(&msg, 0, sizeof(msg));
+  iov[0].iov_base     = buf;
+  iov[0].iov_len      = len;
+  msg.msg_iov         = iov;
+  msg.msg_iovlen      = 1;
+  msg.msg_control     = control;
+  msg.msg_controllen  = sizeof(control);
+
+  *fd = -1;
+  if ( (n = (int) recvmsg(sockfd, &msg, 0)) < 0) {
+    return -1;
+  }
+
+  for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+      memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+  }
+
+  return n;
+}
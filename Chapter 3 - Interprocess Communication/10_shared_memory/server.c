@@ -1,4 +1,9 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* nanosleep with -ansi */
+#endif
+
 #include <stdio.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
@@ -15,6 +20,29 @@
 int   shmid, clisem, servsem;   /* shared memory and semaphore IDs */
 Mesg  *mesgptr;                 /* pointer to message structure, which is in the shared memory segment */
 
+/*
+ * Wait until the client is done with the semaphores, before we exit.
+ *
+ * Our sem_signal(clisem)'s are SEM_UNDO (semaphore.c), so when we exit the kernel takes them back from clisem. If the
+ * client hasn't taken the last one (the empty message) by then, it's gone, and the client waits for ever. Worse, a
+ * half-undone clisem can be left for the next client, which then gets through sem_wait without the server having
+ * filled the buffer and writes the same data twice.
+ *
+ * The client detaches the segment once it has seen the empty message, so when we're the only one attached it's done.
+ * That's the `done` word of 11_multi_buffer, kept by the kernel: shm_nattch goes down on its own if the client dies,
+ * too. There's no way to sleep on it, so it's looked at every millisecond, which is nothing next to the transfer.
+*/
+static void client_done (void) {
+  struct shmid_ds ds;
+  struct timespec ms;
+
+  ms.tv_sec   = 0;
+  ms.tv_nsec  = 1000000L;
+  while (shmctl(shmid, IPC_STAT, &ds) == 0 && ds.shm_nattch > 1) {
+    nanosleep(&ms, (struct timespec *) 0);
+  }
+}
+
 int main (void) {
 
   /*
@@ -52,6 +80,7 @@ int main (void) {
   }
 
   server();
+  client_done();
 
   /*
    * Detach the shared memory segment and close the semaphores.
@@ -0,0 +1,47 @@
+#ifndef ZC_H
+#define ZC_H
+
+/*
+ * Zero-copy version of the file server (zc_server.c, zc_client.c).
+ *
+ * In server.c the server read()s the file into the shared memory segment and the client write()s it out of there,
+ * MAXMESGDATA bytes and two semaphore operations at a time. Every byte is copied twice through user space (page cache
+ * -> segment -> stdout) and the two processes take turns for every buffer. But the client doesn't need the bytes to
+ * go through the server at all, it only needs the server to *open* the file (the server may be allowed to read it
+ * when the client isn't, that's the point of having a server). So:
+ *    ->  The client sends the filename over a Unix domain stream socket.
+ *    ->  The server opens the file and passes the open descriptor back (SCM_RIGHTS), together with a zc_ctl: the
+ *        status, the size and, if it didn't work, the error message. That's the whole handshake: one message each
+ *        way, no semaphores.
+ *    ->  The client streams the file to its standard output straight from the page cache: sendfile(2) on Linux, so
+ *        the data never enters user space, or it mmaps the descriptor and write()s from the mapping (one copy).
+ *    ->  If what the server opened isn't a regular file (a FIFO, a device, ...) it can't be mapped or sendfile'd, so
+ *        the server copies it into a memory file (memfd on Linux, an unlinked temporary file elsewhere) and passes
+ *        that instead. -m makes the server do this for regular files too.
+ *    ->  The server serves one client at a time, so nothing a client asks for may keep it busy: the filename has to
+ *        come within ZC_TIMEOUT seconds, and what isn't a regular file is opened and read without blocking (a FIFO
+ *        gives what's in it, nothing more) and only up to ZC_MAXCOPY bytes (/dev/zero would never end).
+*/
+
+#define   ZC_PATH       "/tmp/zc_server.sock"
+#define   ZC_MAXNAME    1024
+#define   ZC_TIMEOUT    5                       /* seconds for the filename to arrive */
+#define   ZC_MAXCOPY    (64L * 1024 * 1024)     /* most bytes copied into a memory file, when the size isn't known */
+
+typedef struct {
+  int     status;                 /* 0 if all OK and a descriptor comes with it, else errno */
+  long    size;                   /* bytes to read from the descriptor, from offset 0 */
+  char    mesg[ZC_MAXNAME + 128]; /* error message if status != 0 */
+} zc_ctl;
+
+/*
+ * fdpass.c:
+ *    send_fd:  Send `len` bytes of `buf` on the Unix domain socket `sockfd`, with the descriptor `fd` (none if < 0).
+ *    recv_fd:  Receive up to `len` bytes into `buf`, and the descriptor that came with it in *fd (-1 if none).
+ *              Both return the number of bytes, or -1 on error.
+*/
+int   send_fd   (int sockfd, int fd, const void *buf, int len);
+
+int   recv_fd   (int sockfd, int *fd, void *buf, int len);
+
+#endif
@@ -0,0 +1,147 @@
+#ifdef __linux__
+#define _GNU_SOURCE                 /* sendfile */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#ifdef __linux__
+  #include <sys/sendfile.h>
+#endif
+
+#include "zc.h"
+#include "err_routine.h"
+
+#define   ZC_CHUNK    (1L << 30)    /* most we sendfile or map at once */
+
+static int  use_mmap = 0;           /* -w: always mmap + write, even where sendfile would work */
+
+/*
+ * Stream `fd` from `off` up to `size` to `out` by mapping it. The only copy is the one `write` makes out of the mapping.
+ * A mapping has to start on a page, and `off` needn't be on one when sendfile stopped part way: the mapping starts at
+ * the page `off` is in, and the `skip` bytes before it aren't written.
+*/
+static void stream_mmap (int fd, int out, long off, long size) {
+  char    *p;
+  long    len, skip, done, page = sysconf(_SC_PAGESIZE);
+  ssize_t n;
+
+  for (; off < size; off += len) {
+    skip  = off % page;
+    len   = (size - off > ZC_CHUNK) ? ZC_CHUNK : size - off;
+    if ( (p = (char *) mmap((void *) 0, skip + len, PROT_READ, MAP_SHARED, fd, (off_t) (off - skip))) ==
+         (char *) MAP_FAILED) {
+      err_sys("zc_client: can't mmap");
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(p, skip + len, MADV_SEQUENTIAL);  /* read ahead, drop behind */
+#endif
+    for (done = 0; done < len; done += n) {
+      if ( (n = write(out, p + skip + done, len - done)) < 0) {
+        err_sys("data write error");
+      }
+    }
+    munmap(p, skip + len);
+  }
+}
+
+/*
+ * Functionality:
+ *    ->  On Linux, sendfile(2) moves the data from the page cache to `out` inside the kernel. Since 2.6.33 the
+ *        output may be any file (a pipe, a terminal, a regular file), not just a socket.
+ *    ->  If sendfile isn't there or refuses this pair of descriptors (EINVAL, ENOSYS) we go on with stream_mmap,
+ *        from where it stopped. Elsewhere (BSD/macOS sendfile only writes to sockets) it's stream_mmap from the start.
+*/
+static void stream (int fd, int out, long size) {
+  long    off = 0;
+#ifdef __linux__
+  off_t   pos = 0;
+  ssize_t n = 0;
+
+  while (!use_mmap && off < size) {
+    if ( (n = sendfile(out, fd, &pos, (size - off > ZC_CHUNK) ? ZC_CHUNK : size - off)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EINVAL || errno == ENOSYS) {
+        break;
+      }
+      err_sys("zc_client: sendfile error");
+    }
+    if (n == 0) {
+      break;            /* the file shrank since the server looked */
+    }
+    off = (long) pos;
+  }
+  if (off < size && (use_mmap || n != 0)) {
+    stream_mmap(fd, out, off, size);
+  }
+#else
+  stream_mmap(fd, out, off, size);
+#endif
+}
+
+/*
+ * Functionality:
+ *    ->  Read the filename from standard input (like client.c), send it to the server and half-close, so the server
+ *        sees the end of the name.
+ *    ->  Get the zc_ctl and the descriptor. An error is printed the way the other clients print the server's error
+ *        message, on standard output.
+ *    ->  Stream the file to standard output.
+*/
+int main (int argc, char **argv) {
+  struct sockaddr_un  addr;
+  char                filename[ZC_MAXNAME];
+  zc_ctl              ctl;
+  int                 sockfd, fd, n;
+
+  if (argc > 1 && strcmp(argv[1], "-w") == 0) {
+    use_mmap = 1;
+  }
+
+  if (fgets(filename, sizeof(filename), stdin) == NULL) {
+    err_sys("filename read error");
+  }
+  n = strlen(filename);
+  if (n > 0 && filename[n-1] == '\n') {
+    n--;      /* ignore new-line from fgets */
+  }
+
+  if ( (sockfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+    err_sys("zc_client: can't open socket");
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, ZC_PATH, sizeof(addr.sun_path) - 1);
+  if (connect(sockfd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    err_sys("zc_client: can't connect to %s", ZC_PATH);
+  }
+
+  if (write(sockfd, filename, n) != n || shutdown(sockfd, SHUT_WR) < 0) {
+    err_sys("zc_client: can't send the filename");
+  }
+  if (recv_fd(sockfd, &fd, &ctl, sizeof(ctl)) != sizeof(ctl)) {
+    err_sys("zc_client: no answer from the server");
+  }
+  close(sockfd);
+
+  if (ctl.status != 0) {
+    ctl.mesg[sizeof(ctl.mesg) - 1] = '\0';
+    printf("%s\n", ctl.mesg);
+    exit(EXIT_FAILURE);
+  }
+  if (fd < 0) {
+    err_sys("zc_client: the server sent no descriptor");
+  }
+
+  stream(fd, 1, ctl.size);
+  close(fd);
+
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,171 @@
+#ifdef __linux__
+#define _GNU_SOURCE                 /* memfd_create */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#ifdef __linux__
+  #include <sys/mman.h>
+#endif
+
+#include "zc.h"
+#include "err_routine.h"
+
+int   force_copy = 0;               /* -m: always pass a memory file, also for regular files */
+
+void  zc_server (int connfd);
+
+/*
+ * Functionality:
+ *    ->  Listen on the Unix domain socket ZC_PATH.
+ *    ->  Serve the clients one after the other (zc_server, below). There's no reason to fork: all the server does for
+ *        a client is an `open` and a `sendmsg`, the transfer itself is the client's business.
+ *    ->  Unlike server.c, it doesn't stop after the first client. Stop it with an interrupt.
+*/
+int main (int argc, char **argv) {
+  struct sockaddr_un  addr;
+  int                 listenfd, connfd;
+
+  if (argc > 1 && strcmp(argv[1], "-m") == 0) {
+    force_copy = 1;
+  }
+  signal(SIGPIPE, SIG_IGN);         /* a client that went away is its problem, not ours */
+
+  if ( (listenfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+    err_sys("zc_server: can't open socket");
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, ZC_PATH, sizeof(addr.sun_path) - 1);
+  unlink(ZC_PATH);
+  if (bind(listenfd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    err_sys("zc_server: can't bind %s", ZC_PATH);
+  }
+  if (listen(listenfd, 5) < 0) {
+    err_sys("zc_server: can't listen");
+  }
+
+  for (;;) {
+    if ( (connfd = accept(listenfd, (struct sockaddr *) 0, (socklen_t *) 0)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      err_sys("zc_server: accept error");
+    }
+    zc_server(connfd);
+    close(connfd);
+  }
+}
+
+/*
+ * A file we can map, with what's in `fd` (which isn't mappable, or -m was given), at most `max` bytes. `fd` may be
+ * non-blocking: EAGAIN means that's all there is for now, and that's what the client gets. More than `max` is EFBIG.
+ * Returns the new descriptor, or -1 with errno set.
+*/
+static int copy_to_memfile (int fd, long max, long *size) {
+  char    buff[65536];
+  int     mfd;
+  ssize_t n;
+
+#ifdef __linux__
+  if ( (mfd = memfd_create("zc_server", MFD_CLOEXEC)) < 0) {
+    return -1;
+  }
+#else
+  char    tmpl[] = "/tmp/zc_server.XXXXXX";
+
+  if ( (mfd = mkstemp(tmpl)) < 0) {
+    return -1;
+  }
+  unlink(tmpl);             /* nobody else can open it, it goes away when the last descriptor is closed */
+#endif
+
+  *size = 0;
+  while ( (n = read(fd, buff, sizeof(buff))) > 0) {
+    if (*size + n > max) {
+      close(mfd);
+      errno = EFBIG;
+      return -1;
+    }
+    if (write(mfd, buff, n) != n) {
+      close(mfd);
+      return -1;
+    }
+    *size += n;
+  }
+  if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+    close(mfd);
+    return -1;
+  }
+
+  return mfd;
+}
+
+/*
+ * Functionality:
+ *    ->  Read the filename, the client half-closes the connection after it. A client that doesn't within ZC_TIMEOUT
+ *        seconds (SO_RCVTIMEO) gets ETIMEDOUT.
+ *    ->  Open it, with O_NONBLOCK so a FIFO without a writer doesn't keep us in open(). For a regular file the
+ *        descriptor goes to the client as it is (blocking again), with its size from fstat. Otherwise (or with -m)
+ *        the contents are copied into a memory file first and that goes instead: st_size bytes with -m, and at most
+ *        ZC_MAXCOPY of anything else. So are regular files of size 0: files in /proc and /sys say 0 and still have
+ *        something to read.
+ *    ->  If anything fails, the zc_ctl carries the errno and the message, and no descriptor.
+ *    ->  Our copy of the descriptor is closed right after sending. The client's copy refers to the same open file.
+*/
+void zc_server (int connfd) {
+  char            filename[ZC_MAXNAME];
+  zc_ctl          ctl;
+  struct stat     st;
+  struct timeval  tv;
+  int             filefd = -1, sendfd = -1, len = 0, n = 0;
+
+  tv.tv_sec   = ZC_TIMEOUT;
+  tv.tv_usec  = 0;
+  setsockopt(connfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  while (len < (int) sizeof(filename) - 1 && (n = read(connfd, filename + len, sizeof(filename) - 1 - len)) > 0) {
+    len += n;
+  }
+  filename[len] = '\0';
+
+  memset(&ctl, 0, sizeof(ctl));
+  if (n < 0) {
+    ctl.status = (errno == EAGAIN || errno == EWOULDBLOCK) ? ETIMEDOUT : errno;
+  } else if ( (filefd = open(filename, O_RDONLY | O_NONBLOCK)) < 0 || fstat(filefd, &st) < 0) {
+    ctl.status = errno;
+  } else if (S_ISREG(st.st_mode) && st.st_size > 0 && !force_copy) {
+    fcntl(filefd, F_SETFL, fcntl(filefd, F_GETFL) & ~O_NONBLOCK);
+    sendfd    = filefd;
+    ctl.size  = (long) st.st_size;
+  } else if ( (sendfd = copy_to_memfile(filefd, (S_ISREG(st.st_mode) && st.st_size > 0) ? (long) st.st_size : ZC_MAXCOPY,
+                                        &ctl.size)) < 0) {
+    ctl.status = errno;
+  }
+
+  if (ctl.status != 0) {
+    snprintf(ctl.mesg, sizeof(ctl.mesg), "%s: can't open, %s", filename, strerror(ctl.status));
+    sendfd = -1;
+  }
+
+  if (send_fd(connfd, sendfd, &ctl, sizeof(ctl)) != sizeof(ctl)) {
+    ;                 /* the client is gone */
+  }
+
+  if (filefd >= 0) {
+    close(filefd);
+  }
+  if (sendfd >= 0 && sendfd != filefd) {
+    close(sendfd);
+  }
+}
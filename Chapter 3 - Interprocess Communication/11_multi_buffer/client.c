@@ -1,3 +1,7 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* getopt with -ansi */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
@@ -8,22 +12,52 @@
 
 #include "mesg.h"
 #include "shm.h"
+#include "shmseg.h"
 #include "err_routine.h"
 #include "semaphore.h"
 
-int   clisem, servsem;        /* semaphore IDs */
-int   shmid[NBUFF];           /* shared memory IDs */
-Mesg  *mesgptr[NBUFF];        /* pointer to message structure, which are in the shared memory segment */
+int     clisem, servsem;      /* semaphore IDs */
+shmseg  seg;                  /* the shared memory segment with all the buffers */
+long    nbuff;                /* number of buffers in it, from the segment's header */
+Mesg    **mesgptr;            /* pointer to message structure, which are in the shared memory segment */
+shm_handoff *handoff;         /* in the segment's header page, see shm.h */
+waiter  w;                    /* how we wait for the server, see wait.h */
+
+/*
+ * sem_wait/sem_signal on the System V semaphore `semid`, or on the wsem `s` if the server was started with -w.
+*/
+static void handoff_wait (int semid, wsem *s) {
+  if (handoff->usewsem) {
+    wsem_wait(&w, s);
+  } else {
+    sem_wait(semid);
+  }
+}
+
+static void handoff_signal (int semid, wsem *s) {
+  if (handoff->usewsem) {
+    wsem_post(s);
+  } else {
+    sem_signal(semid);
+  }
+}
 
 /*
  * Functionality: The following things happen in the main function.
- *    ->  The client will first get the shared memory IDs, each having the storage size equivalent to sizeof(Mesg) 
- *    ->  For each shared memory segment created, element of mesgptr--an array of pointers to struct Mesg--is assigned the 
- *        pointer to respective shared memory segment. 
+ *
+ *        ./client [-P] [-L] [-w adaptive|spin|block] [-c cpu] [-v]
+ *
+ *    ->  The client will first attach the shared memory segment. The number of buffers and their size are whatever the
+ *        server chose, they're read from the segment's header (see shmseg.h). -P and -L are the same as the server's,
+ *        for the client's own mapping.
+ *    ->  Which semaphores to use is also the server's choice (shm.h). If it's the wsem's, -w says how the client
+ *        waits on them and -c pins it to a CPU, like for the server.
+ *    ->  For each buffer in the segment, element of mesgptr--an array of pointers to struct Mesg--is assigned the 
+ *        pointer to respective buffer. 
  *    ->  The semaphores are fetched using the sem_open wrapper. sem_open will modify the number of processes that are waiting 
  *        to get hold of the resource.
  *    ->  The client function is called (described below).
- *    ->  After all the message passing is done, its the client process's job to detach and remove the shared memory segments.
+ *    ->  After all the message passing is done, its the client process's job to detach and remove the shared memory segment.
  *        shmdt is used to detach, whilst shmctl (with IPC_RMID) is used to remove the shared memory segments.
  *    ->  The client also closes the semaphores. (We are not sure if the its the client or server process which removes the 
  *        semaphore IDs, but the final call to sem_close will remove, given no other processes are waiting.)
@@ -46,57 +80,98 @@ Mesg  *mesgptr[NBUFF];        /* pointer to message structure, which are in the
  *
  *    ->  Not ideal like other solutions, but putting the server process into sleep or usleep before exiting somehow solves
  *        the problem described above.
+ *
+ *    ->  What the server does now is the second approach without the polling: the client sets `done` in the segment
+ *        after the last buffer, and the server sleeps until it does (shm.h).
 */
-int main (void) {
+int main (int argc, char **argv) {
 
   register int    i;
+  int             c, flags = 0, usewsem, profile = WAIT_ADAPTIVE, cpu = -1, verbose = 0;
+
+  while ( (c = getopt(argc, argv, "PLw:c:v")) != -1) {
+    switch (c) {
+      case 'P': flags  |= SHMSEG_POPULATE;      break;
+      case 'L': flags  |= SHMSEG_LOCK;          break;
+      case 'w': profile = wait_profile(optarg); break;
+      case 'c': cpu     = atoi(optarg);         break;
+      case 'v': verbose = 1;                    break;
+      default:
+        err_sys("usage: %s [-P] [-L] [-w adaptive|spin|block] [-c cpu] [-v]", argv[0]);
+    }
+  }
+  if (profile < 0) {
+    err_sys("client: the profiles are adaptive, spin and block");
+  }
+  if (cpu >= 0 && wait_pin(cpu) < 0) {
+    err_ret("client: can't pin to CPU %d", cpu);
+  }
+  wait_init(&w, profile);
 
   /*
-   * Get the shared memory segments and attach them.
-   * We don't specify IPC_CREAT, assuming the server creates them.
+   * Get the shared memory segment and attach it.
+   * We don't specify IPC_CREAT, assuming the server creates it.
   */
-  
-  for (i = 0; i < NBUFF; i++) {
-    if ( (shmid[i] = shmget(SHMKEY + i, sizeof(Mesg), 0)) < 0) {
-      err_sys("client: can't get shared memory segment");
-    }
+  if (shmseg_attach(&seg, SHMKEY, flags) < 0) {
+    err_sys("client: can't attach shared memory segment");
+  }
+  nbuff = seg.hdr->nbuff;
 
-    if ( (mesgptr[i] = (Mesg *) shmat(shmid[i], (char *) 0, 0)) == (Mesg *) -1) {
-      err_sys("client: can't attach shared memory segment");
-    }
+  if ( (mesgptr = (Mesg **) malloc(nbuff * sizeof(Mesg *))) == NULL) {
+    err_sys("client: out of memory");
   }
+  for (i = 0; i < nbuff; i++) {
+    mesgptr[i] = (Mesg *) shmseg_buf(&seg, i);
+  }
+  handoff = (shm_handoff *) shmseg_user(&seg);
 
   /*
-   * Open two semaphores. 
+   * Open two semaphores, once the server has made them.
   */
-  if ( (clisem = sem_open(SEMKEY1)) < 0) {
-    err_sys("client: can't open client semaphore");
+  if (__atomic_load_n(&handoff->ready, __ATOMIC_ACQUIRE) == 0) {
+    wait_change(&w, &handoff->ready, &handoff->ready_waiters, 0);
   }
-  if ( (servsem = sem_open(SEMKEY2)) < 0) {
-    err_sys("client: can't open server semaphore");
+  if (!(usewsem = handoff->usewsem)) {
+    if ( (clisem = sem_open(SEMKEY1)) < 0) {
+      err_sys("client: can't open client semaphore");
+    }
+    if ( (servsem = sem_open(SEMKEY2)) < 0) {
+      err_sys("client: can't open server semaphore");
+    }
   }
 
   client();
 
   /*
-   * Detach and remove the shared memory segments and close the semaphores.
+   * Tell the server we're done with the semaphores, it waits for this before it exits.
   */
-  for (i = 0; i < NBUFF; i++) {
-    if (shmdt(mesgptr[i]) < 0) {
-      err_sys("client: can't detach shared memory %d", i);
-    }
-    if (shmctl(shmid[i], IPC_RMID, (struct shmid_ds *) 0) < 0) {
-      err_sys("client: can't remove shared memory %d", i);
-    }
+  __atomic_store_n(&handoff->done, 1, __ATOMIC_RELEASE);
+  wait_wake(&handoff->done, &handoff->done_waiters);
+  if (verbose) {
+    fprintf(stderr, "client: %ld waits ended spinning, %ld yielding, %ld sleeping, spin budget %u\n",
+            w.nspin, w.nyield, w.nsleep, w.budget);
   }
 
+  /*
+   * Detach and remove the shared memory segment and close the semaphores.
+  */
+  if (shmseg_detach(&seg) < 0) {
+    err_sys("client: can't detach shared memory");
+  }
+  if (shmseg_remove(&seg) < 0) {
+    err_sys("client: can't remove shared memory");
+  }
+  free(mesgptr);
+
   /*
     printf("\n[LOG] The value of the client semaphore before closing: %d\n", semctl(clisem, 0, GETVAL));
     printf("\n[LOG] The value of the server semaphore before closing: %d\n", semctl(clisem, 0, GETVAL));
   */
 
-  sem_close(clisem);        /* will remove the semaphore */
-  sem_close(servsem);       /* will remove the semaphore */
+  if (!usewsem) {         /* not handoff->usewsem, the segment is gone */
+    sem_close(clisem);        /* will remove the semaphore */
+    sem_close(servsem);       /* will remove the semaphore */
+  }
   
   exit(EXIT_SUCCESS);
 }
@@ -126,7 +201,7 @@ void client (void) {
   /*
    * Read the filename from standard input, write it to shared memory
   */
-  sem_wait(clisem);       /* wait for server to initialize */
+  handoff_wait(clisem, &handoff->cli);       /* wait for server to initialize */
 
   if (fgets(mesgptr[0]->mesg_data, MAXMESGDATA, stdin) == NULL) {
     err_sys("filename read error");
@@ -137,15 +212,15 @@ void client (void) {
     n--;      /* ignore new-line from fgets */
   }
   mesgptr[0]->mesg_len = n;
-  sem_signal(servsem);                    /* wake up server */
+  handoff_signal(servsem, &handoff->serv);                    /* wake up server */
 
   /*
     printf("[LOG] The value of the client semaphore is: %d\n", semctl(clisem, 0, GETVAL));
   */
 
   for (;;) {
-    for (i = 0; i < NBUFF; i++) {
-      sem_wait(clisem);
+    for (i = 0; i < nbuff; i++) {
+      handoff_wait(clisem, &handoff->cli);
       if ( (n = mesgptr[i]->mesg_len) <= 0) {
         goto alldone;
       }
@@ -157,7 +232,7 @@ void client (void) {
         printf("\n[LOG-CLIENT] clisem: %d, i: %d, servsem: %d, n: %d\n", semctl(clisem, 0, GETVAL), i, semctl(servsem, 0, GETVAL), n);
       */
       
-      sem_signal(servsem);
+      handoff_signal(servsem, &handoff->serv);
     }
   }
 
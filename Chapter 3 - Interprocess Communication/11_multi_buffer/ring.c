@@ -0,0 +1,148 @@
+#include "ring.h"
+
+#include <string.h>
+
+/*
+ * Wait until *word is no longer `seen`, and return what it is now. The waiting itself is wait_change(), the
+ * `_waiting` count is its `waiters`: the sleeper counts itself in *before* it looks at the word for the last time,
+ * and the other side stores the word *before* it looks at the count, so a wake-up isn't lost (see wait.c).
+ *
+ * The words are _Atomic uint32_t here and plain unsigned ints used with __atomic builtins in wait.c, which is the
+ * same thing to GCC and clang.
+*/
+static uint32_t ring_sleep (ring *r, _Atomic uint32_t *word, _Atomic uint32_t *waiting, uint32_t seen) {
+  return wait_change(&r->w, (unsigned int *) word, (unsigned int *) waiting, seen);
+}
+
+static void ring_wake (_Atomic uint32_t *word, _Atomic uint32_t *waiting) {
+  wait_wake((unsigned int *) word, (unsigned int *) waiting);
+}
+
+void ring_init (ring_hdr *h, char *buf, uint32_t size) {
+  atomic_init(&h->head, 0);
+  atomic_init(&h->head_waiting, 0);
+  atomic_init(&h->tail, 0);
+  atomic_init(&h->tail_waiting, 0);
+  h->size = size;
+  h->off  = (uint32_t) (buf - (char *) h);
+}
+
+void ring_attach (ring *r, ring_hdr *h, int side) {
+  r->h    = h;
+  r->buf  = (char *) h + h->off;
+  r->mask = h->size - 1;
+  if (side == RING_PRODUCER) {
+    r->pos  = atomic_load(&h->tail) & RING_POS;
+    r->peer = atomic_load(&h->head);
+  } else {
+    r->pos  = atomic_load(&h->head);
+    r->peer = atomic_load(&h->tail);
+  }
+  wait_init(&r->w, WAIT_ADAPTIVE);
+}
+
+/*
+ * Functionality:
+ *    ->  Free space is size - (tail - head). If our copy of `head` says there is none, read the real one, the
+ *        consumer may have moved it. Only if that's still full do we wait, on `head`.
+ *    ->  The space handed out stops at the end of the buffer, the part at the start comes with the next call.
+*/
+size_t ring_wbuf (ring *r, char **p) {
+  ring_hdr  *h = r->h;
+  uint32_t  used, idx, n;
+
+  while ( (used = (r->pos - r->peer) & RING_POS) == h->size) {
+    r->peer = atomic_load_explicit(&h->head, memory_order_acquire);
+    if ( ((r->pos - r->peer) & RING_POS) == h->size) {
+      r->peer = ring_sleep(r, &h->head, &h->head_waiting, r->peer);
+    }
+  }
+
+  idx = r->pos & r->mask;
+  n   = h->size - used;
+  if (n > h->size - idx) {
+    n = h->size - idx;
+  }
+  *p = r->buf + idx;
+
+  return n;
+}
+
+void ring_wcommit (ring *r, size_t n) {
+  r->pos = (r->pos + (uint32_t) n) & RING_POS;
+  atomic_store(&r->h->tail, r->pos);           /* publishes the data too (seq_cst is at least release) */
+  ring_wake(&r->h->tail, &r->h->tail_waiting);
+}
+
+void ring_close (ring *r) {
+  atomic_store(&r->h->tail, r->pos | RING_EOF);
+  ring_wake(&r->h->tail, &r->h->tail_waiting);
+}
+
+/*
+ * Functionality: Same as ring_wbuf() the other way around. Returns 0 only when the ring is empty *and* the producer
+ * has closed it.
+*/
+size_t ring_rbuf (ring *r, char **p) {
+  ring_hdr  *h = r->h;
+  uint32_t  avail, idx;
+
+  while ( (avail = ((r->peer & RING_POS) - r->pos) & RING_POS) == 0) {
+    r->peer = atomic_load_explicit(&h->tail, memory_order_acquire);
+    if ( (avail = ((r->peer & RING_POS) - r->pos) & RING_POS) != 0) {
+      break;
+    }
+    if (r->peer & RING_EOF) {
+      return 0;
+    }
+    r->peer = ring_sleep(r, &h->tail, &h->tail_waiting, r->peer);
+  }
+
+  idx = r->pos & r->mask;
+  if (avail > h->size - idx) {
+    avail = h->size - idx;
+  }
+  *p = r->buf + idx;
+
+  return avail;
+}
+
+void ring_rcommit (ring *r, size_t n) {
+  r->pos = (r->pos + (uint32_t) n) & RING_POS;
+  atomic_store(&r->h->head, r->pos);
+  ring_wake(&r->h->head, &r->h->head_waiting);
+}
+
+void ring_write (ring *r, const char *buf, size_t n) {
+  char    *p;
+  size_t  len;
+
+  while (n > 0) {
+    if ( (len = ring_wbuf(r, &p)) > n) {
+      len = n;
+    }
+    memcpy(p, buf, len);
+    ring_wcommit(r, len);
+    buf += len;
+    n   -= len;
+  }
+}
+
+/*
+ * Waits for at least one byte, returns fewer than `n` if that's all there is for now. 0 on end of data.
+*/
+size_t ring_read (ring *r, char *buf, size_t n) {
+  char    *p;
+  size_t  len;
+
+  if ( (len = ring_rbuf(r, &p)) == 0) {
+    return 0;
+  }
+  if (len > n) {
+    len = n;
+  }
+  memcpy(buf, p, len);
+  ring_rcommit(r, len);
+
+  return len;
+}
@@ -0,0 +1,116 @@
+/*
+ *  A single-producer/single-consumer ring buffer that lives in shared memory.
+ *
+ *  The NBUFF version (server.c/client.c) hands every buffer over with two semop() calls, one to give the buffer to
+ *  the other side and one to wait for the next, so a file is moved 4080 bytes and two system calls at a time. With
+ *  one producer and one consumer we don't need a semaphore at all:
+ *    ->  The producer only ever writes `tail` and the consumer only ever writes `head`. Both are free running byte
+ *        positions, (tail - head) is what's in the ring. Each side keeps its own copy of the index it owns and the
+ *        last value it saw of the other one, so the shared words are only read when the copy says full/empty.
+ *    ->  `head` and `tail` sit on their own cache lines, otherwise every write of one side would throw the line out
+ *        of the other side's cache (false sharing).
+ *    ->  A side only waits when the ring really is empty (consumer) or full (producer), and it waits on the index
+ *        word of the other side, which changes as soon as there's something to do. How it waits is up to its waiter
+ *        (wait.h): spin a while, then yield, then sleep (futex on Linux). The other side only makes the wake-up system
+ *        call if the `_waiting` count says someone is asleep.
+ *    ->  The producer's close sets RING_EOF in `tail`, so the close itself is a change of the word the consumer sleeps
+ *        on. This is why the positions are only 31 bits wide.
+ *
+ *  The producer and consumer get the memory in place (ring_wbuf/ring_rbuf) so the data can be read() from the file
+ *  straight into the ring and write() out of it, no extra copy in between.
+ *
+ *  The routines available:
+ *    1.  ring_init(h, buf, size);    // set up a ring (the creator, once)
+ *    2.  ring_attach(r, h, side);    // get a handle for one side of it (RING_PRODUCER or RING_CONSUMER), it waits
+ *                                    // with WAIT_ADAPTIVE, wait_init(&r->w, profile) for another profile
+ *    3.  n = ring_wbuf(r, &p);       // producer: wait for free space, n contiguous bytes at p
+ *    4.  ring_wcommit(r, n);         // producer: n bytes at p are written
+ *    5.  ring_close(r);              // producer: no more data
+ *    6.  n = ring_rbuf(r, &p);       // consumer: wait for data, n contiguous bytes at p, 0 on end of data
+ *    7.  ring_rcommit(r, n);         // consumer: n bytes at p are used up
+ *    8.  ring_write(r, buf, n);      // copying versions of the above
+ *    9.  n = ring_read(r, buf, n);
+*/
+
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "shm.h"
+#include "wait.h"
+
+#define   RING_CACHELINE    64
+#define   RING_EOF          0x80000000u     /* set in `tail` by ring_close() */
+#define   RING_POS          0x7fffffffu     /* positions wrap at 2^31 */
+
+#define   RING_PRODUCER     0
+#define   RING_CONSUMER     1
+
+/*
+ * The part that is in shared memory. The data is `off` bytes from the start of the header, so the header works at
+ * whatever address each process attached the segment.
+*/
+typedef struct {
+  _Alignas(RING_CACHELINE)
+  _Atomic uint32_t  head;             /* next byte to read, written by the consumer only */
+  _Atomic uint32_t  head_waiting;     /* how many are asleep on `head` (the producer) */
+
+  _Alignas(RING_CACHELINE)
+  _Atomic uint32_t  tail;             /* next byte to write, written by the producer only */
+  _Atomic uint32_t  tail_waiting;     /* how many are asleep on `tail` (the consumer) */
+
+  _Alignas(RING_CACHELINE)
+  uint32_t          size;             /* power of 2, at most 2^30 */
+  uint32_t          off;              /* where the data starts, from the header */
+} ring_hdr;
+
+/*
+ * One side's handle, private to the process.
+*/
+typedef struct {
+  ring_hdr  *h;
+  char      *buf;
+  uint32_t  mask;
+  uint32_t  pos;                      /* our index (head or tail) */
+  uint32_t  peer;                     /* what we last saw of the other one */
+  waiter    w;                        /* how we wait for it */
+} ring;
+
+/*
+ * The segment used by ring_server and ring_client: the filename goes to the server through `req`, the file comes
+ * back through `data`. The server sets `ready` to RING_READY once both rings are set up.
+*/
+#define   RING_READY        0x52494e47u     /* "RING" */
+
+typedef struct {
+  ring_hdr          req;
+  ring_hdr          data;
+  _Atomic uint32_t  ready;
+  _Alignas(RING_CACHELINE)
+  char              reqbuf[RING_REQSIZE];
+  _Alignas(RING_CACHELINE)
+  char              databuf[RING_DATASIZE];
+} ring_seg;
+
+void    ring_init     (ring_hdr *h, char *buf, uint32_t size);
+
+void    ring_attach   (ring *r, ring_hdr *h, int side);
+
+size_t  ring_wbuf     (ring *r, char **p);
+
+void    ring_wcommit  (ring *r, size_t n);
+
+void    ring_close    (ring *r);
+
+size_t  ring_rbuf     (ring *r, char **p);
+
+void    ring_rcommit  (ring *r, size_t n);
+
+void    ring_write    (ring *r, const char *buf, size_t n);
+
+size_t  ring_read     (ring *r, char *buf, size_t n);
+
+#endif
@@ -0,0 +1,109 @@
+#ifdef __linux__
+#define _GNU_SOURCE                         /* nanosleep() and getopt() with -std=c11 */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shm.h"
+#include "ring.h"
+#include "err_routine.h"
+
+int       shmid;
+ring_seg  *seg;
+int       profile = WAIT_ADAPTIVE;      /* how we wait on the rings, see wait.h */
+
+void ring_client (void);
+
+/*
+ * Functionality:
+ *    ->  The segment must already exist (the server creates it). After attaching, we wait until the server has set
+ *        it up. This is the only polling left, and it only happens once at start up.
+ *    ->  -w and -c are the same as the server's.
+ *    ->  ring_client (described below) does the work.
+ *    ->  The segment is detached and removed. The server may still be attached; the segment goes away when it
+ *        detaches too.
+*/
+int main (int argc, char **argv) {
+  struct timespec   ts = { 0, 1000000 };
+  int               c, cpu = -1;
+
+  while ( (c = getopt(argc, argv, "w:c:")) != -1) {
+    switch (c) {
+      case 'w': profile = wait_profile(optarg); break;
+      case 'c': cpu     = atoi(optarg);         break;
+      default:
+        err_sys("usage: %s [-w adaptive|spin|block] [-c cpu]", argv[0]);
+    }
+  }
+  if (profile < 0) {
+    err_sys("ring_client: the profiles are adaptive, spin and block");
+  }
+  if (cpu >= 0 && wait_pin(cpu) < 0) {
+    err_ret("ring_client: can't pin to CPU %d", cpu);
+  }
+
+  if ( (shmid = shmget(RINGKEY, sizeof(ring_seg), 0)) < 0) {
+    err_sys("ring_client: can't get shared memory segment");
+  }
+  if ( (seg = (ring_seg *) shmat(shmid, (char *) 0, 0)) == (ring_seg *) -1) {
+    err_sys("ring_client: can't attach shared memory segment");
+  }
+
+  while (atomic_load(&seg->ready) != RING_READY) {
+    nanosleep(&ts, (struct timespec *) 0);
+  }
+
+  ring_client();
+
+  if (shmdt(seg) < 0) {
+    err_sys("ring_client: can't detach shared memory");
+  }
+  if (shmctl(shmid, IPC_RMID, (struct shmid_ds *) 0) < 0) {
+    err_sys("ring_client: can't remove shared memory");
+  }
+
+  exit(EXIT_SUCCESS);
+}
+
+/*
+ * Functionality:
+ *    ->  The filename is read from standard input and written to the request ring, which is then closed so the server
+ *        knows the name is complete.
+ *    ->  Whatever is in the data ring is written to standard output right from the ring, and handed back to the server
+ *        with ring_rcommit. We only block when the ring is empty; ring_rbuf returns 0 once the server has closed it and
+ *        everything was read.
+*/
+void ring_client (void) {
+  ring      req, data;
+  char      filename[RING_REQSIZE], *p;
+  size_t    n;
+
+  ring_attach(&req, &seg->req, RING_PRODUCER);
+  ring_attach(&data, &seg->data, RING_CONSUMER);
+  wait_init(&req.w, profile);
+  wait_init(&data.w, profile);
+
+  if (fgets(filename, sizeof(filename), stdin) == NULL) {
+    err_sys("filename read error");
+  }
+  n = strlen(filename);
+  if (n > 0 && filename[n-1] == '\n') {
+    n--;      /* ignore new-line from fgets */
+  }
+  ring_write(&req, filename, n);
+  ring_close(&req);
+
+  while ( (n = ring_rbuf(&data, &p)) > 0) {
+    if (write(1, p, n) != (ssize_t) n) {
+      err_sys("data write error");
+    }
+    ring_rcommit(&data, n);
+  }
+}
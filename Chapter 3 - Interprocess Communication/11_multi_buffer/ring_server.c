@@ -0,0 +1,120 @@
+#ifdef __linux__
+#define _GNU_SOURCE                         /* getopt() with -std=c11 */
+#endif
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "shm.h"
+#include "ring.h"
+#include "err_routine.h"
+
+#define   RING_CHUNK    (64 * 1024)     /* most we read() into the ring at once, so the client can start early */
+
+int       shmid;
+ring_seg  *seg;
+int       profile = WAIT_ADAPTIVE;      /* how we wait on the rings, see wait.h */
+
+void ring_server (void);
+
+/*
+ * Functionality: Same job as server.c, but with one segment and no semaphores.
+ *    ->  -w picks how we wait when a ring is empty or full (wait.h), -c pins us to a CPU, which is what `-w spin`
+ *        is meant for. The client takes the same options.
+ *    ->  The segment (ring_seg in ring.h) is created and attached. `ready` is cleared first, then both rings are set
+ *        up and `ready` is set, which is what the client waits for after it attached.
+ *    ->  ring_server (described below) does the work.
+ *    ->  The segment is detached. Like in the NBUFF version, the client removes it.
+*/
+int main (int argc, char **argv) {
+  int               c, cpu = -1;
+
+  while ( (c = getopt(argc, argv, "w:c:")) != -1) {
+    switch (c) {
+      case 'w': profile = wait_profile(optarg); break;
+      case 'c': cpu     = atoi(optarg);         break;
+      default:
+        err_sys("usage: %s [-w adaptive|spin|block] [-c cpu]", argv[0]);
+    }
+  }
+  if (profile < 0) {
+    err_sys("ring_server: the profiles are adaptive, spin and block");
+  }
+  if (cpu >= 0 && wait_pin(cpu) < 0) {
+    err_ret("ring_server: can't pin to CPU %d", cpu);
+  }
+
+  if ( (shmid = shmget(RINGKEY, sizeof(ring_seg), PERMS | IPC_CREAT)) < 0) {
+    err_sys("ring_server: can't get shared memory");
+  }
+  if ( (seg = (ring_seg *) shmat(shmid, (char *) 0, 0)) == (ring_seg *) -1) {
+    err_sys("ring_server: can't attach shared memory");
+  }
+
+  atomic_store(&seg->ready, 0);
+  ring_init(&seg->req, seg->reqbuf, RING_REQSIZE);
+  ring_init(&seg->data, seg->databuf, RING_DATASIZE);
+  atomic_store(&seg->ready, RING_READY);
+
+  ring_server();
+
+  if (shmdt(seg) < 0) {
+    err_sys("ring_server: can't detach shared memory");
+  }
+
+  return 0;
+}
+
+/*
+ * Functionality:
+ *    ->  The filename is read from the request ring until the client closes it. This is where the server waits for
+ *        the client to show up.
+ *    ->  If the file can't be opened, the error message is sent in place of the file's contents, as before.
+ *    ->  Otherwise the file is read() straight into the free space of the data ring, at most RING_CHUNK bytes at a
+ *        time, and each piece is handed over with ring_wcommit. We only block when the ring is full.
+ *    ->  Closing the data ring is the end of file for the client (there's no 0-length message anymore).
+*/
+void ring_server (void) {
+  ring      req, data;
+  char      filename[RING_REQSIZE], errmesg[RING_REQSIZE + 256], *p;
+  size_t    len = 0, n;
+  ssize_t   nread;
+  int       filefd;
+
+  ring_attach(&req, &seg->req, RING_CONSUMER);
+  ring_attach(&data, &seg->data, RING_PRODUCER);
+  wait_init(&req.w, profile);
+  wait_init(&data.w, profile);
+
+  while (len < sizeof(filename) - 1 && (n = ring_read(&req, filename + len, sizeof(filename) - 1 - len)) > 0) {
+    len += n;
+  }
+  filename[len] = '\0';
+
+  if ( (filefd = open(filename, 0)) < 0) {
+    snprintf(errmesg, sizeof(errmesg), "%s: can't open, %s\n", filename, sys_err_str());
+    ring_write(&data, errmesg, strlen(errmesg));
+  } else {
+    for (;;) {
+      if ( (n = ring_wbuf(&data, &p)) > RING_CHUNK) {
+        n = RING_CHUNK;
+      }
+      if ( (nread = read(filefd, p, n)) < 0) {
+        err_sys("ring_server: read error");
+      }
+      if (nread == 0) {
+        break;
+      }
+      ring_wcommit(&data, nread);
+    }
+    close(filefd);
+  }
+
+  ring_close(&data);
+}
@@ -1,3 +1,7 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* getopt with -ansi */
+#endif
+
 #include <stdio.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
@@ -9,77 +13,170 @@
 
 #include "mesg.h"
 #include "shm.h"
+#include "shmseg.h"
 #include "err_routine.h"
 #include "semaphore.h"
 
-int   clisem, servsem;        /* semaphore IDs */
-int   shmid[NBUFF];           /* shared memory IDs */
-Mesg  *mesgptr[NBUFF];        /* pointer to message structure, which are in the shared memory segment */
+int     clisem, servsem;      /* semaphore IDs */
+shmseg  seg;                  /* the shared memory segment with all the buffers */
+long    nbuff;                /* number of buffers in it */
+long    maxmesgdata;          /* bytes of mesg_data in each buffer */
+Mesg    **mesgptr;            /* pointer to message structure, which are in the shared memory segment */
+shm_handoff *handoff;         /* in the segment's header page, see shm.h */
+waiter  w;                    /* how we wait for the client, see wait.h */
+
+/*
+ * sem_wait/sem_signal on the System V semaphore `semid`, or on the wsem `s` if the server was started with -w.
+*/
+static void handoff_wait (int semid, wsem *s) {
+  if (handoff->usewsem) {
+    wsem_wait(&w, s);
+  } else {
+    sem_wait(semid);
+  }
+}
+
+static void handoff_signal (int semid, wsem *s) {
+  if (handoff->usewsem) {
+    wsem_post(s);
+  } else {
+    sem_signal(semid);
+  }
+}
+
+/*
+ * "4096", "64k", "2m" -> bytes.
+*/
+static long getsize (char *s) {
+  char  *end;
+  long  n = strtol(s, &end, 10);
+
+  if (*end == 'k' || *end == 'K') {
+    n *= 1024;
+  } else if (*end == 'm' || *end == 'M') {
+    n *= 1024 * 1024;
+  }
+  return n;
+}
 
 /*
  * Functionality: The following functionality is provided by the main process of server.
- *    ->  First, the shared memory segment is initialzed (IPC_CREAT) using the appropriate PERMS.
- *        The shared memory segment is fetched using the shmat and assigned to each indices of 
- *        mesgptr array.
+ *
+ *        ./server [-n nbuff] [-s bufsize] [-H] [-P] [-L] [-w adaptive|spin|block] [-c cpu] [-v]
+ *
+ *    ->  First, the shared memory segment is initialzed with room for `nbuff` (NBUFF) buffers of `bufsize`
+ *        (sizeof(Mesg)) bytes each, see shmseg.h. -H asks for huge pages, -P faults the pages in up front and -L
+ *        locks them in memory. The client reads the number and size of the buffers from the segment's header.
+ *        A pointer to each buffer is assigned to each indices of mesgptr array.
  *    ->  The client (clisem) and server (servsem) semaphores are also initialized. 
  *        The server is responsible for initializing the semaphores using the sem_create.
+ *        With -w, the semaphores are the wsem's in the segment instead (shm.h), waited on the way the profile says
+ *        (wait.h). -c pins the server to a CPU, for `-w spin`. -v tells how the waits went at the end.
  *    ->  The server function is called (described below).
- *    ->  After the work is done, the memory segments are detached. It is the client's job to remove the 
- *        shared memory segments.
+ *    ->  After the work is done, the memory segment is detached. It is the client's job to remove the 
+ *        shared memory segment.
+ *    ->  Before exiting, the server waits for the client to say it's done (see shm.h). Exiting earlier would let
+ *        the SEM_UNDO adjustments of our sem_signal(clisem)'s hit the client while it still uses the semaphore.
  *    ->  Lastly, the semaphores are closed (We are not sure which process is the one which removes it from 
  *        the system, but it is done by sem_close by itself).
 */
-int main (void) {
+int main (int argc, char **argv) {
 
   register int      i;
+  long              bufsize = sizeof(Mesg);
+  int               c, flags = 0, usewsem = 0, profile = WAIT_ADAPTIVE, cpu = -1, verbose = 0;
 
-  /*
-   * Get the shared memory segments and attach them
-  */
-  for (i = 0; i < NBUFF; i++) {
-    if ( (shmid[i] = shmget(SHMKEY + i, sizeof(Mesg), PERMS | IPC_CREAT)) < 0) {
-      err_sys("server: can't get shared memory");
-    }
-
-    if ( (mesgptr[i] = (Mesg *) shmat(shmid[i], (char *) 0, 0)) == (Mesg *) -1) {
-      err_sys("server: can't attach shared memory");
+  nbuff = NBUFF;
+  while ( (c = getopt(argc, argv, "n:s:HPLw:c:v")) != -1) {
+    switch (c) {
+      case 'n': nbuff   = atol(optarg);         break;
+      case 's': bufsize = getsize(optarg);      break;
+      case 'H': flags  |= SHMSEG_HUGE;          break;
+      case 'P': flags  |= SHMSEG_POPULATE;      break;
+      case 'L': flags  |= SHMSEG_LOCK;          break;
+      case 'w': usewsem = 1;
+                profile = wait_profile(optarg); break;
+      case 'c': cpu     = atoi(optarg);         break;
+      case 'v': verbose = 1;                    break;
+      default:
+        err_sys("usage: %s [-n nbuff] [-s bufsize] [-H] [-P] [-L] [-w adaptive|spin|block] [-c cpu] [-v]", argv[0]);
     }
   }
+  if (profile < 0) {
+    err_sys("server: the profiles are adaptive, spin and block");
+  }
+  if (cpu >= 0 && wait_pin(cpu) < 0) {
+    err_ret("server: can't pin to CPU %d", cpu);
+  }
+  wait_init(&w, profile);
+  if (nbuff < 1 || nbuff > SHMSEG_MAXBUFF || bufsize < (long) sizeof(Mesg) || bufsize > (1L << 30)) {
+    err_sys("server: need 1 to %d buffers of %d bytes to 1 GB", SHMSEG_MAXBUFF, (int) sizeof(Mesg));
+  }
 
   /*
-   * Create two semaphores. The client semaphore starts out at 1 since the client process starts thing going.
+   * Get the shared memory segment and attach it
   */
+  if (shmseg_create(&seg, SHMKEY, nbuff, bufsize, flags) < 0) {
+    err_sys("server: can't get shared memory");
+  }
+  maxmesgdata = seg.hdr->bufsize - MESGHDRSIZE;
 
-  if ( (clisem = sem_create(SEMKEY1, 1)) < 0) {
-    err_sys("server: can't create client semaphore");
+  if ( (mesgptr = (Mesg **) malloc(nbuff * sizeof(Mesg *))) == NULL) {
+    err_sys("server: out of memory");
   }
-  if ( (servsem = sem_create(SEMKEY2, 0)) < 0) {
-    err_sys("server: can't create server semaphore");
+  for (i = 0; i < nbuff; i++) {
+    mesgptr[i] = (Mesg *) shmseg_buf(&seg, i);
   }
-
-  server();
+  handoff = (shm_handoff *) shmseg_user(&seg);
 
   /*
-   * Detach the shared memory segment and close the semaphores.
-   * The client is the last one to use the shared memory, so it'll remove it when it's done.
+   * Create two semaphores. The client semaphore starts out at 1 since the client process starts thing going.
   */
-  for (i = 0; i < NBUFF; i++) {
-    if (shmdt(mesgptr[i]) < 0) {
-      err_sys("server: can't detach shared memory");
+  if ( (handoff->usewsem = usewsem)) {
+    wsem_init(&handoff->cli, 1);
+    wsem_init(&handoff->serv, 0);
+  } else {
+    if ( (clisem = sem_create(SEMKEY1, 1)) < 0) {
+      err_sys("server: can't create client semaphore");
+    }
+    if ( (servsem = sem_create(SEMKEY2, 0)) < 0) {
+      err_sys("server: can't create server semaphore");
     }
   }
+  __atomic_store_n(&handoff->ready, 1, __ATOMIC_RELEASE);
+  wait_wake(&handoff->ready, &handoff->ready_waiters);
+
+  server();
 
   /*
     printf("[LOG] The client semaphore value before exiting: %d\n", semctl(clisem, 0, GETVAL));
     printf("[LOG] The server semaphore value before exiting: %d\n", semctl(servsem, 0, GETVAL));
   */
-  
-  while (semctl(clisem, 0, GETVAL) != 0) {
-    ;
+
+  /*
+   * Wait for the client to finish, sleeping if it takes a while.
+  */
+  if (__atomic_load_n(&handoff->done, __ATOMIC_ACQUIRE) == 0) {
+    wait_change(&w, &handoff->done, &handoff->done_waiters, 0);
+  }
+  if (verbose) {
+    fprintf(stderr, "server: %ld waits ended spinning, %ld yielding, %ld sleeping, spin budget %u\n",
+            w.nspin, w.nyield, w.nsleep, w.budget);
+  }
+
+  /*
+   * Detach the shared memory segment and close the semaphores.
+   * The client is the last one to use the shared memory, so it'll remove it when it's done.
+  */
+  if (shmseg_detach(&seg) < 0) {
+    err_sys("server: can't detach shared memory");
   }
+  free(mesgptr);
 
-  sem_close(clisem);
-  sem_close(servsem);
+  if (!usewsem) {
+    sem_close(clisem);
+    sem_close(servsem);
+  }
 
   return 0;
 }
@@ -110,7 +207,7 @@ void server (void) {
   /*
    * wait for the client to write the filename into shared memory.
   */
-  sem_wait(servsem);        /* we'll wait here for client to start things */
+  handoff_wait(servsem, &handoff->serv);        /* we'll wait here for client to start things */
 
   mesgptr[0]->mesg_data[mesgptr[0]->mesg_len] = '\0';   /* null terminate filename */
 
@@ -121,11 +218,11 @@ void server (void) {
     sprintf(errmesg, ": can't open, %s", sys_err_str());
     strcat(mesgptr[0]->mesg_data, errmesg);
     mesgptr[0]->mesg_len = strlen(mesgptr[0]->mesg_data);
-    sem_signal(clisem);         /* send to client */  /* shared memory access given to client */
+    handoff_signal(clisem, &handoff->cli);         /* send to client */  /* shared memory access given to client */
 
-    sem_wait(servsem);          /* wait for client to process */  /* sleep till the client uses sem_signal(servsem) */
-    mesgptr[1]->mesg_len = 0;
-    sem_signal(clisem);         /* wake up client */
+    handoff_wait(servsem, &handoff->serv);          /* wait for client to process */  /* sleep till the client uses sem_signal(servsem) */
+    mesgptr[1 % nbuff]->mesg_len = 0;              /* the client's next buffer, there may be only one */
+    handoff_signal(clisem, &handoff->cli);         /* wake up client */
 
   } else {  /* file is opened */
     /*
@@ -134,8 +231,8 @@ void server (void) {
      * sem_signal(), followed by our sem_wait() above. 
      * What we do is increment the semaphore value once for every buffer (i.e., the number of resources we have).
     */
-    for (i = 0; i < NBUFF; i++) {
-      sem_signal(servsem);
+    for (i = 0; i < nbuff; i++) {
+      handoff_signal(servsem, &handoff->serv);
     }
 
     /*
@@ -148,18 +245,18 @@ void server (void) {
      * final byte of a shared memory segment.
     */
     for (;;) {
-      for (i= 0; i < NBUFF; i++) {
-        sem_wait(servsem);
+      for (i= 0; i < nbuff; i++) {
+        handoff_wait(servsem, &handoff->serv);
         /*
           printf("[LOG] The value of the server semaphore is: %d\n", semctl(servsem, 0, GETVAL));
           printf("[LOG] The value of the client semaphore is: %d\n", semctl(clisem, 0, GETVAL));
         */
-        n = read(filefd, mesgptr[i]->mesg_data, MAXMESGDATA - 1);
+        n = read(filefd, mesgptr[i]->mesg_data, maxmesgdata - 1);
         if (n < 0) {
           err_sys("server: read error");
         }
         mesgptr[i]->mesg_len = n;
-        sem_signal(clisem);
+        handoff_signal(clisem, &handoff->cli);
         if (n == 0) {
           goto alldone;
         }
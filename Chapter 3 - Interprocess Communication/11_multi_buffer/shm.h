@@ -2,15 +2,39 @@
 #define SHM_H
 
 #include "mesg.h"
+#include "wait.h"
 
-#define     NBUFF     4                 /* number of buffers in shared memory */
-                                        /* (for multiple buffer version) */
+#define     NBUFF     4                 /* default number of buffers in shared memory */
+                                        /* (for multiple buffer version, ./server -n changes it) */
 
-#define     SHMKEY    ((key_t) 7890L)    /* base value of shm key */
+#define     SHMKEY    ((key_t) 7890L)    /* shm key of the segment with the buffers (shmseg.h) */
 
 #define     SEMKEY1   ((key_t) 7891L)    /* client semaphore key */
 #define     SEMKEY2   ((key_t) 7892L)    /* server semaphore key */
 
 #define     PERMS     0666              /* IPC access mode */
 
+/*
+ * Handoff state of server.c/client.c, in the programs' part of the segment's header page (shmseg_user).
+ *    ->  With `./server -w profile` the buffers are handed over with the two wsem's here (wait.h) instead of the
+ *        System V semaphores, so a handoff needs no system call unless somebody has to sleep.
+ *    ->  The server sets `ready` once the semaphores (either kind) are there. The client waits for it before it
+ *        looks at `usewsem`.
+ *    ->  Either way the client sets `done` when it has written out the last buffer. That's what the server waits for
+ *        before it exits (it used to poll the client semaphore with semctl() until it was 0).
+*/
+typedef struct {
+  unsigned int  ready;                  /* set by the server when the rest is valid */
+  unsigned int  ready_waiters;
+  unsigned int  usewsem;                /* 1: `cli` and `serv` below, 0: SEMKEY1 and SEMKEY2 */
+  wsem          cli;                    /* client semaphore, starts at 1 */
+  wsem          serv;                   /* server semaphore, starts at 0 */
+  unsigned int  done;                   /* set by the client at the end */
+  unsigned int  done_waiters;
+} shm_handoff;
+
+#define     RINGKEY       ((key_t) 7900L)   /* shm key of the ring version (ring_server/ring_client) */
+#define     RING_REQSIZE  4096              /* client -> server ring, holds the filename */
+#define     RING_DATASIZE (1 << 20)         /* server -> client ring, power of 2 */
+
 #endif
@@ -0,0 +1,203 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* SHM_HUGETLB, madvise, mlock, nanosleep with -ansi */
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/mman.h>
+
+#include "shm.h"
+#include "shmseg.h"
+#include "err_routine.h"
+
+/*
+ * Size of a huge page, from the "Hugepagesize:" line of /proc/meminfo. 0 if there's no such thing.
+*/
+static long huge_page_size (void) {
+  FILE  *fp;
+  char  line[128];
+  long  kb = 0;
+
+  if ( (fp = fopen("/proc/meminfo", "r")) == NULL) {
+    return 0;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (sscanf(line, "Hugepagesize: %ld kB", &kb) == 1) {
+      break;
+    }
+  }
+  fclose(fp);
+
+  return kb * 1024;
+}
+
+static long round_up (long n, long to) {
+  return (n + to - 1) / to * to;
+}
+
+/*
+ * Functionality: The per process part of attaching, for both sides.
+ *    ->  SHMSEG_POPULATE: with MADV_POPULATE_WRITE (Linux 5.14) the kernel faults the whole range in at once, without
+ *        touching what's in it. Without it we read one byte of every page, which for shared memory allocates the page
+ *        just the same (there's no shared zero page for shm). Reading and not writing matters: the client populates
+ *        after the header is there.
+ *    ->  SHMSEG_LOCK: mlock() also faults the pages in, and keeps them in memory after that.
+*/
+static void shmseg_prepare (shmseg *s, int flags) {
+  char          *p, *end;
+  volatile char c;
+  long          pagesize;
+
+  end = (char *) s->hdr + s->hdr->segsize;
+
+  if (flags & SHMSEG_POPULATE) {
+#ifdef MADV_POPULATE_WRITE
+    if (madvise((void *) s->hdr, s->hdr->segsize, MADV_POPULATE_WRITE) < 0)
+#endif
+    {
+      pagesize = (s->hdr->flags & SHMSEG_HUGE) ? huge_page_size() : sysconf(_SC_PAGESIZE);
+      for (p = (char *) s->hdr; p < end; p += pagesize) {
+        c = *p;
+      }
+      (void) c;
+    }
+    s->flags |= SHMSEG_POPULATE;
+  }
+
+  if (flags & SHMSEG_LOCK) {
+    if (mlock((void *) s->hdr, s->hdr->segsize) < 0) {
+      err_ret("shmseg: can't lock %ld bytes, going on without", s->hdr->segsize);
+    } else {
+      s->flags |= SHMSEG_LOCK;
+    }
+  }
+}
+
+/*
+ * Functionality:
+ *    ->  The header takes one page, the buffers come after it. With huge pages the whole size is rounded up to a
+ *        multiple of the huge page size (shmget wants that).
+ *    ->  Any old segment under `key` is removed first. shmget() with IPC_CREAT on an existing segment that's smaller
+ *        than what we ask for fails, and one that's bigger would leave the client reading the wrong layout.
+ *    ->  SHM_HUGETLB first if asked for. ENOMEM (the pool is empty), EPERM (not in the hugetlb group) or EINVAL
+ *        (no huge pages in this kernel) mean we try again with normal pages.
+ *    ->  The header is filled in, and the magic goes in last, after a release fence.
+*/
+int shmseg_create (shmseg *s, key_t key, long nbuff, long bufsize, int flags) {
+  long        hdrsize, segsize, hugesize = 0;
+  int         id;
+  shmseg_hdr  *hdr;
+
+  if (nbuff < 1 || nbuff > SHMSEG_MAXBUFF || bufsize < 1) {
+    errno = EINVAL;
+    return -1;
+  }
+  bufsize = round_up(bufsize, SHMSEG_ALIGN);
+  hdrsize = sysconf(_SC_PAGESIZE);
+  segsize = hdrsize + nbuff * bufsize;
+
+  if ( (id = shmget(key, 0, 0)) >= 0) {
+    shmctl(id, IPC_RMID, (struct shmid_ds *) 0);
+  }
+
+  s->shmid = -1;
+  s->flags = 0;
+#ifdef SHM_HUGETLB
+  if ((flags & SHMSEG_HUGE) && (hugesize = huge_page_size()) > 0) {
+    s->shmid = shmget(key, round_up(segsize, hugesize), PERMS | IPC_CREAT | IPC_EXCL | SHM_HUGETLB);
+    if (s->shmid >= 0) {
+      segsize   = round_up(segsize, hugesize);
+      s->flags  = SHMSEG_HUGE;
+    } else if (errno != ENOMEM && errno != EPERM && errno != EINVAL) {
+      return -1;
+    }
+  }
+#endif
+  if ((flags & SHMSEG_HUGE) && s->shmid < 0) {
+    fprintf(stderr, "shmseg: no huge pages, using normal ones\n");
+  }
+  if (s->shmid < 0 && (s->shmid = shmget(key, segsize, PERMS | IPC_CREAT | IPC_EXCL)) < 0) {
+    return -1;
+  }
+
+  if ( (hdr = (shmseg_hdr *) shmat(s->shmid, (char *) 0, 0)) == (shmseg_hdr *) -1) {
+    shmctl(s->shmid, IPC_RMID, (struct shmid_ds *) 0);
+    return -1;
+  }
+  s->hdr = hdr;
+
+  memset(hdr->magic, 0, sizeof(hdr->magic));
+  memset((char *) hdr + SHMSEG_USEROFF, 0, hdrsize - SHMSEG_USEROFF);
+  hdr->nbuff    = nbuff;
+  hdr->bufsize  = bufsize;
+  hdr->hdrsize  = hdrsize;
+  hdr->segsize  = segsize;
+  hdr->flags    = s->flags;
+
+  shmseg_prepare(s, flags);
+
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(hdr->magic, SHMSEG_MAGIC, sizeof(hdr->magic));
+
+  return 0;
+}
+
+/*
+ * Functionality:
+ *    ->  Get and attach the segment. No IPC_CREAT, the server creates it.
+ *    ->  Wait up to a second for the magic, then read the layout (after an acquire fence, the other half of the one
+ *        in shmseg_create).
+*/
+int shmseg_attach (shmseg *s, key_t key, int flags) {
+  struct timespec ts;
+  int             tries;
+
+  if ( (s->shmid = shmget(key, 0, 0)) < 0) {
+    return -1;
+  }
+  if ( (s->hdr = (shmseg_hdr *) shmat(s->shmid, (char *) 0, 0)) == (shmseg_hdr *) -1) {
+    return -1;
+  }
+
+  ts.tv_sec   = 0;
+  ts.tv_nsec  = 10 * 1000 * 1000;
+  for (tries = 0; memcmp(s->hdr->magic, SHMSEG_MAGIC, sizeof(s->hdr->magic)) != 0; tries++) {
+    if (tries == 100) {
+      shmdt((char *) s->hdr);
+      errno = EINVAL;
+      return -1;
+    }
+    nanosleep(&ts, (struct timespec *) 0);
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+  s->flags = s->hdr->flags;
+  shmseg_prepare(s, flags);
+
+  return 0;
+}
+
+char *shmseg_buf (shmseg *s, long i) {
+  return (char *) s->hdr + s->hdr->hdrsize + i * s->hdr->bufsize;
+}
+
+void *shmseg_user (shmseg *s) {
+  return (void *) ((char *) s->hdr + SHMSEG_USEROFF);
+}
+
+int shmseg_detach (shmseg *s) {
+  if (s->flags & SHMSEG_LOCK) {
+    munlock((void *) s->hdr, s->hdr->segsize);
+  }
+  return shmdt((char *) s->hdr);
+}
+
+int shmseg_remove (shmseg *s) {
+  return shmctl(s->shmid, IPC_RMID, (struct shmid_ds *) 0);
+}
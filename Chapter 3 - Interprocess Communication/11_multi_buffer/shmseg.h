@@ -0,0 +1,78 @@
+/*
+ *  The buffers of the multiple buffer version (server.c/client.c) as one shared memory segment, sized at run time.
+ *
+ *  With NBUFF segments of sizeof(Mesg) each, the number and size of the buffers are fixed at compile time, a big file
+ *  goes through 4080 bytes at a time, and every buffer is a segment (and a page) of its own. Here the server picks
+ *  `nbuff` and `bufsize` when it starts, and the client learns them from the segment itself:
+ *    ->  The first page of the segment is a header (shmseg_hdr) with the layout. The buffers follow it back to back,
+ *        each `bufsize` bytes (a Mesg header, then the data) and a multiple of SHMSEG_ALIGN. The rest of the header
+ *        page, from SHMSEG_USEROFF on, is for the programs (shmseg_user), server.c keeps its handoff state there.
+ *    ->  The magic is written last, so a client that attached early sees a header that isn't there yet rather than
+ *        half of one.
+ *    ->  SHMSEG_HUGE asks for huge pages (SHM_HUGETLB, Linux). A 2 MB page covers what would take 512 normal ones,
+ *        so the buffers cost a TLB entry or two instead of one per 4 KB. If the system has none to give (the pool in
+ *        /proc/sys/vm/nr_hugepages is empty, or we're not allowed), we go on with normal pages. The header says what
+ *        we got.
+ *    ->  SHMSEG_POPULATE faults the pages in right after attaching, so the first pass over the buffers doesn't take
+ *        a page fault per page. SHMSEG_LOCK mlock()s them so they stay in memory. Both are per process, the client
+ *        asks for its own. If mlock isn't allowed (RLIMIT_MEMLOCK) it's a warning, not an error.
+ *
+ *  The routines available:
+ *    1.  shmseg_create(s, key, nbuff, bufsize, flags);   // server: (re)create and attach, write the header
+ *    2.  shmseg_attach(s, key, flags);                   // client: attach, read the layout from the header
+ *    3.  p = shmseg_buf(s, i);                           // start of buffer i
+ *    4.  p = shmseg_user(s);                             // the programs' part of the header page
+ *    5.  shmseg_detach(s);
+ *    6.  shmseg_remove(s);                               // the last one out
+*/
+
+#ifndef SHMSEG_H
+#define SHMSEG_H
+
+#include <sys/types.h>
+
+#define   SHMSEG_MAGIC      "SHMSEG1"
+#define   SHMSEG_ALIGN      64              /* buffers start on their own cache line */
+#define   SHMSEG_MAXBUFF    4096            /* the server semaphore counts the free buffers */
+#define   SHMSEG_USEROFF    256             /* start of the programs' part of the header page, zeroed by the creator */
+
+#define   SHMSEG_HUGE       0x1
+#define   SHMSEG_POPULATE   0x2
+#define   SHMSEG_LOCK       0x4
+
+typedef struct {
+  char    magic[8];                 /* SHMSEG_MAGIC once the rest is valid */
+  long    nbuff;                    /* number of buffers */
+  long    bufsize;                  /* bytes per buffer, Mesg header included */
+  long    hdrsize;                  /* offset of buffer 0 from the start of the segment */
+  long    segsize;                  /* size of the whole segment */
+  int     flags;                    /* SHMSEG_HUGE if the segment really is on huge pages */
+} shmseg_hdr;
+
+typedef struct {
+  int         shmid;
+  shmseg_hdr  *hdr;                 /* where this process attached the segment */
+  int         flags;                /* what this process got: the header's SHMSEG_HUGE, POPULATE, LOCK */
+} shmseg;
+
+/*
+ * shmseg_create: Create the segment for `nbuff` buffers of `bufsize` bytes (rounded up to SHMSEG_ALIGN), removing an
+ *                old one with the same key first (it may be of another size). Returns 0 if all OK, else -1.
+*/
+int   shmseg_create   (shmseg *s, key_t key, long nbuff, long bufsize, int flags);
+
+/*
+ * shmseg_attach: Attach the segment the server made, waiting a little for the header if the server is still at it.
+ *                Only SHMSEG_POPULATE and SHMSEG_LOCK mean anything in `flags`. Returns 0 if all OK, else -1.
+*/
+int   shmseg_attach   (shmseg *s, key_t key, int flags);
+
+char  *shmseg_buf     (shmseg *s, long i);
+
+void  *shmseg_user    (shmseg *s);
+
+int   shmseg_detach   (shmseg *s);
+
+int   shmseg_remove   (shmseg *s);
+
+#endif
@@ -0,0 +1,224 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* syscall, sched_setaffinity, nanosleep, sysconf with -ansi */
+#endif
+
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+
+#ifdef __linux__
+  #include <sys/syscall.h>
+  #include <linux/futex.h>
+#endif
+
+#include "wait.h"
+
+/*
+ * Tell the CPU we're spinning: on x86 `pause` keeps the loop from flooding the pipeline with loads and leaves more
+ * of the core to a hyperthread sibling, ARM's `yield` is the same hint.
+*/
+static void cpu_relax (void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __asm__ __volatile__ ("pause" ::: "memory");
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__ ("yield" ::: "memory");
+#else
+  __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+/*
+ * Sleep while *word == val. Spurious returns are fine, the caller looks again.
+*/
+static void wait_sleep (unsigned int *word, unsigned int val) {
+#ifdef __linux__
+  /* not FUTEX_PRIVATE_FLAG, the word is shared between processes */
+  syscall(SYS_futex, word, FUTEX_WAIT, val, (struct timespec *) 0, (unsigned int *) 0, 0);
+#else
+  /* no futex, poll the word every 50 microseconds */
+  struct timespec   ts;
+
+  ts.tv_sec   = 0;
+  ts.tv_nsec  = 50000;
+  while (__atomic_load_n(word, __ATOMIC_ACQUIRE) == val) {
+    nanosleep(&ts, (struct timespec *) 0);
+  }
+#endif
+}
+
+/*
+ * A wait that ended after `n` rounds of spinning: pull the budget an eighth of the way towards 2n.
+*/
+static void wait_adapt (waiter *w, unsigned n) {
+  long  budget = (long) w->budget + ((long) 2 * n - (long) w->budget) / 8;
+
+  if (budget < WAIT_MINSPIN) {
+    budget = WAIT_MINSPIN;
+  } else if (budget > WAIT_MAXSPIN) {
+    budget = WAIT_MAXSPIN;
+  }
+  w->budget = budget;
+}
+
+/*
+ * Functionality: The three stages, for any condition `ready` (which also does the taking, for a semaphore).
+ *    ->  Spin: up to `budget` rounds (forever for WAIT_SPIN, none for WAIT_BLOCK or with one CPU).
+ *    ->  Yield: WAIT_YIELDS times. Only WAIT_ADAPTIVE gets here.
+ *    ->  Sleep on `word` while it is `val`. We count ourselves in `waiters` and *then* check `ready` one last time,
+ *        with a seq_cst fence in between. The waker changes the word, has a fence of its own and then reads
+ *        `waiters` (wait_wake), so either our last check sees the change or the waker sees us and wakes us up. And
+ *        the futex won't go to sleep if the word isn't `val` anymore.
+*/
+static void wait_for (waiter *w, unsigned int *word, unsigned int *waiters, unsigned int val,
+                      int (*ready) (void *), void *arg) {
+  unsigned  i, limit;
+
+  if (w->profile != WAIT_BLOCK) {
+    limit = (w->ncpu > 1) ? w->budget : 0;
+    for (i = 0; w->profile == WAIT_SPIN || i < limit; i++) {
+      if ((*ready)(arg)) {
+        if (w->profile == WAIT_ADAPTIVE) {
+          wait_adapt(w, i);
+        }
+        w->nspin++;
+        return;
+      }
+      if (w->ncpu > 1) {
+        cpu_relax();
+      } else {
+        sched_yield();      /* WAIT_SPIN on one CPU: the other side can't get anywhere while we hold it */
+      }
+    }
+    if (w->ncpu > 1) {
+      w->budget -= w->budget / 8;
+      if (w->budget < WAIT_MINSPIN) {
+        w->budget = WAIT_MINSPIN;
+      }
+    }
+    for (i = 0; i < WAIT_YIELDS; i++) {
+      if ((*ready)(arg)) {
+        w->nyield++;
+        return;
+      }
+      sched_yield();
+    }
+  }
+
+  w->nsleep++;
+  for (;;) {
+    __atomic_add_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if ((*ready)(arg)) {
+      __atomic_sub_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+      return;
+    }
+    wait_sleep(word, val);
+    __atomic_sub_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+    if ((*ready)(arg)) {
+      return;
+    }
+  }
+}
+
+int wait_profile (const char *name) {
+  if (strcmp(name, "adaptive") == 0) {
+    return WAIT_ADAPTIVE;
+  } else if (strcmp(name, "spin") == 0) {
+    return WAIT_SPIN;
+  } else if (strcmp(name, "block") == 0) {
+    return WAIT_BLOCK;
+  }
+  return -1;
+}
+
+void wait_init (waiter *w, int profile) {
+  long  n = sysconf(_SC_NPROCESSORS_ONLN);
+
+  w->profile  = profile;
+  w->budget   = WAIT_MINSPIN * 16;
+  w->ncpu     = (n > 0) ? n : 1;
+  w->nspin    = w->nyield = w->nsleep = 0;
+}
+
+int wait_pin (int cpu) {
+#ifdef __linux__
+  cpu_set_t   set;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set);
+#else
+  (void) cpu;
+  errno = ENOSYS;         /* macOS only has affinity *hints* (thread_policy_set), nothing to pin with */
+  return -1;
+#endif
+}
+
+/*
+ * wait_change: the condition is *word != seen.
+*/
+struct change {
+  unsigned int  *word;
+  unsigned int  seen;
+  unsigned int  now;
+};
+
+static int changed (void *arg) {
+  struct change   *c = (struct change *) arg;
+
+  c->now = __atomic_load_n(c->word, __ATOMIC_ACQUIRE);
+  return c->now != c->seen;
+}
+
+unsigned int wait_change (waiter *w, unsigned int *word, unsigned int *waiters, unsigned int seen) {
+  struct change   c;
+
+  c.word  = word;
+  c.seen  = seen;
+  wait_for(w, word, waiters, seen, changed, &c);
+
+  return c.now;
+}
+
+void wait_wake (unsigned int *word, unsigned int *waiters) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(waiters, __ATOMIC_SEQ_CST) > 0) {
+#ifdef __linux__
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, (struct timespec *) 0, (unsigned int *) 0, 0);
+#else
+    (void) word;          /* the sleeper polls */
+#endif
+  }
+}
+
+/*
+ * wsem: the condition is "the count is > 0, and we got to take one off it". The sleep is on the count being 0.
+*/
+static int taken (void *arg) {
+  unsigned int  *count = (unsigned int *) arg;
+  unsigned int  c = __atomic_load_n(count, __ATOMIC_ACQUIRE);
+
+  while (c > 0) {
+    if (__atomic_compare_exchange_n(count, &c, c - 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void wsem_init (wsem *s, unsigned int value) {
+  s->count    = value;
+  s->waiters  = 0;
+}
+
+void wsem_wait (waiter *w, wsem *s) {
+  wait_for(w, &s->count, &s->waiters, 0, taken, &s->count);
+}
+
+void wsem_post (wsem *s) {
+  __atomic_add_fetch(&s->count, 1, __ATOMIC_RELEASE);
+  wait_wake(&s->count, &s->waiters);
+}
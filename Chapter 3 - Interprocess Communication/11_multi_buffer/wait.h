@@ -0,0 +1,79 @@
+/*
+ *  How a process waits for the other side of a shared memory transport.
+ *
+ *  A semop() that blocks, or a futex wait, puts the process to sleep and the handoff costs two context switches even
+ *  when the other side answers a microsecond later, which on a machine with a spare CPU it usually does. Spinning
+ *  on the shared word instead answers in nanoseconds, but burns the CPU if the other side takes its time. So:
+ *    1.  Spin: look at the word, `pause` (or the CPU's equivalent), look again, up to `budget` times.
+ *    2.  Yield: a few sched_yield()s, for when the other side is waiting for our CPU.
+ *    3.  Sleep: futex on Linux, polling with nanosleep elsewhere. The waker only makes the wake-up system call if
+ *        there's someone in this stage (`waiters`).
+ *
+ *  The budget tunes itself. A wait that ended while spinning after n rounds pulls the budget towards 2n, so it keeps
+ *  some room over the handoff times we see. A wait that had to go on to yield or sleep means the spinning was wasted,
+ *  and the budget shrinks by an eighth. On a machine with one CPU there's no spinning at all: whoever we wait for
+ *  can't run while we spin.
+ *
+ *  The profiles:
+ *    ->  WAIT_ADAPTIVE:  all of the above (the default).
+ *    ->  WAIT_SPIN:      low latency. Only spin, never sleep. Meant for a process pinned to a core of its own
+ *                        (wait_pin), where there's nothing better for that core to do.
+ *    ->  WAIT_BLOCK:     power saving. Go to sleep at once, no spinning or yielding.
+ *
+ *  The routines available:
+ *    1.  profile = wait_profile(name);             // "adaptive", "spin" or "block" -> WAIT_*, -1 if none of those
+ *    2.  wait_init(w, profile);                    // a waiter, private to the process
+ *    3.  wait_pin(cpu);                            // run only on `cpu` from now on (Linux)
+ *    4.  v = wait_change(w, word, waiters, seen);  // wait until *word != seen
+ *    5.  wait_wake(word, waiters);                 // after changing *word, wake whoever sleeps on it
+ *    6.  wsem_init(s, value);                      // a counting semaphore in shared memory
+ *    7.  wsem_wait(w, s);                          // P
+ *    8.  wsem_post(s);                             // V
+ *
+ *  The words are plain unsigned ints in shared memory, used with the GCC __atomic builtins, so this works for the
+ *  C89 programs here as well as for the C11 ring.
+*/
+
+#ifndef WAIT_H
+#define WAIT_H
+
+#define   WAIT_ADAPTIVE   0
+#define   WAIT_SPIN       1
+#define   WAIT_BLOCK      2
+
+#define   WAIT_MINSPIN    64                /* the budget never goes below this ... */
+#define   WAIT_MAXSPIN    (1 << 16)         /* ... or above this, in rounds of `pause` */
+#define   WAIT_YIELDS     4
+
+typedef struct {
+  int       profile;
+  unsigned  budget;                         /* rounds to spin before yielding */
+  unsigned  ncpu;                           /* CPUs online, no spinning if 1 */
+  long      nspin, nyield, nsleep;          /* how the waits ended, for the curious */
+} waiter;
+
+/*
+ * A counting semaphore in shared memory: the count is the futex word.
+*/
+typedef struct {
+  unsigned int  count;
+  unsigned int  waiters;
+} wsem;
+
+int           wait_profile  (const char *name);
+
+void          wait_init     (waiter *w, int profile);
+
+int           wait_pin      (int cpu);
+
+unsigned int  wait_change   (waiter *w, unsigned int *word, unsigned int *waiters, unsigned int seen);
+
+void          wait_wake     (unsigned int *word, unsigned int *waiters);
+
+void          wsem_init     (wsem *s, unsigned int value);
+
+void          wsem_wait     (waiter *w, wsem *s);
+
+void          wsem_post     (wsem *s);
+
+#endif
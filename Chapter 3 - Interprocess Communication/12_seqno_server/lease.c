@@ -0,0 +1,187 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* getaddrinfo with -std=c99 */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netdb.h>
+
+#include "seqno.h"
+#include "lease.h"
+
+/*
+ * The socket is `connect`ed to the server. For datagram sockets that only sets the default destination and filters
+ * what we receive to what comes from there, no packet is sent. A Unix domain datagram socket has to be bound to a
+ * name of its own, otherwise the server has nowhere to send the reply.
+*/
+static int open_unix (seq_lease *l, const char *path) {
+  struct sockaddr_un  addr;
+  int                 err;
+
+  if ( (l->fd = socket(AF_UNIX, SOCK_DGRAM, 0)) < 0) {
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), SEQ_CLI_PATH, (long) getpid());
+  strncpy(l->path, addr.sun_path, sizeof(l->path) - 1);
+  unlink(l->path);
+  if (bind(l->fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    err = errno;
+    close(l->fd);
+    l->fd       = -1;
+    l->path[0]  = '\0';
+    errno = err;
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  if (connect(l->fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    err = errno;
+    close(l->fd);
+    unlink(l->path);
+    l->fd       = -1;
+    l->path[0]  = '\0';
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
+
+static int open_udp (seq_lease *l, const char *hostport) {
+  struct addrinfo hints, *res;
+  char            host[256], port[16], *colon;
+  int             rc;
+
+  strncpy(host, hostport, sizeof(host) - 1);
+  host[sizeof(host) - 1] = '\0';
+  snprintf(port, sizeof(port), "%d", SEQ_PORT);
+  if ( (colon = strrchr(host, ':')) != NULL) {
+    *colon = '\0';
+    strncpy(port, colon + 1, sizeof(port) - 1);
+  }
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  if (getaddrinfo(host, port, &hints, &res) != 0) {
+    return -1;
+  }
+  if ( (l->fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol)) < 0) {
+    freeaddrinfo(res);
+    return -1;
+  }
+  rc = connect(l->fd, res->ai_addr, res->ai_addrlen);
+  freeaddrinfo(res);
+  if (rc < 0) {
+    close(l->fd);
+    l->fd = -1;
+  }
+
+  return rc;
+}
+
+int seq_open (seq_lease *l, const char *where, long k) {
+  memset(l, 0, sizeof(*l));
+  l->fd = -1;
+  l->k  = (k < 1) ? 1 : k;
+
+  if (strcmp(where, "unix") == 0) {
+    return open_unix(l, SEQ_PATH);
+  } else if (strncmp(where, "unix:", 5) == 0) {
+    return open_unix(l, where + 5);
+  } else if (strncmp(where, "udp:", 4) == 0) {
+    return open_udp(l, where + 4);
+  }
+
+  errno = EINVAL;
+  return -1;
+}
+
+/*
+ * Functionality:
+ *    ->  Send "LEASE <id> <k>" and wait SEQ_TIMEOUT_MS for the answer. Answers to earlier requests (a different id)
+ *        are thrown away, their numbers are lost.
+ *    ->  No answer in time: send it again, with the same id, up to SEQ_TRIES times. If the first answer shows up
+ *        late, it's just as good.
+*/
+static int get_lease (seq_lease *l) {
+  char            buff[SEQ_MSGLEN + 1];
+  fd_set          rset;
+  struct timeval  tv;
+  long            id, first, count;
+  ssize_t         n;
+  int             len, tries;
+
+  l->id++;
+  len = snprintf(buff, sizeof(buff), "LEASE %ld %ld\n", l->id, l->k);
+
+  for (tries = 0; tries < SEQ_TRIES; tries++) {
+    if (send(l->fd, buff, len, 0) != len) {
+      return -1;
+    }
+
+    for (;;) {
+      FD_ZERO(&rset);
+      FD_SET(l->fd, &rset);
+      tv.tv_sec   = SEQ_TIMEOUT_MS / 1000;
+      tv.tv_usec  = (SEQ_TIMEOUT_MS % 1000) * 1000;
+      if ( (n = select(l->fd + 1, &rset, (fd_set *) 0, (fd_set *) 0, &tv)) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return -1;
+      }
+      if (n == 0) {
+        break;          /* timed out, try again */
+      }
+      if ( (n = recv(l->fd, buff, SEQ_MSGLEN, 0)) < 0) {
+        if (errno == EINTR || errno == ECONNREFUSED) {
+          continue;     /* ECONNREFUSED: UDP, nobody listening (yet), the timeout will do the rest */
+        }
+        return -1;
+      }
+      buff[n] = '\0';
+      if (sscanf(buff, "OK %ld %ld %ld", &id, &first, &count) == 3 && id == l->id) {
+        l->next = first;
+        l->end  = first + count;
+        l->nleases++;
+        return 0;
+      }
+    }
+
+    len = snprintf(buff, sizeof(buff), "LEASE %ld %ld\n", l->id, l->k);
+  }
+
+  errno = ETIMEDOUT;
+  return -1;
+}
+
+long seq_next (seq_lease *l) {
+  if (l->next == l->end && get_lease(l) < 0) {
+    return -1;
+  }
+
+  return l->next++;
+}
+
+void seq_close (seq_lease *l) {
+  if (l->fd >= 0) {
+    close(l->fd);
+  }
+  if (l->path[0] != '\0') {
+    unlink(l->path);
+  }
+}
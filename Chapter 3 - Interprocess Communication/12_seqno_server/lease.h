@@ -0,0 +1,37 @@
+#ifndef LEASE_H
+#define LEASE_H
+
+/*
+ * The client side of seqno_server (see seqno.h for the protocol).
+ *
+ *    ->  seq_open:   "unix" (or "unix:/path") for the local server, "udp:host[:port]" for a remote one. `k` is how
+ *                    many numbers to ask for at a time. Returns 0 if all OK, -1 if the socket couldn't be set up.
+ *    ->  seq_next:   The next number. While the lease lasts this is `next++` and a compare, nothing else. When it's
+ *                    used up, a new lease is requested (SEQ_TRIES tries, SEQ_TIMEOUT_MS apart). Returns -1 if the
+ *                    server doesn't answer.
+ *    ->  seq_close:  Close the socket. What's left of the lease is lost (a gap).
+ *
+ * A seq_lease is not shared: a program with several threads gives each thread its own, which is what keeps seq_next
+ * a plain increment.
+*/
+
+#define   SEQ_TRIES         5
+#define   SEQ_TIMEOUT_MS    500
+
+typedef struct {
+  int     fd;
+  char    path[108];          /* our socket's name, if it's a Unix domain one */
+  long    k;
+  long    next;               /* next number to hand out */
+  long    end;                /* first number that isn't ours */
+  long    id;                 /* id of the last request */
+  long    nleases;            /* leases obtained, for the curious */
+} seq_lease;
+
+int   seq_open    (seq_lease *l, const char *where, long k);
+
+long  seq_next    (seq_lease *l);
+
+void  seq_close   (seq_lease *l);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef SEQNO_H
+#define SEQNO_H
+
+/*
+ * Sequence numbers by the block.
+ *
+ * 1_file_record_locking and 9_semaphores get every single number by locking `seqno`, reading the text, incrementing
+ * it and writing it back, so handing out N numbers costs N lock round trips and 4N system calls, and all processes
+ * wait on the same lock. Here one server owns the counter and hands out *leases*: K consecutive numbers at once. The
+ * client gives them out with a plain increment (lease.c) and only asks the server again once they're used up.
+ *
+ * The protocol is one datagram each way, in text, over a Unix domain datagram socket (local) or UDP (remote):
+ *
+ *    request:  "LEASE <id> <count>\n"
+ *    reply:    "OK <id> <first> <count>\n"     the numbers first .. first + count - 1 are yours
+ *              "ERR <id> <message>\n"
+ *
+ * `id` is chosen by the client and comes back in the reply, so a late reply to a request that was sent again isn't
+ * mistaken for the answer to the new one. The server may grant less than asked for (at most SEQ_MAXLEASE).
+ *
+ * Every number is handed out at most once, also across restarts of the server, but there may be gaps: a lease whose
+ * reply got lost, the rest of a lease of a client that exited, and the numbers reserved but not handed out when the
+ * server stopped (see seqno_server.c) are never used.
+*/
+
+#define   SEQ_PATH        "/tmp/seqno.sock"     /* server's Unix domain socket */
+#define   SEQ_CLI_PATH    "/tmp/seqno.%ld"      /* a client's, with its pid */
+#define   SEQ_PORT        6970                  /* server's UDP port */
+
+#define   SEQ_MAXLEASE    (1L << 20)
+#define   SEQ_MSGLEN      128
+
+#endif
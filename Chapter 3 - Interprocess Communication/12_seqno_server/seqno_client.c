@@ -0,0 +1,63 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* getopt with -std=c99 */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "lease.h"
+#include "err_routine.h"
+
+/*
+ * The seqno example once more, with the numbers coming from seqno_server.
+ *
+ *    ./seqno_client [-w unix|unix:path|udp:host[:port]] [-k lease] [-n count] [-q]
+ *
+ *    ->  Gets `count` (20) numbers, `lease` (100) at a time, and prints them like 9_semaphores/main.c did.
+ *    ->  -q doesn't print them, only how long it took and how many leases it needed, to see how the rate goes with
+ *        the lease size.
+*/
+int main (int argc, char **argv) {
+  seq_lease       l;
+  const char      *where = "unix";
+  long            k = 100, count = 20, i, seqno;
+  int             c, quiet = 0, pid = getpid();
+  struct timeval  start, end;
+  double          secs;
+
+  while ( (c = getopt(argc, argv, "w:k:n:q")) != -1) {
+    switch (c) {
+      case 'w': where = optarg;       break;
+      case 'k': k     = atol(optarg); break;
+      case 'n': count = atol(optarg); break;
+      case 'q': quiet = 1;            break;
+      default:
+        err_sys("usage: %s [-w unix|unix:path|udp:host[:port]] [-k lease] [-n count] [-q]", argv[0]);
+    }
+  }
+
+  if (seq_open(&l, where, k) < 0) {
+    err_sys("can't reach the server at %s", where);
+  }
+
+  gettimeofday(&start, (struct timezone *) 0);
+  for (i = 0; i < count; i++) {
+    if ( (seqno = seq_next(&l)) < 0) {
+      seq_close(&l);
+      err_sys("no answer from the server");
+    }
+    if (!quiet) {
+      printf("pid = %d, seq number = %ld\n", pid, seqno);
+    }
+  }
+  gettimeofday(&end, (struct timezone *) 0);
+
+  secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  printf("pid = %d: %ld numbers in %.3f s (%.0f per second), %ld leases of %ld\n",
+         pid, count, secs, secs > 0 ? count / secs : 0, l.nleases, k);
+
+  seq_close(&l);
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,251 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* getopt, pwrite and fdatasync with -std=c99 */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+
+#include "seqno.h"
+#include "err_routine.h"
+
+#define   SEQFILE       "seqno.hwm"
+#define   SEQ_RESERVE   (1L << 16)      /* numbers reserved on disk beyond what's needed */
+#define   SEQ_BATCH     64              /* requests read before one sync and the replies */
+
+/*
+ * Functionality:
+ *    ->  The only state on disk is the high-water mark `reserved`: no number below it may ever be handed out again.
+ *        On start up it is read from SEQFILE and handing out starts there (`next = reserved`).
+ *    ->  Requests are granted from [next, reserved). Only when that runs out is `reserved` moved up, by what's needed
+ *        plus `reserve` more, written and fdatasync'ed *before* any of the new numbers goes out. So a crash can lose
+ *        up to `reserve` numbers (a gap) but never hands one out twice, and the sync happens once every `reserve`
+ *        numbers instead of once per request.
+ *    ->  Requests are read in batches: whatever is queued on the sockets, up to SEQ_BATCH of them. If the batch
+ *        needs the mark moved, it's one write and one sync for all of them, then all the replies (group commit).
+ *    ->  The same loop serves the Unix domain socket and the UDP one, recvfrom tells where to send the reply.
+ *
+ * Options:
+ *    -f file     where the mark is kept (SEQFILE)
+ *    -s path     Unix domain socket (SEQ_PATH), "-" for none
+ *    -p port     UDP port (SEQ_PORT), 0 for none
+ *    -r count    numbers to reserve ahead (SEQ_RESERVE)
+*/
+
+typedef struct {
+  int                     fd;
+  struct sockaddr_storage addr;
+  socklen_t               addrlen;
+  long                    id;
+  long                    count;          /* asked for, then granted */
+  long                    first;
+} request;
+
+static int      markfd;
+static long     reserved;
+static long     nsyncs;
+
+static void mark_read (const char *path) {
+  char  buff[64];
+  int   n;
+
+  if ( (markfd = open(path, O_RDWR | O_CREAT, 0644)) < 0) {
+    err_sys("can't open %s", path);
+  }
+  if ( (n = read(markfd, buff, sizeof(buff) - 1)) < 0) {
+    err_sys("read error on %s", path);
+  }
+  buff[n] = '\0';
+  if (n == 0) {
+    reserved = 1;       /* a new file, the first number is 1 */
+  } else if (sscanf(buff, "%ld", &reserved) != 1) {
+    err_sys("%s: not a number", path);
+  }
+}
+
+/*
+ * Fixed width, so the file never needs truncating and it's always one number, whatever was there before.
+*/
+static void mark_write (long mark) {
+  char  buff[64];
+  int   n;
+
+  n = snprintf(buff, sizeof(buff), "%020ld\n", mark);
+  if (pwrite(markfd, buff, n, (off_t) 0) != n) {
+    err_sys("write error on the mark");
+  }
+#ifdef __APPLE__
+  if (fsync(markfd) < 0) {                /* no fdatasync */
+#else
+  if (fdatasync(markfd) < 0) {
+#endif
+    err_sys("can't sync the mark");
+  }
+  reserved = mark;
+  nsyncs++;
+}
+
+static int open_unix (const char *path) {
+  struct sockaddr_un  addr;
+  int                 fd;
+
+  if ( (fd = socket(AF_UNIX, SOCK_DGRAM, 0)) < 0) {
+    err_sys("can't open unix socket");
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  unlink(path);
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    err_sys("can't bind %s", path);
+  }
+
+  return fd;
+}
+
+static int open_udp (int port) {
+  struct sockaddr_in  addr;
+  int                 fd;
+
+  if ( (fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+    err_sys("can't open udp socket");
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family       = AF_INET;
+  addr.sin_addr.s_addr  = htonl(INADDR_ANY);
+  addr.sin_port         = htons(port);
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    err_sys("can't bind udp port %d", port);
+  }
+
+  return fd;
+}
+
+/*
+ * Read one request from `fd` without waiting. Returns 1 if `req` was filled in, 0 if there's nothing (more) to read.
+ * Garbage is answered right away and not counted.
+*/
+static int get_request (int fd, request *req) {
+  char    buff[SEQ_MSGLEN + 1], reply[SEQ_MSGLEN];
+  ssize_t n;
+
+  for (;;) {
+    req->addrlen = sizeof(req->addr);
+    if ( (n = recvfrom(fd, buff, SEQ_MSGLEN, MSG_DONTWAIT, (struct sockaddr *) &req->addr, &req->addrlen)) < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return 0;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      err_sys("recvfrom error");
+    }
+    buff[n] = '\0';
+    req->fd = fd;
+    if (sscanf(buff, "LEASE %ld %ld", &req->id, &req->count) == 2 && req->count > 0) {
+      if (req->count > SEQ_MAXLEASE) {
+        req->count = SEQ_MAXLEASE;
+      }
+      return 1;
+    }
+    n = snprintf(reply, sizeof(reply), "ERR 0 bad request\n");
+    sendto(fd, reply, n, 0, (struct sockaddr *) &req->addr, req->addrlen);
+  }
+}
+
+int main (int argc, char **argv) {
+  request     batch[SEQ_BATCH];
+  fd_set      rset;
+  const char  *file = SEQFILE, *path = SEQ_PATH;
+  char        reply[SEQ_MSGLEN];
+  long        next, need, reserve = SEQ_RESERVE, granted = 0;
+  int         c, i, n, fds[2], nfds = 0, maxfd = -1, port = SEQ_PORT, len;
+
+  while ( (c = getopt(argc, argv, "f:s:p:r:")) != -1) {
+    switch (c) {
+      case 'f': file    = optarg;       break;
+      case 's': path    = optarg;       break;
+      case 'p': port    = atoi(optarg); break;
+      case 'r': reserve = atol(optarg); break;
+      default:
+        err_sys("usage: %s [-f file] [-s path|-] [-p port] [-r reserve]", argv[0]);
+    }
+  }
+  if (reserve < 1) {
+    err_sys("reserve must be > 0");
+  }
+
+  mark_read(file);
+  next = reserved;
+
+  if (strcmp(path, "-") != 0) {
+    fds[nfds++] = open_unix(path);
+  }
+  if (port != 0) {
+    fds[nfds++] = open_udp(port);
+  }
+  if (nfds == 0) {
+    err_sys("no socket to listen on");
+  }
+  for (i = 0; i < nfds; i++) {
+    if (fds[i] > maxfd) {
+      maxfd = fds[i];
+    }
+  }
+  printf("seqno_server: starting at %ld\n", next);
+  fflush(stdout);
+
+  for (;;) {
+    FD_ZERO(&rset);
+    for (i = 0; i < nfds; i++) {
+      FD_SET(fds[i], &rset);
+    }
+    if (select(maxfd + 1, &rset, (fd_set *) 0, (fd_set *) 0, (struct timeval *) 0) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      err_sys("select error");
+    }
+
+    /* a batch: everything that's waiting, from both sockets */
+    n = 0;
+    for (i = 0; i < nfds && n < SEQ_BATCH; i++) {
+      while (n < SEQ_BATCH && get_request(fds[i], &batch[n])) {
+        n++;
+      }
+    }
+    if (n == 0) {
+      continue;
+    }
+
+    need = 0;
+    for (i = 0; i < n; i++) {
+      need += batch[i].count;
+    }
+    if (next + need > reserved) {
+      mark_write(next + need + reserve);      /* one sync for the whole batch */
+    }
+
+    for (i = 0; i < n; i++) {
+      batch[i].first  = next;
+      next           += batch[i].count;
+      len = snprintf(reply, sizeof(reply), "OK %ld %ld %ld\n", batch[i].id, batch[i].first, batch[i].count);
+      if (sendto(batch[i].fd, reply, len, 0, (struct sockaddr *) &batch[i].addr, batch[i].addrlen) != len) {
+        ;         /* the client is gone, or will ask again; the numbers are lost either way */
+      }
+    }
+
+    if ( (granted += n) % 100000 < (long) n) {
+      printf("seqno_server: %ld leases, next %ld, %ld syncs\n", granted, next, nsyncs);
+      fflush(stdout);
+    }
+  }
+}
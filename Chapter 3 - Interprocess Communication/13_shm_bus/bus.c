@@ -0,0 +1,359 @@
+#ifdef __linux__
+#define _GNU_SOURCE                         /* syscall(), shm_open, ftruncate with -std=c11 */
+#endif
+
+#include "bus.h"
+
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+  #include <sys/syscall.h>
+  #include <linux/futex.h>
+#endif
+
+#define   BUS_NAP   100           /* longest sleep in ms, in case a wake-up went to a process that died */
+
+/*
+ * Sleep until *word is no longer `seen`, or BUS_NAP ms. Spurious returns are fine, the callers look again anyway.
+ *
+ * The sleeper reads `seen`, counts itself in `waiters` and then looks at the lanes one last time. The other side
+ * changes the lane and then looks at `waiters`. With a seq_cst fence between the two steps on both sides, at least
+ * one of them sees what the other did: either the last look finds the change, or the other side sees the waiter,
+ * bumps the word and the futex won't sleep on `seen` (or gets woken). When nobody's asleep, which is most of the
+ * time, the other side doesn't write anything shared at all.
+*/
+static void bus_sleep (_Atomic uint32_t *word, uint32_t seen) {
+#ifdef __linux__
+  struct timespec   ts = { 0, BUS_NAP * 1000000L };
+
+  /* not FUTEX_PRIVATE_FLAG, the word is shared between processes */
+  syscall(SYS_futex, (uint32_t *) word, FUTEX_WAIT, seen, &ts, (uint32_t *) 0, 0);
+#else
+  /* no futex, poll the word every 50 microseconds */
+  struct timespec   ts = { 0, 50000 };
+  int               i;
+
+  for (i = 0; i < BUS_NAP * 20 && atomic_load(word) == seen; i++) {
+    nanosleep(&ts, (struct timespec *) 0);
+  }
+#endif
+}
+
+/*
+ * Wake everyone asleep on `word`. Everyone, because a receiver only wants some types and a single wake-up could go
+ * to one that isn't interested in what was just sent.
+*/
+static void bus_wake (_Atomic uint32_t *word, _Atomic uint32_t *waiters) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load(waiters) > 0) {
+    atomic_fetch_add(word, 1);
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t *) word, FUTEX_WAKE, INT_MAX, (struct timespec *) 0, (uint32_t *) 0, 0);
+#endif
+  }
+}
+
+static bus_slot *bus_slotp (bus_hdr *h, uint32_t lane, uint64_t pos) {
+  return (bus_slot *) ((char *) h + h->slotoff + ((size_t) lane * h->nslots + (pos & (h->nslots - 1))) * h->slotsize);
+}
+
+/*
+ * Functionality:
+ *    ->  The layout: the header, `ntypes` lanes, then nslots * ntypes slots of `slotsize` bytes each.
+ *    ->  O_EXCL, so two creators can't both set it up. `ready` is the last store, so a bus_open that comes too early
+ *        fails instead of using half a bus.
+ *    ->  Slot i of every lane starts with sequence i: free, for the sender that claims position i.
+*/
+int bus_create (const char *name, int ntypes, long nslots, long maxdata) {
+  bus_hdr   *h;
+  size_t    slotsize, slotoff, size;
+  uint32_t  n, i, l;
+  int       fd;
+
+  if (ntypes < 1 || ntypes > BUS_MAXTYPES || nslots < 1 || nslots > (1L << 20) || maxdata < 0 || maxdata > MAXMESGDATA) {
+    errno = EINVAL;
+    return -1;
+  }
+  for (n = 1; n < (uint32_t) nslots; n <<= 1) {
+    ;
+  }
+  slotsize  = (sizeof(bus_slot) + maxdata + BUS_CACHELINE - 1) / BUS_CACHELINE * BUS_CACHELINE;
+  slotoff   = sizeof(bus_hdr) + ntypes * sizeof(bus_lane);
+  size      = slotoff + (size_t) ntypes * n * slotsize;
+
+  if ( (fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, PERMS)) < 0) {
+    return -1;
+  }
+  if (ftruncate(fd, size) < 0 || (h = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    close(fd);
+    shm_unlink(name);
+    return -1;
+  }
+
+  memcpy(h->magic, BUS_MAGIC, sizeof(h->magic));
+  h->ntypes   = ntypes;
+  h->nslots   = n;
+  h->maxdata  = maxdata;
+  h->slotsize = slotsize;
+  h->slotoff  = slotoff;
+  h->size     = size;
+  atomic_init(&h->posted, 0);
+  atomic_init(&h->posted_waiters, 0);
+  for (l = 0; l < (uint32_t) ntypes; l++) {
+    atomic_init(&h->lane[l].enq, 0);
+    atomic_init(&h->lane[l].deq, 0);
+    atomic_init(&h->lane[l].freed, 0);
+    atomic_init(&h->lane[l].freed_waiters, 0);
+    for (i = 0; i < n; i++) {
+      atomic_init(&bus_slotp(h, l, i)->seq, i);
+    }
+  }
+  atomic_store(&h->ready, BUS_READY);
+
+  munmap(h, size);
+  close(fd);
+
+  return 0;
+}
+
+/*
+ * The size comes from the object itself (fstat), the layout from the header.
+*/
+int bus_open (bus *b, const char *name) {
+  struct stat   st;
+  bus_hdr       *h;
+  int           fd;
+
+  if ( (fd = shm_open(name, O_RDWR, 0)) < 0) {
+    return -1;
+  }
+  if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(bus_hdr)) {
+    close(fd);
+    errno = EINVAL;
+    return -1;
+  }
+  if ( (h = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    close(fd);
+    return -1;
+  }
+  close(fd);                /* the mapping stays */
+
+  if (memcmp(h->magic, BUS_MAGIC, sizeof(h->magic)) != 0 || atomic_load(&h->ready) != BUS_READY ||
+      h->size != (size_t) st.st_size) {
+    munmap(h, st.st_size);
+    errno = EINVAL;
+    return -1;
+  }
+
+  b->h    = h;
+  b->next = 0;
+
+  return 0;
+}
+
+void bus_close (bus *b) {
+  munmap(b->h, b->h->size);
+  b->h = NULL;
+}
+
+int bus_unlink (const char *name) {
+  return shm_unlink(name);
+}
+
+/*
+ * Functionality: The sending half of Vyukov's queue, for one lane. Returns 0 if the lane is full.
+ *    ->  Look at the slot for position `enq`. If its sequence is the position, it's free: claim the position by
+ *        moving `enq` on (CAS). If another sender got there first the CAS fails, gives us the new `enq`, and we
+ *        try that one.
+ *    ->  If the sequence is behind the position, the slot still holds the message from one lap ago: the lane is
+ *        full. If it's ahead, another sender claimed it and moved on since we read `enq`, read it again.
+ *    ->  Fill the slot, then store sequence `pos + 1` (release, so the data is there before the receiver sees it).
+*/
+static int lane_put (bus_hdr *h, uint32_t l, const Mesg *mesg) {
+  bus_lane  *lane = &h->lane[l];
+  bus_slot  *s;
+  uint64_t  pos, seq;
+  int64_t   dif;
+
+  pos = atomic_load_explicit(&lane->enq, memory_order_relaxed);
+  for (;;) {
+    s   = bus_slotp(h, l, pos);
+    seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+    dif = (int64_t) (seq - pos);
+    if (dif == 0) {
+      if (atomic_compare_exchange_weak_explicit(&lane->enq, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (dif < 0) {
+      return 0;
+    } else {
+      pos = atomic_load_explicit(&lane->enq, memory_order_relaxed);
+    }
+  }
+
+  s->len  = mesg->mesg_len;
+  s->type = mesg->mesg_type;
+  memcpy(s->data, mesg->mesg_data, mesg->mesg_len);
+  atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
+
+  return 1;
+}
+
+/*
+ * Functionality: The receiving half, same thing with `deq` and sequence `pos + 1`. Returns 0 if the lane is empty.
+ * Giving the slot back is storing sequence `pos + nslots`: free, for the sender one lap later.
+*/
+static int lane_get (bus_hdr *h, uint32_t l, Mesg *mesg) {
+  bus_lane  *lane = &h->lane[l];
+  bus_slot  *s;
+  uint64_t  pos, seq;
+  int64_t   dif;
+
+  pos = atomic_load_explicit(&lane->deq, memory_order_relaxed);
+  for (;;) {
+    s   = bus_slotp(h, l, pos);
+    seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+    dif = (int64_t) (seq - (pos + 1));
+    if (dif == 0) {
+      if (atomic_compare_exchange_weak_explicit(&lane->deq, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (dif < 0) {
+      return 0;
+    } else {
+      pos = atomic_load_explicit(&lane->deq, memory_order_relaxed);
+    }
+  }
+
+  mesg->mesg_len  = s->len;
+  mesg->mesg_type = s->type;
+  memcpy(mesg->mesg_data, s->data, s->len);
+  atomic_store_explicit(&s->seq, pos + h->nslots, memory_order_release);
+
+  return 1;
+}
+
+/*
+ * Functionality:
+ *    ->  The type picks the lane. Types and lengths the bus wasn't made for are EINVAL, like msgsnd.
+ *    ->  If the lane is full: with BUS_NOWAIT that's EAGAIN, otherwise note what `freed` is, say we're waiting, try
+ *        once more and sleep on `freed`. The next receiver that takes something from this lane wakes us.
+ *    ->  Once it's in, wake the receivers if any are asleep.
+*/
+int bus_send (bus *b, const Mesg *mesg, int flags) {
+  bus_hdr   *h = b->h;
+  bus_lane  *lane;
+  uint32_t  l, seen;
+
+  if (mesg->mesg_type < 1 || mesg->mesg_type > (long) h->ntypes || mesg->mesg_len < 0 ||
+      mesg->mesg_len > (int) h->maxdata) {
+    errno = EINVAL;
+    return -1;
+  }
+  l     = mesg->mesg_type - 1;
+  lane  = &h->lane[l];
+
+  while (!lane_put(h, l, mesg)) {
+    if (flags & BUS_NOWAIT) {
+      errno = EAGAIN;
+      return -1;
+    }
+    seen = atomic_load(&lane->freed);
+    atomic_fetch_add(&lane->freed_waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!lane_put(h, l, mesg)) {
+      bus_sleep(&lane->freed, seen);
+      atomic_fetch_sub(&lane->freed_waiters, 1);
+      continue;
+    }
+    atomic_fetch_sub(&lane->freed_waiters, 1);
+    break;
+  }
+
+  bus_wake(&h->posted, &h->posted_waiters);
+
+  return 0;
+}
+
+/*
+ * Look through the lanes the type asks for, once. Returns 1 with the message in *mesg, 0 if they're all empty.
+ *    ->  type > 0:   that lane only.
+ *    ->  type < 0:   lanes 0 to -type - 1, lowest first, so the lowest type wins.
+ *    ->  type 0:     all of them, starting one further each time, or a busy type 1 would starve all the others.
+*/
+static int bus_get (bus *b, long type, Mesg *mesg) {
+  bus_hdr   *h = b->h;
+  uint32_t  i, l, n;
+
+  if (type > 0) {
+    l = type - 1;
+    if (!lane_get(h, l, mesg)) {
+      return 0;
+    }
+  } else if (type < 0) {
+    n = (-type < (long) h->ntypes) ? -type : h->ntypes;
+    for (l = 0; l < n && !lane_get(h, l, mesg); l++) {
+      ;
+    }
+    if (l == n) {
+      return 0;
+    }
+  } else {
+    for (i = 0; i < h->ntypes; i++) {
+      l = (b->next + i) % h->ntypes;
+      if (lane_get(h, l, mesg)) {
+        break;
+      }
+    }
+    if (i == h->ntypes) {
+      return 0;
+    }
+    b->next = l + 1;
+  }
+
+  bus_wake(&h->lane[l].freed, &h->lane[l].freed_waiters);
+
+  return 1;
+}
+
+/*
+ * Functionality: Same as bus_send the other way around, sleeping on `posted`. The type is read from mesg_type
+ * before anything is received into *mesg, since receiving overwrites it.
+*/
+int bus_recv (bus *b, Mesg *mesg, int flags) {
+  bus_hdr   *h = b->h;
+  long      type = mesg->mesg_type;
+  uint32_t  seen;
+
+  if (type > (long) h->ntypes) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  while (!bus_get(b, type, mesg)) {
+    if (flags & BUS_NOWAIT) {
+      errno = EAGAIN;
+      return -1;
+    }
+    seen = atomic_load(&h->posted);
+    atomic_fetch_add(&h->posted_waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!bus_get(b, type, mesg)) {
+      bus_sleep(&h->posted, seen);
+      atomic_fetch_sub(&h->posted_waiters, 1);
+      continue;
+    }
+    atomic_fetch_sub(&h->posted_waiters, 1);
+    break;
+  }
+
+  return mesg->mesg_len;
+}
@@ -0,0 +1,140 @@
+/*
+ *  A message bus in a named shared memory segment, for any number of senders and receivers.
+ *
+ *  The servers before this one (10_shared_memory, 11_multi_buffer) set up their segments for one client, and the
+ *  client removes them when it's done. The message queue servers (7_system_v_ipc, 8_multiplexing_messages) take any
+ *  number of clients, but every message is two copies and a system call each way (msgsnd/msgrcv). The bus is the
+ *  message queue done in shared memory:
+ *    ->  The segment is a POSIX shared memory object (shm_open), found by name, and it stays there until it's
+ *        removed with bus_unlink (busctl -r). Processes come and go, nobody owns it.
+ *    ->  Messages are Mesg's (mesg.h) with the same mesg_type rules as msgsnd/msgrcv: the sender gives a type > 0,
+ *        and the receiver asks for type 0 (anything), type > 0 (that type only) or type < 0 (the lowest type that
+ *        is <= -type). Only mesg_len bytes of the data are copied, in and out.
+ *    ->  Each type has a queue (a `lane`) of its own, so a receiver never has to step over messages it doesn't want,
+ *        and asking for a type is only a matter of which lanes to look at. The types are 1 to `ntypes`, fixed when
+ *        the bus is created.
+ *    ->  A lane is a bounded multi-producer/multi-consumer queue (Dmitry Vyukov's). Every slot has a sequence
+ *        number that says whose turn it is: a sender may fill slot `pos` when its sequence is `pos`, a receiver may
+ *        empty it when it's `pos + 1`. Senders claim a position with a compare-and-swap on `enq`, receivers on
+ *        `deq`, then copy without holding anything, and hand the slot over by storing the next sequence. Senders and
+ *        receivers of a lane only meet on the slot they both want.
+ *    ->  Back-pressure: a full lane stops its senders (bus_send sleeps until a receiver frees a slot, or fails with
+ *        EAGAIN with BUS_NOWAIT, like IPC_NOWAIT), it doesn't grow and it doesn't drop messages.
+ *    ->  Sleeping is on a futex on Linux, polling elsewhere, and a side only makes the wake-up system call if
+ *        someone is asleep (the `_waiters` counts).
+ *
+ *  What it doesn't do that a message queue does:
+ *    ->  A receiver of type 0 (or < 0) takes messages from one lane at a time, so messages of different types don't
+ *        come out in the order they went in.
+ *    ->  A process that dies between claiming a slot and handing it over (a kill -9 in the middle of a memcpy)
+ *        leaves the lane stuck at that slot. The kernel cleans up after a msgsnd that was interrupted, we can't.
+ *
+ *  The routines available:
+ *    1.  bus_create(name, ntypes, nslots, maxdata);    // make a new bus (busctl -c)
+ *    2.  bus_open(b, name);                            // attach to it
+ *    3.  bus_send(b, mesg, flags);                     // flags: 0 or BUS_NOWAIT
+ *    4.  n = bus_recv(b, mesg, flags);                 // mesg->mesg_type says which type(s)
+ *    5.  bus_close(b);                                 // detach
+ *    6.  bus_unlink(name);                             // remove it (busctl -r)
+*/
+
+#ifndef BUS_H
+#define BUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "mesg.h"
+
+#define   BUS_NAME        "/unp_bus"        /* default name of the segment */
+#define   BUS_MAGIC       "MSGBUS1"
+#define   BUS_READY       0x62757321u       /* "bus!", the creator is done setting it up */
+#define   BUS_CACHELINE   64
+#define   BUS_MAXTYPES    64
+
+#define   BUS_NOWAIT      0x1               /* don't sleep on a full lane (bus_send) or an empty bus (bus_recv) */
+
+#define   PERMS           0666
+
+/*
+ * One queue. `enq` and `deq` are free running positions, the slot is position & (nslots - 1). Each sits on a cache
+ * line of its own, senders hammer one, receivers the other.
+*/
+typedef struct {
+  _Alignas(BUS_CACHELINE)
+  _Atomic uint64_t  enq;                  /* next position a sender claims */
+
+  _Alignas(BUS_CACHELINE)
+  _Atomic uint64_t  deq;                  /* next position a receiver claims */
+
+  _Alignas(BUS_CACHELINE)
+  _Atomic uint32_t  freed;                /* bumped for every slot a receiver gives back, senders sleep on it */
+  _Atomic uint32_t  freed_waiters;        /* senders asleep on `freed` */
+} bus_lane;
+
+typedef struct {
+  _Atomic uint64_t  seq;                  /* whose turn it is, see above */
+  int               len;
+  long              type;
+  char              data[];               /* maxdata bytes */
+} bus_slot;
+
+/*
+ * Start of the segment. The lanes come right after it, then the slots of lane 0, of lane 1, ... Offsets, not
+ * pointers, so each process can map it at any address.
+*/
+typedef struct {
+  char              magic[8];
+  _Atomic uint32_t  ready;                /* BUS_READY once the rest is valid */
+  uint32_t          ntypes;               /* lanes, for types 1 to ntypes */
+  uint32_t          nslots;               /* slots per lane, a power of 2 */
+  uint32_t          maxdata;              /* most data bytes in a message, <= MAXMESGDATA */
+  size_t            slotsize;             /* bytes per slot, a multiple of BUS_CACHELINE */
+  size_t            slotoff;              /* offset of the first slot of lane 0 */
+  size_t            size;                 /* of the whole segment */
+
+  _Alignas(BUS_CACHELINE)
+  _Atomic uint32_t  posted;               /* bumped for every message sent, receivers sleep on it */
+  _Atomic uint32_t  posted_waiters;       /* receivers asleep on `posted` */
+
+  bus_lane          lane[];               /* lines up on a cache line by itself, bus_lane does */
+} bus_hdr;
+
+/*
+ * A process's handle on the bus.
+*/
+typedef struct {
+  bus_hdr   *h;
+  uint32_t  next;                         /* lane a type 0 receiver looks at first, to be fair to all of them */
+} bus;
+
+/*
+ * bus_create:  Make a new bus `name` with `ntypes` types, `nslots` messages per type (rounded up to a power of 2)
+ *              and at most `maxdata` bytes per message. It's an error if one is there already.
+ *              Returns 0 if all OK, else -1.
+*/
+int   bus_create  (const char *name, int ntypes, long nslots, long maxdata);
+
+/*
+ * bus_open:    Attach to the bus `name`. Returns 0 if all OK, else -1.
+*/
+int   bus_open    (bus *b, const char *name);
+
+/*
+ * bus_send:    Send mesg_len bytes of mesg_data with type mesg_type. Returns 0 if all OK, else -1: EINVAL for a type
+ *              or length the bus doesn't take, EAGAIN if the lane is full and flags has BUS_NOWAIT.
+*/
+int   bus_send    (bus *b, const Mesg *mesg, int flags);
+
+/*
+ * bus_recv:    Receive a message of the type mesg_type asks for (the msgrcv rules) into *mesg, type included.
+ *              Returns the number of data bytes, or -1: EAGAIN if there's none and flags has BUS_NOWAIT.
+*/
+int   bus_recv    (bus *b, Mesg *mesg, int flags);
+
+void  bus_close   (bus *b);
+
+int   bus_unlink  (const char *name);
+
+#endif
@@ -0,0 +1,85 @@
+#ifdef __linux__
+#define _GNU_SOURCE                         /* getopt with -std=c11 */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bus.h"
+#include "err_routine.h"
+
+/*
+ * Make, remove and look at a bus.
+ *
+ *    ./busctl -c [-b name] [-t ntypes] [-n nslots] [-d maxdata]
+ *    ./busctl -r [-b name]
+ *    ./busctl -s [-b name]
+ *
+ *    ->  -c makes the bus `name` (BUS_NAME) with `ntypes` types (8), `nslots` messages per type (1024) and messages of
+ *        up to `maxdata` bytes (MAXMESGDATA). It stays there until -r removes it, whoever uses it in between.
+ *    ->  -s shows, per type, how many messages went in and out and how many are waiting in the lane, and how many
+ *        processes are asleep on it. A lane that is always full means the receivers don't keep up, and its
+ *        senders are being held back.
+*/
+int main (int argc, char **argv) {
+  const char  *name = BUS_NAME;
+  long        ntypes = 8, nslots = 1024, maxdata = MAXMESGDATA;
+  int         c, what = 0;
+  uint32_t    l;
+  uint64_t    in, out;
+  bus         b;
+
+  while ( (c = getopt(argc, argv, "crsb:t:n:d:")) != -1) {
+    switch (c) {
+      case 'c': case 'r': case 's':
+        what = c;
+        break;
+      case 'b': name    = optarg;       break;
+      case 't': ntypes  = atol(optarg); break;
+      case 'n': nslots  = atol(optarg); break;
+      case 'd': maxdata = atol(optarg); break;
+      default:
+        what = 0;
+        break;
+    }
+  }
+
+  switch (what) {
+    case 'c':
+      if (bus_create(name, ntypes, nslots, maxdata) < 0) {
+        err_sys("busctl: can't create bus %s (1 to %d types, up to %d bytes)", name, BUS_MAXTYPES, MAXMESGDATA);
+      }
+      break;
+
+    case 'r':
+      if (bus_unlink(name) < 0) {
+        err_sys("busctl: can't remove bus %s", name);
+      }
+      break;
+
+    case 's':
+      if (bus_open(&b, name) < 0) {
+        err_sys("busctl: can't open bus %s", name);
+      }
+      printf("%s: %u types, %u slots each, %u bytes per message, %zu bytes in all, %u receivers asleep\n",
+             name, b.h->ntypes, b.h->nslots, b.h->maxdata, b.h->size, atomic_load(&b.h->posted_waiters));
+      for (l = 0; l < b.h->ntypes; l++) {
+        in  = atomic_load(&b.h->lane[l].enq);
+        out = atomic_load(&b.h->lane[l].deq);
+        if (in == 0) {
+          continue;
+        }
+        printf("  type %2u: %12llu sent %12llu received %8llu queued %4u senders asleep\n", l + 1,
+               (unsigned long long) in, (unsigned long long) out, (unsigned long long) (in - out),
+               atomic_load(&b.h->lane[l].freed_waiters));
+      }
+      bus_close(&b);
+      break;
+
+    default:
+      err_sys("usage: %s -c|-r|-s [-b name] [-t ntypes] [-n nslots] [-d maxdata]", argv[0]);
+  }
+
+  exit(EXIT_SUCCESS);
+}
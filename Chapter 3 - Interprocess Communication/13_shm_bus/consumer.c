@@ -0,0 +1,73 @@
+#ifdef __linux__
+#define _GNU_SOURCE                         /* getopt with -std=c11 */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "bus.h"
+#include "err_routine.h"
+
+Mesg mesg;
+
+/*
+ * Take messages off the bus.
+ *
+ *    ./consumer [-b name] [-t type] [-n count] [-q]
+ *
+ *    ->  `type` (0) is what to ask for, with the msgrcv rules: 0 for anything, > 0 for that type, < 0 for the lowest
+ *        type up to -type.
+ *    ->  The messages are written to the standard output, with their type in front, until `count` of them came
+ *        (forever without -n). -q only counts them, and says how long it took at the end.
+ *    ->  Any number of consumers can take from the same bus, each message goes to one of them.
+*/
+int main (int argc, char **argv) {
+  const char      *name = BUS_NAME;
+  long            type = 0, count = -1, i;
+  int             c, n, quiet = 0, pid = getpid();
+  bus             b;
+  struct timeval  start, end;
+  double          secs;
+
+  while ( (c = getopt(argc, argv, "b:t:n:q")) != -1) {
+    switch (c) {
+      case 'b': name  = optarg;       break;
+      case 't': type  = atol(optarg); break;
+      case 'n': count = atol(optarg); break;
+      case 'q': quiet = 1;            break;
+      default:
+        err_sys("usage: %s [-b name] [-t type] [-n count] [-q]", argv[0]);
+    }
+  }
+
+  if (bus_open(&b, name) < 0) {
+    err_sys("consumer: can't open bus %s (make it with busctl -c)", name);
+  }
+
+  gettimeofday(&start, (struct timezone *) 0);
+  for (i = 0; count < 0 || i < count; i++) {
+    mesg.mesg_type = type;                        /* receive message of this type */
+    if ( (n = bus_recv(&b, &mesg, 0)) < 0) {
+      err_sys("consumer: bus_recv error");
+    }
+    if (!quiet) {
+      printf("%ld: %.*s", mesg.mesg_type, n, mesg.mesg_data);
+      if (n == 0 || mesg.mesg_data[n - 1] != '\n') {
+        putchar('\n');
+      }
+      fflush(stdout);
+    }
+  }
+  gettimeofday(&end, (struct timezone *) 0);
+
+  if (quiet) {
+    secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+    printf("pid = %d: %ld messages in %.3f s (%.0f per second)\n", pid, count, secs, secs > 0 ? count / secs : 0);
+  }
+
+  bus_close(&b);
+  exit(EXIT_SUCCESS);
+}
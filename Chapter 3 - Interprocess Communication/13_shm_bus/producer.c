@@ -0,0 +1,90 @@
+#ifdef __linux__
+#define _GNU_SOURCE                         /* getopt with -std=c11 */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "bus.h"
+#include "err_routine.h"
+
+Mesg mesg;
+
+/*
+ * Put messages on the bus.
+ *
+ *    ./producer [-b name] [-t type] [-n count] [-s size] [-N]
+ *
+ *    ->  Without -n, every line of the standard input is a message of type `type` (1), new-line and all.
+ *    ->  With -n, `count` messages of `size` bytes (64) go out as fast as the bus takes them, and at the end we say
+ *        how long it took. Several of these into one consumer is the fan-in the bus is for.
+ *    ->  -N sends with BUS_NOWAIT: when the lane is full the message is dropped and counted, instead of waiting.
+ *        Without it a producer that's faster than the consumers is held back (it sleeps in bus_send).
+*/
+int main (int argc, char **argv) {
+  const char      *name = BUS_NAME;
+  long            count = -1, i, dropped = 0;
+  int             c, size = 64, flags = 0, pid = getpid();
+  bus             b;
+  struct timeval  start, end;
+  double          secs;
+
+  mesg.mesg_type = 1;
+  while ( (c = getopt(argc, argv, "b:t:n:s:N")) != -1) {
+    switch (c) {
+      case 'b': name            = optarg;       break;
+      case 't': mesg.mesg_type  = atol(optarg); break;
+      case 'n': count           = atol(optarg); break;
+      case 's': size            = atoi(optarg); break;
+      case 'N': flags           = BUS_NOWAIT;   break;
+      default:
+        err_sys("usage: %s [-b name] [-t type] [-n count] [-s size] [-N]", argv[0]);
+    }
+  }
+  if (size < 0 || size > MAXMESGDATA) {
+    err_sys("producer: size must be 0 to %d", MAXMESGDATA);
+  }
+
+  if (bus_open(&b, name) < 0) {
+    err_sys("producer: can't open bus %s (make it with busctl -c)", name);
+  }
+
+  if (count < 0) {
+    while (fgets(mesg.mesg_data, MAXMESGDATA, stdin) != NULL) {
+      mesg.mesg_len = strlen(mesg.mesg_data);
+      if (bus_send(&b, &mesg, flags) < 0) {
+        if (errno != EAGAIN) {
+          err_sys("producer: bus_send error");
+        }
+        dropped++;
+      }
+    }
+  } else {
+    memset(mesg.mesg_data, 'x', size);
+    mesg.mesg_len = size;
+    gettimeofday(&start, (struct timezone *) 0);
+    for (i = 0; i < count; i++) {
+      if (bus_send(&b, &mesg, flags) < 0) {
+        if (errno != EAGAIN) {
+          err_sys("producer: bus_send error");
+        }
+        dropped++;
+      }
+    }
+    gettimeofday(&end, (struct timezone *) 0);
+
+    secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+    printf("pid = %d: %ld messages of type %ld in %.3f s (%.0f per second)\n",
+           pid, count, mesg.mesg_type, secs, secs > 0 ? count / secs : 0);
+  }
+  if (dropped > 0) {
+    printf("pid = %d: %ld messages dropped, the lane was full\n", pid, dropped);
+  }
+
+  bus_close(&b);
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,489 @@
+#ifdef __linux__
+#define _GNU_SOURCE                         /* getopt, wait4, clock_gettime, kill with -std=c99 */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "transport.h"
+#include "err_routine.h"
+
+#define   BENCH_SIZES     "1k,64k,1m,16m,256m"
+#define   BENCH_RUNS      3
+#define   BENCH_SETTLE    200             /* ms a server gets to set up before the client is started */
+#define   BENCH_TIMEOUT   120             /* s a run may take */
+#define   BENCH_CHUNK     (1 << 20)
+
+#define   MAXSIZES        32
+
+/*
+ * What some of the programs print on their standard output besides the file (3_pipes_client_server, 5_fifo). They're
+ * taken out of what comes back before it's checked against the file, wherever they are: the server's are written when
+ * it exits, which can be in the middle of the client's output.
+*/
+static const char   *banners[] = {
+  "****************CLIENT****************\n",
+  "****************SERVER****************\n",
+};
+
+#define   NBANNERS        ((int) (sizeof(banners) / sizeof(banners[0])))
+#define   BANNER_LEN      39              /* they're all this long */
+
+/*
+ * What one run measured. The CPU time and context switches are the client's, plus the server's when it's a `once`
+ * server (we wait for it, so its rusage comes with it). A `keep` server is only reaped at the very end.
+*/
+typedef struct {
+  long            bytes;
+  double          secs;
+  double          startup;                /* s from starting the client to its first byte */
+  struct rusage   ru;
+  int             server_counted;
+  int             ok;                     /* the file came, byte for byte, and the client exited with 0 */
+} result;
+
+/*
+ * A running checksum of a byte stream (FNV-1a, eight bytes at a time) and its length. The bytes are taken into the
+ * words the same way however the stream is cut into pieces, so the file read in one go and the client's output read
+ * as it comes sum the same.
+*/
+typedef struct {
+  unsigned long   h;
+  unsigned char   part[8];
+  int             npart;
+  long            len;
+} digest;
+
+static const char   *base = "..";
+static int          settle = BENCH_SETTLE;
+static int          timeout = BENCH_TIMEOUT;
+static int          verbose;
+
+static double now (void) {
+  struct timespec   ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void msleep (int ms) {
+  struct timespec   ts;
+
+  ts.tv_sec   = ms / 1000;
+  ts.tv_nsec  = (ms % 1000) * 1000000L;
+  nanosleep(&ts, (struct timespec *) 0);
+}
+
+/*
+ * Sizes with the k, m and g suffixes, like the -s of 11_multi_buffer/server.
+*/
+static long getsize (char *s) {
+  char  *end;
+  long  n = strtol(s, &end, 10);
+
+  if (*end == 'k' || *end == 'K') {
+    n *= 1024;
+  } else if (*end == 'm' || *end == 'M') {
+    n *= 1024 * 1024;
+  } else if (*end == 'g' || *end == 'G') {
+    n *= 1024L * 1024 * 1024;
+  }
+  return n;
+}
+
+static void digest_init (digest *d) {
+  memset(d, 0, sizeof(*d));
+  d->h = 14695981039346656037UL;
+}
+
+static void digest_word (digest *d, const unsigned char *p) {
+  unsigned long   w;
+
+  memcpy(&w, p, sizeof(w));
+  d->h = (d->h ^ w) * 1099511628211UL;
+}
+
+static void digest_add (digest *d, const unsigned char *p, long n) {
+  d->len += n;
+  while (n > 0 && d->npart > 0) {
+    d->part[d->npart++] = *p++;
+    n--;
+    if (d->npart == 8) {
+      digest_word(d, d->part);
+      d->npart = 0;
+    }
+  }
+  for ( ; n >= 8; n -= 8, p += 8) {
+    digest_word(d, p);
+  }
+  while (n-- > 0) {
+    d->part[d->npart++] = *p++;
+  }
+}
+
+static unsigned long digest_end (digest *d) {
+  if (d->npart > 0) {
+    memset(d->part + d->npart, 0, 8 - d->npart);
+    digest_word(d, d->part);
+  }
+  return (d->h ^ (unsigned long) d->len) * 1099511628211UL;
+}
+
+/*
+ * The checksum of the file at `path`, to hold the client's output up to.
+*/
+static unsigned long file_digest (const char *path) {
+  static unsigned char  buf[BENCH_CHUNK];
+  digest                d;
+  int                   fd, n;
+
+  if ( (fd = open(path, O_RDONLY)) < 0) {
+    err_sys("can't open %s", path);
+  }
+  digest_init(&d);
+  while ( (n = read(fd, buf, sizeof(buf))) > 0) {
+    digest_add(&d, buf, n);
+  }
+  if (n < 0) {
+    err_sys("read error on %s", path);
+  }
+  close(fd);
+
+  return digest_end(&d);
+}
+
+/*
+ * Take `len` bytes of output (at `w`) into `d`, less the banners. A banner can be cut in two by the end of a read, so
+ * the last BANNER_LEN - 1 bytes are only taken if they can't be the start of one; they're moved to the front of `w`
+ * for the next read, and their count is returned. At the end of the output, call with `last` set and nothing's kept.
+*/
+static int take_output (digest *d, unsigned char *w, int len, int last) {
+  unsigned char   *p, *from = w, *end = w + len;
+  int             i, keep;
+
+  for (p = w; (p = memchr(p, '*', end - p)) != NULL && end - p >= BANNER_LEN; p++) {
+    for (i = 0; i < NBANNERS && memcmp(p, banners[i], BANNER_LEN) != 0; i++) {
+      ;
+    }
+    if (i < NBANNERS) {
+      digest_add(d, from, p - from);
+      from  = p + BANNER_LEN;
+      p     = from - 1;
+    }
+  }
+  keep = last ? 0 : (int) (end - from < BANNER_LEN - 1 ? end - from : BANNER_LEN - 1);
+  digest_add(d, from, end - from - keep);
+  memmove(w, end - keep, keep);
+
+  return keep;
+}
+
+static void rusage_add (struct rusage *to, const struct rusage *ru) {
+  timeradd(&to->ru_utime, &ru->ru_utime, &to->ru_utime);
+  timeradd(&to->ru_stime, &ru->ru_stime, &to->ru_stime);
+  to->ru_nvcsw  += ru->ru_nvcsw;
+  to->ru_nivcsw += ru->ru_nivcsw;
+}
+
+/*
+ * Make (or reuse) a test file of `size` bytes in `dir`. The contents are pseudo-random, so nothing on the way can
+ * get away with compressing or deduplicating it.
+*/
+static void make_file (const char *dir, long size, char *path, size_t len) {
+  struct stat     st;
+  static char     buf[BENCH_CHUNK];
+  unsigned long   x = 88172645463325252UL;
+  long            left, i;
+  int             fd, n;
+
+  snprintf(path, len, "%s/ipcbench.%ld", dir, size);
+  if (stat(path, &st) == 0 && st.st_size == size) {
+    return;
+  }
+  if ( (fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+    err_sys("can't create %s", path);
+  }
+  for (left = size; left > 0; left -= n) {
+    for (i = 0; i < BENCH_CHUNK; i += sizeof(x)) {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      memcpy(buf + i, &x, sizeof(x));
+    }
+    n = (left < BENCH_CHUNK) ? left : BENCH_CHUNK;
+    if (write(fd, buf, n) != n) {
+      err_sys("write error on %s", path);
+    }
+  }
+  close(fd);
+}
+
+/*
+ * A pipe whose ends don't leak into the other programs we start (tr_spawn's dup2 clears the flag on the copy).
+*/
+static void cloexec_pipe (int fd[2]) {
+  if (pipe(fd) < 0) {
+    err_sys("can't create pipe");
+  }
+  fcntl(fd[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fd[1], F_SETFD, FD_CLOEXEC);
+}
+
+/*
+ * Wait up to `ms` for `pid` to exit, then kill it. Its rusage is added to `ru` (if not NULL).
+*/
+static void reap (pid_t pid, int ms, struct rusage *ru) {
+  struct rusage   r;
+  int             status, waited;
+
+  for (waited = 0; ; waited += 10) {
+    if (wait4(pid, &status, WNOHANG, &r) == pid) {
+      break;
+    }
+    if (waited == ms) {
+      kill(pid, SIGTERM);
+    } else if (waited == ms + 1000) {
+      kill(pid, SIGKILL);
+    }
+    msleep(10);
+  }
+  if (ru != NULL) {
+    rusage_add(ru, &r);
+  }
+}
+
+/*
+ * Functionality: One run of one transport on one file.
+ *    ->  The filename goes to the client through a pipe, its standard output comes back through another one. That
+ *        pipe costs the same for every transport.
+ *    ->  What comes back is checked against the file as it comes: the banners some of the programs print are taken
+ *        out (take_output), and the rest has to be `size` bytes with the file's checksum, `sum`. Only then is the run
+ *        ok, whatever the number of bytes: a transport that sends a buffer twice, or loses one, isn't.
+ *    ->  The clock starts when the client is forked and stops when its output ends. The first byte that comes back
+ *        gives the startup latency: starting the client, it getting through to the server, the server opening the
+ *        file and the first piece of it making the trip.
+ *    ->  If the run takes more than `timeout` seconds the client is killed and the run is not ok.
+*/
+static void run_client (transport *tr, const char *file, long size, unsigned long sum, result *res) {
+  static unsigned char  buf[BANNER_LEN + BENCH_CHUNK];
+  struct pollfd         pfd;
+  digest                d;
+  int                   in[2], out[2], status, n, ms, kept = 0;
+  double                start, deadline;
+  pid_t                 pid;
+
+  cloexec_pipe(in);
+  cloexec_pipe(out);
+  memset(res, 0, sizeof(*res));
+  digest_init(&d);
+
+  start = now();
+  deadline = start + timeout;
+  pid = tr_spawn(base, tr->dir, tr->client, in[0], out[1]);
+  close(in[0]);
+  close(out[1]);
+  if (write(in[1], file, strlen(file)) < 0 || write(in[1], "\n", 1) != 1) {
+    err_ret("%s: can't send the filename", tr->name);
+  }
+  close(in[1]);
+
+  pfd.fd      = out[0];
+  pfd.events  = POLLIN;
+  for (;;) {
+    if ( (ms = (int) ((deadline - now()) * 1000)) < 0) {
+      ms = 0;
+    }
+    if ( (n = poll(&pfd, 1, ms)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      err_sys("poll error");
+    }
+    if (n == 0) {
+      kill(pid, SIGKILL);
+      fprintf(stderr, "%s: timed out\n", tr->name);
+      break;
+    }
+    if ( (n = read(out[0], buf + kept, BENCH_CHUNK)) <= 0) {
+      break;
+    }
+    if (res->bytes == 0) {
+      res->startup = now() - start;
+    }
+    res->bytes += n;
+    kept = take_output(&d, buf, kept + n, 0);
+  }
+  res->secs = now() - start;
+  close(out[0]);
+  take_output(&d, buf, kept, 1);
+
+  if (wait4(pid, &status, 0, &res->ru) < 0) {
+    err_sys("wait4 error");
+  }
+  res->ok = (d.len == size && digest_end(&d) == sum && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static void print_result (transport *tr, long size, int run, result *res) {
+  double  cpu;
+
+  cpu = res->ru.ru_utime.tv_sec + res->ru.ru_utime.tv_usec / 1e6 + res->ru.ru_stime.tv_sec +
+        res->ru.ru_stime.tv_usec / 1e6;
+  printf("%s,%ld,%d,%ld,%.6f,%.2f,%.3f,%.6f,%.6f,%.3f,%ld,%ld,%d,%d\n",
+         tr->name, size, run, res->bytes, res->secs,
+         res->secs > 0 ? size / res->secs / (1024 * 1024) : 0,
+         res->startup * 1000,
+         res->ru.ru_utime.tv_sec + res->ru.ru_utime.tv_usec / 1e6,
+         res->ru.ru_stime.tv_sec + res->ru.ru_stime.tv_usec / 1e6,
+         cpu * 1e9 / size,
+         res->ru.ru_nvcsw, res->ru.ru_nivcsw, res->server_counted, res->ok);
+  fflush(stdout);
+}
+
+/*
+ * Is `name` in the comma separated `list`? A NULL list has everything.
+*/
+static int wanted (const char *list, const char *name) {
+  size_t      len = strlen(name);
+  const char  *p;
+
+  if (list == NULL) {
+    return 1;
+  }
+  for (p = list; (p = strstr(p, name)) != NULL; p += len) {
+    if ( (p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0')) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Functionality:
+ *    ->  The transports are read from the transports file (transport.h), -t picks some of them by name. With -m,
+ *        make is run in their directories first.
+ *    ->  A test file is made for every size (-s), in -d. They're left there for the next time with -k.
+ *    ->  Every transport gets `runs` runs on every file, started the way its mode says. A `once` server is started
+ *        before each run and given `settle` ms to set up; a `keep` server once before all of them.
+ *    ->  One CSV line per run goes to the standard output, what's going on to the standard error:
+ *          transport,size,run,bytes,secs,mb_per_s,startup_ms,user_s,sys_s,cpu_ns_per_byte,nvcsw,nivcsw,
+ *          server_counted,ok
+ *        The CPU and context switch columns are the client's, and the server's too if server_counted is 1. The
+ *        rates are per byte of the file, `bytes` is everything that came (banners and all). ok is 1 if the file
+ *        came back as it is (run_client).
+ *
+ * Options:
+ *    -f file       the transports (transports.txt)
+ *    -C dir        where their directories are (..)
+ *    -t a,b,...    only these transports
+ *    -s 1k,64m,... the file sizes (BENCH_SIZES), k, m and g suffixes
+ *    -r runs       runs per transport and size (BENCH_RUNS)
+ *    -d dir        where the test files go (/tmp)
+ *    -k            keep the test files
+ *    -S ms         how long a server gets to start (BENCH_SETTLE)
+ *    -T secs       the most a run may take (BENCH_TIMEOUT)
+ *    -m            make the transports first
+ *    -v            say what's being run
+*/
+int main (int argc, char **argv) {
+  static transport  tr[TR_MAX];
+  const char        *conf = "transports.txt", *only = NULL, *dir = "/tmp";
+  char              *sizelist = BENCH_SIZES, *p, files[MAXSIZES][1024];
+  long              sizes[MAXSIZES];
+  unsigned long     sums[MAXSIZES];
+  int               c, i, j, k, run, ntr, nsizes = 0, runs = BENCH_RUNS, keep = 0, build = 0;
+  pid_t             server = 0;
+  result            res;
+
+  while ( (c = getopt(argc, argv, "f:C:t:s:r:d:kS:T:mv")) != -1) {
+    switch (c) {
+      case 'f': conf      = optarg;       break;
+      case 'C': base      = optarg;       break;
+      case 't': only      = optarg;       break;
+      case 's': sizelist  = optarg;       break;
+      case 'r': runs      = atoi(optarg); break;
+      case 'd': dir       = optarg;       break;
+      case 'k': keep      = 1;            break;
+      case 'S': settle    = atoi(optarg); break;
+      case 'T': timeout   = atoi(optarg); break;
+      case 'm': build     = 1;            break;
+      case 'v': verbose   = 1;            break;
+      default:
+        err_sys("usage: %s [-f file] [-C dir] [-t names] [-s sizes] [-r runs] [-d dir] [-k] [-S ms] [-T secs] [-m] "
+                "[-v]", argv[0]);
+    }
+  }
+  signal(SIGPIPE, SIG_IGN);               /* a client that dies early shouldn't take us with it */
+
+  ntr = tr_load(conf, tr, TR_MAX);
+  for (p = strtok(sizelist, ","); p != NULL && nsizes < MAXSIZES; p = strtok(NULL, ",")) {
+    if ( (sizes[nsizes] = getsize(p)) <= 0) {
+      err_sys("bad size %s", p);
+    }
+    make_file(dir, sizes[nsizes], files[nsizes], sizeof(files[nsizes]));
+    sums[nsizes] = file_digest(files[nsizes]);
+    nsizes++;
+  }
+
+  printf("transport,size,run,bytes,secs,mb_per_s,startup_ms,user_s,sys_s,cpu_ns_per_byte,nvcsw,nivcsw,"
+         "server_counted,ok\n");
+  fflush(stdout);
+
+  for (i = 0; i < ntr; i++) {
+    if (!wanted(only, tr[i].name)) {
+      continue;
+    }
+    if (build && tr_build(base, tr[i].dir) != 0) {
+      fprintf(stderr, "%s: make failed in %s, skipped\n", tr[i].name, tr[i].dir);
+      continue;
+    }
+    if (tr[i].mode == TR_KEEP) {
+      server = tr_spawn(base, tr[i].dir, tr[i].server, -1, -1);
+      msleep(settle);
+    }
+    for (j = 0; j < nsizes; j++) {
+      for (run = 1; run <= runs; run++) {
+        if (verbose) {
+          fprintf(stderr, "%s: %ld bytes, run %d\n", tr[i].name, sizes[j], run);
+        }
+        if (tr[i].mode == TR_ONCE) {
+          server = tr_spawn(base, tr[i].dir, tr[i].server, -1, -1);
+          msleep(settle);
+        }
+        run_client(&tr[i], files[j], sizes[j], sums[j], &res);
+        if (tr[i].mode == TR_ONCE) {
+          reap(server, 2000, &res.ru);    /* it should be on its way out already */
+          res.server_counted = 1;
+        }
+        print_result(&tr[i], sizes[j], run, &res);
+        if (!res.ok) {
+          fprintf(stderr, "%s: run %d with %ld bytes failed (%ld bytes came)\n", tr[i].name, run, sizes[j],
+                  res.bytes);
+        }
+      }
+    }
+    if (tr[i].mode == TR_KEEP) {
+      kill(server, SIGTERM);
+      reap(server, 2000, (struct rusage *) 0);
+    }
+  }
+
+  if (!keep) {
+    for (k = 0; k < nsizes; k++) {
+      unlink(files[k]);
+    }
+  }
+
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,139 @@
+#ifdef __linux__
+#define _GNU_SOURCE                         /* fork, chdir, strtok_r with -std=c99 */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "transport.h"
+#include "err_routine.h"
+
+/*
+ * Cut `s` at the first `c`, return what's after it (NULL if there's no `c`). Leading and trailing blanks of the
+ * first part go.
+*/
+static char *field (char *s, int c, char **first) {
+  char  *p = strchr(s, c), *end;
+
+  if (p != NULL) {
+    *p++ = '\0';
+  }
+  while (*s == ' ' || *s == '\t') {
+    s++;
+  }
+  end = s + strlen(s);
+  while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n')) {
+    *--end = '\0';
+  }
+  *first = s;
+
+  return p;
+}
+
+static int split (char *s, char **argv) {
+  char  *save, *p;
+  int   n = 0;
+
+  for (p = strtok_r(s, " \t", &save); p != NULL; p = strtok_r(NULL, " \t", &save)) {
+    if (n == TR_MAXARGS - 1) {
+      return -1;
+    }
+    argv[n++] = p;
+  }
+  argv[n] = NULL;
+
+  return n;
+}
+
+int tr_load (const char *path, transport *tr, int max) {
+  FILE  *fp;
+  char  *rest, *mode, *server, *client, *p;
+  int   n = 0, lineno = 0;
+
+  if ( (fp = fopen(path, "r")) == NULL) {
+    err_sys("can't open %s", path);
+  }
+  while (n < max && fgets(tr[n].line, TR_MAXLINE, fp) != NULL) {
+    lineno++;
+    if ( (p = strchr(tr[n].line, '#')) != NULL) {
+      *p = '\0';
+    }
+    if (strspn(tr[n].line, " \t\n") == strlen(tr[n].line)) {
+      continue;
+    }
+
+    if ( (rest = field(tr[n].line, ':', &tr[n].name)) == NULL ||
+         (rest = field(rest, ':', &tr[n].dir)) == NULL ||
+         (rest = field(rest, ':', &mode)) == NULL ||
+         (rest = field(rest, ':', &server)) == NULL ||
+         field(rest, ':', &client) != NULL) {
+      err_sys("%s:%d: need 5 fields separated by ':'", path, lineno);
+    }
+
+    if (strcmp(mode, "none") == 0) {
+      tr[n].mode = TR_NONE;
+    } else if (strcmp(mode, "once") == 0) {
+      tr[n].mode = TR_ONCE;
+    } else if (strcmp(mode, "keep") == 0) {
+      tr[n].mode = TR_KEEP;
+    } else {
+      err_sys("%s:%d: the mode is none, once or keep", path, lineno);
+    }
+    if (split(server, tr[n].server) < 0 || split(client, tr[n].client) <= 0) {
+      err_sys("%s:%d: no client command, or too many arguments", path, lineno);
+    }
+    if ( (tr[n].mode == TR_NONE) != (tr[n].server[0] == NULL)) {
+      err_sys("%s:%d: a server command is needed for once and keep, and only for them", path, lineno);
+    }
+    n++;
+  }
+  fclose(fp);
+
+  return n;
+}
+
+pid_t tr_spawn (const char *base, const char *dir, char **argv, int in, int out) {
+  pid_t   pid;
+  int     null;
+
+  if ( (pid = fork()) < 0) {
+    err_sys("can't fork");
+  } else if (pid == 0) {
+    if ( (null = open("/dev/null", O_RDWR)) < 0) {
+      err_sys("can't open /dev/null");
+    }
+    dup2(in >= 0 ? in : null, 0);
+    dup2(out >= 0 ? out : null, 1);
+    dup2(null, 2);                    /* the servers like to talk, it's not our output */
+    if (chdir(base) < 0 || chdir(dir) < 0) {
+      _exit(126);
+    }
+    execvp(argv[0], argv);
+    _exit(127);
+  }
+
+  return pid;
+}
+
+int tr_build (const char *base, const char *dir) {
+  char    path[TR_MAXLINE * 2];
+  pid_t   pid;
+  int     status;
+
+  snprintf(path, sizeof(path), "%s/%s", base, dir);
+  if ( (pid = fork()) < 0) {
+    err_sys("can't fork");
+  } else if (pid == 0) {
+    execlp("make", "make", "-s", "-C", path, (char *) 0);
+    _exit(127);
+  }
+  if (waitpid(pid, &status, 0) < 0) {
+    err_sys("waitpid error");
+  }
+
+  return status;
+}
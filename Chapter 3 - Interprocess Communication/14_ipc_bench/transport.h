@@ -0,0 +1,65 @@
+/*
+ *  The transports the benchmark knows about, and how to start their programs.
+ *
+ *  Every client-server pair in this chapter does the same thing: the client reads a filename from its standard input,
+ *  the server sends the file back and the client writes it to its standard output. So all the benchmark needs to know
+ *  about a transport is which programs to start, and where. That's one line of the transports file (transports.txt):
+ *
+ *      name : directory : mode : server command : client command
+ *
+ *    ->  The directory is relative to the chapter (or -C), the commands are run in it.
+ *    ->  The mode says what to do with the server:
+ *          none  there's no server, the client program is the whole thing (pipes, fork()ed in main.c).
+ *          once  the server serves one client and exits, so it's started again for every run.
+ *          keep  the server keeps running, it's started once for all the runs of the transport and killed after.
+ *    ->  The commands are split at blanks, no quoting. With mode none the server command is left empty.
+ *    ->  '#' starts a comment, blank lines are skipped.
+ *
+ *  A new transport is a new line, nothing is compiled in.
+ *
+ *  The routines available:
+ *    1.  n = tr_load(path, tr, max);                   // read the transports file, returns how many
+ *    2.  pid = tr_spawn(base, tr->dir, argv, in, out); // start a program of a transport
+ *    3.  tr_build(base, tr->dir);                      // run make in its directory
+*/
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <sys/types.h>
+
+#define   TR_MAXLINE    512
+#define   TR_MAXARGS    32
+#define   TR_MAX        64              /* transports in one file */
+
+#define   TR_NONE       0
+#define   TR_ONCE       1
+#define   TR_KEEP       2
+
+typedef struct {
+  char    *name;
+  char    *dir;
+  int     mode;                         /* TR_NONE, TR_ONCE or TR_KEEP */
+  char    *server[TR_MAXARGS];          /* NULL terminated, server[0] NULL with TR_NONE */
+  char    *client[TR_MAXARGS];
+  char    line[TR_MAXLINE];             /* where all the strings above are */
+} transport;
+
+/*
+ * tr_load: Read up to `max` transports from `path` into `tr`. A line that doesn't make sense is a fatal error, with
+ *          its number.
+*/
+int   tr_load   (const char *path, transport *tr, int max);
+
+/*
+ * tr_spawn: fork and exec `argv` in base/dir, with `in` as its standard input and `out` as its standard output (-1
+ *           for /dev/null). Returns the child's pid.
+*/
+pid_t tr_spawn  (const char *base, const char *dir, char **argv, int in, int out);
+
+/*
+ * tr_build: `make -s` in base/dir, returns its exit status.
+*/
+int   tr_build  (const char *base, const char *dir);
+
+#endif
@@ -0,0 +1,77 @@
+#include "arena.h"
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+int arena_create (Arena *a, long size) {
+  if ( (a->shmid = shmget(IPC_PRIVATE, ARENA_HDRSIZE + size, PERMS | IPC_CREAT)) < 0) {
+    return -1;
+  }
+  if ( (a->hdr = (ArenaHdr *) shmat(a->shmid, (char *) 0, 0)) == (ArenaHdr *) -1) {
+    shmctl(a->shmid, IPC_RMID, (struct shmid_ds *) 0);
+    return -1;
+  }
+  memcpy(a->hdr->magic, ARENA_MAGIC, sizeof(a->hdr->magic));
+  a->hdr->generation  = ((unsigned long) time((time_t *) 0) << 16) ^ (unsigned long) getpid();
+  a->hdr->size        = size;
+  a->data             = (char *) a->hdr + ARENA_HDRSIZE;
+  a->head             = 0;
+  a->tail             = 0;
+
+  return 0;
+}
+
+/*
+ * Functionality: If `len` bytes from the head would run past the end of the arena, the rest of the arena is skipped
+ *                and they start at the beginning. The skipped bytes count as in use (the tail moves past them when
+ *                the chunk after them is freed), so the room needed is the skip plus `len`.
+*/
+char *arena_reserve (Arena *a, long len) {
+  long  size = a->hdr->size, pos = a->head % size, skip;
+
+  skip = (pos + len > size) ? size - pos : 0;
+  if (len > size || a->head + skip + len - a->tail > size) {
+    return NULL;
+  }
+  a->head += skip;
+
+  return a->data + (a->head % size);
+}
+
+long arena_commit (Arena *a, long n) {
+  long  offset = a->head;
+
+  a->head += n;
+  return offset;
+}
+
+void arena_free (Arena *a, long offset, long length) {
+  if (offset + length > a->tail && offset + length <= a->head) {
+    a->tail = offset + length;
+  }
+}
+
+void arena_remove (Arena *a) {
+  shmdt((char *) a->hdr);
+  shmctl(a->shmid, IPC_RMID, (struct shmid_ds *) 0);
+}
+
+ArenaHdr *arena_attach (int shmid) {
+  ArenaHdr  *h;
+
+  if ( (h = (ArenaHdr *) shmat(shmid, (char *) 0, SHM_RDONLY)) == (ArenaHdr *) -1) {
+    return NULL;
+  }
+  if (memcmp(h->magic, ARENA_MAGIC, sizeof(h->magic)) != 0) {
+    shmdt((char *) h);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  return h;
+}
+
+char *arena_at (ArenaHdr *h, long offset) {
+  return (char *) h + ARENA_HDRSIZE + (offset % h->size);
+}
@@ -0,0 +1,130 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <sys/shm.h>
+
+#include <errno.h>
+extern int errno;
+
+/*
+ * The file goes through a System V message queue, but not in it.
+ *
+ * In 7_system_v_ipc every MAXMESGDATA bytes of the file are a message: copied from the server into the kernel with
+ * msgsnd() and out again with msgrcv(), and the queue holds only msg_qbytes (16 KB) of them at a time. Here the queue
+ * carries only small descriptors, and the bytes are in a shared memory segment, the arena:
+ *    ->  The server creates the arena (one System V segment) and reads the file straight into it, ARENA_CHUNK bytes
+ *        at a time. Then it sends the client an ArenaDesc: which segment (`region`, its shmid), where in it
+ *        (`offset`), how much (`length`), and the arena's `generation`.
+ *    ->  The client attaches the segment (the first time), writes the bytes from where they are, and sends the
+ *        descriptor back as its acknowledgement. That frees the bytes.
+ *    ->  The arena is used as a ring: the server allocates at the head, and every acknowledgement moves the tail up.
+ *        A chunk never wraps around the end of the arena (what's left at the end is skipped), so the client always
+ *        gets it in one piece. When the ring is full, the server waits for an acknowledgement.
+ *    ->  The queue still does what a queue is good at: the descriptors come out in order, and by mesg_type, so the
+ *        requests (ARENA_SERVER), the descriptors for a client (its pid) and its acknowledgements (pid | ARENA_ACK)
+ *        all share one queue without getting mixed up.
+ *
+ * The server's read() copies the file into the arena, and that's the only copy: the client's write() takes the bytes
+ * from the arena, and the queue never sees them.
+ *
+ * `offset` is a position in the ring that only goes up, the byte is at offset % size of the arena. The generation
+ * is made up when the arena is created: a descriptor for an arena that's gone (a server that was restarted, whose
+ * new arena got the same shmid) doesn't match the arena's generation.
+ *
+ * The routines available:
+ *    1.  arena_create(a, size);            // the server: make the arena
+ *    2.  p = arena_reserve(a, len);        // room for `len` bytes at the head, or NULL if the ring is full
+ *    3.  offset = arena_commit(a, n);      // the first `n` of them are in use
+ *    4.  arena_free(a, offset, length);    // acknowledged, the tail moves up to the end of it
+ *    5.  arena_remove(a);                  // detach and remove it
+ *    6.  h = arena_attach(shmid);          // the client: attach it, read-only
+ *    7.  p = arena_at(h, offset);          // where a descriptor's bytes are
+*/
+
+#define   ARENA_MKEY      ((key_t) 3456L)   /* the message queue */
+#define   PERMS           0666
+
+#define   ARENA_SERVER    1L                /* mesg_type of the requests */
+#define   ARENA_ACK       (1L << 30)        /* pid | ARENA_ACK: acknowledgements from client pid */
+
+#define   ARENA_SIZE      (4L * 1024 * 1024)  /* default size of the arena */
+#define   ARENA_CHUNK     (256L * 1024)       /* default bytes per descriptor */
+#define   ARENA_TIMEOUT   5                 /* seconds the server waits for an acknowledgement before it checks on the client */
+#define   ARENA_MAGIC     "ARENA01"
+
+/*
+ * Start of the segment. The data starts ARENA_HDRSIZE bytes in.
+*/
+typedef struct {
+  char          magic[8];
+  unsigned long generation;
+  long          size;                     /* bytes of data */
+} ArenaHdr;
+
+#define   ARENA_HDRSIZE   64
+
+/*
+ * What goes through the queue, both ways. As for msgsnd(), the long mesg_type comes first, the rest is the data.
+*/
+typedef struct {
+  long          mesg_type;                /* the client's pid, or pid | ARENA_ACK coming back */
+  long          region;                   /* shmid of the arena */
+  unsigned long generation;               /* of the arena */
+  long          offset;                   /* in the ring */
+  long          length;                   /* 0: end of file */
+} ArenaDesc;
+
+#define   ARENA_DESCSIZE  (sizeof(ArenaDesc) - sizeof(long))
+
+/*
+ * The server's handle on the arena.
+*/
+typedef struct {
+  int           shmid;
+  ArenaHdr      *hdr;
+  char          *data;
+  long          head;                     /* next offset to allocate */
+  long          tail;                     /* everything before it is free */
+} Arena;
+
+/*
+ * arena_create:  Make an arena with `size` bytes of data, and attach it. Returns 0 if all OK, else -1.
+*/
+int       arena_create  (Arena *a, long size);
+
+/*
+ * arena_reserve: Room for `len` bytes at the head of the ring, in one piece, or NULL if there isn't that much free
+ *                (or `len` is more than the arena). Nothing is in use until arena_commit.
+*/
+char      *arena_reserve (Arena *a, long len);
+
+/*
+ * arena_commit:  The first `n` bytes of the last arena_reserve are in use. Returns their offset, for the descriptor.
+*/
+long      arena_commit  (Arena *a, long n);
+
+/*
+ * arena_free:    The bytes at `offset` are acknowledged. They're freed in order, so the tail moves up to the end of
+ *                them (and whatever was skipped at the end of the ring before them is free too).
+*/
+void      arena_free    (Arena *a, long offset, long length);
+
+/*
+ * arena_remove:  Detach the arena and remove it. Clients that still have it attached keep it until they detach.
+*/
+void      arena_remove  (Arena *a);
+
+/*
+ * arena_attach:  Attach the arena `shmid`, read-only, and check it is one. Returns its header, or NULL.
+*/
+ArenaHdr  *arena_attach (int shmid);
+
+/*
+ * arena_at:      Where the bytes at `offset` are.
+*/
+char      *arena_at     (ArenaHdr *h, long offset);
+
+#endif
@@ -0,0 +1,85 @@
+#include "arena.h"
+#include "mesg.h"
+#include "err_routine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+Mesg  mesg;
+
+/*
+ * Functionality:
+ *    ->  Open the queue, the server must have created it.
+ *    ->  Read the filename from the standard input, and send "pid filename" as a request (ARENA_SERVER).
+ *    ->  Take the descriptors for our pid off the queue, one after the other. The first one (and any with another
+ *        region) says which arena to attach. The bytes are written to the standard output from the arena, and the
+ *        descriptor goes back with mesg_type pid | ARENA_ACK, which frees them.
+ *    ->  A descriptor of length 0 is the end of file. The queue is left for the server (and the next client).
+*/
+int main (void) {
+  ArenaDesc d;
+  ArenaHdr  *h = NULL;
+  char      *p, filename[MAXMESGDATA - 32];
+  int       msgqid, n;
+  long      pid = getpid(), region = -1, off, w;
+
+  if ( (msgqid = msgget(ARENA_MKEY, 0)) < 0) {
+    err_sys("client: can't msgget message queue, is the server running?");
+  }
+
+  if (fgets(filename, sizeof(filename), stdin) == NULL) {
+    err_sys("client: filename read error");
+  }
+  n = strlen(filename);
+  if (n > 0 && filename[n-1] == '\n') {
+    filename[n-1] = '\0';             /* ignore newline from fgets() */
+  }
+  sprintf(mesg.mesg_data, "%ld %s", pid, filename);
+
+  mesg.mesg_type  = ARENA_SERVER;
+  mesg.mesg_len   = strlen(mesg.mesg_data);
+  if (msgsnd(msgqid, (char *) &(mesg.mesg_type), mesg.mesg_len, 0) != 0) {
+    err_sys("client: msgsnd error");
+  }
+
+  for (;;) {
+    if (msgrcv(msgqid, (char *) &d, ARENA_DESCSIZE, pid, 0) < 0) {
+      err_sys("client: msgrcv error");
+    }
+    if (d.length == 0) {
+      break;
+    }
+    if (d.region != region) {
+      if (h != NULL) {
+        shmdt((char *) h);
+      }
+      if ( (h = arena_attach((int) d.region)) == NULL) {
+        err_sys("client: can't attach the arena %ld", d.region);
+      }
+      region = d.region;
+    }
+    if (d.generation != h->generation || d.length < 0 || d.length > h->size) {
+      err_sys("client: descriptor for an arena that's gone");
+    }
+
+    p = arena_at(h, d.offset);
+    for (off = 0; off < d.length; off += w) {
+      if ( (w = write(1, p + off, d.length - off)) < 0) {
+        err_sys("client: data write error");
+      }
+    }
+
+    d.mesg_type = pid | ARENA_ACK;
+    if (msgsnd(msgqid, (char *) &d, ARENA_DESCSIZE, 0) != 0) {
+      err_sys("client: acknowledgement error");
+    }
+  }
+
+  if (h != NULL) {
+    shmdt((char *) h);
+  }
+
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,223 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* getopt, kill and sigaction with -ansi */
+#endif
+
+#include "arena.h"
+#include "mesg.h"
+#include "err_routine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+Mesg    mesg;                 /* the request */
+Arena   arena;
+
+volatile sig_atomic_t stop;
+
+void sig_stop (int signo) {
+  (void) signo;
+  stop = 1;
+}
+
+void sig_alarm (int signo) {
+  (void) signo;               /* only there to interrupt msgrcv */
+}
+
+/*
+ * "4096", "64k", "2m" -> bytes.
+*/
+static long getsize (char *s) {
+  char  *end;
+  long  n = strtol(s, &end, 10);
+
+  if (*end == 'k' || *end == 'K') {
+    n *= 1024;
+  } else if (*end == 'm' || *end == 'M') {
+    n *= 1024 * 1024;
+  }
+  return n;
+}
+
+/*
+ * Drop whatever is still on the queue for, or from, a client that went away, and with it everything it had in the
+ * arena (there's one client at a time, so that's all of it).
+*/
+void drain (int msgqid, long pid) {
+  ArenaDesc d;
+
+  while (msgrcv(msgqid, (char *) &d, ARENA_DESCSIZE, pid, IPC_NOWAIT | MSG_NOERROR) >= 0) {
+    ;
+  }
+  while (msgrcv(msgqid, (char *) &d, ARENA_DESCSIZE, pid | ARENA_ACK, IPC_NOWAIT | MSG_NOERROR) >= 0) {
+    ;
+  }
+  arena.head = arena.tail = 0;
+}
+
+/*
+ * Wait for an acknowledgement from client `pid`, and free what it acknowledges. Every ARENA_TIMEOUT seconds (SIGALRM)
+ * we check that it's still there. Returns 1, or 0 if the client is gone (or we're stopped).
+*/
+int wait_ack (int msgqid, long pid) {
+  ArenaDesc d;
+  int       n;
+
+  for (;;) {
+    alarm(ARENA_TIMEOUT);
+    n = msgrcv(msgqid, (char *) &d, ARENA_DESCSIZE, pid | ARENA_ACK, MSG_NOERROR);
+    alarm(0);
+    if (n >= 0) {
+      if (d.region == arena.shmid && d.generation == arena.hdr->generation) {
+        arena_free(&arena, d.offset, d.length);
+      }
+      return 1;
+    } else if (errno != EINTR) {
+      err_sys("server: acknowledgement read error");
+    } else if (stop || (kill((pid_t) pid, 0) < 0 && errno == ESRCH)) {
+      err_ret("server: client %ld went away", pid);
+      drain(msgqid, pid);
+      return 0;
+    }
+  }
+}
+
+/*
+ * Send the client the descriptor for the `n` bytes just put in the arena (0: end of file).
+*/
+void send_desc (int msgqid, long pid, long offset, long n) {
+  ArenaDesc d;
+
+  d.mesg_type   = pid;
+  d.region      = arena.shmid;
+  d.generation  = arena.hdr->generation;
+  d.offset      = offset;
+  d.length      = n;
+  if (msgsnd(msgqid, (char *) &d, ARENA_DESCSIZE, 0) != 0) {
+    err_sys("server: msgsnd error");
+  }
+}
+
+/*
+ * Functionality: One client.
+ *    ->  If the file can't be opened, the error message goes into the arena and is sent like a piece of the file.
+ *    ->  Otherwise the file is read into the arena `chunk` bytes at a time, straight to where the client will find
+ *        it, and a descriptor is sent for each piece. If the ring is full we wait for the client to acknowledge
+ *        (wait_ack), which frees the oldest piece.
+ *    ->  A descriptor with length 0 is the end of file. Then we wait until everything has been acknowledged, so the
+ *        next client starts with an empty arena. That's up to the end of the last piece sent, not the head: the
+ *        arena_reserve that found the end of file may have skipped to the start of the ring, and nothing after those
+ *        skipped bytes will ever be acknowledged.
+*/
+void serve (int msgqid, long pid, char *filename, long chunk) {
+  char  *p, errmesg[256], *sys_err_str();
+  int   filefd;
+  long  n, end = arena.head;                /* where the last piece sent ends */
+
+  if ( (filefd = open(filename, O_RDONLY)) < 0) {
+    sprintf(errmesg, "%.*s: can't open, %s\n", (int) (sizeof(errmesg) - 64), filename, sys_err_str());
+    n = strlen(errmesg);
+    while ( (p = arena_reserve(&arena, n)) == NULL) {
+      if (!wait_ack(msgqid, pid)) {
+        return;
+      }
+    }
+    memcpy(p, errmesg, n);
+    send_desc(msgqid, pid, arena_commit(&arena, n), n);
+    end = arena.head;
+  } else {
+    for (;;) {
+      while ( (p = arena_reserve(&arena, chunk)) == NULL) {
+        if (!wait_ack(msgqid, pid)) {
+          close(filefd);
+          return;
+        }
+      }
+      if ( (n = read(filefd, p, chunk)) <= 0) {
+        break;
+      }
+      send_desc(msgqid, pid, arena_commit(&arena, n), n);
+      end = arena.head;
+    }
+    close(filefd);
+    if (n < 0) {
+      err_ret("server: read error on %s", filename);
+    }
+  }
+
+  send_desc(msgqid, pid, end, 0L);
+  while (arena.tail < end) {
+    if (!wait_ack(msgqid, pid)) {
+      return;
+    }
+  }
+  arena.head = arena.tail = 0;
+}
+
+/*
+ * Functionality:
+ *    ->  Create the queue (or open it, if it's there) and the arena, `size` bytes (ARENA_SIZE).
+ *    ->  Read a request, the mesg_type is ARENA_SERVER, the data is "pid filename". Serve that client (serve), then
+ *        the next one. A request waits on the queue while another client is served.
+ *    ->  SIGINT or SIGTERM remove the queue and the arena.
+ *
+ *        ./server [-a size] [-c chunk]
+*/
+int main (int argc, char **argv) {
+  int               c, n, off, msgqid;
+  long              pid, size = ARENA_SIZE, chunk = ARENA_CHUNK;
+  struct sigaction  sa;
+
+  while ( (c = getopt(argc, argv, "a:c:")) != -1) {
+    switch (c) {
+      case 'a': size  = getsize(optarg); break;
+      case 'c': chunk = getsize(optarg); break;
+      default:
+        err_sys("usage: %s [-a size] [-c chunk]", argv[0]);
+    }
+  }
+  if (chunk < 1 || size < 2 * chunk) {
+    err_sys("server: the arena must hold at least two chunks");
+  }
+
+  if ( (msgqid = msgget(ARENA_MKEY, PERMS | IPC_CREAT)) < 0) {
+    err_sys("server: can't get message queue");
+  }
+  if (arena_create(&arena, size) < 0) {
+    err_sys("server: can't create the arena (%ld bytes)", size);
+  }
+
+  memset(&sa, 0, sizeof(sa));
+  sigemptyset(&sa.sa_mask);
+  sa.sa_handler = sig_stop;               /* no SA_RESTART: msgrcv returns EINTR */
+  sigaction(SIGINT, &sa, (struct sigaction *) 0);
+  sigaction(SIGTERM, &sa, (struct sigaction *) 0);
+  sa.sa_handler = sig_alarm;
+  sigaction(SIGALRM, &sa, (struct sigaction *) 0);
+
+  while (!stop) {
+    if ( (n = msgrcv(msgqid, (char *) &(mesg.mesg_type), MAXMESGDATA - 1, ARENA_SERVER, MSG_NOERROR)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      err_sys("server: request read error");
+    }
+    mesg.mesg_data[n] = '\0';
+    off = -1;
+    if (sscanf(mesg.mesg_data, "%ld %n", &pid, &off) != 1 || off < 0 || pid <= 1) {
+      err_ret("server: bad request");
+      continue;
+    }
+    serve(msgqid, pid, mesg.mesg_data + off, chunk);
+  }
+
+  arena_remove(&arena);
+  if (msgctl(msgqid, IPC_RMID, (struct msqid_ds *) 0) < 0) {
+    err_sys("server: can't RMID message queue");
+  }
+
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,173 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* pread, pwrite with -ansi */
+#endif
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include "counter.h"
+#include "lock.h"
+#include "err_routine.h"
+
+#define PERMS     0666
+
+/*
+ * The header, in the first slot.
+*/
+typedef struct {
+  char    magic[8];
+  int     nslots;
+  int     slotsize;
+} counter_hdr;
+
+#define SLOT_OFF(c, slot)   ((long) ((slot) + 1) * (c)->slotsize)
+
+int counter_create (path, nslots, slotsize)
+const char  *path;
+int         nslots;
+int         slotsize; {
+  counter_hdr hdr;
+  int         fd;
+
+  if (nslots < 1 || slotsize < 1) {
+    return -1;
+  }
+  slotsize = (slotsize + COUNTER_ALIGN - 1) / COUNTER_ALIGN * COUNTER_ALIGN;
+
+  if ( (fd = open(path, O_RDWR | O_CREAT | O_EXCL, PERMS)) < 0) {
+    return -1;
+  }
+
+  /* the slots are the hole at the end of the file, which reads as zeros */
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, COUNTER_MAGIC, sizeof(hdr.magic));
+  hdr.nslots    = nslots;
+  hdr.slotsize  = slotsize;
+  if (write(fd, (char *) &hdr, sizeof(hdr)) != sizeof(hdr) || ftruncate(fd, (off_t) (nslots + 1) * slotsize) < 0) {
+    close(fd);
+    unlink(path);
+    return -1;
+  }
+
+  close(fd);
+  return 0;
+}
+
+int counter_open (c, path)
+counter     *c;
+const char  *path; {
+  counter_hdr hdr;
+
+  if ( (c->fd = open(path, O_RDWR)) < 0) {
+    return -1;
+  }
+  if (read(c->fd, (char *) &hdr, sizeof(hdr)) != sizeof(hdr) || memcmp(hdr.magic, COUNTER_MAGIC, sizeof(hdr.magic)) != 0 ||
+      hdr.nslots < 1 || hdr.slotsize < (int) sizeof(long)) {
+    close(c->fd);
+    return -1;
+  }
+
+  c->nslots   = hdr.nslots;
+  c->slotsize = hdr.slotsize;
+  c->map      = NULL;
+  c->maplen   = (long) (hdr.nslots + 1) * hdr.slotsize;
+
+  return 0;
+}
+
+void counter_close (c)
+counter *c; {
+  if (c->map != NULL) {
+    munmap(c->map, c->maplen);
+  }
+  close(c->fd);
+}
+
+static void counter_check (c, slot)
+counter *c;
+int     slot; {
+  if (slot < 0 || slot >= c->nslots) {
+    err_sys("counter slot %d out of range (0..%d)", slot, c->nslots - 1);
+  }
+}
+
+static long *counter_slot (c, slot)
+counter *c;
+int     slot; {
+  void  *p;
+
+  counter_check(c, slot);
+  if (c->map == NULL) {
+    if ( (p = mmap((void *) 0, c->maplen, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, (off_t) 0)) == MAP_FAILED) {
+      err_sys("can't mmap counter file");
+    }
+    c->map = (char *) p;
+  }
+
+  return (long *) (c->map + SLOT_OFF(c, slot));
+}
+
+long counter_get (c, slot)
+counter *c;
+int     slot; {
+  long  val;
+
+  counter_check(c, slot);
+  if (pread(c->fd, (char *) &val, sizeof(val), (off_t) SLOT_OFF(c, slot)) != sizeof(val)) {
+    err_sys("counter read error");
+  }
+
+  return val;
+}
+
+long counter_add (c, slot, delta)
+counter *c;
+int     slot;
+long    delta; {
+  long  val, off;
+
+  counter_check(c, slot);
+  off = SLOT_OFF(c, slot);
+
+  my_range_lock(c->fd, off, (long) c->slotsize);
+  if (pread(c->fd, (char *) &val, sizeof(val), (off_t) off) != sizeof(val)) {
+    err_sys("counter read error");
+  }
+  val += delta;
+  if (pwrite(c->fd, (char *) &val, sizeof(val), (off_t) off) != sizeof(val)) {
+    err_sys("counter write error");
+  }
+  my_range_unlock(c->fd, off, (long) c->slotsize);
+
+  return val;
+}
+
+/*
+ * The page cache page is the same whether it's reached with pread/pwrite or through the mapping, so the two paths see
+ * each other's updates, and the range lock keeps them apart.
+*/
+long counter_add_mapped (c, slot, delta)
+counter *c;
+int     slot;
+long    delta; {
+  long  *p, val, off;
+
+  p   = counter_slot(c, slot);
+  off = SLOT_OFF(c, slot);
+
+  my_range_lock(c->fd, off, (long) c->slotsize);
+  val = (*p += delta);
+  my_range_unlock(c->fd, off, (long) c->slotsize);
+
+  return val;
+}
+
+long counter_add_atomic (c, slot, delta)
+counter *c;
+int     slot;
+long    delta; {
+  return __atomic_add_fetch(counter_slot(c, slot), delta, __ATOMIC_SEQ_CST);
+}
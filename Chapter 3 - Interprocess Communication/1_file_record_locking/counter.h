@@ -0,0 +1,65 @@
+#ifndef COUNTER_H
+#define COUNTER_H
+
+/*
+ * A file of many independent counters, so processes updating different counters don't wait for each other.
+ *
+ * `seqno` is one number in text, and every increment locks the whole file, seeks, reads, scans, prints, seeks and
+ * writes. With one counter that's all there is to do. With many counters in one file, locking the whole file would
+ * make every process wait for every other one. Here:
+ *    ->  The file is a header followed by `nslots` slots of `slotsize` bytes (a multiple of COUNTER_ALIGN, the size of
+ *        a cache line; pass the page size to give every counter its own page). Slot `i` starts at (i + 1) * slotsize,
+ *        and holds the counter as a binary `long` at its start. Binary and native byte order, so the file is only good
+ *        on the kind of machine that made it.
+ *
+ *            0             slotsize        2 * slotsize    ...
+ *            | header      | counter 0     | counter 1     | ...
+ *
+ *    ->  An update only locks the bytes of its own slot (my_range_lock in lock.c), so updates of different counters
+ *        run in parallel.
+ *    ->  counter_add does the update with pread/pwrite under the lock, 4 system calls and no formatting.
+ *    ->  counter_add_mapped does the update in the file mapped with mmap, under the same lock, 2 system calls (the
+ *        lock and the unlock). It can be mixed with counter_add.
+ *    ->  counter_add_atomic does an atomic add in the mapping and no system call at all. It doesn't take the lock, so
+ *        don't mix it with the two above on the same counter.
+ *    ->  Slots are aligned to COUNTER_ALIGN so two counters never share a cache line, otherwise processes updating
+ *        "different" counters through the mapping would still fight over the same line (false sharing).
+*/
+
+#define   COUNTER_MAGIC   "CNTRFILE"      /* 8 bytes, no terminating null in the file */
+#define   COUNTER_ALIGN   64
+
+typedef struct {
+  int     fd;
+  int     nslots;
+  int     slotsize;
+  char    *map;                           /* the whole file, NULL until the first counter_add_mapped/_atomic */
+  long    maplen;
+} counter;
+
+/*
+ * counter_create:  Make a counter file with `nslots` counters set to 0. `slotsize` is rounded up to a multiple of
+ *                  COUNTER_ALIGN. Fails (-1) if the file exists.
+ * counter_open:    Open a counter file. Every process should open it itself: the range locks are OFD locks, which
+ *                  belong to the open file. Returns 0 if all OK, -1 if it's not a counter file.
+ * counter_close:   Unmap and close.
+ * counter_get:     The value of counter `slot` (pread, no lock).
+*/
+int   counter_create      (const char *path, int nslots, int slotsize);
+
+int   counter_open        (counter *c, const char *path);
+
+void  counter_close       (counter *c);
+
+long  counter_get         (counter *c, int slot);
+
+/*
+ * Add `delta` to counter `slot`, return the new value.
+*/
+long  counter_add         (counter *c, int slot, long delta);
+
+long  counter_add_mapped  (counter *c, int slot, long delta);
+
+long  counter_add_atomic  (counter *c, int slot, long delta);
+
+#endif
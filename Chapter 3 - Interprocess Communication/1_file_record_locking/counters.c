@@ -0,0 +1,112 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "counter.h"
+#include "err_routine.h"
+
+#define COUNTFILE "counters.dat"
+
+/*
+ * Exercise counter.c:
+ *
+ *    ./counters nprocs loops [io|mmap|atomic] [same]
+ *
+ *    ->  Makes the file `counters.dat` with one counter per process if it isn't there yet (remove it to start over, or
+ *        when using more processes than last time).
+ *    ->  Forks `nprocs` processes, each adds 1 to its own counter `loops` times, with counter_add (io, the default),
+ *        counter_add_mapped (mmap) or counter_add_atomic (atomic). With `same` they all use counter 0 instead, which
+ *        is the seqno situation: everybody waits for the same lock.
+ *    ->  Prints the time it took and checks every counter went up by what it should have.
+*/
+int main (argc, argv)
+int   argc;
+char  **argv; {
+  counter         c;
+  int             nprocs, loops, i, j, slot, same, status;
+  long            *before, expect;
+  long            (*add) (counter *, int, long) = counter_add;
+  char            *how = "io";
+  struct timeval  start, end;
+  double          secs;
+
+  if (argc < 3 || (nprocs = atoi(argv[1])) < 1 || (loops = atoi(argv[2])) < 1) {
+    err_sys("usage: %s nprocs loops [io|mmap|atomic] [same]", argv[0]);
+  }
+  if (argc > 3) {
+    how = argv[3];
+    if (strcmp(how, "mmap") == 0) {
+      add = counter_add_mapped;
+    } else if (strcmp(how, "atomic") == 0) {
+      add = counter_add_atomic;
+    } else if (strcmp(how, "io") != 0) {
+      err_sys("unknown update path %s", how);
+    }
+  }
+  same = (argc > 4 && strcmp(argv[4], "same") == 0);
+
+  if (access(COUNTFILE, 0) < 0 && counter_create(COUNTFILE, nprocs, COUNTER_ALIGN) < 0) {
+    err_sys("can't create %s", COUNTFILE);
+  }
+  if (counter_open(&c, COUNTFILE) < 0) {
+    err_sys("%s isn't a counter file", COUNTFILE);
+  }
+  if (c.nslots < nprocs) {
+    err_sys("%s has only %d counters, remove it to start over", COUNTFILE, c.nslots);
+  }
+  if ( (before = (long *) malloc(sizeof(long) * nprocs)) == NULL) {
+    err_sys("malloc error");
+  }
+  for (i = 0; i < nprocs; i++) {
+    before[i] = counter_get(&c, i);
+  }
+  counter_close(&c);
+
+  gettimeofday(&start, (struct timezone *) 0);
+  for (i = 0; i < nprocs; i++) {
+    switch (fork()) {
+      case -1:
+        err_sys("can't fork");
+        break;
+      case 0:
+        if (counter_open(&c, COUNTFILE) < 0) {      /* our own open file, for the OFD locks */
+          err_sys("can't open %s", COUNTFILE);
+        }
+        slot = same ? 0 : i;
+        for (j = 0; j < loops; j++) {
+          add(&c, slot, 1L);
+        }
+        counter_close(&c);
+        exit(EXIT_SUCCESS);
+      default:
+        break;
+    }
+  }
+  for (i = 0; i < nprocs; i++) {
+    if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      err_sys("a worker failed");
+    }
+  }
+  gettimeofday(&end, (struct timezone *) 0);
+
+  secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  printf("%d procs x %d loops, %s, %s counter%s: %.3f s, %.0f updates per second\n", nprocs, loops, how,
+         same ? "one" : "own", same ? "" : "s", secs, (double) nprocs * loops / secs);
+
+  if (counter_open(&c, COUNTFILE) < 0) {
+    err_sys("can't open %s", COUNTFILE);
+  }
+  for (i = 0; i < nprocs; i++) {
+    expect = same ? (i == 0 ? (long) nprocs * loops : 0) : loops;
+    if (counter_get(&c, i) - before[i] != expect) {
+      printf("counter %d: went from %ld to %ld, expected +%ld\n", i, before[i], counter_get(&c, i), expect);
+    }
+  }
+  counter_close(&c);
+
+  exit(EXIT_SUCCESS);
+}
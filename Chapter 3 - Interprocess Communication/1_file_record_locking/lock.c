@@ -1,8 +1,14 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* lockf, flock and F_OFD_SETLKW with -ansi */
+#endif
+
 #include <unistd.h>         /* for lockf, getpid */
 #include <sys/file.h>       /* for flock */
 #include <sys/errno.h>      /* for errno */
 #include <stdio.h>          /* for sprintf */
 #include <fcntl.h>          /* for open and it's bitmasks */
+#include <stdlib.h>         /* for rand */
+#include <time.h>           /* for nanosleep */
 
 extern int errno;
 
@@ -13,6 +19,57 @@ extern int errno;
 #define TEMPFILE  "temp.lock"     /* name of the temp lock file, used by the creat method */
 #define PERMS     0666            /* file permission used for open system call */
 
+/*
+ * How the busy-retry locks (link, creat, open) wait before trying again. The default is what they always did, sleep a
+ * second. See lock_backoff_set in lock.h.
+*/
+static int  backoff_mode  = LOCK_BACKOFF_SLEEP;
+static long backoff_usec  = 1000000L;
+static long backoff_max   = 1000000L;
+
+void lock_backoff_set (mode, usec, max_usec)
+int   mode;
+long  usec;
+long  max_usec; {
+  backoff_mode  = mode;
+  backoff_usec  = usec;
+  backoff_max   = (max_usec < usec) ? usec : max_usec;
+}
+
+/*
+ * Called after the `attempt`th failed try (0 for the first one).
+ *    ->  LOCK_BACKOFF_SPIN:  don't wait at all, just try again. Fastest hand over, but the waiters eat the CPU the
+ *                            lock holder needs.
+ *    ->  LOCK_BACKOFF_SLEEP: always `usec`.
+ *    ->  LOCK_BACKOFF_EXP:   `usec`, doubled on every failed try up to `max_usec`. Half of it is random, so processes
+ *                            which failed together don't all come back at the same time.
+*/
+static void lock_backoff (attempt)
+int attempt; {
+  struct timespec ts;
+  long            usec = backoff_usec;
+
+  switch (backoff_mode) {
+    case LOCK_BACKOFF_SPIN:
+      return;
+    case LOCK_BACKOFF_EXP:
+      while (attempt-- > 0 && usec < backoff_max) {
+        usec *= 2;
+      }
+      if (usec > backoff_max) {
+        usec = backoff_max;
+      }
+      usec = usec / 2 + rand() % (usec / 2 + 1);
+      break;
+    default:
+      break;
+  }
+
+  ts.tv_sec   = usec / 1000000L;
+  ts.tv_nsec  = (usec % 1000000L) * 1000L;
+  nanosleep(&ts, (struct timespec *) 0);
+}
+
 void my_lock (fd)
 int fd; {
   lseek(fd, 0L, 0);                           /* rewind before lockf */
@@ -56,7 +113,7 @@ int fd; {
 
 void my_link_lock (fd) 
 int fd; {
-  int   tempfd;
+  int   tempfd, attempt = 0;
   char  tempfile[30];
 
   sprintf(tempfile, "LCK%d", getpid());     /* Stores the "LCK<pid>" in the char array tempfile */
@@ -80,7 +137,7 @@ int fd; {
     if (errno != EEXIST) {
       err_sys("link error");
     }
-    sleep(1);
+    lock_backoff(attempt++);
   }
 
   /* Here's what's essentially happening when we're "locking" the file.
@@ -112,7 +169,7 @@ int fd; {
 
 void my_creat_lock (fd)
 int fd; {
-  int tempfd;
+  int tempfd, attempt = 0;
 
   /*
    * Try to create a temporary file, with all write permissions turned off.
@@ -133,7 +190,7 @@ int fd; {
     if (errno != EACCES) {
       err_sys("creat error");
     }
-    sleep(1);
+    lock_backoff(attempt++);
   }
   close(tempfd);
 }
@@ -147,7 +204,7 @@ int fd; {
 
 void my_open_lock (fd)
 int fd; {
-  int tempfd;
+  int tempfd, attempt = 0;
 
   /*
    * Try to create the lock file, using open() with both O_CREAT (create file if it doesn't exist) 
@@ -159,7 +216,7 @@ int fd; {
     if (errno != EEXIST) {
       err_sys("open error for lock file");
     }
-    sleep(1);
+    lock_backoff(attempt++);
   }
   close(tempfd);
 }
@@ -171,3 +228,77 @@ int fd; {
   }
 }
 
+
+/*
+ * Like lockf, but with fcntl and, where there are any (Linux), open file description locks: F_OFD_SETLKW.
+ *
+ * A lockf/F_SETLKW lock belongs to the process, so two descriptors of the same process don't exclude each other, and
+ * closing *any* descriptor of the file drops the lock. An OFD lock belongs to the open file (what `open` returned), so
+ * it behaves like flock: it's only dropped when that is closed, and two `open`s of the same file exclude each other
+ * even within one process (or thread). Each process has to `open` the file itself, a descriptor inherited over `fork`
+ * is the same open file.
+ *
+ * Unlike flock, fcntl locks cover a range of bytes, [offset, offset + len), len 0 meaning to the end of the file (and
+ * beyond, however far it grows). Two processes locking ranges that don't overlap don't wait for each other, which is
+ * what counter.c uses to update different counters in the same file at the same time.
+*/
+static int range_op (fd, type, wait, offset, len)
+int   fd;
+int   type;
+int   wait;
+long  offset;
+long  len; {
+  struct flock  lk;
+
+  lk.l_type   = type;
+  lk.l_whence = SEEK_SET;
+  lk.l_start  = offset;
+  lk.l_len    = len;
+  lk.l_pid    = 0;              /* must be 0 for OFD locks */
+#ifdef F_OFD_SETLKW
+  return fcntl(fd, wait ? F_OFD_SETLKW : F_OFD_SETLK, &lk);
+#else
+  return fcntl(fd, wait ? F_SETLKW : F_SETLK, &lk);
+#endif
+}
+
+void my_range_lock (fd, offset, len)
+int   fd;
+long  offset;
+long  len; {
+  if (range_op(fd, F_WRLCK, 1, offset, len) == -1) {
+    err_sys("can't F_WRLCK %ld..%ld", offset, offset + len);
+  }
+}
+
+int my_range_trylock (fd, offset, len)
+int   fd;
+long  offset;
+long  len; {
+  if (range_op(fd, F_WRLCK, 0, offset, len) == -1) {
+    if (errno == EACCES || errno == EAGAIN) {
+      return 0;                 /* someone else has (part of) it */
+    }
+    err_sys("can't F_WRLCK %ld..%ld", offset, offset + len);
+  }
+  return 1;
+}
+
+void my_range_unlock (fd, offset, len)
+int   fd;
+long  offset;
+long  len; {
+  if (range_op(fd, F_UNLCK, 0, offset, len) == -1) {
+    err_sys("can't F_UNLCK %ld..%ld", offset, offset + len);
+  }
+}
+
+void my_fcntl_lock (fd)
+int fd; {
+  my_range_lock(fd, 0L, 0L);    /* 0L -> lock entire file */
+}
+
+void my_fcntl_unlock (fd)
+int fd; {
+  my_range_unlock(fd, 0L, 0L);
+}
@@ -26,4 +26,32 @@ void my_open_lock (int fd);
 
 void my_open_unlock (int fd);
 
+/* 6 - Lock and unlock using fcntl, open file description (OFD) locks where available */
+void my_fcntl_lock (int fd);
+
+void my_fcntl_unlock (int fd);
+
+/*
+ * 7 - The same, for the bytes [offset, offset + len) only (len 0: to the end of the file). Locks on ranges that don't
+ *     overlap don't wait for each other. my_range_trylock doesn't wait, it returns 0 if the range is taken, 1 if we got
+ *     it.
+*/
+void my_range_lock (int fd, long offset, long len);
+
+int  my_range_trylock (int fd, long offset, long len);
+
+void my_range_unlock (int fd, long offset, long len);
+
+/*
+ * How 3, 4 and 5 wait before trying again when the lock is taken:
+ *    LOCK_BACKOFF_SPIN   try again right away
+ *    LOCK_BACKOFF_SLEEP  sleep `usec` microseconds (the default, 1 second)
+ *    LOCK_BACKOFF_EXP    sleep `usec`, doubled on every failure up to `max_usec`, with jitter
+*/
+#define LOCK_BACKOFF_SPIN   0
+#define LOCK_BACKOFF_SLEEP  1
+#define LOCK_BACKOFF_EXP    2
+
+void lock_backoff_set (int mode, long usec, long max_usec);
+
 #endif
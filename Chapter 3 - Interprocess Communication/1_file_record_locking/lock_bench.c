@@ -0,0 +1,318 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* getopt, clock_gettime with -ansi */
+#endif
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+
+#include "lock.h"
+#include "err_routine.h"
+
+#define SEQFILE     "seqno"
+#define MAXBUFF     100
+#define MAXPROCS    64
+#define MAXSAMPLES  100000        /* wait times kept per process, for the percentiles */
+
+/*
+ * Contention harness for the locks in lock.c.
+ *
+ *    ./lock_bench [-p nprocs] [-t seconds] [-s strategy] [-b spin|sleep|exp] [-u usec] [-m max_usec]
+ *
+ * Functionality:
+ *    ->  For each strategy (all of them, or the one given with -s), `nprocs` processes are forked. Each opens `seqno`
+ *        itself (flock and OFD locks belong to the open file, an inherited descriptor would be shared) and does the
+ *        same as file_record.c, lock, read-increment-write the number, unlock, as fast as it can until the parent
+ *        sets `stop` after `seconds`.
+ *    ->  Every child counts its acquisitions and keeps the time each lock call took (the wait), in a shared memory
+ *        segment the parent reads afterwards.
+ *    ->  The parent prints one line per strategy:
+ *          acq/s       acquisitions per second, all processes together.
+ *          min%/max%   the smallest and largest share one process got (100/nprocs each is perfectly fair).
+ *          jain        Jain's fairness index, (sum x)^2 / (n * sum x^2), 1.0 is perfectly fair, 1/n is one process
+ *                      getting everything.
+ *          p50/p99/max the wait for the lock in microseconds.
+ *          ok          the number in `seqno` went up by exactly the number of acquisitions (otherwise the lock let
+ *                      two processes in at once).
+ *    ->  The backoff of the busy-retry locks (link, creat, open) is set with -b/-u/-m, see lock_backoff_set.
+ *
+ * Two more strategies besides the five in lock.c: `ofd` (fcntl, open file description locks) and `sysv`, a System V
+ * semaphore with SEM_UNDO, which isn't a file lock but is what the later examples use for the same job.
+*/
+
+typedef struct {
+  char    *name;
+  void    (*lock) (int fd);
+  void    (*unlock) (int fd);
+} strategy;
+
+typedef struct {
+  long          count;                    /* acquisitions */
+  long          nsamples;
+  unsigned int  wait_us[MAXSAMPLES];
+} proc_stats;
+
+typedef struct {
+  volatile int  stop;
+  proc_stats    proc[MAXPROCS];
+} shared;
+
+static int            semid = -1;
+static struct sembuf  sem_lock_op   = { 0, -1, SEM_UNDO };
+static struct sembuf  sem_unlock_op = { 0, 1, SEM_UNDO };
+
+void  sysv_lock     (int fd);
+void  sysv_unlock   (int fd);
+
+static strategy strategies[] = {
+  { "lockf",  my_lock,            my_unlock },
+  { "flock",  my_sys_call_lock,   my_sys_call_unlock },
+  { "link",   my_link_lock,       my_link_unlock },
+  { "creat",  my_creat_lock,      my_creat_unlock },
+  { "open",   my_open_lock,       my_open_unlock },
+  { "ofd",    my_fcntl_lock,      my_fcntl_unlock },
+  { "sysv",   sysv_lock,          sysv_unlock },
+  { NULL,     NULL,               NULL }
+};
+
+void sysv_lock (fd)
+int fd; {
+  (void) fd;
+  if (semop(semid, &sem_lock_op, 1) < 0) {
+    err_sys("can't semop lock");
+  }
+}
+
+void sysv_unlock (fd)
+int fd; {
+  (void) fd;
+  if (semop(semid, &sem_unlock_op, 1) < 0) {
+    err_sys("can't semop unlock");
+  }
+}
+
+static long now_us (void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static int seqno_get (fd)
+int fd; {
+  char  buff[MAXBUFF + 1];
+  int   n, seqno;
+
+  lseek(fd, 0L, 0);
+  if ( (n = read(fd, buff, MAXBUFF)) <= 0) {
+    err_sys("read error");
+  }
+  buff[n] = '\0';
+  if (sscanf(buff, "%d\n", &seqno) != 1) {
+    err_sys("sscanf error");
+  }
+
+  return seqno;
+}
+
+static void seqno_put (fd, seqno)
+int fd;
+int seqno; {
+  char  buff[MAXBUFF + 1];
+  int   n;
+
+  sprintf(buff, "%03d\n", seqno);
+  n = strlen(buff);
+  lseek(fd, 0L, 0);
+  if (write(fd, buff, n) != n) {
+    err_sys("write error");
+  }
+}
+
+static void worker (sh, s, st)
+shared      *sh;
+strategy    *s;
+proc_stats  *st; {
+  int   fd;
+  long  t0, t1;
+
+  if ( (fd = open(SEQFILE, O_RDWR)) < 0) {
+    err_sys("can't open %s", SEQFILE);
+  }
+  srand(getpid());        /* for the jitter of LOCK_BACKOFF_EXP */
+
+  while (!sh->stop) {
+    t0 = now_us();
+    s->lock(fd);
+    t1 = now_us();
+
+    seqno_put(fd, seqno_get(fd) + 1);
+    s->unlock(fd);
+
+    st->count++;
+    if (st->nsamples < MAXSAMPLES) {
+      st->wait_us[st->nsamples++] = (unsigned int) (t1 - t0);
+    }
+  }
+  close(fd);
+}
+
+static int cmp_uint (a, b)
+const void *a;
+const void *b; {
+  unsigned int  x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+
+  return (x > y) - (x < y);
+}
+
+int main (argc, argv)
+int   argc;
+char  **argv; {
+  int             c, i, j, fd, nprocs = 4, secs = 2, mode = LOCK_BACKOFF_EXP, shmid, before, after, status;
+  long            usec = 10, max_usec = 10000, total, nsamples, minc, maxc;
+  double          sumsq, jain;
+  char            *only = NULL;
+  unsigned int    *all;
+  pid_t           pids[MAXPROCS];
+  shared          *sh;
+  strategy        *s;
+  union semun {
+    int             val;
+    struct semid_ds *buf;
+    unsigned short  *array;
+  } arg;
+
+  while ( (c = getopt(argc, argv, "p:t:s:b:u:m:")) != -1) {
+    switch (c) {
+      case 'p': nprocs    = atoi(optarg); break;
+      case 't': secs      = atoi(optarg); break;
+      case 's': only      = optarg;       break;
+      case 'u': usec      = atol(optarg); break;
+      case 'm': max_usec  = atol(optarg); break;
+      case 'b':
+        if (strcmp(optarg, "spin") == 0) {
+          mode = LOCK_BACKOFF_SPIN;
+        } else if (strcmp(optarg, "sleep") == 0) {
+          mode = LOCK_BACKOFF_SLEEP;
+        } else if (strcmp(optarg, "exp") == 0) {
+          mode = LOCK_BACKOFF_EXP;
+        } else {
+          err_sys("backoff is spin, sleep or exp");
+        }
+        break;
+      default:
+        err_sys("usage: lock_bench [-p nprocs] [-t seconds] [-s strategy] [-b spin|sleep|exp] [-u usec] [-m max_usec]");
+    }
+  }
+  if (nprocs < 1 || nprocs > MAXPROCS || secs < 1 || usec < 1) {
+    err_sys("bad arguments");
+  }
+  lock_backoff_set(mode, usec, max_usec);
+
+  if ( (shmid = shmget(IPC_PRIVATE, sizeof(shared), 0600)) < 0) {
+    err_sys("can't get shared memory");
+  }
+  if ( (sh = (shared *) shmat(shmid, (char *) 0, 0)) == (shared *) -1) {
+    err_sys("can't attach shared memory");
+  }
+  shmctl(shmid, IPC_RMID, (struct shmid_ds *) 0);     /* gone when we exit */
+
+  if ( (semid = semget(IPC_PRIVATE, 1, 0600)) < 0) {
+    err_sys("can't get semaphore");
+  }
+  arg.val = 1;
+  if (semctl(semid, 0, SETVAL, arg) < 0) {
+    err_sys("can't SETVAL");
+  }
+
+  if ( (all = (unsigned int *) malloc(sizeof(unsigned int) * MAXSAMPLES * nprocs)) == NULL) {
+    err_sys("malloc error");
+  }
+
+  printf("%-6s %10s %7s %7s %6s %9s %9s %9s %s\n", "lock", "acq/s", "min%", "max%", "jain", "p50us", "p99us", "maxus", "");
+  for (s = strategies; s->name != NULL; s++) {
+    if (only != NULL && strcmp(only, s->name) != 0) {
+      continue;
+    }
+    if (s->lock == my_creat_lock && geteuid() == 0) {
+      /* creat() of the mode 0 file only fails with EACCES if we aren't allowed to write it, root always is */
+      printf("%-6s skipped, doesn't lock for root\n", s->name);
+      continue;
+    }
+    fflush(stdout);       /* or the children flush our buffer again when they exit */
+
+    /* left over from an earlier run that was killed while holding the lock */
+    unlink("seqno.lock");
+    unlink("temp.lock");
+
+    if ( (fd = open(SEQFILE, O_RDWR)) < 0) {
+      err_sys("can't open %s", SEQFILE);
+    }
+    before = seqno_get(fd);
+
+    memset(sh, 0, sizeof(shared));
+    for (i = 0; i < nprocs; i++) {
+      if ( (pids[i] = fork()) < 0) {
+        err_sys("can't fork");
+      } else if (pids[i] == 0) {
+        close(fd);
+        worker(sh, s, &sh->proc[i]);
+        _exit(0);
+      }
+    }
+
+    /*
+     * The workers look at `stop` before every acquisition, so each one finishes its lock/increment/unlock and leaves
+     * no lock file behind. Someone waiting for the lock still gets it once.
+    */
+    sleep(secs);
+    sh->stop = 1;
+    for (i = 0; i < nprocs; i++) {
+      if (waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        err_sys("a worker failed");
+      }
+    }
+
+    after = seqno_get(fd);
+    close(fd);
+
+    total = nsamples = 0;
+    minc  = maxc = sh->proc[0].count;
+    sumsq = 0;
+    for (i = 0; i < nprocs; i++) {
+      total += sh->proc[i].count;
+      sumsq += (double) sh->proc[i].count * sh->proc[i].count;
+      if (sh->proc[i].count < minc) {
+        minc = sh->proc[i].count;
+      }
+      if (sh->proc[i].count > maxc) {
+        maxc = sh->proc[i].count;
+      }
+      for (j = 0; j < sh->proc[i].nsamples; j++) {
+        all[nsamples++] = sh->proc[i].wait_us[j];
+      }
+    }
+    jain = (sumsq > 0) ? ((double) total * total) / (nprocs * sumsq) : 0;
+    qsort(all, nsamples, sizeof(unsigned int), cmp_uint);
+
+    printf("%-6s %10.0f %6.1f%% %6.1f%% %6.3f %9u %9u %9u %s\n", s->name, (double) total / secs,
+           total ? 100.0 * minc / total : 0, total ? 100.0 * maxc / total : 0, jain,
+           nsamples ? all[nsamples / 2] : 0, nsamples ? all[nsamples * 99 / 100] : 0, nsamples ? all[nsamples - 1] : 0,
+           (after - before == total) ? "ok" : "LOST UPDATES");
+    fflush(stdout);
+  }
+
+  unlink("seqno.lock");
+  unlink("temp.lock");
+  semctl(semid, 0, IPC_RMID, arg);
+
+  return 0;
+}
@@ -1,4 +1,6 @@
 #include "client.h"         /* for function declaration: client */
+#include "fdcopy.h"         /* for function declaration: fd_copy */
+#include "pipetune.h"       /* for macro: PIPETUNE_MAX */
 #include "err_routine.h"    /* for function declaration: err_sys */
 
 #include <stdio.h>
@@ -15,6 +17,8 @@
  *                The read string is then written to the writefd, which is the writing end of pipe1.
  *                After reading the filename, it is sent to the reading end of pipe1, which is read by server function in server.c
  *                While the input from the pipe2 is buffered by server, the client reads it, and sends the buffer to the standard output.
+ *                That last part is fd_copy (fdcopy.c), which splice()s from the pipe to the standard output if it can.
+ *                The size of the pipe is up to the server (pipetune.c), we take whatever is in it, up to PIPETUNE_MAX.
 */
 void client (readfd, writefd)
 int readfd;
@@ -45,14 +49,8 @@ int writefd; {
   /*
    * Read the data from the IPC descriptor and write to standard output.
   */
-  while ( (n = read(readfd, buff, MAXBUFF)) > 0 ) {
-    if (write(1, buff, n) != n) {             /* fd 1 = stdout */
-      err_sys("client: data write error");
-    }
-  }
-
-  if (n < 0) {
-    err_sys("client: data read error");
+  if (fd_copy(readfd, 1, PIPETUNE_MAX) < 0) {        /* fd 1 = stdout */
+    err_sys("client: data copy error");
   }
 
   printf("****************CLIENT****************\n");
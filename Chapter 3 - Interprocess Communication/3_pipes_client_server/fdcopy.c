@@ -0,0 +1,117 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* splice, F_SETPIPE_SZ and F_GETPIPE_SZ */
+#endif
+
+#include "fdcopy.h"
+
+#include <stdio.h>
+#include <stdlib.h>         /* for function: malloc, free */
+#include <unistd.h>         /* for function: read, write */
+#include <fcntl.h>          /* for function: fcntl, splice */
+#include <errno.h>
+
+#define PIPE_MAX_SIZE   "/proc/sys/fs/pipe-max-size"
+
+/*
+ * The largest pipe an unprivileged process may ask for, 0 if we can't tell.
+*/
+static long pipe_max (void) {
+  FILE  *fp;
+  long  max = 0;
+
+  if ( (fp = fopen(PIPE_MAX_SIZE, "r")) != NULL) {
+    if (fscanf(fp, "%ld", &max) != 1) {
+      max = 0;
+    }
+    fclose(fp);
+  }
+  return max;
+}
+
+long pipe_resize (fd, size)
+int   fd;
+long  size; {
+#ifdef F_SETPIPE_SZ
+  long  max = pipe_max();
+
+  if (max > 0 && size > max) {
+    size = max;
+  }
+  fcntl(fd, F_SETPIPE_SZ, (int) size);      /* EBUSY, EPERM: it stays as it is */
+  return fcntl(fd, F_GETPIPE_SZ);
+#else
+  (void) fd;
+  (void) size;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+/*
+ * Functionality:
+ *    ->  splice() `chunk` bytes at a time, for as long as it works. SPLICE_F_MOVE asks for the pages to be moved
+ *        rather than copied (a hint), SPLICE_F_MORE says more is coming.
+ *    ->  If the very first one fails with EINVAL (or ENOSYS), neither end is spliceable and we read() and write()
+ *        instead. Later failures are real errors, some of the data is already gone.
+ *    ->  A short write() is finished off before the next read(), like on a pipe to a slow reader.
+ *    ->  fd_copyn stops after `max` bytes, so a copy can be done in pieces (pipetune.c times them).
+*/
+long fd_copy (from, to, chunk)
+int   from;
+int   to;
+long  chunk; {
+  return fd_copyn(from, to, chunk, -1L);
+}
+
+/*
+ * How much to ask for next: `chunk`, or what's left of `max`.
+*/
+#define NEXT(chunk, max, total)   (((max) < 0 || (max) - (total) > (chunk)) ? (chunk) : (max) - (total))
+
+long fd_copyn (from, to, chunk, max)
+int   from;
+int   to;
+long  chunk;
+long  max; {
+  long    total = 0;
+  ssize_t n, w, off;
+  char    *buff;
+
+#ifdef SPLICE_F_MOVE
+  while (total != max) {
+    if ( (n = splice(from, NULL, to, NULL, NEXT(chunk, max, total), SPLICE_F_MOVE | SPLICE_F_MORE)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (total == 0 && (errno == EINVAL || errno == ENOSYS)) {
+        break;              /* not spliceable, copy it */
+      }
+      return -1;
+    }
+    if (n == 0) {
+      return total;
+    }
+    total += n;
+  }
+  if (total == max) {
+    return total;
+  }
+#endif
+
+  if ( (buff = malloc(chunk)) == NULL) {
+    return -1;
+  }
+  n = 0;
+  while (total != max && (n = read(from, buff, NEXT(chunk, max, total))) > 0) {
+    for (off = 0; off < n; off += w) {
+      if ( (w = write(to, buff + off, n - off)) < 0) {
+        free(buff);
+        return -1;
+      }
+    }
+    total += n;
+  }
+  free(buff);
+
+  return (n < 0) ? -1 : total;
+}
@@ -0,0 +1,40 @@
+#ifndef FDCOPY_H
+#define FDCOPY_H
+
+/*
+ * Moving the contents of one descriptor to another, for the server (file -> pipe or FIFO) and the client (pipe -> stdout).
+ *
+ * A read()/write() loop copies every byte twice, from the kernel to our buffer and back, and makes two system calls
+ * per buffer. On Linux, splice() moves the data between a pipe and another descriptor inside the kernel: the file's
+ * pages are put into the pipe as they are (no copy on the server side), and a pipe to a file or socket is one copy
+ * less as well. One end of a splice() has to be a pipe, and not every file system or device takes part (a terminal
+ * doesn't, nor does a file opened with O_APPEND), so if the first splice() says EINVAL we go back to read and write.
+ *
+ * The routines available:
+ *    1.  size = pipe_resize(fd, size);   // make the pipe `fd` `size` bytes, as far as we may, returns its size
+ *    2.  n = fd_copy(from, to, chunk);   // everything from `from` to `to`, at most `chunk` bytes at a time
+ *    3.  n = fd_copyn(from, to, chunk, max);   // the same, but stop after `max` bytes (-1: no limit)
+ *
+ * NOTE:  5_fifo has a copy of this file with pipe_grow (always the biggest pipe) instead of pipe_resize and fd_copyn.
+ *        Here the size is picked by pipetune.c, so the two differ on purpose.
+*/
+
+/*
+ * pipe_resize: Set the capacity of the pipe to `size` with F_SETPIPE_SZ, rounded up to a page by the kernel, and not
+ *              above /proc/sys/fs/pipe-max-size (1 MB unless the admin changed it, the default is 64 KB). A pipe can't
+ *              shrink below what's in it (EBUSY), nor grow past the user's pipe-user-pages-soft, then it keeps its size.
+ *              Returns the size of the pipe, or -1 if `fd` isn't one or this isn't Linux.
+*/
+long  pipe_resize (int fd, long size);
+
+/*
+ * fd_copy:   Copy until end of file on `from`. Returns the number of bytes copied, or -1 on an error (errno says what).
+*/
+long  fd_copy   (int from, int to, long chunk);
+
+/*
+ * fd_copyn:  Copy until end of file on `from`, or `max` bytes. Less than `max` means end of file (or -1, an error).
+*/
+long  fd_copyn  (int from, int to, long chunk, long max);
+
+#endif
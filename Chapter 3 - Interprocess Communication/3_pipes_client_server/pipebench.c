@@ -0,0 +1,191 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* gettimeofday with -ansi */
+#endif
+
+#include "fdcopy.h"         /* for function: pipe_resize, fd_copy */
+#include "pipetune.h"       /* for function: pipetune_copy, pipetune_save */
+#include "err_routine.h"    /* for function: err_sys */
+
+#include <stdio.h>
+#include <stdlib.h>         /* for function: atoi, exit, malloc */
+#include <unistd.h>         /* for function: pipe, fork, close */
+#include <fcntl.h>          /* for function: open */
+#include <sys/time.h>       /* for function: gettimeofday */
+#include <sys/wait.h>       /* for function: waitpid */
+
+/*
+ * The fixed sizes we compare with. 1024 bytes on a default pipe is what client.c and server.c did at first.
+*/
+struct fixed {
+  char  *name;
+  long  pipesize;           /* 0: the pipe as it comes */
+  long  chunk;
+} fixed[] = {
+  { "fixed 1K",    0,                1024 },
+  { "fixed 64K",   64L * 1024,       64L * 1024 },
+  { "fixed 1M",    1024L * 1024,     1024L * 1024 },
+  { "fixed max",   PIPETUNE_MAX,     PIPETUNE_MAX },
+};
+
+static long pipe_size (int fd) {
+#ifdef F_GETPIPE_SZ
+  return fcntl(fd, F_GETPIPE_SZ);
+#else
+  (void) fd;
+  return 0;
+#endif
+}
+
+/*
+ * The reader: read() what comes through the pipe into a buffer of its own, PIPETUNE_MAX at a time, the way the client
+ * does. Splicing into /dev/null would never copy a byte, and the rates (and what pipetune picks from them) would have
+ * nothing to do with a program that uses the data.
+*/
+static void sink (int fd) {
+  char  *buff;
+  long  n;
+
+  if ( (buff = malloc(PIPETUNE_MAX)) == NULL) {
+    err_sys("reader: out of memory");
+  }
+  while ( (n = read(fd, buff, PIPETUNE_MAX)) != 0) {
+    if (n < 0) {
+      err_sys("reader: read error");
+    }
+  }
+  free(buff);
+  _exit(0);
+}
+
+/*
+ * One copy of `file` through a new pipe to a child that reads it (sink), like the server and client do.
+ * With `prof` it's pipetune_copy, otherwise the pipe is resized to `pipesize` (if > 0) and fd_copy'd `chunk` at a time.
+ * Returns the seconds it took, start to the child's exit. `*size` is the size of the pipe as it ended up.
+*/
+static double run (char *file, long pipesize, long chunk, PipeProfile *prof, long *size) {
+  struct timeval  t0, t1;
+  int             pipefd[2], fd;
+  pid_t           pid;
+
+  if (pipe(pipefd) < 0) {
+    err_sys("pipe error");
+  }
+  if ( (pid = fork()) < 0) {
+    err_sys("fork error");
+  } else if (pid == 0) {
+    close(pipefd[1]);
+    sink(pipefd[0]);
+  }
+  close(pipefd[0]);
+
+  if ( (fd = open(file, O_RDONLY)) < 0) {
+    err_sys("can't open %s", file);
+  }
+  gettimeofday(&t0, (struct timezone *) 0);
+  if (prof != NULL) {
+    if (pipetune_copy(fd, pipefd[1], prof) < 0) {
+      err_sys("copy error");
+    }
+  } else {
+    if (pipesize > 0) {
+      pipe_resize(pipefd[1], pipesize);
+    }
+    if (fd_copy(fd, pipefd[1], chunk) < 0) {
+      err_sys("copy error");
+    }
+  }
+  *size = pipe_size(pipefd[1]);
+  close(pipefd[1]);
+  close(fd);
+  while (waitpid(pid, (int *) 0, 0) != pid) {
+    ;
+  }
+  gettimeofday(&t1, (struct timezone *) 0);
+
+  return (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1e6;
+}
+
+static void report (char *name, long size, long chunk, long bytes, double secs) {
+  printf("%-24s %10ld %10ld %10.1f\n", name, size, chunk, bytes / secs / (1024 * 1024));
+}
+
+/*
+ * Functionality:
+ *    ->  Copy `file` through a pipe with each of the fixed sizes, `runs` times (3), and print the best rate of each.
+ *    ->  Then with pipetune_copy and no profile, the way the first transfer goes: tuning on the way. The time includes
+ *        the trials.
+ *    ->  Then with the profile that chose, the way every transfer after that goes. The profile is saved, the server
+ *        will use it. The file should be bigger than the trials (a dozen or so PIPETUNE_TRIAL bytes), or nothing is
+ *        tuned.
+ *
+ *        ./pipebench file [runs]
+*/
+int main (int argc, char **argv) {
+  PipeProfile prof, tuned;
+  double      secs, best;
+  long        bytes, size = 0;
+  int         i, r, runs;
+
+  if (argc < 2) {
+    err_sys("usage: %s file [runs]", argv[0]);
+  }
+  runs = (argc > 2) ? atoi(argv[2]) : 3;
+  if (runs < 1) {
+    runs = 1;
+  }
+  if ( (r = open(argv[1], O_RDONLY)) < 0 || (bytes = lseek(r, 0L, SEEK_END)) < 0) {
+    err_sys("can't open %s", argv[1]);
+  }
+  close(r);
+
+  printf("%s: %ld bytes, best of %d\n\n", argv[1], bytes, runs);
+  printf("%-24s %10s %10s %10s\n", "", "pipe", "chunk", "MB/s");
+
+  for (i = 0; i < (int) (sizeof(fixed) / sizeof(fixed[0])); i++) {
+    best = 0;
+    for (r = 0; r < runs; r++) {
+      secs = run(argv[1], fixed[i].pipesize, fixed[i].chunk, (PipeProfile *) 0, &size);
+      if (best == 0 || secs < best) {
+        best = secs;
+      }
+    }
+    report(fixed[i].name, size, fixed[i].chunk, bytes, best);
+  }
+
+  best = 0;
+  tuned.tuned = 0;
+  for (r = 0; r < runs; r++) {
+    prof.chunk = prof.pipesize = prof.rate = 0;
+    prof.tuned = 0;
+    secs = run(argv[1], 0L, 0L, &prof, &size);
+    if (prof.tuned) {
+      tuned = prof;
+    }
+    if (best == 0 || secs < best) {
+      best = secs;
+    }
+  }
+  if (!tuned.tuned) {
+    printf("\nthe file is too small to tune on, nothing saved\n");
+    exit(EXIT_SUCCESS);
+  }
+  report("autotune (first run)", tuned.pipesize, tuned.chunk, bytes, best);
+
+  best = 0;
+  for (r = 0; r < runs; r++) {
+    prof = tuned;
+    secs = run(argv[1], 0L, 0L, &prof, &size);
+    if (best == 0 || secs < best) {
+      best = secs;
+    }
+  }
+  report("autotune (profile)", size, tuned.chunk, bytes, best);
+
+  if (pipetune_save(&tuned) < 0) {
+    err_sys("can't save the profile");
+  }
+  printf("\nchosen: pipe %ld bytes, chunk %ld bytes (%ld KB/s in the trials), saved as the profile\n",
+         tuned.pipesize, tuned.chunk, tuned.rate);
+
+  exit(EXIT_SUCCESS);
+}
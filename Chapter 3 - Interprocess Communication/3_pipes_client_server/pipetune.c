@@ -0,0 +1,176 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* gettimeofday with -ansi */
+#endif
+
+#include "pipetune.h"
+#include "fdcopy.h"
+
+#include <stdio.h>
+#include <stdlib.h>         /* for function: getenv */
+#include <string.h>         /* for function: memset, strlen */
+#include <sys/ioctl.h>      /* for function: ioctl (FIONREAD) */
+#include <sys/time.h>       /* for function: gettimeofday */
+
+/*
+ * $PIPETUNE_PROFILE, or PIPETUNE_PROFILE in the home directory, or in $TMPDIR (/tmp) if there's no $HOME. Never the
+ * current directory: the server runs wherever it's started, the source tree included.
+*/
+static char *profile_name (void) {
+  static char name[1024];
+  char        *dir = getenv("PIPETUNE_PROFILE");
+
+  if (dir != NULL && *dir != '\0') {
+    return dir;
+  }
+  if ( (dir = getenv("HOME")) == NULL || *dir == '\0') {
+    if ( (dir = getenv("TMPDIR")) == NULL || *dir == '\0') {
+      dir = "/tmp";
+    }
+  }
+  if (strlen(dir) + sizeof(PIPETUNE_PROFILE) + 1 > sizeof(name)) {
+    return "/tmp/" PIPETUNE_PROFILE;
+  }
+  sprintf(name, "%s/%s", dir, PIPETUNE_PROFILE);
+
+  return name;
+}
+
+int pipetune_load (prof)
+PipeProfile *prof; {
+  FILE  *fp;
+  int   n;
+
+  memset(prof, 0, sizeof(*prof));
+  if ( (fp = fopen(profile_name(), "r")) == NULL) {
+    return -1;
+  }
+  n = fscanf(fp, "%ld %ld %ld", &prof->pipesize, &prof->chunk, &prof->rate);
+  fclose(fp);
+  if (n != 3 || prof->pipesize < 0 || prof->chunk <= 0 || prof->chunk > PIPETUNE_MAX) {
+    memset(prof, 0, sizeof(*prof));
+    return -1;
+  }
+
+  return 0;
+}
+
+int pipetune_save (prof)
+PipeProfile *prof; {
+  FILE  *fp;
+
+  if ( (fp = fopen(profile_name(), "w")) == NULL) {
+    return -1;
+  }
+  fprintf(fp, "%ld %ld %ld\n", prof->pipesize, prof->chunk, prof->rate);
+
+  return fclose(fp);
+}
+
+/*
+ * Bytes waiting in the pipe (FIONREAD works from either end), 0 if we can't tell.
+*/
+static long queued (fd)
+int fd; {
+  int n;
+
+  return (ioctl(fd, FIONREAD, &n) < 0) ? 0 : n;
+}
+
+/*
+ * Copy PIPETUNE_TRIAL bytes, `chunk` at a time, and return the rate in KB/s. `*n` is what was copied, less than
+ * PIPETUNE_TRIAL at end of file, -1 on an error.
+*/
+static long trial (from, to, chunk, n)
+int   from;
+int   to;
+long  chunk;
+long  *n; {
+  struct timeval  t0, t1;
+  long            q0, usec;
+  double          taken;
+
+  q0 = queued(to);
+  gettimeofday(&t0, (struct timezone *) 0);
+  if ( (*n = fd_copyn(from, to, chunk, PIPETUNE_TRIAL)) < 0) {
+    return -1;
+  }
+  gettimeofday(&t1, (struct timezone *) 0);
+  taken = (double) *n + q0 - queued(to);
+
+  usec = (t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_usec - t0.tv_usec);
+  if (usec < 1) {
+    usec = 1;
+  }
+
+  return (long) (taken * 1000000.0 / usec / 1024);
+}
+
+/*
+ * Functionality:
+ *    ->  With a profile (prof->chunk set), resize the pipe and fd_copy.
+ *    ->  Without, the trials described in pipetune.h. Each one copies its part of the file, nothing is read twice.
+ *        Going up, the pipe only grows. Going back down to the winner can fail with EBUSY (the pipe holds more than
+ *        that), the pipe then stays bigger and its real size is what's saved.
+ *    ->  Where F_SETPIPE_SZ doesn't exist (pipe_resize says -1) only the chunk is tuned, and pipesize is 0.
+*/
+long pipetune_copy (from, to, prof)
+int         from;
+int         to;
+PipeProfile *prof; {
+  long  size, best = 0, bestsize = PIPETUNE_MIN, rate, n, total = 0, got;
+
+  if (prof->chunk > 0) {
+    if (prof->pipesize > 0) {
+      pipe_resize(to, prof->pipesize);
+    }
+    return fd_copy(from, to, prof->chunk);
+  }
+
+  for (size = PIPETUNE_MIN; size <= PIPETUNE_MAX; size *= 2) {
+    if ( (got = pipe_resize(to, size)) > 0 && got < size) {
+      break;                              /* pipe-max-size, or the user's quota */
+    }
+    if ( (rate = trial(from, to, size, &n)) < 0) {
+      return -1;
+    }
+    total += n;
+    if (n < PIPETUNE_TRIAL) {
+      return total;                       /* end of file before we knew */
+    }
+    if (rate * 100 <= best * (100 + PIPETUNE_GAIN)) {
+      break;
+    }
+    best      = rate;
+    bestsize  = size;
+  }
+  if (best == 0) {                        /* the pipe can't even be PIPETUNE_MIN */
+    n = fd_copy(from, to, PIPETUNE_MIN);
+    return (n < 0) ? -1 : total + n;
+  }
+
+  prof->chunk     = bestsize;
+  prof->pipesize  = pipe_resize(to, bestsize);
+  if ( (rate = trial(from, to, bestsize / 4, &n)) < 0) {
+    return -1;
+  }
+  total += n;
+  if (n < PIPETUNE_TRIAL) {
+    prof->chunk = 0;
+    return total;
+  }
+  if (rate * 100 > best * (100 + PIPETUNE_GAIN)) {
+    best        = rate;
+    prof->chunk = bestsize / 4;
+  }
+  if (prof->pipesize < 0) {
+    prof->pipesize = 0;
+  }
+  prof->rate  = best;
+  prof->tuned = 1;
+
+  if ( (n = fd_copy(from, to, prof->chunk)) < 0) {
+    return -1;
+  }
+
+  return total + n;
+}
@@ -0,0 +1,47 @@
+#ifndef PIPETUNE_H
+#define PIPETUNE_H
+
+/*
+ * Picking the pipe capacity and the chunk size for the server's copy, instead of guessing them.
+ *
+ * What's fastest depends on the machine (cache sizes, how fast the reader is, what the output is): a bigger pipe lets
+ * the writer run ahead of the reader, but past some size it's only memory, and the biggest chunk isn't always the best
+ * one either. So the first transfer is used to measure.
+ *    ->  The first PIPETUNE_TRIAL bytes are copied with a 64 KB pipe and 64 KB chunks, the next with both doubled, and
+ *        so on up to PIPETUNE_MAX (or pipe-max-size), for as long as each step is PIPETUNE_GAIN percent faster than
+ *        the best one before it. Then the best size is tried once more with a quarter of the chunk.
+ *    ->  The rate of a step is what the reader took out of the pipe while it ran (what we put in, less what's still
+ *        in the pipe, FIONREAD), not what we put in. Otherwise a big pipe would look fast just by filling up.
+ *    ->  The rest of the file goes with the winner, which is saved to the profile: the file named by the environment
+ *        variable PIPETUNE_PROFILE, or else PIPETUNE_PROFILE in $HOME ($TMPDIR or /tmp without one). The next run
+ *        reads it and doesn't measure. Delete it to measure again, e.g. on another machine.
+ *    ->  A file too small to finish the trials is copied as it goes, and nothing is saved.
+ *
+ * The routines available:
+ *    1.  pipetune_load(&prof);               // 0 if there's a profile, -1 (and an empty prof) if not
+ *    2.  pipetune_save(&prof);               // write it out, 0 or -1
+ *    3.  n = pipetune_copy(from, to, &prof); // like fd_copy, `to` a pipe, tuning first if prof is empty
+*/
+
+#define   PIPETUNE_PROFILE  ".pipetune.prof"
+#define   PIPETUNE_TRIAL    (4L * 1024 * 1024)    /* bytes copied with each candidate */
+#define   PIPETUNE_MIN      (64L * 1024)          /* the first candidate, and Linux's default pipe */
+#define   PIPETUNE_MAX      (4L * 1024 * 1024)    /* the last one, however big pipe-max-size is */
+#define   PIPETUNE_GAIN     5                     /* percent faster, or we stay with the smaller one */
+
+typedef struct {
+  long  pipesize;     /* capacity of the pipe, 0: leave it as it is */
+  long  chunk;        /* bytes per splice (or read and write), 0: not tuned yet */
+  long  rate;         /* KB/s when it was chosen */
+  int   tuned;        /* chosen by this pipetune_copy, not loaded */
+} PipeProfile;
+
+int   pipetune_load (PipeProfile *prof);
+int   pipetune_save (PipeProfile *prof);
+
+/*
+ * pipetune_copy: Copy until end of file on `from`. Returns the number of bytes copied, or -1 (errno).
+*/
+long  pipetune_copy (int from, int to, PipeProfile *prof);
+
+#endif
@@ -1,4 +1,6 @@
 #include "server.h"
+#include "fdcopy.h"
+#include "pipetune.h"
 #include "err_routine.h"
 
 #include <stdio.h>
@@ -22,6 +24,9 @@
  *                After encountering the EOF, the read operation sets the byte-offset to the end of the file such that the next call 
  *                will return a zero. Hence, we know when to terminate reading the file.
  *                The final if statement signifies that read operation was not successful.
+ *                NOTE: The read/write loop is now pipetune_copy (pipetune.c), which sizes the pipe and the chunk from
+ *                the profile (or measures them on this file, and saves them for the next run), and then fd_copy
+ *                (fdcopy.c) splice()s the file into the pipe on Linux. Elsewhere it's the same loop, with a bigger buffer.
 */
 void server(readfd, writefd)
 int readfd;
@@ -29,6 +34,7 @@ int writefd; {
   char        buff[MAXBUFF];
   char        errmesg[256], *sys_err_str(); 
   int         n, fd;
+  PipeProfile prof;
   extern int  errno;
 
   printf("****************SERVER****************\n");
@@ -53,15 +59,18 @@ int writefd; {
     }
   } else {
     /*
-     * Read the data from the file and write to the IPC descriptor.
+     * Move the data from the file to the IPC descriptor, with the pipe size and chunk of the profile, or tune them.
     */
-    while ( (n = read(fd, buff, MAXBUFF)) > 0) {
-      if (write(writefd, buff, n) != n) {
-        err_sys("server: data write error");
-      }
+    pipetune_load(&prof);
+    if (pipetune_copy(fd, writefd, &prof) < 0) {
+      err_sys("server: data copy error");
     }
-    if (n < 0) {
-      err_sys("server: read error");
+    close(fd);
+    if (prof.tuned) {
+      fprintf(stderr, "server: tuned, pipe %ld bytes, chunk %ld bytes (%ld KB/s)\n", prof.pipesize, prof.chunk, prof.rate);
+      if (pipetune_save(&prof) < 0) {
+        fprintf(stderr, "server: can't save the profile\n");
+      }
     }
   }
   printf("****************SERVER****************\n");
@@ -0,0 +1,253 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* posix_spawn, copy_file_range and sendfile with -ansi */
+#endif
+
+#include "p2open.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+extern char **environ;
+
+/*
+ * Functionality:
+ *    ->  Make the pipes asked for. Our ends are close-on-exec, so they don't leak into this or any other child.
+ *    ->  The file actions are what the child does between fork and exec: its end of a pipe becomes its standard
+ *        input (or output), and the original descriptor is closed.
+ *    ->  posix_spawnp() does the fork and the exec (vfork() or clone() underneath on Linux, no copy of our memory).
+ *        It returns the error instead of setting errno.
+ *    ->  The child's ends are closed here, or we would never see end of file on the pipe from it.
+*/
+pid_t p2open (argv, tochild, fromchild)
+char *const argv[];
+int         *tochild;
+int         *fromchild; {
+  int                         in[2] = { -1, -1 }, out[2] = { -1, -1 }, err;
+  pid_t                       pid;
+  posix_spawn_file_actions_t  fa;
+
+  if (tochild != NULL && pipe(in) < 0) {
+    return -1;
+  }
+  if (fromchild != NULL && pipe(out) < 0) {
+    err = errno;
+    close(in[0]);
+    close(in[1]);
+    errno = err;
+    return -1;
+  }
+
+  posix_spawn_file_actions_init(&fa);
+  if (tochild != NULL) {
+    fcntl(in[1], F_SETFD, FD_CLOEXEC);
+    posix_spawn_file_actions_adddup2(&fa, in[0], 0);
+    if (in[0] != 0) {
+      posix_spawn_file_actions_addclose(&fa, in[0]);
+    }
+  }
+  if (fromchild != NULL) {
+    fcntl(out[0], F_SETFD, FD_CLOEXEC);
+    posix_spawn_file_actions_adddup2(&fa, out[1], 1);
+    if (out[1] != 1) {
+      posix_spawn_file_actions_addclose(&fa, out[1]);
+    }
+  }
+
+  err = posix_spawnp(&pid, argv[0], &fa, (posix_spawnattr_t *) 0, argv, environ);
+  posix_spawn_file_actions_destroy(&fa);
+
+  if (tochild != NULL) {
+    close(in[0]);
+    *tochild = in[1];
+  }
+  if (fromchild != NULL) {
+    close(out[1]);
+    *fromchild = out[0];
+  }
+  if (err != 0) {
+    if (tochild != NULL) {
+      close(in[1]);
+    }
+    if (fromchild != NULL) {
+      close(out[0]);
+    }
+    errno = err;
+    return -1;
+  }
+
+  return pid;
+}
+
+int p2close (pid, tochild, fromchild)
+pid_t pid;
+int   tochild;
+int   fromchild; {
+  int status;
+
+  if (tochild >= 0) {
+    close(tochild);
+  }
+  if (fromchild >= 0) {
+    close(fromchild);
+  }
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      return -1;
+    }
+  }
+
+  return status;
+}
+
+/*
+ * read() and write() P2BUFF bytes at a time until end of file on `from`. A short write() is finished off.
+*/
+static long copy_rw (from, to)
+int from;
+int to; {
+  char    *buff;
+  long    total = 0;
+  ssize_t n, w, off;
+
+  if ( (buff = malloc(P2BUFF)) == NULL) {
+    return -1;
+  }
+  while ( (n = read(from, buff, P2BUFF)) != 0) {
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    for (off = 0; off < n; off += w) {
+      if ( (w = write(to, buff + off, n - off)) < 0) {
+        free(buff);
+        return -1;
+      }
+    }
+    total += n;
+  }
+  free(buff);
+
+  return (n < 0) ? -1 : total;
+}
+
+/*
+ * Functionality: Copy the regular file `from` to `to`, inside the kernel if we can.
+ *    ->  To a regular file, copy_file_range(): on some file systems (NFS, Btrfs, XFS with reflinks) the data isn't
+ *        even copied, and on the rest it doesn't come up to user space.
+ *    ->  To anything else (a pipe, a socket, a terminal), sendfile(), which moves the file's pages to it.
+ *    ->  If the first call says the pair isn't supported (EINVAL, EXDEV across file systems on older kernels,
+ *        EBADF for an O_APPEND output, ENOSYS), it's read() and write() after all. Nothing has been copied yet.
+ *    ->  `to` the same file as `from` is refused (EINVAL), as cat refuses it ("input file is output file"). Opened
+ *        O_APPEND (`>>` by the shell) every write would grow what is still to be read, and the copy never ends.
+*/
+static long copy_file (from, to)
+int from;
+int to; {
+  long        total = 0;
+  struct stat in, st;
+  int         reg;
+#ifdef __linux__
+  ssize_t     n;
+#endif
+
+  if (fstat(from, &in) < 0 || fstat(to, &st) < 0) {
+    return -1;
+  }
+  if ( (reg = S_ISREG(st.st_mode)) && in.st_dev == st.st_dev && in.st_ino == st.st_ino) {
+    errno = EINVAL;
+    return -1;
+  }
+#ifdef __linux__
+  for (;;) {
+    if (reg) {
+      n = copy_file_range(from, (loff_t *) 0, to, (loff_t *) 0, 1024 * 1024, 0);
+    } else {
+      n = sendfile(to, from, (off_t *) 0, 1024 * 1024);
+    }
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (total == 0 && (errno == EINVAL || errno == EXDEV || errno == EBADF || errno == ENOSYS)) {
+        break;
+      }
+      return -1;
+    }
+    if (n == 0) {
+      return total;
+    }
+    total += n;
+  }
+#endif
+
+  return copy_rw(from, to);
+}
+
+/*
+ * Is argv `cat file`, and nothing else? Options, more files, or "-" (the standard input) and it's not.
+*/
+static int is_cat (argv)
+char *const argv[]; {
+  const char *name;
+
+  if (argv[0] == NULL || argv[1] == NULL || argv[2] != NULL || argv[1][0] == '-') {
+    return 0;
+  }
+  name = strrchr(argv[0], '/');
+  name = (name == NULL) ? argv[0] : name + 1;
+
+  return strcmp(name, "cat") == 0;
+}
+
+/*
+ * Functionality:
+ *    ->  `cat file` of a regular file: open it and copy_file. A file that can't be opened is an error here (cat
+ *        would have said so on its standard error and exited 1), errno says why.
+ *    ->  Anything else, or a `file` that isn't a regular file (a FIFO, a device), is run with p2open, and what it
+ *        writes is copied to `to`.
+*/
+long p2run (argv, to, status)
+char *const argv[];
+int         to;
+int         *status; {
+  struct stat st;
+  int         fd, fromchild, err;
+  long        n;
+  pid_t       pid;
+
+  *status = 0;
+  if (is_cat(argv)) {
+    if ( (fd = open(argv[1], O_RDONLY)) < 0) {
+      return -1;
+    }
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+      n   = copy_file(fd, to);
+      err = errno;
+      close(fd);
+      errno = err;
+      return n;
+    }
+    close(fd);
+  }
+
+  if ( (pid = p2open(argv, (int *) 0, &fromchild)) < 0) {
+    return -1;
+  }
+  n   = copy_rw(fromchild, to);
+  err = errno;
+  *status = p2close(pid, -1, fromchild);
+  errno = err;
+
+  return n;
+}
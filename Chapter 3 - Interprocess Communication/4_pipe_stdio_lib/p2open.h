@@ -0,0 +1,48 @@
+#ifndef P2OPEN_H
+#define P2OPEN_H
+
+#include <sys/types.h>
+
+/*
+ * popen() without the shell, and with a pipe each way.
+ *
+ * popen("cat file", "r") runs /bin/sh -c "cat file": two processes (the shell and cat) to copy a file, and
+ * whatever is in the filename is a command line to the shell ("x; rm -rf ~" is a filename too). And it's one
+ * direction only, either we read what the command writes or it reads what we write.
+ *    ->  p2open starts the program itself with posix_spawnp(), the arguments are an argv[] array, nothing is
+ *        parsed. It gives us a pipe to the program's standard input, one from its standard output, or both.
+ *    ->  p2run does what popen("cat ...") and a read loop did: the output of a command copied to a descriptor.
+ *        If the command is nothing but `cat` of one regular file, it isn't run at all: the file is copied here,
+ *        with copy_file_range() (to a file) or sendfile() (to anything else) on Linux, which copy inside the
+ *        kernel. Otherwise the command's output is copied P2BUFF bytes at a time, not a line at a time.
+ *
+ * NOTE:  With both pipes, writing all the input before reading any output deadlocks once the output fills its pipe
+ *        (64 KB on Linux): the command waits for us to read, and we wait for it to read. Write and read in turns
+ *        (or poll() both), or close the pipe to it early.
+ *
+ * The routines available:
+ *    1.  pid = p2open(argv, &tochild, &fromchild);   // either pointer can be NULL: that side is ours, not a pipe
+ *    2.  status = p2close(pid, tochild, fromchild);  // close the pipes (-1: none) and wait for it
+ *    3.  n = p2run(argv, to, &status);               // the output of argv goes to `to`
+*/
+
+#define   P2BUFF    (64 * 1024)         /* bytes per read and write when it has to be read and write */
+
+/*
+ * p2open:  Run argv[0] (looked for in PATH if it has no '/') with argv. Returns its pid, or -1 (errno says why).
+*/
+pid_t p2open  (char *const argv[], int *tochild, int *fromchild);
+
+/*
+ * p2close: Close the pipes that are >= 0 and wait for `pid`. Returns its exit status (as from waitpid), or -1.
+*/
+int   p2close (pid_t pid, int tochild, int fromchild);
+
+/*
+ * p2run:   Copy the standard output of argv to `to`. Returns the number of bytes copied, or -1 (errno). The
+ *          command's exit status is in `*status`, 0 if it was done in-process. `cat file` with `to` that same file
+ *          is -1 with EINVAL, before anything is copied.
+*/
+long  p2run   (char *const argv[], int to, int *status);
+
+#endif
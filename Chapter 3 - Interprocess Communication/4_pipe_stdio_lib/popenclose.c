@@ -1,21 +1,23 @@
+#include "p2open.h"
 #include "err_routine.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 
 #define MAXLINE     1024
 
 /*
  * main:  Use this program to provide a file name to the input stream and the program
- *        will execute the cat command on the provided filename.
+ *        will copy that file to the standard output, as `cat` would.
  *        Also, it will print out the current working directory.
 */
 int main (void) {
   
-  int   n;
-  char  line[MAXLINE], command[MAXLINE + 10];
-  FILE  *fp;
+  int   n, fd, status;
+  char  line[MAXLINE], *argv[3];
+  pid_t pid;
 
   /* First example */
   /*
@@ -25,49 +27,45 @@ int main (void) {
     err_sys("filename read error");
   }
 
-  /*
-   * Use popen to create a pipe and execute the command
-  */
-  sprintf(command, "cat %s", line);
-  /*
-   * popen with the second argument (type) as "r" indicates the calling process reads the standard output of the command
-   * If the type is "w", the calling process writes to the standard input of the command
-  */
-  if ( (fp = popen(command, "r")) == NULL) {
-    err_sys("popen error");
+  n = strlen(line);
+  if (n > 0 && line[n-1] == '\n') {
+    line[n-1] = '\0';                 /* ignore newline from fgets() */
   }
 
   /*
-   * Read the data from the FILE pointer and write to standard output
+   * popen(command, "r") with command "cat <line>" ran /bin/sh -c on it, so the filename was a command line
+   * ("x; rm -rf ~" would have been two commands), and the output came back one fgets() line at a time.
+   * The filename is now one argument of an argv[], and p2run doesn't run cat at all for a regular file: the file
+   * is copied to the standard output in the kernel (see p2open.h). Anything else is spawned, without a shell.
   */
-  while ((fgets(line, MAXLINE, fp)) != NULL) {
-    n = strlen(line);
-    if (write(1, line, n) != n) {
-      err_sys("data write error");
-    }
+  argv[0] = "cat";
+  argv[1] = line;
+  argv[2] = NULL;
+  if (p2run(argv, 1, &status) < 0) {
+    err_sys("can't copy %s: %s\n", line, strerror(errno));
   }
 
-  if (ferror(fp)) {
-    err_sys("fgets error");
-  }
-
-  pclose(fp);
-
 
   /* Second example */
   /* chdir("/"); */   /* changes the current working directory to "/". Unmounts the filesystem */
 
-  if ( (fp = popen("/bin/pwd", "r")) == NULL) {
-    err_sys("popen error");
+  /*
+   * The output of pwd is read from the pipe p2open gives us (no shell here either), and pwd is waited for by p2close.
+  */
+  argv[0] = "/bin/pwd";
+  argv[1] = NULL;
+  if ( (pid = p2open(argv, (int *) 0, &fd)) < 0) {
+    err_sys("p2open error: %s\n", strerror(errno));
   }
 
-  if (fgets(line, MAXLINE, fp) == NULL) {
-    err_sys("fgets error");
+  if ( (n = read(fd, line, MAXLINE - 1)) <= 0) {
+    err_sys("read error");
   }
+  line[n] = '\0';
 
   printf("Current Directory: %s", line);   /* pwd inserts new-line */
 
-  pclose(fp);
+  p2close(pid, -1, fd);
 
   return 0;
 }
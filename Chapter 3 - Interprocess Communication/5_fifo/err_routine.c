@@ -3,6 +3,7 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include "err_routine.h"
 
 char *pname = NULL;
 
@@ -59,6 +60,33 @@ int     t_nerr;
 char    *t_errlist[1];
 #endif
 
+/*
+ * Nonfatal error related to a system call. Print a message, the errno text and a new-line, and return.
+ *
+ *        err_ret(str, arg1, arg2, ...)
+ *
+ * Nothing is kept between calls, so a long-running server can call it as often as it likes.
+*/
+void err_ret (char *fmt, ...) {
+  va_list args;
+  int     err = errno;                      /* before fprintf can change it */
+
+  va_start(args, fmt);
+  if (pname != NULL) {
+    fprintf(stderr, "%s: ", pname);
+  }
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+
+  if (err != 0) {
+    fprintf(stderr, ": %s", strerror(err));
+  }
+  fprintf(stderr, "\n");
+  fflush(stdout);
+
+  return ;
+}
+
 /*
  * Return a string containing some additional operating-system dependent information.
  * NOTE that different versions of UNIX assign different meanings to the same value of "errno" 
@@ -19,4 +19,8 @@
 
 void err_sys (char *fmt, ...);
 
+char *sys_err_str (void);
+
+void err_ret (char *fmt, ...);
+
 #endif
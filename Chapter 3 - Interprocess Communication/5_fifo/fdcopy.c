@@ -0,0 +1,90 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* splice, F_SETPIPE_SZ and F_GETPIPE_SZ */
+#endif
+
+#include "fdcopy.h"
+
+#include <stdio.h>
+#include <stdlib.h>         /* for function: malloc, free */
+#include <unistd.h>         /* for function: read, write */
+#include <fcntl.h>          /* for function: fcntl, splice */
+#include <errno.h>
+
+#define PIPE_MAX_SIZE   "/proc/sys/fs/pipe-max-size"
+
+long pipe_grow (fd)
+int fd; {
+#ifdef F_SETPIPE_SZ
+  FILE  *fp;
+  long  max = 0, size;
+
+  if ( (size = fcntl(fd, F_GETPIPE_SZ)) < 0) {
+    return -1;
+  }
+  if ( (fp = fopen(PIPE_MAX_SIZE, "r")) != NULL) {
+    if (fscanf(fp, "%ld", &max) != 1) {
+      max = 0;
+    }
+    fclose(fp);
+  }
+  if (max > size && fcntl(fd, F_SETPIPE_SZ, (int) max) >= 0) {
+    size = fcntl(fd, F_GETPIPE_SZ);
+  }
+  return size;
+#else
+  (void) fd;
+  errno = ENOSYS;           /* the pipe is what it is, 16 KB to 64 KB on macOS depending on use */
+  return -1;
+#endif
+}
+
+/*
+ * Functionality:
+ *    ->  splice() `chunk` bytes at a time, for as long as it works. SPLICE_F_MOVE asks for the pages to be moved
+ *        rather than copied (a hint), SPLICE_F_MORE says more is coming.
+ *    ->  If the very first one fails with EINVAL (or ENOSYS), neither end is spliceable and we read() and write()
+ *        instead. Later failures are real errors, some of the data is already gone.
+ *    ->  A short write() is finished off before the next read(), like on a pipe to a slow reader.
+*/
+long fd_copy (from, to, chunk)
+int   from;
+int   to;
+long  chunk; {
+  long    total = 0;
+  ssize_t n, w, off;
+  char    *buff;
+
+#ifdef SPLICE_F_MOVE
+  for (;;) {
+    if ( (n = splice(from, NULL, to, NULL, chunk, SPLICE_F_MOVE | SPLICE_F_MORE)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (total == 0 && (errno == EINVAL || errno == ENOSYS)) {
+        break;              /* not spliceable, copy it */
+      }
+      return -1;
+    }
+    if (n == 0) {
+      return total;
+    }
+    total += n;
+  }
+#endif
+
+  if ( (buff = malloc(chunk)) == NULL) {
+    return -1;
+  }
+  while ( (n = read(from, buff, chunk)) > 0) {
+    for (off = 0; off < n; off += w) {
+      if ( (w = write(to, buff + off, n - off)) < 0) {
+        free(buff);
+        return -1;
+      }
+    }
+    total += n;
+  }
+  free(buff);
+
+  return (n < 0) ? -1 : total;
+}
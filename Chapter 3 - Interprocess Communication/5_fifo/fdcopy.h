@@ -0,0 +1,30 @@
+#ifndef FDCOPY_H
+#define FDCOPY_H
+
+/*
+ * Moving the contents of one descriptor to another, for the server (file -> pipe or FIFO) and the client (pipe -> stdout).
+ *
+ * A read()/write() loop copies every byte twice, from the kernel to our buffer and back, and makes two system calls
+ * per buffer. On Linux, splice() moves the data between a pipe and another descriptor inside the kernel: the file's
+ * pages are put into the pipe as they are (no copy on the server side), and a pipe to a file or socket is one copy
+ * less as well. One end of a splice() has to be a pipe, and not every file system or device takes part (a terminal
+ * doesn't, nor does a file opened with O_APPEND), so if the first splice() says EINVAL we go back to read and write.
+ *
+ * The routines available:
+ *    1.  size = pipe_grow(fd);           // make the pipe (or FIFO) `fd` as big as we may, returns its size
+ *    2.  n = fd_copy(from, to, chunk);   // everything from `from` to `to`, at most `chunk` bytes at a time
+*/
+
+/*
+ * pipe_grow: Raise the capacity of the pipe to /proc/sys/fs/pipe-max-size with F_SETPIPE_SZ (1 MB unless the admin
+ *            changed it, the default is 64 KB). If we can't have that much (the user is over pipe-user-pages-soft) the
+ *            pipe stays as it is. Returns the size of the pipe, or -1 if `fd` isn't one or this isn't Linux.
+*/
+long  pipe_grow (int fd);
+
+/*
+ * fd_copy:   Copy until end of file on `from`. Returns the number of bytes copied, or -1 on an error (errno says what).
+*/
+long  fd_copy   (int from, int to, long chunk);
+
+#endif
@@ -1,4 +1,5 @@
 #include "fifo.h"           /* for function declaration: client, server */
+#include "fdcopy.h"         /* for function declaration: pipe_grow, fd_copy */
 #include "err_routine.h"    /* for function declaration: err_sys */
 
 #include <stdio.h>
@@ -11,6 +12,7 @@ int readfd;
 int writefd; {
   char buff[MAXBUFF];
   int n;
+  long chunk;
 
   printf("****************CLIENT****************\n");
 
@@ -35,14 +37,11 @@ int writefd; {
   /*
    * Read the data from the IPC descriptor and write to standard output.
   */
-  while ( (n = read(readfd, buff, MAXBUFF)) > 0 ) {
-    if (write(1, buff, n) != n) {             /* fd 1 = stdout */
-      err_sys("client: data write error");
-    }
+  if ( (chunk = pipe_grow(readfd)) < MAXBUFF) {
+    chunk = MAXBUFF;
   }
-
-  if (n < 0) {
-    err_sys("client: data read error");
+  if (fd_copy(readfd, 1, chunk) < 0) {        /* fd 1 = stdout */
+    err_sys("client: data copy error");
   }
 
   printf("****************CLIENT****************\n");
@@ -54,6 +53,7 @@ int writefd; {
   char        buff[MAXBUFF];
   char        errmesg[256], *sys_err_str(); 
   int         n, fd;
+  long        chunk;
   extern int  errno;
 
   printf("****************SERVER****************\n");
@@ -78,16 +78,15 @@ int writefd; {
     }
   } else {
     /*
-     * Read the data from the file and write to the IPC descriptor.
+     * Move the data from the file to the IPC descriptor, a FIFO's worth at a time.
     */
-    while ( (n = read(fd, buff, MAXBUFF)) > 0) {
-      if (write(writefd, buff, n) != n) {
-        err_sys("server: data write error");
-      }
+    if ( (chunk = pipe_grow(writefd)) < MAXBUFF) {
+      chunk = MAXBUFF;
     }
-    if (n < 0) {
-      err_sys("server: read error");
+    if (fd_copy(fd, writefd, chunk) < 0) {
+      err_sys("server: data copy error");
     }
+    close(fd);
   }
   printf("****************SERVER****************\n");
 }
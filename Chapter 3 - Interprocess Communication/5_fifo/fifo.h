@@ -14,6 +14,7 @@
  *                The read string is then written to the writefd, which is the writing end of pipe1.
  *                After reading the filename, it is sent to the reading end of pipe1, which is read by server function in server.c
  *                While the input from the pipe2 is buffered by server, the client reads it, and sends the buffer to the standard output.
+ *                That last part is fd_copy (fdcopy.c), which splice()s from the FIFO to the standard output if it can.
 */
 void client (int readfd, int writefd);
 
@@ -31,6 +32,8 @@ void client (int readfd, int writefd);
  *                After encountering the EOF, the read operation sets the byte-offset to the end of the file such that the next call 
  *                will return a zero. Hence, we know when to terminate reading the file.
  *                The final if statement signifies that read operation was not successful.
+ *                NOTE: The read/write loop is now fd_copy (fdcopy.c), which splice()s the file into the FIFO on Linux, after
+ *                pipe_grow has made the FIFO as big as it may be. Elsewhere it's the same loop, with a bigger buffer.
 */
 void server (int readfd, int writefd);
 
@@ -0,0 +1,26 @@
+#ifndef FIFO_MPX_H
+#define FIFO_MPX_H
+
+#include <limits.h>         /* for PIPE_BUF */
+
+/*
+ * The concurrent FIFO server (fifo_mpx_server.c) and its client (fifo_mpx_client.c).
+ *
+ * With FIFO1 and FIFO2 there's one conversation at a time: two clients would write their filenames into the same
+ * FIFO and read each other's files from the other one. Instead:
+ *    ->  The server creates one well-known FIFO, MPX_SERVER_FIFO, that every client writes its request to. A request
+ *        is one line, "pid path\n", written with one write() of at most PIPE_BUF bytes. Writes of up to PIPE_BUF
+ *        bytes to a pipe or FIFO are atomic, so the requests of different clients never get mixed up, however many
+ *        of them write at once.
+ *    ->  Every client has a FIFO of its own for the reply, MPX_CLIENT_FIFO with its pid in it. It makes that FIFO
+ *        before it sends the request, and removes it when it's done. The server writes only into a FIFO (no symbolic
+ *        link, no regular file) that belongs to the user the process with that pid runs as.
+*/
+#define   MPX_SERVER_FIFO   "/tmp/fifo.serv"
+#define   MPX_CLIENT_FIFO   "/tmp/fifo.%ld"
+#define   MPX_MAXREQ        PIPE_BUF            /* request, new-line included */
+#define   MPX_WORKERS       4                   /* default number of workers in the server */
+#define   MPX_OPENWAIT      5                   /* seconds a worker waits for the client to open its FIFO */
+#define   PERMS             0666
+
+#endif
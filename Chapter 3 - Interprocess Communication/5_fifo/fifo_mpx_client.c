@@ -0,0 +1,86 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* mkfifo with -ansi */
+#endif
+
+#include "fifo_mpx.h"
+#include "fdcopy.h"
+#include "err_routine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+/*
+ * Functionality:
+ *    ->  Make our own FIFO for the reply, MPX_CLIENT_FIFO with our pid. It has to be ours: the server only writes
+ *        into a FIFO that belongs to the user we run as. If one that isn't ours is in the way (and /tmp is sticky,
+ *        so we can't remove it), we give up.
+ *    ->  Open the server's FIFO for writing. O_NONBLOCK so that if no server has it open for reading we get ENXIO
+ *        instead of waiting for one.
+ *    ->  Read the filename from the standard input and send "pid filename\n" with one write(). It has to fit in
+ *        MPX_MAXREQ (PIPE_BUF) bytes, or it wouldn't be atomic.
+ *    ->  Open our FIFO for reading. This waits until the server's worker opens it for writing. Then whatever comes
+ *        is copied to the standard output (fd_copy, splice() if it can), until the worker closes it.
+ *    ->  Remove our FIFO.
+*/
+int main (void) {
+  char  fifo[64], filename[MPX_MAXREQ], req[MPX_MAXREQ + 64];
+  int   servfd, readfd, n, len;
+  long  pid = getpid(), chunk;
+
+  sprintf(fifo, MPX_CLIENT_FIFO, pid);
+  unlink(fifo);                           /* left over by an earlier process with our pid */
+  if (mkfifo(fifo, PERMS) < 0) {
+    err_sys("client: can't create fifo: %s", fifo);
+  }
+
+  if ( (servfd = open(MPX_SERVER_FIFO, O_WRONLY | O_NONBLOCK)) < 0) {
+    unlink(fifo);
+    err_sys("client: can't open %s, is the server running?", MPX_SERVER_FIFO);
+  }
+
+  if (fgets(filename, sizeof(filename), stdin) == NULL) {
+    unlink(fifo);
+    err_sys("client: filename read error");
+  }
+  n = strlen(filename);
+  if (n > 0 && filename[n-1] == '\n') {
+    n--;                      /* ignore newline from fgets */
+  }
+  filename[n] = '\0';
+
+  len = sprintf(req, "%ld %s\n", pid, filename);
+  if (len > MPX_MAXREQ) {
+    unlink(fifo);
+    err_sys("client: filename too long, the request must fit in %d bytes", MPX_MAXREQ);
+  }
+  if (write(servfd, req, len) != len) {
+    unlink(fifo);
+    err_sys("client: request write error");
+  }
+  close(servfd);
+
+  if ( (readfd = open(fifo, O_RDONLY)) < 0) {
+    unlink(fifo);
+    err_sys("client: can't open read fifo: %s", fifo);
+  }
+  if ( (chunk = pipe_grow(readfd)) < MPX_MAXREQ) {
+    chunk = MPX_MAXREQ;
+  }
+  if (fd_copy(readfd, 1, chunk) < 0) {        /* fd 1 = stdout */
+    unlink(fifo);
+    err_sys("client: data copy error");
+  }
+  close(readfd);
+
+  if (unlink(fifo) < 0) {
+    err_sys("client: can't unlink %s", fifo);
+  }
+
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,283 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* mkfifo, poll, sigaction, kill, getopt and O_NOFOLLOW with -ansi */
+#endif
+
+#include "fifo_mpx.h"
+#include "fdcopy.h"
+#include "err_routine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#ifdef __APPLE__
+#include <sys/sysctl.h>     /* for function: sysctl (KERN_PROC_PID) */
+#endif
+
+volatile sig_atomic_t stop;
+
+void sig_stop (int signo) {
+  (void) signo;
+  stop = 1;
+}
+
+/*
+ * The user that process `pid` runs as, or -1 if we can't tell (it's gone, or there's no way to ask).
+*/
+uid_t pid_owner (long pid) {
+#ifdef __APPLE__
+  struct kinfo_proc kp;
+  size_t            len = sizeof(kp);
+  int               mib[4];
+
+  mib[0] = CTL_KERN;
+  mib[1] = KERN_PROC;
+  mib[2] = KERN_PROC_PID;
+  mib[3] = (int) pid;
+  if (sysctl(mib, 4, &kp, &len, (void *) 0, 0) < 0 || len == 0) {
+    return (uid_t) -1;
+  }
+  return kp.kp_eproc.e_ucred.cr_uid;
+#else
+  char        proc[64];
+  struct stat st;
+
+  sprintf(proc, "/proc/%ld", pid);
+  return (stat(proc, &st) < 0) ? (uid_t) -1 : st.st_uid;
+#endif
+}
+
+/*
+ * Open the client's FIFO for writing. O_NONBLOCK, so that if the client isn't there (yet) we get ENXIO instead of
+ * waiting forever for one that died. It gets MPX_OPENWAIT seconds to show up. The descriptor is made blocking again
+ * for the copy.
+ *
+ * The path comes from the request, and anybody can write a request, so what we opened is checked before a byte goes
+ * into it (EACCES if it fails):
+ *    ->  O_NOFOLLOW: a symbolic link planted at /tmp/fifo.<pid> isn't followed to some file of ours.
+ *    ->  It has to be a FIFO. Opening a regular file O_WRONLY doesn't change it, writing to it would.
+ *    ->  It has to belong to the user that process `pid` runs as, the client that made it. A FIFO somebody else made
+ *        for another user's pid doesn't get that user's file.
+*/
+int open_reply (const char *fifo, long pid) {
+  struct stat st;
+  int         fd, waited;
+
+  for (waited = 0; (fd = open(fifo, O_WRONLY | O_NONBLOCK | O_NOFOLLOW | O_NOCTTY)) < 0; waited += 10) {
+    if (errno != ENXIO || waited >= MPX_OPENWAIT * 1000) {
+      return -1;
+    }
+    poll((struct pollfd *) 0, 0, 10);     /* 10 ms */
+  }
+  if (fstat(fd, &st) < 0 || !S_ISFIFO(st.st_mode) || st.st_uid != pid_owner(pid)) {
+    close(fd);
+    errno = EACCES;
+    return -1;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+  return fd;
+}
+
+/*
+ * Functionality: What a worker does, over and over.
+ *    ->  Take a job off the job pipe. Every job is MPX_MAXREQ bytes (a request line without its new-line), and
+ *        every write to the pipe is a whole job, so a read of MPX_MAXREQ bytes gets exactly one, whichever worker
+ *        does it. End of file means the parent is gone, and so do we.
+ *    ->  Open the client's FIFO (open_reply). If the client is gone, or the FIFO isn't one it made, forget about it.
+ *    ->  If the file can't be opened, the error message is the reply. Otherwise the file is copied into the FIFO
+ *        with fd_copy, splice() on Linux.
+ *    ->  Closing the FIFO is the end of file for the client.
+*/
+void worker (int jobfd) {
+  char  job[MPX_MAXREQ], fifo[64], errmesg[MPX_MAXREQ + 256], *sys_err_str();
+  int   n, fd, filefd, off;
+  long  pid, chunk;
+
+  signal(SIGPIPE, SIG_IGN);               /* a client that goes away is an EPIPE, not the end of us */
+  for (;;) {
+    if ( (n = read(jobfd, job, MPX_MAXREQ)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      err_sys("worker: job read error");
+    }
+    if (n == 0) {
+      return;
+    }
+    off = -1;
+    if (n != MPX_MAXREQ || sscanf(job, "%ld %n", &pid, &off) != 1 || off < 0) {
+      err_ret("worker: bad job");
+      continue;
+    }
+
+    sprintf(fifo, MPX_CLIENT_FIFO, pid);
+    if ( (fd = open_reply(fifo, pid)) < 0) {
+      err_ret("worker: no reply fifo for client %ld", pid);
+      continue;
+    }
+
+    if ( (filefd = open(job + off, O_RDONLY)) < 0) {
+      sprintf(errmesg, "%s: can't open, %s\n", job + off, sys_err_str());
+      n = strlen(errmesg);
+      if (write(fd, errmesg, n) != n) {
+        err_ret("worker: errmesg write error");
+      }
+    } else {
+      if ( (chunk = pipe_grow(fd)) < MPX_MAXREQ) {
+        chunk = MPX_MAXREQ;
+      }
+      if (fd_copy(filefd, fd, chunk) < 0) {
+        err_ret("worker: data copy error for client %ld", pid);
+      }
+      close(filefd);
+    }
+    close(fd);
+  }
+}
+
+/*
+ * Check a request line (without its new-line) and hand it to the workers as one MPX_MAXREQ byte job.
+*/
+void dispatch (int jobfd, char *line) {
+  char  job[MPX_MAXREQ];
+  long  pid;
+  int   off = -1;
+
+  if (strlen(line) >= MPX_MAXREQ || sscanf(line, "%ld %n", &pid, &off) != 1 || off < 0 || pid <= 1 ||
+      line[off] == '\0') {
+    err_ret("server: bad request \"%s\"", line);
+    return;
+  }
+  memset(job, 0, sizeof(job));
+  strcpy(job, line);
+  if (write(jobfd, job, sizeof(job)) != sizeof(job)) {
+    err_sys("server: job write error");
+  }
+}
+
+/*
+ * Functionality:
+ *    ->  Create the well-known FIFO and open it for reading, O_NONBLOCK so the open doesn't wait for a client. We
+ *        also open it for writing ourselves: without a writer, a read returns end of file every time the last
+ *        client closes it, and poll() says POLLHUP for ever after.
+ *    ->  The workers (worker, above) are forked. They get their jobs from a pipe, so the file I/O, and waiting for a
+ *        slow client, happens in them while we go on reading requests. Up to `nworkers` clients are served at once,
+ *        the rest wait in the job pipe.
+ *    ->  The loop poll()s the FIFO, reads whatever is there without blocking, and dispatches every complete line.
+ *        A read can end in the middle of a request (when our buffer is full), the rest is kept for the next read.
+ *        Once a second (the poll timeout) dead workers are replaced.
+ *    ->  SIGINT or SIGTERM stop the workers and remove the FIFO.
+ *
+ *        ./fifo_mpx_server [-n workers]
+*/
+int main (int argc, char **argv) {
+  char              buff[MPX_MAXREQ * 4], *line, *nl;
+  int               c, i, n, readfd, dummyfd, jobs[2], have = 0, nworkers = MPX_WORKERS, status;
+  pid_t             *pids, pid;
+  struct pollfd     pfd;
+  struct sigaction  sa;
+
+  while ( (c = getopt(argc, argv, "n:")) != -1) {
+    switch (c) {
+      case 'n': nworkers = atoi(optarg); break;
+      default:
+        err_sys("usage: %s [-n workers]", argv[0]);
+    }
+  }
+  if (nworkers < 1 || (pids = (pid_t *) calloc(nworkers, sizeof(pid_t))) == NULL) {
+    err_sys("server: need at least one worker");
+  }
+
+  if (mkfifo(MPX_SERVER_FIFO, PERMS) < 0 && errno != EEXIST) {
+    err_sys("server: can't create fifo: %s", MPX_SERVER_FIFO);
+  }
+  if ( (readfd = open(MPX_SERVER_FIFO, O_RDONLY | O_NONBLOCK)) < 0) {
+    err_sys("server: can't open read fifo: %s", MPX_SERVER_FIFO);
+  }
+  if ( (dummyfd = open(MPX_SERVER_FIFO, O_WRONLY)) < 0) {
+    err_sys("server: can't open write fifo: %s", MPX_SERVER_FIFO);
+  }
+  if (pipe(jobs) < 0) {
+    err_sys("server: can't create the job pipe");
+  }
+
+  memset(&sa, 0, sizeof(sa));
+  sigemptyset(&sa.sa_mask);
+  sa.sa_handler = sig_stop;
+  sigaction(SIGINT, &sa, (struct sigaction *) 0);
+  sigaction(SIGTERM, &sa, (struct sigaction *) 0);
+
+  pfd.fd      = readfd;
+  pfd.events  = POLLIN;
+  while (!stop) {
+    for (i = 0; i < nworkers; i++) {
+      if (pids[i] != 0) {
+        continue;
+      }
+      if ( (pids[i] = fork()) < 0) {
+        err_sys("server: can't fork");
+      } else if (pids[i] == 0) {
+        sa.sa_handler = SIG_DFL;
+        sigaction(SIGINT, &sa, (struct sigaction *) 0);
+        sigaction(SIGTERM, &sa, (struct sigaction *) 0);
+        close(readfd);
+        close(dummyfd);
+        close(jobs[1]);
+        worker(jobs[0]);
+        exit(EXIT_SUCCESS);
+      }
+    }
+
+    if (poll(&pfd, 1, 1000) > 0) {
+      if ( (n = read(readfd, buff + have, sizeof(buff) - have)) < 0 && errno != EAGAIN && errno != EINTR) {
+        err_sys("server: request read error");
+      }
+      if (n > 0) {
+        have += n;
+        for (line = buff; (nl = memchr(line, '\n', buff + have - line)) != NULL; line = nl + 1) {
+          *nl = '\0';
+          dispatch(jobs[1], line);
+        }
+        have -= line - buff;
+        memmove(buff, line, have);
+        if (have >= MPX_MAXREQ) {
+          err_ret("server: request longer than %d bytes, dropped", MPX_MAXREQ);
+          have = 0;
+        }
+      }
+    }
+
+    while ( (pid = waitpid(-1, &status, WNOHANG)) > 0) {
+      for (i = 0; i < nworkers; i++) {
+        if (pids[i] == pid) {
+          err_ret("server: worker %d died (status %d), starting another", (int) pid, status);
+          pids[i] = 0;
+        }
+      }
+    }
+  }
+
+  close(jobs[1]);                         /* the workers that are idle see end of file */
+  for (i = 0; i < nworkers; i++) {
+    if (pids[i] != 0) {
+      kill(pids[i], SIGTERM);
+    }
+  }
+  while (wait(&status) > 0) {
+    ;
+  }
+  close(readfd);
+  close(dummyfd);
+  unlink(MPX_SERVER_FIFO);
+  free(pids);
+
+  exit(EXIT_SUCCESS);
+}
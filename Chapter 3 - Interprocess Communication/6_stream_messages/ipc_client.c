@@ -6,7 +6,10 @@
 #include <string.h>
 #include <unistd.h>
 
-Mesg  mesg;
+/* static: the client and the server are linked into one program, each has its own */
+static Mesg    mesg;
+static MesgBuf in;
+static MesgOut out;
 
 /*
  * Functionality: When the function is called, it searches in standard input for (MAXMESGDATA -1) bytes and stores it in 
@@ -20,12 +23,18 @@ Mesg  mesg;
  *                NOTE: The while loop checks for the mesg_recv function to return a value greater than 0. Usually, this is 
  *                because a value of zero indicates that the function received an empty envelope (sent by the server at the 
  *                end). A negative value indicates the inner system call failed.
+ *
+ *                NEW: Before the filename, the two ends agree on the longest message (mesg_agree). We take up
+ *                to MESGMAXDEFAULT bytes, so the server can send the file in big messages, and the data is
+ *                written from the MesgBuf as it is (mesgbuf_recv), not copied into mesg first.
 */
 void client (ipcreadfd, ipcwritefd)
 int ipcreadfd;
 int ipcwritefd; {
 
-  int n;
+  int           r, n;
+  unsigned long type, len;
+  char          *data;
 
   /*
    * Read the filename from standard input, write it as a 
@@ -40,21 +49,29 @@ int ipcwritefd; {
     n--;      /* ignore newline from fgets() */
   }
 
+  mesgbuf_init(&in, ipcreadfd);
+  mesgout_init(&out, ipcwritefd, 0);
+  if (mesg_agree(&in, &out, MESGMAXDEFAULT) < 0) {
+    err_sys("no hello from the server");
+  }
+
   mesg.mesg_len   = n;
   mesg.mesg_type  = 1L;
-  mesg_send(ipcwritefd, &mesg);
+  mesgout_put(&out, &mesg);
+  mesgout_flush(&out);
 
   /*
    * Receive the message from the IPC descriptor and write the data to the standard output.
   */
-  while ( (n = mesg_recv(ipcreadfd, &mesg)) > 0) {
-    if (write(1, mesg.mesg_data, n) != n) {
+  while ( (r = mesgbuf_recv(&in, &type, &data, &len)) == MESG_OK && len > 0) {
+    if (write(1, data, len) != (long) len) {
       err_sys("data write error");
     }
   }
 
-  if (n < 0) {
+  if (r != MESG_OK) {
     err_sys("data read error");
   }
+  mesgbuf_free(&in);
 }
 
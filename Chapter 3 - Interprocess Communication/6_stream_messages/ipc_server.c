@@ -8,7 +8,11 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 
-Mesg  mesg;
+/* static: the client and the server are linked into one program, each has its own */
+static Mesg    mesg;
+static MesgBuf in;
+static MesgOut out;
+static char    data[MESGOUTBYTES];     /* the file is read into this, see below */
 
 /*
  * Functionality: The server is used by the child process. After reading the filename from the client.
@@ -23,7 +27,12 @@ Mesg  mesg;
  *
  *                After the file is opened, the content of the file is read (MAXMESGDATA bytes) 
  *                and then MAXMESGDATA byte is sent to the writing end pipe which the server has 
- *                access to using the mesg_send function. (The message is sent as an envelope.)
+ *                access to. (The message is sent as an envelope.) The envelopes are batched with
+ *                a MesgOut (msg.h), MESGOUTCOUNT of them per writev(), rather than a write() each.
+ *
+ *                NEW: The two ends first agree on the longest message (mesg_agree). The file is then
+ *                read MESGOUTBYTES at a time, and sent as one message if the client takes that much
+ *                (as many as it takes if not), instead of in MAXMESGDATA byte pieces.
  *                The opened file is closed as the file has been read.
  *                The process also terminates if the function cannot read from the file due to 
  *                sys call error. 
@@ -36,7 +45,8 @@ void server (ipcreadfd, ipcwritefd)
 int ipcreadfd;
 int ipcwritefd; {
 
-  int n, filefd;
+  int   n, i, filefd;
+  long  rec;
   char errmesg[256], *sys_err_str();
 
   struct stat statbuf;
@@ -44,11 +54,16 @@ int ipcwritefd; {
   /*
    * Read the filename message from the IPC descriptor.
   */
-  mesg.mesg_type = 1L;
+  mesgbuf_init(&in, ipcreadfd);
+  mesgout_init(&out, ipcwritefd, 0);
+  if (mesg_agree(&in, &out, MAXMESGDATA) < 0) {
+    err_sys("server: no hello from the client");
+  }
 
-  if ( (n = mesg_recv(ipcreadfd, &mesg)) <= 0) {
+  if (mesgbuf_read(&in, &mesg) != MESG_OK || (n = mesg.mesg_len) <= 0) {
     err_sys("server: filename read error");
   }
+  mesgbuf_free(&in);
 
   mesg.mesg_data[n] = '\0';       /* null terminate filename */
   
@@ -59,7 +74,7 @@ int ipcwritefd; {
     sprintf(errmesg, ": can't open, %s\n", sys_err_str());
     strcat(mesg.mesg_data, errmesg);
     mesg.mesg_len = strlen(mesg.mesg_data);
-    mesg_send(ipcwritefd, &mesg);
+    mesgout_put(&out, &mesg);
   } else {
     /* NEW: Return error if the opened file is a directory */
     if (fstat(filefd, &statbuf) < 0) {
@@ -69,11 +84,16 @@ int ipcwritefd; {
       err_sys("server: cannot open directory");
     }
     /*
-     * Read the data from the file and send a message to the IPC descriptor.
+     * Read the data from the file and queue messages for the IPC descriptor, their data straight from where it was
+     * read (mesgout_data). They're MESGOUTBYTES long, or as long as the client takes. The queue is flushed before
+     * the buffer is read into again, since a queued message must not change until it's sent.
     */
-    while ( (n = read(filefd, mesg.mesg_data, MAXMESGDATA)) > 0) {
-      mesg.mesg_len = n;
-      mesg_send(ipcwritefd, &mesg);
+    rec = (out.max < MESGOUTBYTES) ? (long) out.max : MESGOUTBYTES;
+    while ( (n = read(filefd, data, MESGOUTBYTES)) > 0) {
+      for (i = 0; i < n; i += rec) {
+        mesgout_data(&out, 1L, data + i, (n - i < rec) ? n - i : rec);
+      }
+      mesgout_flush(&out);
     }
     close(filefd);
 
@@ -86,6 +106,7 @@ int ipcwritefd; {
    * Send a message with a length of 0 to signify the end
   */
   mesg.mesg_len = 0;
-  mesg_send(ipcwritefd, &mesg);
+  mesgout_put(&out, &mesg);
+  mesgout_flush(&out);
 }
 
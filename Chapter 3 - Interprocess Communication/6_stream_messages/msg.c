@@ -1,73 +1,493 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* writev and gettimeofday with -ansi */
+#endif
+
 #include "msg.h"
 #include "err_routine.h"
 
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/time.h>
+
+#define   MAXFD   64              /* mesg_recv keeps a MesgBuf for each of descriptors 0 to MAXFD-1 */
+
+/*
+ * Functionality: The type goes out a byte at a time, the least significant first, so it reads the same on any
+ *                machine. The length is a varint: the low 7 bits of what's left in each byte, and the top bit set
+ *                if there's more to come. A message of up to 127 bytes has a 6 byte header.
+*/
+int mesg_enchdr (hdr, type, len)
+unsigned char *hdr;
+unsigned long type;
+unsigned long len; {
+  int i = 5;
+
+  hdr[0] = MESG_VERSION;
+  hdr[1] = type & 0xff;
+  hdr[2] = (type >> 8) & 0xff;
+  hdr[3] = (type >> 16) & 0xff;
+  hdr[4] = (type >> 24) & 0xff;
+  do {
+    hdr[i] = len & 0x7f;
+    if ( (len >>= 7) != 0) {
+      hdr[i] |= 0x80;
+    }
+    i++;
+  } while (len != 0 && i < MESGHDRMAX);
+
+  return (i);
+}
+
+int mesg_dechdr (hdr, have, type, len)
+const unsigned char *hdr;
+int                 have;
+unsigned long       *type;
+unsigned long       *len; {
+  int i, shift;
+
+  if (have < 1) {
+    return (0);
+  }
+  if (hdr[0] != MESG_VERSION) {
+    return (-1);
+  }
+  if (have < 6) {
+    return (0);
+  }
+  *type = hdr[1] | (hdr[2] << 8) | ((unsigned long) hdr[3] << 16) | ((unsigned long) hdr[4] << 24);
+  *len  = 0;
+  for (i = 5, shift = 0; i < MESGHDRMAX; i++, shift += 7) {
+    if (i >= have) {
+      return (0);
+    }
+    *len |= (unsigned long) (hdr[i] & 0x7f) << shift;
+    if ((hdr[i] & 0x80) == 0) {
+      return (i + 1);
+    }
+  }
+
+  return (-1);                /* more than 5 bytes of length */
+}
 
 /*
- * Functionality: The length of message is determined (along with the header size), and is then
- *                written to the provided file descriptor (in bytes). The function is used to 
- *                send the data to the pipe (named pipe in our case). 
- *                
- *                NOTE: The write call may write bytes value (or even unspecified holes in structures)
- *                but a structure that can store the value in similar structure can receive and store 
- *                the correct value. (check the test directory)
- *                (For instance, in this struct, the first two members are int and long, so
- *                when the values of int and long are written in a file/pipe, it can be "unreadable", 
- *                but after reading the bytes from the file/pipe and storing in the same struct, the
- *                corresponding bytes value will be used by the type (int and long).)
+ * Functionality: The header for the message (see msg.h) is made, and then the header and the mesg_len bytes of
+ *                data are written to the provided file descriptor with one writev(). The function is used to
+ *                send the data to the pipe (named pipe in our case).
+ *
+ *                NOTE: The Mesg structure itself used to be written, holes and all, and the other end had to
+ *                store it in a similar structure to make sense of the int and long (check the test directory).
+ *                The header is now the same bytes on any machine, so the other end needn't be one like ours.
 */
 void mesg_send (fd, mesg_ptr)
 int   fd;
 Mesg  *mesg_ptr; {
-  int n;
+  unsigned char hdr[MESGHDRMAX];
+  struct iovec  iov[2];
+  int           n;
+
+  if (mesg_ptr->mesg_len < 0 || mesg_ptr->mesg_len > MAXMESGDATA) {
+    err_sys("message length %d out of range", mesg_ptr->mesg_len);
+  }
 
   /*
    * Write the message header and the optional data.
-   * First calculate the length of the length field, plus the type field, plus the optional data.
+   * The length is that of the header, plus the optional data.
   */
-  n = MESGHDRSIZE + mesg_ptr->mesg_len;
+  iov[0].iov_base = (char *) hdr;
+  iov[0].iov_len  = mesg_enchdr(hdr, (unsigned long) mesg_ptr->mesg_type, mesg_ptr->mesg_len);
+  iov[1].iov_base = mesg_ptr->mesg_data;
+  iov[1].iov_len  = mesg_ptr->mesg_len;
+  n = iov[0].iov_len + iov[1].iov_len;
 
-  if (write(fd, (char *) mesg_ptr, n) != n) {
+  if (writev(fd, iov, 2) != n) {
     err_sys("message write error");
   }
 }
 
+void mesgout_init (mo, fd, delay)
+MesgOut *mo;
+int     fd;
+int     delay; {
+  mo->fd      = fd;
+  mo->delay   = delay;
+  mo->max     = MESGMAXDEFAULT;
+  mo->since   = 0;
+  mo->count   = 0;
+  mo->nbytes  = 0;
+  mo->niov    = 0;
+  mo->used    = 0;
+}
+
+/*
+ * The time now, in milliseconds.
+*/
+static long now_ms () {
+  struct timeval tv;
+
+  gettimeofday(&tv, (void *) 0);
+  return tv.tv_sec * 1000L + tv.tv_usec / 1000;
+}
+
+/*
+ * Functionality: Add `len` bytes at `base` to the iovec. If they follow on from the last entry (the messages that are
+ *                copied lie one after the other in buff), that entry just gets longer.
+*/
+static void mesgout_add (mo, base, len)
+MesgOut       *mo;
+char          *base;
+unsigned long len; {
+  int last = mo->niov - 1;
+
+  if (last >= 0 && (char *) mo->iov[last].iov_base + mo->iov[last].iov_len == base) {
+    mo->iov[last].iov_len += len;
+  } else {
+    mo->iov[mo->niov].iov_base  = base;
+    mo->iov[mo->niov].iov_len   = len;
+    mo->niov++;
+  }
+}
+
+/*
+ * Functionality: Queue a message. Its header goes into buff, and so does the data if `copy` says so, otherwise the
+ *                iovec points at it. Then the queue is sent if it's full (messages or bytes), or if the oldest message
+ *                has waited long enough. Because the queue is sent once it holds MESGOUTBYTES bytes, and no more than
+ *                MESGHDRMAX + MAXMESGDATA is ever copied into buff at once, there's always room in buff for one more.
+*/
+static void mesgout_queue (mo, type, data, len, copy)
+MesgOut       *mo;
+unsigned long type;
+char          *data;
+unsigned long len;
+int           copy; {
+  int h;
+
+  if (len > mo->max) {
+    err_sys("message of %lu bytes, the other end takes %lu", len, mo->max);
+  }
+  if (mo->count++ == 0 && mo->delay > 0) {
+    mo->since = now_ms();
+  }
+
+  h = mesg_enchdr((unsigned char *) mo->buff + mo->used, type, len);
+  if (copy) {
+    memcpy(mo->buff + mo->used + h, data, len);
+    mesgout_add(mo, mo->buff + mo->used, h + len);
+    mo->used += h + len;
+  } else {
+    mesgout_add(mo, mo->buff + mo->used, h);
+    mesgout_add(mo, data, len);
+    mo->used += h;
+  }
+  mo->nbytes += h + len;
+
+  if (mo->count >= MESGOUTCOUNT || mo->nbytes >= MESGOUTBYTES ||
+      (mo->delay > 0 && now_ms() - mo->since >= mo->delay)) {
+    mesgout_flush(mo);
+  }
+}
+
+void mesgout_put (mo, mesg_ptr)
+MesgOut *mo;
+Mesg    *mesg_ptr; {
+  if (mesg_ptr->mesg_len < 0 || mesg_ptr->mesg_len > MAXMESGDATA) {
+    err_sys("message length %d out of range", mesg_ptr->mesg_len);
+  }
+  mesgout_queue(mo, (unsigned long) mesg_ptr->mesg_type, mesg_ptr->mesg_data, mesg_ptr->mesg_len, 1);
+}
+
+void mesgout_ref (mo, mesg_ptr)
+MesgOut *mo;
+Mesg    *mesg_ptr; {
+  if (mesg_ptr->mesg_len < 0 || mesg_ptr->mesg_len > MAXMESGDATA) {
+    err_sys("message length %d out of range", mesg_ptr->mesg_len);
+  }
+  mesgout_data(mo, (unsigned long) mesg_ptr->mesg_type, mesg_ptr->mesg_data, mesg_ptr->mesg_len);
+}
+
+void mesgout_data (mo, type, data, len)
+MesgOut       *mo;
+unsigned long type;
+char          *data;
+unsigned long len; {
+  mesgout_queue(mo, type, data, len, len < MESGREFMIN);
+}
+
+/*
+ * Functionality: writev() the iovec, as often as it takes. A write to a pipe or socket can be short (a signal, or
+ *                the other end reading slowly): the entries that went out are skipped and the one that went out
+ *                in part is moved on by what was written.
+*/
+void mesgout_flush (mo)
+MesgOut *mo; {
+  struct iovec  *iov  = mo->iov;
+  int           niov  = mo->niov;
+  ssize_t       n;
+
+  while (niov > 0) {
+    if ( (n = writev(mo->fd, iov, niov)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      err_sys("message write error");
+    }
+    for ( ; niov > 0 && (size_t) n >= iov->iov_len; iov++, niov--) {
+      n -= iov->iov_len;
+    }
+    if (niov > 0) {
+      iov->iov_base = (char *) iov->iov_base + n;
+      iov->iov_len  -= n;
+    }
+  }
+
+  mo->count   = 0;
+  mo->nbytes  = 0;
+  mo->niov    = 0;
+  mo->used    = 0;
+}
+
+int mesgout_timeout (mo)
+MesgOut *mo; {
+  long left;
+
+  if (mo->delay <= 0 || mo->count == 0) {
+    return (-1);
+  }
+  left = mo->since + mo->delay - now_ms();
+
+  return (left > 0) ? (int) left : 0;
+}
+
+void mesgbuf_init (mb, fd)
+MesgBuf *mb;
+int     fd; {
+  if ( (mb->buff = malloc(MESGBUFSIZE)) == NULL) {
+    err_sys("mesgbuf_init: can't allocate buffer");
+  }
+  mb->fd    = fd;
+  mb->max   = MESGMAXDEFAULT;
+  mb->size  = MESGBUFSIZE;
+  mb->start = 0;
+  mb->end   = 0;
+  mb->need  = 0;
+  mb->eof   = 0;
+}
+
+void mesgbuf_free (mb)
+MesgBuf *mb; {
+  free(mb->buff);
+  mb->buff = NULL;
+  mb->size = 0;
+}
+
+/*
+ * Functionality: The bytes not taken out yet (at most part of one message, if the caller took out all it could) are
+ *                moved to the front, so the read() gets the rest of the buffer. If the message we have part of is
+ *                longer than the buffer (mesgbuf_get said how long in `need`), the buffer grows to fit it. A buffer
+ *                that grew goes back to MESGBUFSIZE when it's empty. A read() interrupted by a signal is done again.
+*/
+int mesgbuf_fill (mb)
+MesgBuf *mb; {
+  char  *p;
+  long  size = mb->size;
+  int   n;
+
+  if (mb->start > 0) {
+    memmove(mb->buff, mb->buff + mb->start, mb->end - mb->start);
+    mb->end   -= mb->start;
+    mb->start = 0;
+  }
+  if (mb->need > size) {
+    size = mb->need;
+  } else if (mb->end == 0 && size > MESGBUFSIZE) {
+    size = MESGBUFSIZE;
+  }
+  if (size != mb->size) {
+    if ( (p = realloc(mb->buff, size)) == NULL) {
+      errno = ENOMEM;
+      return (-1);
+    }
+    mb->buff = p;
+    mb->size = size;
+  }
+  if (mb->end == mb->size) {
+    errno = ENOBUFS;          /* full of messages nobody took out */
+    return (-1);
+  }
+
+  while ( (n = read(mb->fd, mb->buff + mb->end, mb->size - mb->end)) < 0 && errno == EINTR) {
+    ;
+  }
+  if (n > 0) {
+    mb->end += n;
+  } else if (n == 0) {
+    mb->eof = 1;
+  }
+
+  return (n);
+}
+
 /*
- * Functionality: The function is called to read the pipe to check for bytes of size 
- *                MESGHDRSIZE (16 in our case). It is stored in the pointer to the 
- *                structure mesg_ptr parameter. If the data is actual header of the 
- *                message envelope, the size of the message is read from the structure
- *                and the respective size is read from the file descriptor (pipe in our
- *                case).
+ * Functionality: The header says how many bytes of data follow. A header that isn't one, or one that says more than
+ *                `max`, can't have come from a peer that keeps to what was agreed: the stream is out of step and
+ *                there's no finding the next header.
+*/
+int mesgbuf_get (mb, type, data, len)
+MesgBuf       *mb;
+unsigned long *type;
+char          **data;
+unsigned long *len; {
+  long          have = mb->end - mb->start;
+  int           h;
+  unsigned long t, n;
+
+  if ( (h = mesg_dechdr((unsigned char *) mb->buff + mb->start, have, &t, &n)) < 0) {
+    errno = EBADMSG;
+    return (MESG_ERROR);
+  }
+  if (h == 0) {
+    return (MESG_AGAIN);
+  }
+  if (n > mb->max) {
+    errno = EMSGSIZE;
+    return (MESG_ERROR);
+  }
+  if (have < (long) (h + n)) {
+    mb->need = h + n;
+    return (MESG_AGAIN);
+  }
+
+  *type     = t;
+  *data     = mb->buff + mb->start + h;
+  *len      = n;
+  mb->start += h + n;
+  mb->need  = 0;
+
+  return (MESG_OK);
+}
+
+int mesgbuf_recv (mb, type, data, len)
+MesgBuf       *mb;
+unsigned long *type;
+char          **data;
+unsigned long *len; {
+  int r;
+
+  for (;;) {
+    if ( (r = mesgbuf_get(mb, type, data, len)) != MESG_AGAIN) {
+      return (r);
+    }
+    if (mb->eof) {
+      if (mb->end > mb->start) {
+        errno = EBADMSG;      /* the writer stopped half way through a message */
+        return (MESG_ERROR);
+      }
+      return (MESG_EOF);
+    }
+    if (mesgbuf_fill(mb) < 0) {
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? MESG_AGAIN : MESG_ERROR;
+    }
+  }
+}
+
+int mesgbuf_read (mb, mesg_ptr)
+MesgBuf *mb;
+Mesg    *mesg_ptr; {
+  unsigned long type, len;
+  char          *data;
+  int           r;
+
+  if ( (r = mesgbuf_recv(mb, &type, &data, &len)) != MESG_OK) {
+    return (r);
+  }
+  if (len > MAXMESGDATA) {
+    errno = EMSGSIZE;
+    return (MESG_ERROR);
+  }
+  mesg_ptr->mesg_type = type;
+  mesg_ptr->mesg_len  = len;
+  memcpy(mesg_ptr->mesg_data, data, len);
+
+  return (MESG_OK);
+}
+
+/*
+ * Functionality: The hello is our `max` as 4 bytes, little-endian, like the type in a header. It's sent (and the
+ *                queue flushed) before we wait for the other end's, so two ends calling this at once don't wait for
+ *                each other.
+*/
+long mesg_agree (in, out, max)
+MesgBuf       *in;
+MesgOut       *out;
+unsigned long max; {
+  unsigned char hello[4], *p;
+  unsigned long type, len, theirs;
+  char          *data;
+
+  if (max > 0xffffffffUL) {
+    max = 0xffffffffUL;
+  }
+  hello[0] = max & 0xff;
+  hello[1] = (max >> 8) & 0xff;
+  hello[2] = (max >> 16) & 0xff;
+  hello[3] = (max >> 24) & 0xff;
+  mesgout_data(out, MESG_HELLO, (char *) hello, sizeof(hello));
+  mesgout_flush(out);
+
+  if (mesgbuf_recv(in, &type, &data, &len) != MESG_OK || type != MESG_HELLO || len != sizeof(hello)) {
+    return (-1);
+  }
+  p = (unsigned char *) data;
+  theirs = p[0] | (p[1] << 8) | ((unsigned long) p[2] << 16) | ((unsigned long) p[3] << 24);
+
+  in->max   = max;
+  out->max  = theirs;
+
+  return (long) ((max < theirs) ? max : theirs);
+}
+
+/*
+ * Functionality: The message is taken out of the MesgBuf kept for the file descriptor, which is allocated (and
+ *                initialized) on the first call for it. Several small messages come in with one read(), and a read()
+ *                that returns part of a message is no longer an error: the rest is read on the next call.
  *
- *                NOTE: The function might be called with a valid envelope that contains 
- *                the mesg_len field as zero (0). Such envelope is send by the process 
+ *                NOTE: The function might be called with a valid envelope that contains
+ *                the mesg_len field as zero (0). Such envelope is send by the process
  *                which indicates the envelope content is fulfilled.
+ *
+ *                NOTE: The buffer is freed at end of file. If the descriptor is closed before that and opened
+ *                again for something else, what was left in the buffer would be read first, so read to the end
+ *                (or use a MesgBuf of your own).
 */
 int mesg_recv (fd, mesg_ptr)
 int   fd;
 Mesg  *mesg_ptr; {
-  int n;
+  static MesgBuf  *mbuf[MAXFD];
+  int             r;
+
+  if (fd < 0 || fd >= MAXFD) {
+    err_sys("mesg_recv: descriptor %d out of range", fd);
+  }
+  if (mbuf[fd] == NULL) {
+    if ( (mbuf[fd] = (MesgBuf *) malloc(sizeof(MesgBuf))) == NULL) {
+      err_sys("mesg_recv: can't allocate buffer");
+    }
+    mesgbuf_init(mbuf[fd], fd);
+  }
 
   /*
-   * Read the message header first. This tells us how much data follows the message for the next read.
    * An end-of-file on the file descriptor causes us to return 0.
    * Hence, we force the assumption on the caller that a 0-length message means EOF.
   */
-  if ( (n = read(fd, (char *) mesg_ptr, MESGHDRSIZE)) == 0) {
+  if ( (r = mesgbuf_read(mbuf[fd], mesg_ptr)) == MESG_EOF) {
+    mesgbuf_free(mbuf[fd]);
+    free(mbuf[fd]);
+    mbuf[fd] = NULL;
     return (0);       /* end of file */
-  } else if (n != MESGHDRSIZE) {
-    err_sys("message header read error");
-  }
-
-  /*
-   * Read the actual data, if there is any.
-  */
-  if ( (n = mesg_ptr->mesg_len) > 0) {
-    if (read(fd, mesg_ptr->mesg_data, n) != n) {
-      err_sys("data read error");
-    }
+  } else if (r != MESG_OK) {
+    err_sys("message read error");
   }
 
-  return (n);
+  return (mesg_ptr->mesg_len);
 }
@@ -7,9 +7,12 @@
  * You may have to change the 4096 to a smaller value, if message queues on your system were configured with "msgmax" less than 4096
 */
 
+#include <sys/types.h>
+#include <sys/uio.h>        /* for struct iovec */
+
 #define   MAXMESGDATA   (4096 - 16)                   /* We don't want sizeof(Mesg) > 4096 */
 
-#define   MESGHDRSIZE   (sizeof(Mesg) - MAXMESGDATA)  /* length of mesg_len and mesg_type */
+#define   MESGHDRSIZE   (sizeof(Mesg) - MAXMESGDATA)  /* length of mesg_len and mesg_type, in memory */
 
 /*
  * NOTE:  Using the sizeof on Mesg type yields 4096 rather than 4092.
@@ -25,16 +28,221 @@ typedef struct {
   char  mesg_data[MAXMESGDATA];   /* Actual data */
 } Mesg;
 
+/*
+ * What goes through the descriptor.
+ *
+ * The Mesg itself used to be written, header and all: an int and a long as they are in memory, with the hole between
+ * them. Their size and byte order depend on the machine (a 32-bit peer has a 4-byte long, and a 12-byte header), and
+ * every message could carry at most MAXMESGDATA bytes. Now each message is a header of its own, followed by the data:
+ *
+ *        byte 0        MESG_VERSION
+ *        bytes 1-4     the type, 32 bits, little-endian (least significant byte first)
+ *        bytes 5-      the length of the data, a varint: 7 bits per byte, the least significant first, the top bit
+ *                      set in every byte but the last. 1 byte up to 127, 2 up to 16383, ... 5 at most.
+ *
+ * 6 to MESGHDRMAX bytes of header, whatever the machine. The same bytes work through a pipe, a FIFO, a socket or a
+ * buffer in shared memory (mesg_enchdr and mesg_dechdr). A message can be as long as the receiver takes: each end
+ * has a maximum (MESGMAXDEFAULT unless told otherwise), and mesg_agree lets the two ends settle on the smaller one.
+ * Messages of type MESG_HELLO (0) are the ones mesg_agree sends, a Mesg has a type > 0.
+ *
+ * The Mesg is still there for the callers that have one (mesg_send, mesg_recv, mesgout_put, mesgbuf_read), but only
+ * mesg_len bytes of its data go out, and only messages of up to MAXMESGDATA bytes fit in one.
+*/
+
+#define   MESG_VERSION    1
+#define   MESG_HELLO      0L                          /* type of the message mesg_agree sends */
+#define   MESGHDRMAX      10                          /* version, type, and a 5 byte varint */
+#define   MESGMAXDEFAULT  (1024L * 1024L)             /* the longest message taken, until mesg_agree says */
+
+/*
+ * mesg_enchdr: Write the header for a message of type `type` with `len` bytes of data to `hdr` (MESGHDRMAX bytes).
+ *              Returns its length.
+*/
+int mesg_enchdr (unsigned char *hdr, unsigned long type, unsigned long len);
+
+/*
+ * mesg_dechdr: Read a header out of the `have` bytes at `hdr`. Returns its length, 0 if the `have` bytes are only
+ *              the start of one, or -1 if it isn't a header (wrong version, or a varint too long).
+*/
+int mesg_dechdr (const unsigned char *hdr, int have, unsigned long *type, unsigned long *len);
+
 /*
  * mesg_send: Send a message by writing on a file descriptor.
  *            The mesg_len, mesg_type, and mesg_data fields must be filled in by the caller.
+ *            One write() per message, it goes out at once. For a stream of them, see MesgOut below.
 */
 void mesg_send (int fd, Mesg *mesg_ptr);
 
 /*
  * mesg_recv: Receive a message by reading on a file descriptor.
  *            Fill in the mesg_len, mesg_type and mesg_data fields, and return mesg_len as the return value also.
+ *            The bytes are read through a MesgBuf (below) kept for `fd`, so several messages come with one read().
 */
 int mesg_recv (int fd, Mesg *mesg_ptr);
 
+/*
+ * Buffered reading of messages.
+ *
+ * Reading the header and then the data costs two read()s per message, however small, and a read() on a pipe or a
+ * socket can return fewer bytes than asked for, without anything being wrong. A MesgBuf reads as much as there is,
+ * up to the size of its buffer, and takes the messages out of it one after the other. A message that came only in
+ * part (even half a header) stays in the buffer until the rest of it is read.
+ *
+ * The buffer is MESGBUFSIZE bytes to begin with. A message longer than that (up to `max`) makes it grow, and once it
+ * is empty again it goes back to MESGBUFSIZE.
+ *
+ * The routines available:
+ *    1.  mesgbuf_init(mb, fd);                     // start reading messages from `fd`
+ *    2.  n = mesgbuf_fill(mb);                     // one read() into the buffer
+ *    3.  r = mesgbuf_get(mb, &type, &data, &len);  // the next message in the buffer, if it's all there. No read().
+ *    4.  r = mesgbuf_recv(mb, &type, &data, &len); // the next message, reading as needed
+ *    5.  r = mesgbuf_read(mb, mesg);               // the same, copied into a Mesg
+ *    6.  mesgbuf_free(mb);                         // give back the buffer
+ *
+ * mesgbuf_get and mesgbuf_recv don't copy, `data` points into the buffer, until the next call.
+ *
+ * For an event loop the descriptor is made O_NONBLOCK, and whenever poll() (or select()) says it's readable:
+ *
+ *        while ( (r = mesgbuf_recv(&mb, &type, &data, &len)) == MESG_OK) {
+ *          ... message ...
+ *        }
+ *        if (r == MESG_AGAIN) ... back to poll(). MESG_EOF: the other end is done. MESG_ERROR: errno says why.
+*/
+
+#define   MESGBUFSIZE   (64 * 1024)
+
+#define   MESG_OK       1                             /* there's a message */
+#define   MESG_EOF      0                             /* end of file, between two messages */
+#define   MESG_ERROR    (-1)                          /* read error, or a broken message (EBADMSG, EMSGSIZE) */
+#define   MESG_AGAIN    (-2)                          /* no whole message yet, and the read() would block */
+
+typedef struct {
+  int           fd;
+  unsigned long max;              /* longest message we take, MESGMAXDEFAULT or what mesg_agree says */
+  char          *buff;
+  long          size;             /* of buff */
+  long          start;            /* first byte not taken out yet */
+  long          end;              /* one past the last byte read */
+  long          need;             /* bytes the message at start takes, header included, if they're not all there */
+  int           eof;              /* read() returned 0 */
+} MesgBuf;
+
+/*
+ * mesgbuf_init:  Empty buffer for `fd`.
+*/
+void mesgbuf_init (MesgBuf *mb, int fd);
+
+/*
+ * mesgbuf_free:  Free the buffer. The MesgBuf can be used again after another mesgbuf_init.
+*/
+void mesgbuf_free (MesgBuf *mb);
+
+/*
+ * mesgbuf_fill:  One read() of whatever fits in the buffer (the part of a message left at the end is moved to the
+ *                front first, and the buffer made bigger if the message needs it). Returns what read() returned: the
+ *                number of bytes, 0 at end of file, -1 on an error (EAGAIN if the descriptor is O_NONBLOCK and
+ *                there's nothing to read).
+*/
+int mesgbuf_fill (MesgBuf *mb);
+
+/*
+ * mesgbuf_get:   Take the next message out of the buffer. Returns MESG_OK, MESG_AGAIN if it isn't all in the buffer
+ *                yet, or MESG_ERROR if the header makes no sense (EBADMSG) or says more than `max` bytes (EMSGSIZE).
+*/
+int mesgbuf_get (MesgBuf *mb, unsigned long *type, char **data, unsigned long *len);
+
+/*
+ * mesgbuf_recv:  mesgbuf_get, calling mesgbuf_fill until there's a message. Returns MESG_OK, MESG_EOF, MESG_AGAIN
+ *                (O_NONBLOCK only) or MESG_ERROR. End of file in the middle of a message is a MESG_ERROR.
+*/
+int mesgbuf_recv (MesgBuf *mb, unsigned long *type, char **data, unsigned long *len);
+
+/*
+ * mesgbuf_read:  mesgbuf_recv into a Mesg. A message longer than MAXMESGDATA doesn't fit, it's a MESG_ERROR
+ *                (EMSGSIZE) and it's gone.
+*/
+int mesgbuf_read (MesgBuf *mb, Mesg *mesg_ptr);
+
+/*
+ * Batched writing of messages.
+ *
+ * mesg_send costs a write() per message. A MesgOut queues the messages instead and sends all of them with one
+ * writev() when there are MESGOUTCOUNT of them, or MESGOUTBYTES bytes, or the oldest has waited `delay`
+ * milliseconds, or the caller says so (mesgout_flush). The last message can sit in the queue until then, so whatever
+ * has to go out right away is sent with mesg_send, after a mesgout_flush if the same descriptor has a queue.
+ *
+ * The routines available:
+ *    1.  mesgout_init(mo, fd, delay);              // queue for `fd`, `delay` ms at most (0: only when full or flushed)
+ *    2.  mesgout_put(mo, mesg);                    // queue a copy of the message
+ *    3.  mesgout_ref(mo, mesg);                    // queue the message, the data itself is not copied
+ *    4.  mesgout_data(mo, type, data, len);        // the same, for `len` bytes at `data`, as long as `max` allows
+ *    5.  mesgout_flush(mo);                        // writev() everything queued
+ *    6.  ms = mesgout_timeout(mo);                 // how long until the oldest has to go, for poll()
+ *
+ * mesgout_ref and mesgout_data copy only the header (and data shorter than MESGREFMIN, which is cheaper to copy than
+ * to point at) and put a pointer to the data in the iovec, so the data must not change until it has been sent. It
+ * has been sent at the latest MESGOUTCOUNT messages later, or after mesgout_flush. Reading into a ring of MESGOUTCOUNT
+ * Mesgs, one after the other, is safe, and so is one buffer flushed before it's used again.
+ *
+ * The `delay` is looked at when a message is queued. A caller that may go quiet with messages in the queue gives
+ * mesgout_timeout to poll() and flushes when it runs out. Errors are fatal (err_sys), as in mesg_send, and the
+ * descriptor is expected to block.
+*/
+
+#define   MESGOUTCOUNT  16                            /* messages per writev() */
+#define   MESGOUTBYTES  (64 * 1024)                   /* bytes per writev() */
+#define   MESGREFMIN    512                           /* mesgout_ref copies data shorter than this */
+
+typedef struct {
+  int           fd;
+  int           delay;                                /* ms the oldest message may wait, 0 for no limit */
+  unsigned long max;                                  /* longest message the other end takes */
+  long          since;                                /* when the oldest was queued, ms */
+  int           count;                                /* messages queued */
+  long          nbytes;                               /* bytes queued */
+  int           niov;
+  int           used;                                 /* bytes of buff in use */
+  struct iovec  iov[2 * MESGOUTCOUNT];                /* at most a header and a reference per message */
+  char          buff[MESGOUTBYTES + MESGHDRMAX + MAXMESGDATA];  /* headers, and the messages that are copied */
+} MesgOut;
+
+/*
+ * mesgout_init:    Empty queue for `fd`.
+*/
+void mesgout_init (MesgOut *mo, int fd, int delay);
+
+/*
+ * mesgout_put:     Queue a copy of the message. The caller can use the Mesg again as soon as it returns.
+*/
+void mesgout_put (MesgOut *mo, Mesg *mesg_ptr);
+
+/*
+ * mesgout_ref:     Queue the message without copying its data (see above).
+*/
+void mesgout_ref (MesgOut *mo, Mesg *mesg_ptr);
+
+/*
+ * mesgout_data:    Queue a message of type `type` with the `len` bytes at `data`, without copying them (see above).
+*/
+void mesgout_data (MesgOut *mo, unsigned long type, char *data, unsigned long len);
+
+/*
+ * mesgout_flush:   Send everything in the queue, and empty it.
+*/
+void mesgout_flush (MesgOut *mo);
+
+/*
+ * mesgout_timeout: Milliseconds until the oldest message is due (0 if it is), or -1 if there's no `delay` or
+ *                  nothing queued. Given to poll() as the timeout; when it runs out, mesgout_flush.
+*/
+int mesgout_timeout (MesgOut *mo);
+
+/*
+ * mesg_agree:      Settle on the longest message with the other end. A MESG_HELLO message with `max` goes out on
+ *                  `out`, and the first message on `in` has to be the other end's. Both ends do the same, in any order.
+ *                  From then on `in` takes up to `max` bytes, and `out` sends no more than the other end's. Returns
+ *                  the smaller of the two, or -1 if the other end didn't say hello (or is gone).
+*/
+long mesg_agree (MesgBuf *in, MesgOut *out, unsigned long max);
+
 #endif
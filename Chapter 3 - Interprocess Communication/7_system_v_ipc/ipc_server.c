@@ -1,3 +1,7 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* S_IFMT and S_IFDIR with -ansi */
+#endif
+
 #include "msgq.h"
 #include "mesg.h"
 #include "err_routine.h"
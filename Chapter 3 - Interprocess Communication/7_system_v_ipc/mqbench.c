@@ -0,0 +1,216 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* mq_*, clock_gettime and getopt with -ansi */
+#endif
+
+#include "msgq.h"
+#include "err_routine.h"
+#include "pmesg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <mqueue.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/*
+ * The same two measurements, on a pair of System V queues and on a pair of POSIX ones:
+ *    ->  latency: a message goes to the child on the first queue and comes back on the second, `n / 10` times.
+ *        The time for one round trip.
+ *    ->  throughput: `n` messages go to the child, one after the other, and the child says when it has them all.
+ *        Messages and bytes per second.
+ *
+ * A queue is used the way mesg.c and pmesg.c use it: the type (a long) and then the data, in one call.
+*/
+
+#define   BENCH_COUNT   100000
+#define   BENCH_MAXSIZES 16
+
+typedef struct {
+  const char  *name;
+  int         (*open)   (int which);                  /* 1 or 2, called before the fork */
+  void        (*send)   (int q, long *buff, int len);
+  int         (*recv)   (int q, long *buff);          /* returns the length of the data */
+  void        (*remove) (int q, int which);           /* after the child is gone */
+} Backend;
+
+int sysv_open (int which) {
+  (void) which;
+  return msgget(IPC_PRIVATE, PERMS | IPC_CREAT);
+}
+
+void sysv_send (int q, long *buff, int len) {
+  if (msgsnd(q, (char *) buff, len, 0) != 0) {
+    err_sys("msgsnd error");
+  }
+}
+
+int sysv_recv (int q, long *buff) {
+  int n;
+
+  if ( (n = msgrcv(q, (char *) buff, MAXMESGDATA, 0L, 0)) < 0) {
+    err_sys("msgrcv error");
+  }
+  return n;
+}
+
+void sysv_remove (int q, int which) {
+  (void) which;
+  msgctl(q, IPC_RMID, (struct msqid_ds *) 0);
+}
+
+void posix_name (char *name, int which) {
+  sprintf(name, "/unp.mqbench.%ld.%d", (long) getpid(), which);
+}
+
+int posix_open (int which) {
+  char name[64];
+
+  posix_name(name, which);
+  return pmesg_open(name, O_RDWR | O_CREAT | O_EXCL);
+}
+
+void posix_send (int q, long *buff, int len) {
+  if (mq_send((mqd_t) q, (char *) buff, sizeof(long) + len, PMESG_PRIO(*buff)) != 0) {
+    err_sys("mq_send error");
+  }
+}
+
+int posix_recv (int q, long *buff) {
+  long n;
+
+  if ( (n = mq_receive((mqd_t) q, (char *) buff, PMESG_MSGSIZE, (unsigned int *) 0)) < 0) {
+    err_sys("mq_receive error");
+  }
+  return n - sizeof(long);
+}
+
+void posix_remove (int q, int which) {
+  char name[64];
+
+  mq_close((mqd_t) q);
+  posix_name(name, which);
+  mq_unlink(name);
+}
+
+Backend backends[] = {
+  { "sysv",   sysv_open,  sysv_send,  sysv_recv,  sysv_remove },
+  { "posix",  posix_open, posix_send, posix_recv, posix_remove }
+};
+
+double now_sec (void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Functionality: One backend, one message size.
+ *    ->  The child echoes `rtts` messages from q1 back on q2, then takes `n` messages from q1 and sends one back
+ *        when it has them all.
+ *    ->  The parent times both. The type is 1, so on the POSIX queues every message has the same priority.
+*/
+void bench (Backend *b, int size, long n) {
+  long    *buff, i, rtts = (n / 10 > 0) ? n / 10 : 1;
+  int     q1, q2;
+  pid_t   pid;
+  double  t0, rtt, secs;
+
+  if ( (buff = (long *) malloc(PMESG_MSGSIZE)) == NULL) {
+    err_sys("mqbench: can't allocate buffer");
+  }
+  memset(buff, 'x', PMESG_MSGSIZE);
+  buff[0] = 1L;
+
+  if ( (q1 = b->open(1)) < 0 || (q2 = b->open(2)) < 0) {
+    err_sys("mqbench: can't create the %s queues", b->name);
+  }
+
+  if ( (pid = fork()) < 0) {
+    err_sys("mqbench: can't fork");
+  } else if (pid == 0) {
+    for (i = 0; i < rtts; i++) {
+      b->send(q2, buff, b->recv(q1, buff));
+    }
+    for (i = 0; i < n; i++) {
+      b->recv(q1, buff);
+    }
+    b->send(q2, buff, 0);
+    exit(EXIT_SUCCESS);
+  }
+
+  t0 = now_sec();
+  for (i = 0; i < rtts; i++) {
+    b->send(q1, buff, size);
+    b->recv(q2, buff);
+  }
+  rtt = (now_sec() - t0) / rtts;
+
+  t0 = now_sec();
+  for (i = 0; i < n; i++) {
+    b->send(q1, buff, size);
+  }
+  b->recv(q2, buff);
+  secs = now_sec() - t0;
+
+  waitpid(pid, (int *) 0, 0);
+  b->remove(q1, 1);
+  b->remove(q2, 2);
+  free(buff);
+
+  printf("%-8s %8d %12.2f %14.0f %10.2f\n", b->name, size, rtt * 1e6, n / secs, n * (double) size / secs / 1e6);
+}
+
+/*
+ * Functionality:
+ *    ->  Every size (-s, as many as wanted, 64 and MAXMESGDATA if none) on both backends, or on the one given
+ *        with -b.
+ *    ->  The queues are as the programs here have them: System V ones as the system makes them (msgmnb bytes,
+ *        16 KB unless changed), POSIX ones PMESG_MAXMSG messages. How many fit in the queue decides how often the
+ *        sender has to wait for the receiver.
+ *
+ *        ./mqbench [-n messages] [-s size]... [-b sysv|posix]
+*/
+int main (int argc, char **argv) {
+  int   c, i, j, sizes[BENCH_MAXSIZES], nsizes = 0;
+  long  n = BENCH_COUNT;
+  char  *only = NULL;
+
+  while ( (c = getopt(argc, argv, "n:s:b:")) != -1) {
+    switch (c) {
+      case 'n': n = atol(optarg); break;
+      case 's':
+        if (nsizes == BENCH_MAXSIZES || (sizes[nsizes] = atoi(optarg)) < 0 || sizes[nsizes] > MAXMESGDATA) {
+          err_sys("mqbench: up to %d sizes, each 0 to %d bytes", BENCH_MAXSIZES, MAXMESGDATA);
+        }
+        nsizes++;
+        break;
+      case 'b': only = optarg; break;
+      default:
+        err_sys("usage: %s [-n messages] [-s size]... [-b sysv|posix]", argv[0]);
+    }
+  }
+  if (n < 1) {
+    err_sys("mqbench: -n must be at least 1");
+  }
+  if (nsizes == 0) {
+    sizes[nsizes++] = 64;
+    sizes[nsizes++] = MAXMESGDATA;
+  }
+
+  printf("%-8s %8s %12s %14s %10s\n", "backend", "size", "rtt_us", "msgs_per_s", "mb_per_s");
+  fflush(stdout);
+  for (i = 0; i < nsizes; i++) {
+    for (j = 0; j < (int) (sizeof(backends) / sizeof(backends[0])); j++) {
+      if (only == NULL || strcmp(only, backends[j].name) == 0) {
+        bench(&backends[j], sizes[i], n);
+        fflush(stdout);
+      }
+    }
+  }
+
+  exit(EXIT_SUCCESS);
+}
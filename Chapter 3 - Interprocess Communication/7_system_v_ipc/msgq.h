@@ -33,6 +33,15 @@ extern int errno;
 #define   MKEY1   1234L
 #define   MKEY2   2345L
 
+/*
+ * The names of the POSIX message queues (pmesg.h) that take the place of MKEY1 and MKEY2 in pclient and pserver.
+ * PMQ1 takes the requests of every client. Each client gets its replies on a queue of its own, PMQ2 with its pid in
+ * it, which it creates before it asks and removes when it's done.
+ * On Linux they show up in /dev/mqueue, if it's mounted.
+*/
+#define   PMQ1    "/unp.mq.1"
+#define   PMQ2    "/unp.mq.2.%ld"
+
 #define   PERMS   0666
 
 #endif
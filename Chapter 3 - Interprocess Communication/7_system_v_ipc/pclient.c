@@ -0,0 +1,73 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* mq_* with -ansi */
+#endif
+
+#include "msgq.h"
+#include "err_routine.h"
+#include "pmesg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <mqueue.h>
+#include <unistd.h>
+
+static Mesg mesg;
+
+/*
+ * Functionality: client.c over POSIX message queues (pmesg.c).
+ *    ->  Create our own queue for the replies, PMQ2 with our pid, and open PMQ1 to write the request to. The server
+ *        must have already created PMQ1. A queue of ours left over (the same pid, an earlier client killed before it
+ *        could remove it) is removed first, so whatever is on it isn't taken for our file.
+ *    ->  Read the filename from the standard input, and send "pid filename" as one message. The pid tells the
+ *        server where the file goes: PMQ1 is shared by every client, PMQ2 isn't.
+ *    ->  Write what comes on our queue to the standard output, until the empty message.
+ *    ->  Remove our queue. PMQ1 stays: the server keeps it for the next client, and removes it when it's stopped.
+ *
+ * It's client() (ipc_client.c) with the pid in the request, which a System V client doesn't need: there the reply's
+ * mesg_type picks it out of the one queue.
+*/
+int main (void) {
+
+  char  name[64], filename[MAXMESGDATA - 32];
+  int   readid, writeid, n;
+  long  pid = (long) getpid();
+
+  sprintf(name, PMQ2, pid);
+  mq_unlink(name);
+  if ( (readid = pmesg_open(name, O_RDONLY | O_CREAT | O_EXCL)) < 0) {
+    err_sys("client: can't create message queue %s", name);
+  }
+  if ( (writeid = pmesg_open(PMQ1, O_WRONLY)) < 0) {
+    mq_unlink(name);
+    err_sys("client: can't open message queue %s, is the server running?", PMQ1);
+  }
+
+  if (fgets(filename, sizeof(filename), stdin) == NULL) {
+    mq_unlink(name);
+    err_sys("client: filename read error");
+  }
+  n = strlen(filename);
+  if (n > 0 && filename[n-1] == '\n') {
+    n--;      /* ignore newline from fgets() */
+  }
+  filename[n] = '\0';
+
+  mesg.mesg_len   = sprintf(mesg.mesg_data, "%ld %s", pid, filename);
+  mesg.mesg_type  = 1L;
+  mesg_send(writeid, &mesg);
+
+  while ( (n = mesg_recv(readid, &mesg)) > 0) {
+    if (write(1, mesg.mesg_data, n) != n) {
+      mq_unlink(name);
+      err_sys("client: data write error");
+    }
+  }
+
+  mq_close((mqd_t) readid);
+  mq_close((mqd_t) writeid);
+  mq_unlink(name);
+
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,130 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* mq_*, clock_gettime and struct sigevent with -ansi */
+#endif
+
+#include "pmesg.h"
+#include "err_routine.h"
+#include "msgq.h"
+
+#include <fcntl.h>
+#include <mqueue.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+int pmesg_open (name, oflag)
+const char  *name;
+int         oflag; {
+  struct mq_attr  attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.mq_maxmsg  = PMESG_MAXMSG;
+  attr.mq_msgsize = PMESG_MSGSIZE;
+
+  return (int) mq_open(name, oflag, PERMS, &attr);      /* the attributes only count with O_CREAT */
+}
+
+/*
+ * Send a message on a POSIX message queue.
+ * The mesg_len, mesg_type and mesg_data fields must be filled in by the caller.
+*/
+void mesg_send (id, mesg_ptr)
+int   id;
+Mesg  *mesg_ptr; {
+  /*
+   * Send the type followed by the optional data, from the same place msgsnd() sends it from (see mesg.c).
+   * The type is also the priority.
+  */
+  if (mesg_ptr->mesg_type <= 0) {
+    err_sys("mesg_send: the type must be > 0");
+  }
+  if (mq_send((mqd_t) id, (char *) &(mesg_ptr->mesg_type), sizeof(long) + mesg_ptr->mesg_len,
+              PMESG_PRIO(mesg_ptr->mesg_type)) != 0) {
+    err_sys("mq_send error");
+  }
+}
+
+/*
+ * Receive a message from a POSIX message queue.
+ * The message with the highest priority (the biggest mesg_type, up to PMESG_PRIOMAX) comes first, the oldest of
+ * them if there's more than one.
+ * Return the number of bytes in the data portion of the message.
+ * A 0-length data message implies end-of-file.
+*/
+int mesg_recv (id, mesg_ptr)
+int   id;
+Mesg  *mesg_ptr; {
+  long  n;
+
+  /*
+   * The buffer given to mq_receive() has to be at least mq_msgsize, which is PMESG_MSGSIZE: from mesg_type to the
+   * end of the Mesg.
+  */
+  while ( (n = mq_receive((mqd_t) id, (char *) &(mesg_ptr->mesg_type), PMESG_MSGSIZE, (unsigned int *) 0)) < 0 &&
+          errno == EINTR) {
+    ;
+  }
+  if (n < (long) sizeof(long)) {
+    err_dump("mq_receive error");
+  }
+
+  return (mesg_ptr->mesg_len = n - sizeof(long));       /* 0 at the end of file */
+}
+
+/*
+ * mq_timedreceive() with a time that has already gone by returns ETIMEDOUT at once if the queue is empty, whether or
+ * not it was opened O_NONBLOCK.
+*/
+int mesg_poll (id, mesg_ptr)
+int   id;
+Mesg  *mesg_ptr; {
+  struct timespec now;
+  long            n;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+  if ( (n = mq_timedreceive((mqd_t) id, (char *) &(mesg_ptr->mesg_type), PMESG_MSGSIZE, (unsigned int *) 0,
+                            &now)) < 0) {
+    if (errno != ETIMEDOUT && errno != EAGAIN && errno != EINTR) {
+      err_dump("mq_timedreceive error");
+    }
+    errno = EAGAIN;
+    return -1;
+  }
+
+  return (mesg_ptr->mesg_len = n - sizeof(long));
+}
+
+int mesg_timedsend (id, mesg_ptr, secs)
+int   id;
+Mesg  *mesg_ptr;
+int   secs; {
+  struct timespec until;
+
+  if (mesg_ptr->mesg_type <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  clock_gettime(CLOCK_REALTIME, &until);
+  until.tv_sec += secs;
+  while (mq_timedsend((mqd_t) id, (char *) &(mesg_ptr->mesg_type), sizeof(long) + mesg_ptr->mesg_len,
+                      PMESG_PRIO(mesg_ptr->mesg_type), &until) != 0) {
+    if (errno != EINTR) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+int pmesg_notify (id, signo)
+int id;
+int signo; {
+  struct sigevent sev;
+
+  memset(&sev, 0, sizeof(sev));
+  sev.sigev_notify  = SIGEV_SIGNAL;
+  sev.sigev_signo   = signo;
+
+  return mq_notify((mqd_t) id, &sev);
+}
@@ -0,0 +1,68 @@
+#ifndef PMESG_H
+#define PMESG_H
+
+#include "mesg.h"
+
+/*
+ * mesg_send and mesg_recv over POSIX message queues (mq_open(3)), instead of System V ones (mesg.c). A program is
+ * linked with one or the other: client() and server() don't know the difference.
+ *
+ * A System V queue is known by a number, and the only way to wait for it is msgrcv(). poll(), select() and epoll
+ * know nothing of it, so a process can't wait for a message and for a socket (or a pipe, or a signal) at the same
+ * time. On Linux the mqd_t a POSIX queue is opened as is a file descriptor: it goes into a poll() or epoll set with
+ * the rest, and is readable when there's a message on it. Elsewhere mq_notify() sends a signal when a message
+ * arrives on an empty queue (pmesg_notify).
+ *
+ * The differences that show:
+ *    ->  The queue is a name, PMQ1 and PMQ2 (msgq.h), and it stays until mq_unlink(), like a System V queue stays
+ *        until IPC_RMID.
+ *    ->  The mesg_type is sent with the data, so it comes out the other end as it went in, and it gives the
+ *        message its priority: PMESG_PRIO(type). mq_receive() takes the oldest message of the highest priority,
+ *        there's no asking for a type (the mesg_type the caller fills in for mesg_recv is not looked at). Messages
+ *        that must not be mixed up go on queues of their own.
+ *    ->  The queue holds PMESG_MAXMSG messages (/proc/sys/fs/mqueue/msg_max is 10 unless changed).
+ *
+ * The routines available (besides mesg_send and mesg_recv):
+ *    1.  id = pmesg_open(name, oflag);     // mq_open() with our attributes, O_CREAT to create
+ *    2.  n = mesg_poll(id, mesg);          // mesg_recv without waiting, -1 (EAGAIN) if the queue is empty
+ *    3.  mesg_timedsend(id, mesg, secs);   // mesg_send that gives up after `secs` on a full queue, 0 or -1
+ *    4.  pmesg_notify(id, signo);          // signal `signo` when a message arrives on the empty queue, once
+ *
+ * macOS has no POSIX message queues, this is for Linux (and the BSDs with mqd_t as a descriptor).
+*/
+
+#define   PMESG_MAXMSG    10                          /* messages on a queue */
+#define   PMESG_MSGSIZE   (sizeof(long) + MAXMESGDATA) /* mesg_type and the data, as msgsnd() sends them */
+#define   PMESG_PRIOMAX   31                          /* POSIX promises at least 32 priorities, 0 to 31 */
+#define   PMESG_SENDWAIT  1                           /* seconds pserver waits on a full queue before it looks around */
+
+/*
+ * A mesg_type of 1 to PMESG_PRIOMAX is its own priority, anything above it is PMESG_PRIOMAX.
+*/
+#define   PMESG_PRIO(type)  ((type) < PMESG_PRIOMAX ? (unsigned int) (type) : PMESG_PRIOMAX)
+
+/*
+ * pmesg_open:    Open (or with O_CREAT, create) the queue `name`, PMESG_MAXMSG messages of PMESG_MSGSIZE. Returns the
+ *                descriptor, or -1.
+*/
+int   pmesg_open    (const char *name, int oflag);
+
+/*
+ * mesg_poll:     Like mesg_recv, but if the queue is empty return -1 (errno EAGAIN) instead of waiting.
+*/
+int   mesg_poll     (int id, Mesg *mesg_ptr);
+
+/*
+ * mesg_timedsend: Like mesg_send, but if the queue stays full for `secs` seconds return -1 (errno ETIMEDOUT) instead
+ *                of waiting on. Nor does it give up the program on an error: -1 and errno. Returns 0 once it's sent.
+*/
+int   mesg_timedsend (int id, Mesg *mesg_ptr, int secs);
+
+/*
+ * pmesg_notify:  Have `signo` sent to us when a message arrives on the queue while it is empty. It's only once: it has
+ *                to be asked for again after the signal (before emptying the queue, or a message could slip by).
+ *                Returns 0, or -1 (EBUSY if another process asked first).
+*/
+int   pmesg_notify  (int id, int signo);
+
+#endif
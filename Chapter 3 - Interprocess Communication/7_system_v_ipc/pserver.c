@@ -0,0 +1,244 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* epoll, signalfd, sigaction and kill with -ansi */
+#endif
+
+#include "msgq.h"
+#include "err_routine.h"
+#include "pmesg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <mqueue.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#else
+volatile sig_atomic_t stop, arrived;
+
+void sig_catch (int signo) {
+  if (signo == SIGUSR1) {
+    arrived = 1;
+  } else {
+    stop = 1;
+  }
+}
+#endif
+
+static Mesg mesg;
+
+/*
+ * Is there a SIGINT or SIGTERM waiting for us? On Linux they're blocked the whole time (they go to sigfd), so they're
+ * pending. Elsewhere they're let in while a client is served, and sig_catch notes them.
+*/
+static int stopping (void) {
+#ifdef __linux__
+  sigset_t  pending;
+
+  sigpending(&pending);
+  return sigismember(&pending, SIGINT) || sigismember(&pending, SIGTERM);
+#else
+  return stop;
+#endif
+}
+
+/*
+ * Send a reply, PMESG_SENDWAIT seconds at a time. When a wait runs out (the client's queue is full, it isn't
+ * reading), give up if we've been told to stop, or if the client is gone. Otherwise wait some more: it's only slow.
+ * Returns 0, or -1 if the client is to be given up on.
+*/
+static int reply (id, mesg_ptr, pid)
+int   id;
+Mesg  *mesg_ptr;
+long  pid; {
+  while (mesg_timedsend(id, mesg_ptr, PMESG_SENDWAIT) < 0) {
+    if (errno != ETIMEDOUT) {
+      err_ret("server: can't send to client %ld", pid);
+      return -1;
+    }
+    if (stopping()) {
+      return -1;
+    }
+    if (kill((pid_t) pid, 0) < 0 && errno == ESRCH) {
+      err_ret("server: client %ld went away", pid);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Functionality: Serve one request, if there's one on PMQ1.
+ *    ->  The request is "pid filename". The reply goes on the client's own queue, PMQ2 with that pid, so no two
+ *        clients' replies meet on one queue, and nothing a client didn't read is there for the next one.
+ *    ->  As server() (ipc_server.c) does: the file, or the error message, then an empty message for the end.
+ *        A directory is an error message too, not the end of the server.
+ *    ->  Every send goes through reply(), so a client that stops reading can't keep us from a SIGINT or SIGTERM,
+ *        and one that died is dropped. Its queue is removed, it can't do that itself any more.
+*/
+static void serve (readid)
+int readid; {
+  char        name[64], filename[MAXMESGDATA], *sys_err_str();
+  int         n, filefd, writeid, off = -1, ok = 0;
+  long        pid;
+  struct stat st;
+
+  if ( (n = mesg_poll(readid, &mesg)) < 0) {
+    return;                                       /* somebody else's notification, nothing there */
+  }
+  mesg.mesg_data[n] = '\0';
+  if (sscanf(mesg.mesg_data, "%ld %n", &pid, &off) != 1 || off < 0 || pid <= 1) {
+    err_ret("server: bad request");
+    return;
+  }
+  strcpy(filename, mesg.mesg_data + off);
+
+  sprintf(name, PMQ2, pid);
+  if ( (writeid = pmesg_open(name, O_WRONLY)) < 0) {
+    err_ret("server: can't open message queue %s", name);
+    return;
+  }
+
+  mesg.mesg_type = 1L;
+  if ( (filefd = open(filename, O_RDONLY)) >= 0 && fstat(filefd, &st) == 0 && S_ISDIR(st.st_mode)) {
+    close(filefd);
+    filefd  = -1;
+    errno   = EISDIR;
+  }
+  if (filefd < 0) {
+    sprintf(mesg.mesg_data, "%.*s: can't open, %s\n", MAXMESGDATA - 256, filename, sys_err_str());
+    mesg.mesg_len = strlen(mesg.mesg_data);
+    ok = reply(writeid, &mesg, pid);
+  } else {
+    while ( (n = read(filefd, mesg.mesg_data, MAXMESGDATA)) > 0) {
+      mesg.mesg_len = n;
+      if ( (ok = reply(writeid, &mesg, pid)) < 0) {
+        break;
+      }
+    }
+    if (n < 0) {
+      err_ret("server: read error on %s", filename);
+    }
+    close(filefd);
+  }
+
+  if (ok == 0) {
+    mesg.mesg_len = 0;
+    reply(writeid, &mesg, pid);
+  }
+  mq_close((mqd_t) writeid);
+  if (kill((pid_t) pid, 0) < 0 && errno == ESRCH) {
+    mq_unlink(name);
+  }
+}
+
+/*
+ * Functionality: server.c over POSIX message queues (pmesg.c), serving one client after another until it's stopped.
+ *    ->  Create PMQ1 for the requests. The replies go on a queue each client makes for itself (serve).
+ *    ->  Wait until there's a request on PMQ1, or SIGINT or SIGTERM.
+ *
+ *        On Linux the queue is a file descriptor, and so are the signals, with signalfd(): both go into one epoll
+ *        set, and epoll_wait() returns when either is readable. A socket or a pipe would go in the same way; with
+ *        System V queues, msgrcv() is the only way to wait, and only for the queue.
+ *
+ *        Elsewhere mq_notify() (pmesg_notify) has SIGUSR1 sent when a request arrives, and we wait for a signal
+ *        with sigsuspend(). The notification is asked for again before each wait, and the queue is looked at
+ *        before we sleep, in case the request came in between.
+ *    ->  serve() takes the request (which is there, so it doesn't wait) and sends the file.
+ *    ->  When stopped, remove PMQ1. A signal that comes while a client is served ends that client's transfer at the
+ *        next full queue (reply), so we never hang in mq_send.
+ *
+ *        One client at a time, as with ./server. A client that dies holds up the next one for PMESG_SENDWAIT seconds
+ *        at most. One that's alive but doesn't read holds it up until it reads, or dies, or we're stopped.
+*/
+int main (void) {
+
+  int               readid;
+#ifdef __linux__
+  int               epfd, sigfd;
+  sigset_t          mask;
+  struct epoll_event ev;
+#else
+  sigset_t          mask, old;
+  struct sigaction  sa;
+  struct mq_attr    attr;
+#endif
+
+  if ( (readid = pmesg_open(PMQ1, O_RDONLY | O_CREAT)) < 0) {
+    err_sys("server: can't create message queue %s", PMQ1);
+  }
+
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+
+#ifdef __linux__
+  /*
+   * The signals are blocked, so they're only delivered through sigfd.
+  */
+  sigprocmask(SIG_BLOCK, &mask, (sigset_t *) 0);
+  if ( (sigfd = signalfd(-1, &mask, 0)) < 0 || (epfd = epoll_create(2)) < 0) {
+    err_sys("server: can't set up epoll");
+  }
+  memset(&ev, 0, sizeof(ev));
+  ev.events   = EPOLLIN;
+  ev.data.fd  = readid;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, readid, &ev) < 0) {
+    err_sys("server: can't add %s to the epoll set", PMQ1);
+  }
+  ev.data.fd  = sigfd;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, sigfd, &ev) < 0) {
+    err_sys("server: can't add the signals to the epoll set");
+  }
+
+  for (;;) {
+    if (epoll_wait(epfd, &ev, 1, -1) < 0) {
+      continue;           /* EINTR */
+    }
+    if (ev.data.fd == sigfd) {
+      break;
+    }
+    serve(readid);
+  }
+  close(epfd);
+  close(sigfd);
+#else
+  memset(&sa, 0, sizeof(sa));
+  sigemptyset(&sa.sa_mask);
+  sa.sa_handler = sig_catch;
+  sigaction(SIGINT, &sa, (struct sigaction *) 0);
+  sigaction(SIGTERM, &sa, (struct sigaction *) 0);
+  sigaction(SIGUSR1, &sa, (struct sigaction *) 0);
+  sigaddset(&mask, SIGUSR1);
+
+  sigprocmask(SIG_BLOCK, &mask, &old);
+  while (!stop) {
+    arrived = 0;
+    if (pmesg_notify(readid, SIGUSR1) < 0 && errno != EBUSY) {     /* EBUSY: still ours from last time */
+      err_sys("server: can't mq_notify");
+    }
+    if (mq_getattr((mqd_t) readid, &attr) == 0 && attr.mq_curmsgs == 0) {
+      while (!arrived && !stop) {
+        sigsuspend(&old);
+      }
+    }
+    if (!stop) {
+      sigprocmask(SIG_SETMASK, &old, (sigset_t *) 0);
+      serve(readid);
+      sigprocmask(SIG_BLOCK, &mask, (sigset_t *) 0);
+    }
+  }
+#endif
+
+  mq_close((mqd_t) readid);
+  mq_unlink(PMQ1);
+
+  exit(EXIT_SUCCESS);
+}
@@ -1,3 +1,7 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* getopt with -ansi */
+#endif
+
 #include "mesg.h"
 #include "msgq.h"
 #include "err_routine.h"
@@ -8,10 +12,22 @@
 #include <unistd.h>
 
 Mesg mesg;
+int  window = MPX_WINDOW;
 
-int main (void) {
+int main (int argc, char **argv) {
   
-  int id;
+  int id, c;
+
+  while ( (c = getopt(argc, argv, "w:")) != -1) {
+    switch (c) {
+      case 'w': window = atoi(optarg); break;
+      default:
+        err_sys("usage: %s [-w window]", argv[0]);
+    }
+  }
+  if (window < 1) {
+    err_sys("client: the window must be at least 1");
+  }
 
   /*
    * Open the single message queue. The server must have already created it.
@@ -28,35 +44,45 @@ int main (void) {
    * How this call works? 
    *  ->  The client function takes in one argument: the message queue id.
    *  ->  The function attempts to read from the standard input the name of the file whose content is to be viewed.
-   *  ->  When sending a message from the client to the server, the mesg_type member is set to 1L (long value of 1).
-   *  ->  mesg_send essentially is a wrapper to msgsnd system call, so the message is sent to the queue which 
-   *      has the type of 1L (so the server can read the message).
-   *  ->  NOTE: The functionality of the server is provided to the respective function definition, for now, we assume 
-   *      that the server call is successful, and the content is received.
-   *  ->  Notice that the mesg_type member is changed to 2L. This is because the server will send the content of the 
-   *      file to the messsage queue of type 2L. 
+   *  ->  When sending a message from the client to the server, the mesg_type member is set to MPX_SERVER (1L), so one
+   *      of the server's workers reads it. Along with the filename goes our pid and our window (see msgq.h).
+   *  ->  mesg_send essentially is a wrapper to msgsnd system call.
+   *  ->  Notice that the mesg_type member is then changed to our pid. This is what the server sends the content of
+   *      the file as, so the replies for other clients on the same queue are left alone.
    *  ->  mesg_recv also is a wrapper to the system call msgrcv. After receiving the file, an attempt is made to write 
    *      the respective content to the standard output.
+   *  ->  The server only sends `window` messages ahead of us. For every message we've written out we owe it one
+   *      credit. They're sent in batches of half the window, or all we owe before we have to wait for a message.
   */
   client(id);
 
   /*
-   * Now we can delete the message queue.
-  */
-  /*
-   * After the work has been completed, the IPC needs to be closed, which is done through msgctl. 
-   * The argument IPC_RMID signifies the closing of the IPC.
+   * No msgctl(IPC_RMID) anymore: the queue is the server's, other clients may be using it. The server removes it
+   * when it's stopped.
   */
-  if (msgctl(id, IPC_RMID, (struct msqid_ds *) 0) < 0) {
-    err_sys("client: can't RMID message queue 1");
-  }
 
   exit(EXIT_SUCCESS);
 }
 
+/*
+ * Let the server send `count` more messages.
+*/
+void send_credit (int msgqid, long pid, int count) {
+  Mesg  credit;
+
+  if (count > 0) {
+    sprintf(credit.mesg_data, "%d", count);
+    credit.mesg_len   = strlen(credit.mesg_data);
+    credit.mesg_type  = pid | MPX_CREDIT;
+    mesg_send(msgqid, &credit);
+  }
+}
+
 void client (msgqid)
 int msgqid; {
-  int n;
+  int   n, len, owed = 0, batch = (window + 1) / 2;
+  long  pid = getpid();
+  char  head[64];
 
   /*
    * Read the filename from standard input, write it as a message to the IPC descriptor.
@@ -82,18 +108,49 @@ int msgqid; {
     n--;                                  /* ignore the newline from fgets() */
   }
   mesg.mesg_data[n] = '\0';               /* overwrite newline (with null termination) at end */
-  mesg.mesg_len     = n;
-  mesg.mesg_type    = 1L;                 /* send message of this type */
+
+  /*
+   * Put "pid window " in front of the filename.
+  */
+  len = sprintf(head, "%ld %d ", pid, window);
+  if (n + len >= MAXMESGDATA) {
+    err_sys("client: filename too long");
+  }
+  memmove(mesg.mesg_data + len, mesg.mesg_data, n + 1);
+  memcpy(mesg.mesg_data, head, len);
+  mesg.mesg_len     = n + len;
+  mesg.mesg_type    = MPX_SERVER;         /* send message of this type */
   mesg_send(msgqid, &mesg);
 
   /*
    * Receive the message from the IPC descriptor and write the data to the standard output.
   */
-  mesg.mesg_type = 2L;
-  while ( (n = mesg_recv(msgqid, &mesg)) > 0) {
+  for (;;) {
+    mesg.mesg_type = pid;
+    if ( (n = mesg_poll(msgqid, &mesg)) < 0) {
+      send_credit(msgqid, pid, owed);       /* nothing there yet, the server may be waiting for them */
+      owed = 0;
+      mesg.mesg_type = pid;
+      n = mesg_recv(msgqid, &mesg);
+    }
+    if (n <= 0) {
+      break;
+    }
     if (write(1, mesg.mesg_data, n) != n) {
       err_sys("data write error");
     }
+    if (++owed >= batch) {
+      send_credit(msgqid, pid, owed);
+      owed = 0;
+    }
+  }
+
+  /*
+   * Take back the credits the server didn't get to, nobody will read them anymore.
+  */
+  mesg.mesg_type = pid | MPX_CREDIT;
+  while (mesg_poll(msgqid, &mesg) >= 0) {
+    mesg.mesg_type = pid | MPX_CREDIT;
   }
 
   if (n < 0) {
@@ -62,21 +62,29 @@ int     t_nerr;
 char    *t_errlist[1];
 #endif
 
+/*
+ * Nonfatal error related to a system call. Print a message, the errno text and a new-line, and return.
+ *
+ *        err_ret(str, arg1, arg2, ...)
+ *
+ * Unlike my_perror, nothing is kept between calls, so a long-running server can call it as often as it likes.
+*/
 void err_ret (char *fmt, ...) {
   va_list args;
-  va_start(args, fmt);
+  int     err = errno;                      /* before fprintf can change it */
 
+  va_start(args, fmt);
   if (pname != NULL) {
     fprintf(stderr, "%s: ", pname);
   }
-
   vfprintf(stderr, fmt, args);
   va_end(args);
 
-  my_perror();
-
+  if (err != 0) {
+    fprintf(stderr, ": %s", strerror(err));
+  }
+  fprintf(stderr, "\n");
   fflush(stdout);
-  fflush(stdin);
 
   return ;
 }
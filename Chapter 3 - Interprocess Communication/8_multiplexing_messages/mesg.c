@@ -92,3 +92,21 @@ Mesg  *mesg_ptr; {
 
   return n;       /* n will be 0 at the end of file */
 }
+
+/*
+ * mesg_recv without waiting: if there's no message of the type on the queue, return -1 (errno ENOMSG) instead.
+*/
+int mesg_poll (id, mesg_ptr)
+int   id;
+Mesg  *mesg_ptr; {
+  int   n;
+
+  if ( (n = msgrcv(id, (char *) &(mesg_ptr->mesg_type), MAXMESGDATA, mesg_ptr->mesg_type, IPC_NOWAIT)) < 0) {
+    if (errno != ENOMSG) {
+      err_dump("msgrcv error");
+    }
+    return -1;
+  }
+
+  return (mesg_ptr->mesg_len = n);
+}
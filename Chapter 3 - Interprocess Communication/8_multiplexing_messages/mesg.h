@@ -19,4 +19,6 @@ void  mesg_send (int id, Mesg *mesg_ptr);
 
 int   mesg_recv (int id, Mesg *mesg_ptr);
 
+int   mesg_poll (int id, Mesg *mesg_ptr);
+
 #endif
@@ -35,4 +35,20 @@ extern int errno;
 
 #define   PERMS   0666
 
+/*
+ * One queue, any number of clients: the message type says who a message is for.
+ *    ->  MPX_SERVER: everything for the server. A request's data is "pid window filename", the client's pid, how many
+ *        messages it lets the server have on the queue for it, and the file it wants.
+ *    ->  pid: the replies for that client, the file and then a 0-length message. No client has a pid of 1 (that's
+ *        init), so this doesn't clash with MPX_SERVER.
+ *    ->  pid | MPX_CREDIT: from the client to the worker sending it the file, the data is how many more messages it
+ *        may send (as text). MPX_CREDIT is above any pid (Linux's are < 2^22, macOS's < 100000).
+*/
+#define   MPX_SERVER      1L
+#define   MPX_CREDIT      (1L << 30)
+#define   MPX_WINDOW      8               /* default window of a client */
+#define   MPX_WORKERS     4               /* default number of workers in the server */
+#define   MPX_MAXQBYTES   (1024 * 1024)   /* default most the server raises msg_qbytes to */
+#define   MPX_TIMEOUT     5               /* seconds a worker waits for credits before it checks on the client */
+
 #endif
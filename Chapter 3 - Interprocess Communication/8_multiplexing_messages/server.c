@@ -1,24 +1,102 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* getopt, kill, sigaction and msg_cbytes with -ansi */
+#endif
+
 #include "mesg.h"
 #include "msgq.h"
 #include "err_routine.h"
 
 #include <stdlib.h>
 #include <sys/fcntl.h>
+#include <sys/wait.h>
+#include <signal.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
-Mesg mesg;
+Mesg  mesg;                   /* the request */
+Mesg  reply;                  /* what goes back to the client */
+int   nworkers = MPX_WORKERS;
+
+volatile sig_atomic_t stop;
 
-int main (void) {
-  
-  int id;
+void sig_stop (int signo) {
+  (void) signo;
+  stop = 1;
+}
+
+void sig_alarm (int signo) {
+  (void) signo;               /* only there to interrupt msgrcv */
+}
+
+/*
+ * Raise the queue's msg_qbytes to `want`, but not above `max`. Raising it past the system's MSGMNB takes privileges
+ * (CAP_SYS_RESOURCE on Linux), without them we keep what we have. Returns msg_qbytes after all that.
+*/
+unsigned long qbytes_raise (int msgqid, unsigned long want, unsigned long max) {
+  struct msqid_ds   ds;
+  unsigned long     old;
+
+  if (msgctl(msgqid, IPC_STAT, &ds) < 0) {
+    err_sys("server: can't IPC_STAT the message queue");
+  }
+  if (want > max) {
+    want = max;
+  }
+  if ( (old = ds.msg_qbytes) >= want) {
+    return old;
+  }
+  ds.msg_qbytes = want;
+  if (msgctl(msgqid, IPC_SET, &ds) < 0) {
+    err_ret("server: can't raise msg_qbytes from %lu to %lu", old, want);
+    return old;
+  }
+
+  return want;
+}
+
+/*
+ * Functionality:
+ *    ->  The queue is created (or opened, if it's already there) like before.
+ *    ->  msg_qbytes is raised so that every worker can have a full window of messages on the queue at once (within
+ *        -q bytes). The default of 16384 bytes on Linux is four messages, one big file would fill it by itself.
+ *    ->  The workers are forked. Each of them runs server() (described below): they all wait for requests on the one
+ *        queue and the kernel gives each request to one of them, so up to `nworkers` files are read at once.
+ *    ->  The parent only looks after them: a worker that died is replaced, and every second the queue is looked at
+ *        (IPC_STAT). If it's full, msg_qbytes is doubled (up to -q), and every -i seconds the depth is reported.
+ *    ->  SIGINT or SIGTERM stop the workers and remove the queue. The clients don't remove it anymore, it outlives
+ *        any one of them.
+ *
+ * Options:
+ *    -n workers  how many files are served at once (MPX_WORKERS)
+ *    -q bytes    the most msg_qbytes is raised to (MPX_MAXQBYTES)
+ *    -i seconds  how often the queue depth is reported, 0 for never (5)
+*/
+int main (int argc, char **argv) {
+  int               id, c, i, status, interval = 5, tick = 0;
+  pid_t             *pids, pid;
+  unsigned long     maxqbytes = MPX_MAXQBYTES, qbytes;
+  struct msqid_ds   ds;
+  struct sigaction  sa;
+
+  while ( (c = getopt(argc, argv, "n:q:i:")) != -1) {
+    switch (c) {
+      case 'n': nworkers  = atoi(optarg);           break;
+      case 'q': maxqbytes = strtoul(optarg, 0, 0);  break;
+      case 'i': interval  = atoi(optarg);           break;
+      default:
+        err_sys("usage: %s [-n workers] [-q maxqbytes] [-i seconds]", argv[0]);
+    }
+  }
+  if (nworkers < 1) {
+    err_sys("server: need at least one worker");
+  }
 
   /*
    * Create the message queue, if required.
   */
   /*
-   * IPC_CREAT will create an IPC for the respective key_t variable. 
+   * IPC_CREAT will create an IPC for the respective key_t variable.
    * To make a unique IPC channel, IPC_PRIVATE flag is specified.
    * To make sure a new key is made, and no previous key is returned, IPC_EXCL is flag is combined as well.
    * The perms are for the 9-bit mode of the IPC channel.
@@ -27,73 +105,229 @@ int main (void) {
   if ( (id = msgget(MKEY1, PERMS | IPC_CREAT)) < 0) {
     err_sys("server: can't get message queue 1");
   }
-  
+  qbytes = qbytes_raise(id, (unsigned long) (nworkers * MPX_WINDOW + 1) * MAXMESGDATA, maxqbytes);
+  printf("server: %d workers, msg_qbytes %lu\n", nworkers, qbytes);
+  fflush(stdout);
+
   /*
-   * How does the server work?
-   *  ->  The server function takes in the message queue id of the IPC channel.
-   *  ->  At first, the mesg_type member is set to 1L, signifying that the process
-   *      wants to read from the channel of message type 1L. The server reads from this type.
-   *  ->  Even though the name of the file--sent from the file--contains a null-termination,
-   *      the program probably wants to make sure that the character array is properly 
-   *      null-terminated.
-   *  ->  After receiving the filename, the process proceeds to change the mesg_type to 2L,
-   *      which means the message we are about to send will be of type 2L, which the client 
-   *      will read.
-   *  ->  If the file cannot be opened, construct an error message and send it to the client.
-   *  ->  If the file is read, then read MAXMESGDATA bytes from the file, and then send it 
-   *      to the IPC channel. When the file is at EOF, read will return 0, terminating the loop.
-   *  ->  An empty envelope (value of mesg_len member = 0) is sent at the end
-   *  ->  NOTE: Like stated in the client file, the fuction mesg_send and mesg_recv both are 
-   *      wrappers to the system calls msgsnd and msgrcv resepectively.
+   * sigaction and not signal: the handlers must not restart msgrcv, or SIGALRM couldn't get a worker out of it.
   */
-  server(id);
+  memset(&sa, 0, sizeof(sa));
+  sigemptyset(&sa.sa_mask);
+  sa.sa_handler = sig_stop;
+  sigaction(SIGINT, &sa, (struct sigaction *) 0);
+  sigaction(SIGTERM, &sa, (struct sigaction *) 0);
+
+  if ( (pids = (pid_t *) malloc(nworkers * sizeof(pid_t))) == NULL) {
+    err_sys("server: can't allocate the worker table");
+  }
+  for (i = 0; i < nworkers; i++) {
+    pids[i] = 0;
+  }
+
+  while (!stop) {
+    /*
+     * Start the workers, at first and again for any that died.
+    */
+    for (i = 0; i < nworkers; i++) {
+      if (pids[i] != 0) {
+        continue;
+      }
+      if ( (pids[i] = fork()) < 0) {
+        err_sys("server: can't fork");
+      } else if (pids[i] == 0) {
+        sa.sa_handler = SIG_DFL;
+        sigaction(SIGINT, &sa, (struct sigaction *) 0);
+        sigaction(SIGTERM, &sa, (struct sigaction *) 0);
+        sa.sa_handler = sig_alarm;
+        sigaction(SIGALRM, &sa, (struct sigaction *) 0);
+        server(id);
+        exit(EXIT_SUCCESS);
+      }
+    }
+
+    sleep(1);
+
+    while ( (pid = waitpid(-1, &status, WNOHANG)) > 0) {
+      for (i = 0; i < nworkers; i++) {
+        if (pids[i] == pid) {
+          err_ret("server: worker %d died (status %d), starting another", (int) pid, status);
+          pids[i] = 0;
+        }
+      }
+    }
+
+    if (msgctl(id, IPC_STAT, &ds) < 0) {
+      err_sys("server: can't IPC_STAT the message queue");
+    }
+    if (ds.msg_cbytes + MAXMESGDATA > ds.msg_qbytes && ds.msg_qbytes < maxqbytes) {
+      qbytes = qbytes_raise(id, 2 * ds.msg_qbytes, maxqbytes);
+      printf("server: queue full, msg_qbytes now %lu\n", qbytes);
+      fflush(stdout);
+    }
+    if (interval > 0 && ++tick % interval == 0) {
+      printf("server: %lu messages, %lu of %lu bytes on the queue\n",
+             (unsigned long) ds.msg_qnum, (unsigned long) ds.msg_cbytes, (unsigned long) ds.msg_qbytes);
+      fflush(stdout);
+    }
+  }
+
+  for (i = 0; i < nworkers; i++) {
+    if (pids[i] != 0) {
+      kill(pids[i], SIGTERM);
+    }
+  }
+  while (wait(&status) > 0) {
+    ;
+  }
+  if (msgctl(id, IPC_RMID, (struct msqid_ds *) 0) < 0) {
+    err_sys("server: can't RMID message queue 1");
+  }
+  free(pids);
 
   exit(EXIT_SUCCESS);
 }
 
+/*
+ * The window a worker allows a client: what it asked for, but no more than a share of the queue, so that all the
+ * workers can have their windows on the queue at once and nobody's msgsnd waits for space.
+*/
+int window_cap (int msgqid, int window) {
+  struct msqid_ds   ds;
+  long              share;
+
+  if (msgctl(msgqid, IPC_STAT, &ds) < 0) {
+    err_sys("server: can't IPC_STAT the message queue");
+  }
+  share = (long) (ds.msg_qbytes / ((unsigned long) nworkers * MAXMESGDATA));
+  if (window > share) {
+    window = share;
+  }
+
+  return (window < 1) ? 1 : window;
+}
+
+/*
+ * Drop whatever is still on the queue for, or from, a client that went away. That's done on the timeout in wait_credit,
+ * when a request is done and its client isn't there anymore, and before a request is served: a client has only one
+ * request out and sends no credits before it has a reply, so anything typed with its pid then was left by an earlier
+ * process with the same pid (a small file it never read), and would be read as the start of this reply.
+*/
+void drain (int msgqid, long pid) {
+  while (msgrcv(msgqid, (char *) &(reply.mesg_type), MAXMESGDATA, pid, IPC_NOWAIT | MSG_NOERROR) >= 0) {
+    ;
+  }
+  while (msgrcv(msgqid, (char *) &(reply.mesg_type), MAXMESGDATA, pid | MPX_CREDIT, IPC_NOWAIT | MSG_NOERROR) >= 0) {
+    ;
+  }
+}
+
+/*
+ * Wait for more credits from client `pid`. Every MPX_TIMEOUT seconds (SIGALRM) we check that it's still there.
+ * Returns the credits, or 0 if the client is gone.
+*/
+int wait_credit (int msgqid, long pid) {
+  Mesg  credit;
+  int   n, count;
+
+  for (;;) {
+    credit.mesg_type = pid | MPX_CREDIT;
+    alarm(MPX_TIMEOUT);
+    n = msgrcv(msgqid, (char *) &(credit.mesg_type), MAXMESGDATA - 1, credit.mesg_type, MSG_NOERROR);
+    alarm(0);
+    if (n >= 0) {
+      credit.mesg_data[n] = '\0';
+      if ( (count = atoi(credit.mesg_data)) > 0) {
+        return count;
+      }
+    } else if (errno != EINTR) {
+      err_sys("server: credit read error");
+    } else if (kill((pid_t) pid, 0) < 0 && errno == ESRCH) {
+      err_ret("server: client %ld went away", pid);
+      drain(msgqid, pid);
+      return 0;
+    }
+  }
+}
+
+/*
+ * Functionality: What a worker does, over and over.
+ *    ->  Read a request, any request: the mesg_type is MPX_SERVER, the data says who it's from, what window it wants
+ *        and the file. Even though the name of the file contains a null-termination, make sure it's null-terminated.
+ *    ->  The replies go out with the client's pid as their mesg_type, so only that client reads them, however many
+ *        others are waiting on the same queue.
+ *    ->  If the file cannot be opened, construct an error message and send it to the client.
+ *    ->  Otherwise the file is sent MAXMESGDATA bytes at a time, but only `window` messages ahead of the client: each
+ *        message uses up a credit, and when there are none left we wait for the client to send more (wait_credit).
+ *        So a big file never has more than its window on the queue, and the other clients' replies still fit.
+ *    ->  An empty envelope (value of mesg_len member = 0) is sent at the end, it needs no credit. The client takes
+ *        back the credits we didn't use. If the client is gone by then, its replies are drained (drain).
+*/
 void server (msgqid)
 int msgqid; {
-  int   n, filefd;
-  char  errmesg[256], *sys_err_str();
+  int   n, filefd, window, credits, off;
+  long  pid;
+  char  filename[MAXMESGDATA], errmesg[256], *sys_err_str();
 
-  /*
-   * Read the filename message from the IPC descriptor.
-  */
+  for (;;) {
+    mesg.mesg_type = MPX_SERVER;                    /* Receive message of this type */
+    if ( (n = mesg_recv(msgqid, &mesg)) <= 0) {
+      err_ret("server: empty request");
+      continue;
+    }
+    mesg.mesg_data[n] = '\0';                       /* null terminate the request */
+    off = -1;
+    if (sscanf(mesg.mesg_data, "%ld %d %n", &pid, &window, &off) != 2 || off < 0 || pid <= MPX_SERVER ||
+        pid >= MPX_CREDIT) {
+      err_ret("server: bad request");
+      continue;
+    }
+    strcpy(filename, mesg.mesg_data + off);
+    credits = window_cap(msgqid, window);
+    drain(msgqid, pid);
 
-  mesg.mesg_type = 1L;                            /* Receive message of this type */
-  if ( (n = mesg_recv(msgqid, &mesg)) <= 0) {
-    err_sys("server: filename read error");
-  }
-  mesg.mesg_data[n] = '\0';                       /* null terminate filename */
+    reply.mesg_type = pid;                          /* send messages of this type */
+    if ( (filefd = open(filename, 0)) < 0) {        /* oflag 0 = O_RDONLY */
+      /*
+       * Error. Format an error message and send it back to the client.
+      */
+      sprintf(errmesg, ": can't open %s\n", sys_err_str());
+      strncpy(reply.mesg_data, filename, MAXMESGDATA - sizeof(errmesg));
+      reply.mesg_data[MAXMESGDATA - sizeof(errmesg)] = '\0';
+      strcat(reply.mesg_data, errmesg);
+      reply.mesg_len = strlen(reply.mesg_data);
+      mesg_send(msgqid, &reply);
+    } else {
+      /*
+       * Read the data from the file and send a message to the IPC descriptor.
+      */
+      while ( (n = read(filefd, reply.mesg_data, MAXMESGDATA)) > 0) {
+        if (credits == 0 && (credits = wait_credit(msgqid, pid)) == 0) {
+          break;                                    /* the client is gone */
+        }
+        reply.mesg_len = n;
+        reply.mesg_type = pid;
+        mesg_send(msgqid, &reply);
+        credits--;
+      }
+      close(filefd);
+
+      if (n < 0) {
+        err_ret("server: read error on %s", filename);
+      } else if (n > 0) {
+        continue;                                   /* no one to send the end to */
+      }
+    }
 
-  mesg.mesg_type = 2L;                            /* send message of this type */
-  if ( (filefd = open(mesg.mesg_data, 0)) < 0) {  /* oflag 0 = O_RDONLY */
-    /*
-     * Error. Format an error message and send it back to the client.
-    */
-    sprintf(errmesg, ": can't open %s\n", sys_err_str());
-    strcat(mesg.mesg_data, errmesg);
-    mesg.mesg_len = strlen(mesg.mesg_data);
-    mesg_send(msgqid, &mesg);
-  } else {
     /*
-     * Read the data from the file and send a message to the IPC descriptor.
+     * Send a message with a length of 0 to signify the end.
     */
-    while ( (n = read(filefd, mesg.mesg_data, MAXMESGDATA)) > 0) {
-      mesg.mesg_len = n;
-      mesg_send(msgqid, &mesg);
-    }
-    close(filefd);
+    reply.mesg_len  = 0;
+    reply.mesg_type = pid;
+    mesg_send(msgqid, &reply);
 
-    if (n < 0) {
-      err_sys("server: read error");
+    if (kill((pid_t) pid, 0) < 0 && errno == ESRCH) {
+      drain(msgqid, pid);                           /* it went away without reading them */
     }
   }
-
-  /*
-   * Send a message with a length of 0 to signify the end.
-  */
-
-  mesg.mesg_len = 0;
-  mesg_send(msgqid, &mesg);
 }
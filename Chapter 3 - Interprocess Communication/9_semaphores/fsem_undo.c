@@ -0,0 +1,84 @@
+#ifdef __linux__
+#define _GNU_SOURCE             /* nanosleep() with -ansi */
+#endif
+
+#include "err_routine.h"
+#include "semaphore.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define   SEMKEY    ((key_t) 23457L)
+
+/*
+ * A check of the SEM_UNDO emulation in fsemaphore.c, for a process that dies with a negative adjustment.
+ *
+ *    ->  A binary semaphore (1). A child opens it, does a sem_signal (2, its adjustment is -1), and exits without
+ *        sem_close.
+ *    ->  We take it twice (0). Then another child opens it, which gives back what the dead one held: 0 - 1, and the
+ *        counter stays at 0, like the kernel's semval for SEM_UNDO.
+ *    ->  A third sem_wait, in a child, must block. If it gets through, the counter wrapped around. After a while it is
+ *        let through with a sem_signal, and everything is closed.
+ *
+ * Exits 0 and prints "ok", or prints what went wrong and exits 1. Run it with `make test`.
+*/
+int main (void) {
+  int             id, status;
+  pid_t           pid;
+  struct timespec ts;
+
+  if ( (id = sem_create(SEMKEY, 1)) < 0) {
+    err_sys("can't create the semaphore");
+  }
+
+  if ( (pid = fork()) < 0) {
+    err_sys("fork error");
+  } else if (pid == 0) {
+    if ( (id = sem_open(SEMKEY)) < 0) {
+      err_sys("child: can't open the semaphore");
+    }
+    sem_signal(id);
+    _exit(0);                               /* no sem_close: it's up to the others to undo */
+  }
+  waitpid(pid, (int *) 0, 0);
+
+  sem_wait(id);
+  sem_wait(id);
+
+  if ( (pid = fork()) < 0) {
+    err_sys("fork error");
+  } else if (pid == 0) {
+    if ( (id = sem_open(SEMKEY)) < 0) {     /* finds the dead slot */
+      err_sys("child: can't open the semaphore");
+    }
+    sem_wait(id);
+    sem_signal(id);
+    sem_close(id);
+    _exit(0);
+  }
+
+  ts.tv_sec   = 0;
+  ts.tv_nsec  = 300 * 1000000L;
+  nanosleep(&ts, (struct timespec *) 0);
+  if (waitpid(pid, &status, WNOHANG) == pid) {
+    printf("FAIL: a third sem_wait got the semaphore, the negative adjustment wrapped the counter\n");
+    sem_close(id);
+    exit(EXIT_FAILURE);
+  }
+
+  sem_signal(id);
+  waitpid(pid, &status, 0);
+  sem_signal(id);
+  sem_close(id);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    printf("FAIL: the waiter didn't finish\n");
+    exit(EXIT_FAILURE);
+  }
+
+  printf("ok\n");
+  exit(EXIT_SUCCESS);
+}
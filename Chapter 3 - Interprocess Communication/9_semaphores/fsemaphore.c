@@ -0,0 +1,426 @@
+#ifdef __linux__
+#define _GNU_SOURCE             /* syscall() and kill() with -ansi */
+#endif
+
+#include "semaphore.h"
+#include "err_routine.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/shm.h>
+
+#ifdef __linux__
+  #include <limits.h>
+  #include <sys/syscall.h>
+  #include <linux/futex.h>
+#endif
+
+/*
+ * The same interface as semaphore.c, but without a semop() in the common case.
+ *
+ * In semaphore.c every sem_wait and sem_signal is a semop() system call, even when nobody else is using the semaphore,
+ * and sem_create/sem_close need two more for the lock member [2]. Here the semaphore is a 32-bit counter in a small
+ * shared memory segment (the key is the shm key) and:
+ *    ->  sem_wait is a compare-and-swap on the counter when it is > 0, sem_signal an atomic add. No system call at all.
+ *    ->  Only when the counter is 0 does sem_wait go to sleep, with FUTEX_WAIT on the counter itself. sem_signal makes
+ *        the FUTEX_WAKE system call only if `waiters` says someone is sleeping.
+ *    ->  The SEM_UNDO part (a process that dies while holding the semaphore gives it back) is done with a table of
+ *        pids. Every process that created/opened the semaphore has a slot with its pid and its adjustment, which is
+ *        what SEM_UNDO keeps in the kernel: the negated sum of all its operations. A waiter doesn't sleep forever but
+ *        FSEM_CHECK_MS milliseconds at a time, and each time it wakes up without the semaphore it looks for slots
+ *        whose process is gone (kill(pid, 0) fails with ESRCH), adds their adjustment back and frees the slot.
+ *    ->  The process counter [1] is the number of used slots: sem_close frees ours and the last one out removes the
+ *        segment. The lock member [2] is `lock` below, a spin lock holding the owner's pid, which is only taken in
+ *        sem_create/sem_open/sem_close. If the owner died, the lock is taken over.
+ *
+ * NOTE:  The kernel applies the SEM_UNDO adjustment together with the operation. We can't: a process killed between the
+ *        compare-and-swap and the update of its adjustment takes one unit with it. The window is a few instructions.
+ *        Also a pid may be reused after the process died, then we think it's alive. Both are the price of staying in
+ *        user space.
+ *
+ * Where there's no futex, the sleeper polls the counter every FSEM_POLL_US microseconds instead.
+*/
+
+#define   PERMS           0666
+#define   FSEM_MAX        16        /* semaphores open at once in one process */
+#define   FSEM_SLOTS      64        /* processes using one semaphore */
+#define   FSEM_CHECK_MS   100       /* a waiter looks for dead processes this often */
+#define   FSEM_POLL_US    50
+
+#define   FSEM_NEW        0         /* states of `init` */
+#define   FSEM_BUSY       1
+#define   FSEM_READY      2
+#define   FSEM_DEAD       3         /* last one closed it, being removed */
+
+typedef struct {
+  int   pid;                        /* 0 if free */
+  int   adj;                        /* what to add to `value` if `pid` dies */
+} fsem_slot;
+
+typedef struct {
+  unsigned int  value;              /* the semaphore value, [0] in semaphore.c. FUTEX_WAIT needs 32 bits. */
+  unsigned int  waiters;            /* processes asleep on `value` */
+  unsigned int  init;
+  int           lock;               /* pid of the process in sem_create/sem_open/sem_close, or 0 */
+  fsem_slot     slot[FSEM_SLOTS];
+} fsem;
+
+/*
+ * What the semaphore id means in this process.
+*/
+static struct {
+  int   shmid;                      /* -1 if the entry is free */
+  fsem  *s;
+  int   slot;                       /* our slot in s->slot */
+} tab[FSEM_MAX];
+
+static int tab_ready = 0;
+
+static int fsem_alive (pid)
+int pid; {
+  return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+static void fsem_sleep (s, seen, ms)
+fsem          *s;
+unsigned int  seen;
+int           ms; {
+#ifdef __linux__
+  struct timespec ts;
+
+  ts.tv_sec   = ms / 1000;
+  ts.tv_nsec  = (ms % 1000) * 1000000L;
+  /* not FUTEX_PRIVATE_FLAG, the counter is shared between processes */
+  syscall(SYS_futex, &s->value, FUTEX_WAIT, seen, &ts, (unsigned int *) 0, 0);
+#else
+  struct timespec ts;
+  int             n;
+
+  ts.tv_sec   = 0;
+  ts.tv_nsec  = FSEM_POLL_US * 1000L;
+  for (n = ms * 1000 / FSEM_POLL_US; n > 0 && __atomic_load_n(&s->value, __ATOMIC_SEQ_CST) == seen; n--) {
+    nanosleep(&ts, (struct timespec *) 0);
+  }
+#endif
+}
+
+static void fsem_wake (s)
+fsem  *s; {
+  if (__atomic_load_n(&s->waiters, __ATOMIC_SEQ_CST) != 0) {
+#ifdef __linux__
+    /* all of them: a sem_op(id, -2) waiter may not be satisfied by 1, while one waiting for 1 would be */
+    syscall(SYS_futex, &s->value, FUTEX_WAKE, INT_MAX, (struct timespec *) 0, (unsigned int *) 0, 0);
+#endif
+  }
+}
+
+/*
+ * Add a process's adjustment to the counter. A negative one (it did more sem_signal than sem_wait) can't be added to the
+ * unsigned counter as it is, that would wrap it around to 4 billion. Like the kernel does for SEM_UNDO, the counter is
+ * lowered, but not below 0.
+*/
+static void fsem_adjust (s, adj)
+fsem  *s;
+int   adj; {
+  unsigned int  cur, want;
+
+  if (adj > 0) {
+    __atomic_add_fetch(&s->value, (unsigned int) adj, __ATOMIC_SEQ_CST);
+    fsem_wake(s);
+    return;
+  }
+  cur = __atomic_load_n(&s->value, __ATOMIC_SEQ_CST);
+  do {
+    want = (cur > (unsigned int) -adj) ? cur - (unsigned int) -adj : 0;
+  } while (!__atomic_compare_exchange_n(&s->value, &cur, want, 1, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+}
+
+/*
+ * Give back what dead processes held, and free their slots. Claiming the slot with a compare-and-swap makes sure only
+ * one of the processes that noticed does it.
+*/
+static void fsem_recover (s)
+fsem  *s; {
+  int i, pid, adj;
+
+  for (i = 0; i < FSEM_SLOTS; i++) {
+    if ( (pid = __atomic_load_n(&s->slot[i].pid, __ATOMIC_SEQ_CST)) == 0 || fsem_alive(pid)) {
+      continue;
+    }
+    if (!__atomic_compare_exchange_n(&s->slot[i].pid, &pid, -1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      continue;
+    }
+    if ( (adj = __atomic_exchange_n(&s->slot[i].adj, 0, __ATOMIC_SEQ_CST)) != 0) {
+      fsem_adjust(s, adj);
+    }
+    __atomic_store_n(&s->slot[i].pid, 0, __ATOMIC_SEQ_CST);
+  }
+}
+
+static void fsem_lock (s)
+fsem  *s; {
+  int             pid = getpid(), owner;
+  struct timespec ts;
+
+  ts.tv_sec   = 0;
+  ts.tv_nsec  = FSEM_POLL_US * 1000L;
+  for (;;) {
+    owner = 0;
+    if (__atomic_compare_exchange_n(&s->lock, &owner, pid, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      return;
+    }
+    /* `owner` now holds who has it. If it's gone, it was in the middle of sem_create/sem_open/sem_close. */
+    if (!fsem_alive(owner) && __atomic_compare_exchange_n(&s->lock, &owner, pid, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      return;
+    }
+    nanosleep(&ts, (struct timespec *) 0);
+  }
+}
+
+static void fsem_unlock (s)
+fsem  *s; {
+  __atomic_store_n(&s->lock, 0, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Attach the segment for `key` and take a slot in it. Returns the id, or -1.
+ * `create` says whether to create the segment and set the value to `initval` if we're the first one.
+*/
+static int fsem_get (key, create, initval)
+key_t key;
+int   create;
+int   initval; {
+  register int    id, i;
+  int             shmid, pid = getpid();
+  unsigned int    state;
+  fsem            *s;
+  struct timespec ts;
+
+  if (key == IPC_PRIVATE) {
+    return -1;    /* not intended for private semaphores. */
+  } else if (key == (key_t) -1) {
+    return -1;    /* probably an ftok() error by caller. */
+  }
+
+  if (!tab_ready) {
+    for (i = 0; i < FSEM_MAX; i++) {
+      tab[i].shmid = -1;
+    }
+    tab_ready = 1;
+  }
+  for (id = 0; id < FSEM_MAX && tab[id].shmid != -1; id++) {
+    ;
+  }
+  if (id == FSEM_MAX) {
+    return -1;
+  }
+
+  ts.tv_sec   = 0;
+  ts.tv_nsec  = FSEM_POLL_US * 1000L;
+
+again:
+  if ( (shmid = shmget(key, sizeof(fsem), create ? (PERMS | IPC_CREAT) : 0)) < 0) {
+    return -1;    /* doesn't exist, permission problem or tables full */
+  }
+  if ( (s = (fsem *) shmat(shmid, (char *) 0, 0)) == (fsem *) -1) {
+    return -1;
+  }
+
+  /*
+   * A new segment is all zeros, FSEM_NEW. The first one to get it to FSEM_BUSY sets it up. FSEM_DEAD is the same race
+   * as in semaphore.c's sem_create: the last process closed it and is about to remove it, so start over and get a
+   * new one.
+  */
+  state = FSEM_NEW;
+  if (__atomic_compare_exchange_n(&s->init, &state, FSEM_BUSY, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+    if (!create) {
+      __atomic_store_n(&s->init, FSEM_NEW, __ATOMIC_SEQ_CST);
+      shmdt((char *) s);
+      return -1;    /* sem_open, but nobody created it */
+    }
+    s->value    = (unsigned int) initval;
+    s->waiters  = 0;
+    s->lock     = 0;
+    memset(s->slot, 0, sizeof(s->slot));
+    __atomic_store_n(&s->init, FSEM_READY, __ATOMIC_SEQ_CST);
+  }
+  while ( (state = __atomic_load_n(&s->init, __ATOMIC_SEQ_CST)) != FSEM_READY) {
+    if (state == FSEM_DEAD) {
+      shmdt((char *) s);
+      nanosleep(&ts, (struct timespec *) 0);
+      goto again;
+    }
+    nanosleep(&ts, (struct timespec *) 0);
+  }
+
+  fsem_lock(s);
+  if (__atomic_load_n(&s->init, __ATOMIC_SEQ_CST) != FSEM_READY) {
+    fsem_unlock(s);
+    shmdt((char *) s);
+    goto again;
+  }
+  fsem_recover(s);
+  for (i = 0; i < FSEM_SLOTS; i++) {
+    if (s->slot[i].pid == 0) {
+      s->slot[i].adj = 0;
+      __atomic_store_n(&s->slot[i].pid, pid, __ATOMIC_SEQ_CST);
+      break;
+    }
+  }
+  fsem_unlock(s);
+  if (i == FSEM_SLOTS) {
+    shmdt((char *) s);
+    errno = ENOSPC;
+    return -1;    /* too many processes */
+  }
+
+  tab[id].shmid = shmid;
+  tab[id].s     = s;
+  tab[id].slot  = i;
+
+  return id;
+}
+
+static void fsem_put (id)
+int id; {
+  if (shmdt((char *) tab[id].s) < 0) {
+    err_sys("can't shmdt");
+  }
+  tab[id].shmid = -1;
+}
+
+static void fsem_check (id)
+int id; {
+  if (id < 0 || id >= FSEM_MAX || tab[id].shmid == -1) {
+    err_dump("bad semaphore id %d", id);
+  }
+}
+
+/*
+ * sem_create:  Create the segment for `key` (if it doesn't exist) with the value `initval`, or open it.
+*/
+int sem_create (key, initval)
+key_t key;
+int   initval; {
+  return fsem_get(key, 1, initval);
+}
+
+/*
+ * sem_open:  Open a semaphore that must already exist.
+*/
+int sem_open (key)
+key_t key; {
+  return fsem_get(key, 0, 0);
+}
+
+/*
+ * sem_rm:  Remove the semaphore, regardless of who else is using it.
+*/
+void sem_rm (id)
+int id; {
+  fsem_check(id);
+  __atomic_store_n(&tab[id].s->init, FSEM_DEAD, __ATOMIC_SEQ_CST);
+  if (shmctl(tab[id].shmid, IPC_RMID, (struct shmid_ds *) 0) < 0) {
+    err_sys("can't IPC_RMID");
+  }
+  fsem_put(id);
+}
+
+/*
+ * sem_close: Free our slot. If nobody else has one, remove the semaphore.
+ *            Like SEM_UNDO when a process exits, whatever we still hold is given back first.
+*/
+void sem_close (id)
+int id; {
+  register int  i, last = 1;
+  fsem          *s;
+  int           adj;
+
+  fsem_check(id);
+  s = tab[id].s;
+
+  fsem_lock(s);
+  if ( (adj = __atomic_exchange_n(&s->slot[tab[id].slot].adj, 0, __ATOMIC_SEQ_CST)) != 0) {
+    fsem_adjust(s, adj);
+  }
+  __atomic_store_n(&s->slot[tab[id].slot].pid, 0, __ATOMIC_SEQ_CST);
+  fsem_recover(s);
+  for (i = 0; i < FSEM_SLOTS; i++) {
+    if (__atomic_load_n(&s->slot[i].pid, __ATOMIC_SEQ_CST) != 0) {
+      last = 0;
+      break;
+    }
+  }
+
+  if (last) {
+    __atomic_store_n(&s->init, FSEM_DEAD, __ATOMIC_SEQ_CST);
+    fsem_unlock(s);
+    if (shmctl(tab[id].shmid, IPC_RMID, (struct shmid_ds *) 0) < 0) {
+      err_sys("can't IPC_RMID");
+    }
+  } else {
+    fsem_unlock(s);
+  }
+  fsem_put(id);
+}
+
+void sem_wait (id)
+int id; {
+  sem_op(id, -1);
+}
+
+void sem_signal (id)
+int id; {
+  sem_op(id, 1);
+}
+
+/*
+ * sem_op:  Functionality:
+ *    ->  value > 0:  add it to the counter, wake the sleepers if there are any.
+ *    ->  value < 0:  take |value| from the counter with a compare-and-swap if it's big enough. If not, register as a
+ *                    waiter and FUTEX_WAIT as long as the counter is still what we saw. The kernel compares again
+ *                    before putting us to sleep, so a sem_signal between our look and the FUTEX_WAIT isn't missed.
+ *                    After FSEM_CHECK_MS without the semaphore, look for dead processes holding it.
+ *    ->  Either way, the opposite goes into our slot's adjustment, like SEM_UNDO.
+*/
+void sem_op (id, value)
+int id;
+int value; {
+  fsem          *s;
+  unsigned int  cur, need;
+
+  if (value == 0) {
+    err_sys("can't have value == 0");
+  }
+  fsem_check(id);
+  s = tab[id].s;
+
+  if (value > 0) {
+    __atomic_add_fetch(&s->value, (unsigned int) value, __ATOMIC_SEQ_CST);
+    __atomic_sub_fetch(&s->slot[tab[id].slot].adj, value, __ATOMIC_SEQ_CST);
+    fsem_wake(s);
+    return;
+  }
+
+  need = (unsigned int) -value;
+  cur = __atomic_load_n(&s->value, __ATOMIC_SEQ_CST);
+  for (;;) {
+    if (cur >= need) {
+      if (__atomic_compare_exchange_n(&s->value, &cur, cur - need, 1, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        break;
+      }
+      continue;     /* `cur` has the new value */
+    }
+    __atomic_add_fetch(&s->waiters, 1, __ATOMIC_SEQ_CST);
+    fsem_sleep(s, cur, FSEM_CHECK_MS);
+    __atomic_sub_fetch(&s->waiters, 1, __ATOMIC_SEQ_CST);
+    if ( (cur = __atomic_load_n(&s->value, __ATOMIC_SEQ_CST)) < need) {
+      fsem_recover(s);
+      cur = __atomic_load_n(&s->value, __ATOMIC_SEQ_CST);
+    }
+  }
+  __atomic_add_fetch(&s->slot[tab[id].slot].adj, (int) need, __ATOMIC_SEQ_CST);
+}
@@ -6,19 +6,127 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/shm.h>
 
 #define   SEQFILE   "seqno"
 #define   SEMKEY    ((key_t) 23456L)
 #define   MAXBUFF   100
 
-int main (void) {
-  
-  int   fd, i, n, pid, seqno, semid;
-  char  buff[MAXBUFF];
+int   verbose;          /* print every sequence number (the original demo) */
+int   usemem;           /* the critical section is a counter in shared memory instead of the file */
+int   *memcount;
+
+int   seqno_get     (int fd);
+void  seqno_bump    (int fd, int pid);
+void  worker        (int loops);
+
+/*
+ * With no arguments this is the old demo: 20 times, lock, increment the number in `seqno`, print it, unlock. Start
+ * a few of them at once to see the lock at work.
+ *
+ * With arguments it's a benchmark of the semaphore implementation it was linked with (`main` uses semaphore.c, the
+ * System V semaphores, `fmain` fsemaphore.c, the futex-based one):
+ *
+ *    ./main nprocs loops [mem]
+ *
+ *    ->  `nprocs` processes are forked, each does `loops` times sem_wait, the critical section, sem_signal.
+ *    ->  The critical section is the read-increment-write of `seqno`, or with `mem`, an increment of a counter in
+ *        shared memory, which leaves nothing but the cost of the semaphore itself.
+ *    ->  At the end the counter must have gone up by exactly nprocs * loops, otherwise the lock didn't work. The time
+ *        per lock/unlock pair and the context switches of the children (getrusage) are printed.
+*/
+int main (argc, argv)
+int   argc;
+char  **argv; {
+  int             fd, i, nprocs = 1, loops = 20, before, after, memid = -1, status;
+  pid_t           pid;
+  struct timeval  start, end;
+  struct rusage   ru;
+  double          secs;
+
+  verbose = (argc < 2);
+  if (argc > 1 && (nprocs = atoi(argv[1])) < 1) {
+    err_sys("usage: %s [nprocs loops [mem]]", argv[0]);
+  }
+  if (argc > 2 && (loops = atoi(argv[2])) < 1) {
+    err_sys("usage: %s [nprocs loops [mem]]", argv[0]);
+  }
+  usemem = (argc > 3 && strcmp(argv[3], "mem") == 0);
+
+  if (usemem) {
+    if ( (memid = shmget(IPC_PRIVATE, sizeof(int), 0600)) < 0) {
+      err_sys("can't get shared memory");
+    }
+    if ( (memcount = (int *) shmat(memid, (char *) 0, 0)) == (int *) -1) {
+      err_sys("can't attach shared memory");
+    }
+    shmctl(memid, IPC_RMID, (struct shmid_ds *) 0);   /* goes away with the last detach */
+    *memcount = 0;
+    before    = 0;
+  } else {
+    if ( (fd = open(SEQFILE, 2)) < 0) {
+      err_sys("can't open %s", SEQFILE);
+    }
+    before = seqno_get(fd);
+    close(fd);
+  }
+
+  if (verbose) {
+    worker(loops);
+    exit(EXIT_SUCCESS);
+  }
+
+  gettimeofday(&start, (struct timezone *) 0);
+  for (i = 0; i < nprocs; i++) {
+    if ( (pid = fork()) < 0) {
+      err_sys("can't fork");
+    } else if (pid == 0) {
+      worker(loops);
+      exit(EXIT_SUCCESS);
+    }
+  }
+  for (i = 0; i < nprocs; i++) {
+    if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      err_sys("a worker failed");
+    }
+  }
+  gettimeofday(&end, (struct timezone *) 0);
+
+  if (usemem) {
+    after = *memcount;
+  } else {
+    if ( (fd = open(SEQFILE, 0)) < 0) {
+      err_sys("can't open %s", SEQFILE);
+    }
+    after = seqno_get(fd);
+    close(fd);
+  }
+  getrusage(RUSAGE_CHILDREN, &ru);
+
+  secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  printf("%s: %d procs x %d loops (%s): %.3f s, %.0f ns per wait/signal, %.0f per second\n",
+         argv[0], nprocs, loops, usemem ? "mem" : SEQFILE, secs,
+         secs * 1e9 / ((double) nprocs * loops), (double) nprocs * loops / secs);
+  printf("%s: context switches: %ld voluntary, %ld involuntary\n", argv[0], ru.ru_nvcsw, ru.ru_nivcsw);
+  printf("%s: counter went from %d to %d, %s\n", argv[0], before, after,
+         (after - before == nprocs * loops) ? "ok" : "LOST UPDATES");
+
+  exit((after - before == nprocs * loops) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/*
+ * Every worker creates (or opens) the semaphore itself, like separate programs would.
+*/
+void worker (loops)
+int loops; {
+  int   fd = -1, i, pid, semid;
 
   pid = getpid();
 
-  if ( (fd = open(SEQFILE, 2)) < 0) {
+  if (!usemem && (fd = open(SEQFILE, 2)) < 0) {
     err_sys("can't open %s", SEQFILE);
   }
 
@@ -26,38 +134,61 @@ int main (void) {
     err_sys("can't open semaphore");
   }
 
-  for (i = 0; i < 20; i++) {
+  for (i = 0; i < loops; i++) {
     sem_wait(semid);      /* get the lock */
 
-    lseek(fd, 0L, 0);     /* rewind before read */
-
-    if ( (n = read(fd, buff, MAXBUFF)) <= 0) {
-      err_sys("read error");
+    if (usemem) {
+      (*memcount)++;
+    } else {
+      seqno_bump(fd, pid);
     }
-    buff[n] = '\0';       /* null terminate for sscanf */
 
-    if ( (n = sscanf(buff, "%d", &seqno)) != 1) {
-      err_sys("sscanf error");
-    }
+    sem_signal(semid);    /* release the lock */
+  }
 
-    printf("pid = %d, seq number = %d\n", pid, seqno);
+  sem_close(semid);
+}
+
+int seqno_get (fd)
+int fd; {
+  char  buff[MAXBUFF];
+  int   n, seqno;
+
+  lseek(fd, 0L, 0);       /* rewind before read */
 
-    seqno++;
+  if ( (n = read(fd, buff, MAXBUFF - 1)) <= 0) {
+    err_sys("read error");
+  }
+  buff[n] = '\0';         /* null terminate for sscanf */
 
-    sprintf(buff, "%03d\n", seqno);
+  if ( (n = sscanf(buff, "%d", &seqno)) != 1) {
+    err_sys("sscanf error");
+  }
 
-    n = strlen(buff);
+  return seqno;
+}
 
-    lseek(fd, 0L, 0);     /* rewind, again */
+void seqno_bump (fd, pid)
+int fd;
+int pid; {
+  char  buff[MAXBUFF];
+  int   n, seqno;
 
-    if (write(fd, buff, n) != n) {
-      err_sys("write error");
-    }
+  seqno = seqno_get(fd);
 
-    sem_signal(semid);
+  if (verbose) {
+    printf("pid = %d, seq number = %d\n", pid, seqno);
   }
 
-  sem_close(semid);       /* release the lock */
+  seqno++;
+
+  sprintf(buff, "%03d\n", seqno);
+
+  n = strlen(buff);
 
-  exit(EXIT_SUCCESS);
+  lseek(fd, 0L, 0);       /* rewind, again */
+
+  if (write(fd, buff, n) != n) {
+    err_sys("write error");
+  }
 }
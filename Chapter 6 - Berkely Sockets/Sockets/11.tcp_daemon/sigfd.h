@@ -0,0 +1,33 @@
+#ifndef SIGFD_H
+#define SIGFD_H
+
+/*
+ * Signals as a descriptor, so they can go into the same `select` as the sockets.
+ *
+ * With a plain signal handler the handler runs whenever the signal arrives, in the middle of whatever the daemon was
+ * doing, and every blocking call (`select`, `accept`, `read`, ...) may come back with EINTR. With a lot of children
+ * coming and going that's a lot of EINTRs, and a handler that does the real work (`wait3` in `sig_child`) has to be
+ * careful about everything it touches. Instead:
+ *
+ *    ->  Linux:  The signals are blocked and read from a `signalfd`. No handler runs at all, the signal just makes the
+ *                descriptor readable until it's read.
+ *    ->  Others: A self-pipe. The handler only writes the signal number to a pipe (non-blocking, errno preserved), the
+ *                read end is what goes into `select`. The handlers are installed with SA_RESTART so only the wait
+ *                itself may see an EINTR, and nothing is lost if it does: the byte is still in the pipe.
+ *
+ * Signals of the same kind don't queue, so one SIGCHLD may mean several children exited. Always reap in a loop with
+ * WNOHANG until there's nothing left.
+*/
+
+/*
+ * sigfd_open:  Route the `n` signals in `sigs` to a descriptor. Returns the descriptor (non-blocking, close-on-exec)
+ *              or -1 on error.
+ * sigfd_next:  The next signal that arrived, 0 if there's none left (the descriptor is drained), -1 on error.
+ * sigfd_child: Call in a child after `fork`: closes the descriptor and puts the signals back the way they were (not
+ *              blocked, default action), so the child (or whatever it `exec`s) gets them normally.
+*/
+int   sigfd_open    (const int *sigs, int n);
+int   sigfd_next    (int fd);
+void  sigfd_child   (int fd);
+
+#endif  /* SIGFD_H */
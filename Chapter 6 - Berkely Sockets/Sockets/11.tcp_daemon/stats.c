@@ -0,0 +1,328 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* clock_gettime and CLOCK_MONOTONIC with -ansi */
+#endif
+
+#include "stats.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define   STATS_DUMP_LEN    8192      /* big enough for STATS_MAX_SERVICES services */
+
+/*
+ * The block used when no shared memory is requested (or `shmget` failed).
+*/
+static stats_block  local_block;
+static stats_block  *sb = &local_block;
+
+/*
+ * Children we are waiting for, so the reaper can find which service a pid belonged to and how long it lived.
+ * This table is private to the daemon, so it's not part of the (possibly shared) stats block.
+*/
+static struct {
+  pid_t             pid;          /* 0 if the slot is free */
+  int               sid;
+  struct timespec   started;
+} children[STATS_MAX_CHILDREN];
+
+void stats_now (struct timespec *ts) {
+  clock_gettime(CLOCK_MONOTONIC, ts);
+}
+
+stats_block *stats_get (void) {
+  return sb;
+}
+
+static unsigned long long elapsed_us (const struct timespec *from, const struct timespec *to) {
+  long long us;
+
+  us = (long long) (to->tv_sec - from->tv_sec) * 1000000LL + (to->tv_nsec - from->tv_nsec) / 1000;
+  return (us < 0) ? 0 : (unsigned long long) us;
+}
+
+static void hist_add (stats_hist *h, unsigned long long us) {
+  int i = 0;
+
+  /* bucket i holds [2^(i-1), 2^i), so 0us goes to bucket 0, 1us to bucket 1, 2-3us to bucket 2, ... */
+  while (i < STATS_HIST_BUCKETS - 1 && (us >> i) != 0) {
+    i++;
+  }
+  h->bucket[i]++;
+  h->count++;
+  h->sum_us += us;
+  if (us > h->max_us) {
+    h->max_us = us;
+  }
+}
+
+/*
+ * All the updates are made from the daemon's main loop (children are reaped there too, see sigfd.h), so nothing in
+ * this process can interleave with them. Another process can: after a hot upgrade the old daemon and the new one write
+ * the same shared block until the old one is gone. So an update takes `lock` first (a spin lock with the owner's pid,
+ * held for a few instructions; if the owner died holding it, it's taken over), and only then makes `seq` odd. The seq
+ * counter is for the readers of the shared memory copy.
+*/
+static void update_begin (void) {
+  int   pid = getpid(), owner;
+
+  for (;;) {
+    owner = 0;
+    if (__atomic_compare_exchange_n(&sb->lock, &owner, pid, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      break;
+    }
+    if (kill(owner, 0) < 0 && errno == ESRCH &&
+        __atomic_compare_exchange_n(&sb->lock, &owner, pid, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+  __atomic_add_fetch(&sb->seq, 1, __ATOMIC_SEQ_CST);
+}
+
+static void update_end (void) {
+  __atomic_add_fetch(&sb->seq, 1, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&sb->lock, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Is the (shared) block one for these services? Then an upgraded daemon can carry on with it.
+*/
+static int same_services (const char **names, const int *dgram, int nservices) {
+  int   i;
+
+  if (sb->nservices != nservices) {
+    return 0;
+  }
+  for (i = 0; i < nservices; i++) {
+    if (strncmp(sb->svc[i].name, names[i], STATS_NAME_LEN - 1) != 0 || sb->svc[i].is_dgram != dgram[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int stats_init (const char **names, const int *dgram, int nservices, key_t shmkey, int adopt) {
+  int           shmid, i, rc = 0;
+  stats_block   *shared;
+
+  if (nservices > STATS_MAX_SERVICES) {
+    nservices = STATS_MAX_SERVICES;
+  }
+
+  if (shmkey != IPC_PRIVATE) {
+    /*
+     * Readers attach with `shmget(key, 0, 0)` so they don't need to know our size, but they must be built with
+     * the same stats.h.
+    */
+    if ( (shmid = shmget(shmkey, sizeof(stats_block), 0644 | IPC_CREAT)) < 0) {
+      rc = -1;
+    } else if ( (shared = (stats_block *) shmat(shmid, (char *) 0, 0)) == (stats_block *) -1) {
+      rc = -1;
+    } else {
+      sb = shared;
+    }
+  }
+
+  memset(children, 0, sizeof(children));
+
+  /*
+   * Clearing the block under the old daemon would lose its counters, and tear `seq` under a reader. Its children
+   * aren't ours (they're not in `children`), it reaps them and takes them out of `active` itself.
+  */
+  if (adopt && sb != &local_block && same_services(names, dgram, nservices)) {
+    update_begin();
+    sb->pid     = getpid();
+    sb->started = time((time_t *) 0);
+    update_end();
+    return rc;
+  }
+
+  memset(sb, 0, sizeof(stats_block));
+  sb->pid       = getpid();
+  sb->started   = time((time_t *) 0);
+  sb->nservices = nservices;
+  for (i = 0; i < nservices; i++) {
+    strncpy(sb->svc[i].name, names[i], STATS_NAME_LEN - 1);
+    sb->svc[i].is_dgram = dgram[i];
+  }
+
+  return rc;
+}
+
+int stats_listen (const char *path) {
+  int                 fd;
+  struct sockaddr_un  addr;
+
+  if ( (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+  unlink(path);         /* left over from a previous run */
+
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, 5) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+void stats_serve (int listenfd) {
+  int   fd, n;
+  char  buf[STATS_DUMP_LEN];
+
+  if ( (fd = accept(listenfd, (struct sockaddr *) 0, (socklen_t *) 0)) < 0) {
+    return;
+  }
+
+  n = stats_format(sb, buf, sizeof(buf));
+  if (write(fd, buf, n) != n) {
+    ;       /* the reader went away, nothing we can do about it */
+  }
+  close(fd);
+}
+
+static int format_hist (char *buf, int buflen, const char *name, const char *what, const stats_hist *h) {
+  int   n, last, i;
+
+  n = snprintf(buf, buflen, "%s %s n=%lu sum=%llu max=%llu hist=", name, what, h->count, h->sum_us, h->max_us);
+
+  /* only print up to the last non-empty bucket */
+  for (last = STATS_HIST_BUCKETS - 1; last > 0 && h->bucket[last] == 0; last--) {
+    ;
+  }
+  for (i = 0; i <= last && n < buflen; i++) {
+    n += snprintf(buf + n, buflen - n, (i == 0) ? "%lu" : ",%lu", h->bucket[i]);
+  }
+  if (n < buflen) {
+    n += snprintf(buf + n, buflen - n, "\n");
+  }
+
+  return (n < buflen) ? n : buflen - 1;
+}
+
+/*
+ * The dump looks like this (one header line, then three lines per service):
+ *
+ *    # pid 4242 uptime 360 active 1
+ *    str_echo accepts=12 spawns=12 spawn_err=0 active=1 exit=10/1/0 busy_us=0
+ *    str_echo spawn_us n=12 sum=1834 max=402 hist=0,0,0,0,0,0,0,3,8,1
+ *    str_echo life_us n=11 sum=9120337 max=4015221 hist=...
+ *
+ * `exit` is ok/fail/signalled. Histogram bucket i counts samples in [2^(i-1), 2^i) microseconds.
+*/
+int stats_format (const stats_block *blk, char *buf, int buflen) {
+  int                   n, i;
+  const stats_service   *s;
+
+  n = snprintf(buf, buflen, "# pid %d uptime %ld active %ld\n",
+               (int) blk->pid, (long) (time((time_t *) 0) - blk->started), blk->active);
+
+  for (i = 0; i < blk->nservices && n < buflen - 1; i++) {
+    s = &blk->svc[i];
+    n += snprintf(buf + n, buflen - n, "%s accepts=%lu spawns=%lu spawn_err=%lu active=%ld exit=%lu/%lu/%lu busy_us=%llu\n",
+                  s->name, s->accepts, s->spawns, s->spawn_errors, s->active,
+                  s->exit_ok, s->exit_fail, s->exit_signal, s->busy_us);
+    if (n >= buflen - 1) {
+      break;
+    }
+    n += format_hist(buf + n, buflen - n, s->name, "spawn_us", &s->spawn_latency);
+    n += format_hist(buf + n, buflen - n, s->name, "life_us", &s->lifetime);
+  }
+
+  if (n >= buflen) {
+    n = buflen - 1;
+  }
+  return n;
+}
+
+void stats_accept (int sid) {
+  update_begin();
+  sb->svc[sid].accepts++;
+  update_end();
+}
+
+void stats_spawn_error (int sid) {
+  update_begin();
+  sb->svc[sid].spawn_errors++;
+  update_end();
+}
+
+void stats_spawn (int sid, pid_t pid, const struct timespec *ready) {
+  int               i;
+  struct timespec   now;
+
+  stats_now(&now);
+
+  update_begin();
+  sb->svc[sid].spawns++;
+  sb->svc[sid].active++;
+  sb->active++;
+  hist_add(&sb->svc[sid].spawn_latency, elapsed_us(ready, &now));
+
+  /* if the table is full we just lose the lifetime of this child, the counters above are still right */
+  for (i = 0; i < STATS_MAX_CHILDREN; i++) {
+    if (children[i].pid == 0) {
+      children[i].pid     = pid;
+      children[i].sid     = sid;
+      children[i].started = now;
+      break;
+    }
+  }
+  update_end();
+}
+
+/*
+ * Called for every child reaped with wait.
+*/
+int stats_child_exit (pid_t pid, int status) {
+  int                   i, sid = -1;
+  unsigned long long    us;
+  struct timespec       now;
+  stats_service         *s;
+
+  for (i = 0; i < STATS_MAX_CHILDREN; i++) {
+    if (children[i].pid == pid) {
+      break;
+    }
+  }
+  if (i == STATS_MAX_CHILDREN) {
+    return -1;
+  }
+
+  stats_now(&now);
+  us  = elapsed_us(&children[i].started, &now);
+  sid = children[i].sid;
+  s   = &sb->svc[sid];
+  children[i].pid = 0;
+
+  update_begin();
+  s->active--;
+  sb->active--;
+  hist_add(&s->lifetime, us);
+  if (s->is_dgram) {
+    s->busy_us += us;         /* the datagram socket is taken away from `select` for the whole life of the child */
+  }
+  if (WIFSIGNALED(status)) {
+    s->exit_signal++;
+  } else if (WIFEXITED(status) && WEXITSTATUS(status) == STATS_EXEC_FAILED) {
+    s->spawn_errors++;
+  } else if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+    s->exit_ok++;
+  } else {
+    s->exit_fail++;
+  }
+  update_end();
+
+  return sid;
+}
@@ -0,0 +1,117 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*
+ * In-memory counters and histograms for the daemons (`inetd` and `tcp_daemon`).
+ *
+ * The daemons can't print anything (no controlling terminal, fd 0, 1 and 2 point to /dev/null), and `write_log` only
+ * gives us free-text lines. So the daemon keeps one `stats_block` which is updated on the accept/fork/reap path, and
+ * can be read in two ways:
+ *    1.  Connect to the Unix domain stream socket returned by `stats_listen`. The daemon writes a compact text dump
+ *        (see `stats_format`) and closes the connection. Something like `nc -U /tmp/inetd.stats` (or `/tmp/tcp_daemon.stats`) will do.
+ *    2.  If the daemon was started with the shared memory option, the `stats_block` itself lives in a System V shared
+ *        memory segment. A scraper can `shmat` it and read the counters without asking the daemon anything. The `seq`
+ *        member is odd while the daemon is in the middle of an update, so a reader copies the block and retries if
+ *        `seq` was odd or changed during the copy.
+ *        During a hot upgrade the new daemon adopts the segment as it is (the counters go on), while the old one is
+ *        still reaping its children into it. The two writers take turns with `lock`.
+*/
+
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <time.h>
+
+#define   STATS_MAX_SERVICES    8       /* more than enough for our hard-coded services */
+#define   STATS_MAX_CHILDREN    256     /* children we can keep track of at the same time */
+#define   STATS_HIST_BUCKETS    24      /* bucket i counts samples in [2^(i-1), 2^i) microseconds, last one is open */
+#define   STATS_NAME_LEN        16
+
+/*
+ * Log2 histogram of durations, in microseconds.
+*/
+typedef struct {
+  unsigned long         count;
+  unsigned long long    sum_us;
+  unsigned long long    max_us;
+  unsigned long         bucket[STATS_HIST_BUCKETS];
+} stats_hist;
+
+typedef struct {
+  char                  name[STATS_NAME_LEN];   /* service name, same as `services.service` in inetd */
+  int                   is_dgram;               /* datagram services track busy time */
+  unsigned long         accepts;                /* connections accepted (stream) or readiness events taken (datagram) */
+  unsigned long         spawns;                 /* successful forks */
+  unsigned long         spawn_errors;           /* failed accepts, forks or execs */
+  long                  active;                 /* children of this service that are still running */
+  unsigned long         exit_ok;                /* exit(0) */
+  unsigned long         exit_fail;              /* exit(non-zero) */
+  unsigned long         exit_signal;            /* killed by a signal */
+  unsigned long long    busy_us;                /* datagram: total time an instance owned the socket */
+  stats_hist            spawn_latency;          /* socket ready -> fork returned in the parent */
+  stats_hist            lifetime;               /* fork -> child reaped */
+} stats_service;
+
+typedef struct {
+  volatile unsigned long  seq;                  /* odd while an update is in progress */
+  int                     lock;                 /* pid of the daemon updating the block, 0 if none */
+  pid_t                   pid;                  /* pid of the daemon that owns the block */
+  time_t                  started;              /* wall clock time the daemon started */
+  int                     nservices;
+  long                    active;               /* sum of `active` over every service */
+  stats_service           svc[STATS_MAX_SERVICES];
+} stats_block;
+
+/*
+ * stats_init:  Set up the stats block for `nservices` services, named by `names`, `dgram[i]` non-zero for datagram
+ *              services. If `shmkey` is not IPC_PRIVATE, the block is placed in a shared memory segment with that key
+ *              (created if needed), otherwise it's a plain static variable.
+ *              With `adopt` (started by a hot upgrade), a shared block for the same services is taken over as it is,
+ *              only `pid` and `started` change: it's still being written by the old daemon. Otherwise it's cleared.
+ *              Returns 0 if all OK, -1 on error (the static block is still usable in that case).
+*/
+int   stats_init          (const char **names, const int *dgram, int nservices, key_t shmkey, int adopt);
+
+/*
+ * stats_listen:  Create, bind and listen on a Unix domain stream socket at `path` (removed first if it exists).
+ *                Returns the socket descriptor, or -1 on error.
+*/
+int   stats_listen        (const char *path);
+
+/*
+ * stats_serve: Called when the descriptor from `stats_listen` is ready for reading. Accepts one connection,
+ *              writes the dump and closes it.
+*/
+void  stats_serve         (int listenfd);
+
+/*
+ * stats_format:  Write the text dump into `buf` (at most `buflen` bytes, always null terminated).
+ *                Returns the number of bytes written (excluding the null).
+*/
+int   stats_format        (const stats_block *sb, char *buf, int buflen);
+
+/*
+ * stats_accept:      A connection was accepted (or a datagram socket became readable) for service `sid`.
+ * stats_spawn_error: accept or fork failed for service `sid`. Called in the parent, which goes on serving.
+ * stats_spawn:       fork succeeded, `pid` serves service `sid`. `ready` is when `select` said the socket was ready.
+ * stats_child_exit:  `pid` was reaped with `status` (from wait). A child that exited with STATS_EXEC_FAILED never
+ *                    ran the server (its exec failed), and is a spawn error, not a failed exit.
+ *                    Returns the service index of the child, or -1 if we weren't tracking it.
+*/
+#define   STATS_EXEC_FAILED   127       /* the exit status of a child whose exec failed, as in the shell */
+
+void  stats_accept        (int sid);
+void  stats_spawn_error   (int sid);
+void  stats_spawn         (int sid, pid_t pid, const struct timespec *ready);
+int   stats_child_exit    (pid_t pid, int status);
+
+/*
+ * stats_now: monotonic clock, used for the `ready` argument of stats_spawn.
+*/
+void  stats_now           (struct timespec *ts);
+
+/*
+ * stats_get: the live stats block (static or shared memory).
+*/
+stats_block *stats_get    (void);
+
+#endif  /* STATS_H */
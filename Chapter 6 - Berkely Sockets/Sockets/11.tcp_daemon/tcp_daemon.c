@@ -18,19 +18,32 @@ extern int errno;
 #endif
 
 #include <sys/socket.h>
+#include <sys/select.h>
 #include <netinet/in.h>
 
 #include "utils.h"
+#include "stats.h"
+#include "upgrade.h"
+#include "sigfd.h"
 
 #define MSG_LEN 256
 
+#define STATS_PATH    "/tmp/tcp_daemon.stats"     /* Unix domain socket where the counters can be read */
+#define STATS_SHMKEY  ((key_t) 6968L)             /* shared memory key, used if started with `-m` */
+
+static int stats_shm = 0;     /* `-m`: also keep the counters in shared memory */
+
+/* for the hot upgrade (see upgrade.h), the new binary is started the same way we were */
+static char                   **saved_argv;
+static char                   start_dir[MAXPATHLEN];
+
 /*
  * SIGCHLD: Signal is sent to the parent process when a child process terminates. Typically, it is discarded if the process 
  *          does not catch it. For 4.3BSD, this signal also indicates that the status of a child process has changed. This is 
  *          more general than just indicating the death of a child process. The change in status can be the death of a child 
  *          process, or it can be that a child process is stopped by a SIGSTOP, SIGTTIN, SIGTTOU, or SIGTSTP signal.
 */
-void sig_child        (int sig_id);
+void reap_children    (void);
 void daemon_start     (int ignore_sig_child);
 
 /*
@@ -45,15 +58,30 @@ void daemon_start     (int ignore_sig_child);
 */
 
 /* hard-coded entry point for a daemon */
-int main (void) {
+int main (int argc, char **argv) {
+
+  if (argc == 2 && strcmp(argv[1], "-m") == 0) {
+    stats_shm = 1;
+  } else if (argc != 1) {
+    fprintf(stderr, "usage: %s [-m]\n", argv[0]);
+    exit(1);
+  }
+
+  saved_argv = argv;
+  if (getcwd(start_dir, sizeof(start_dir)) == NULL) {
+    strcpy(start_dir, "/");
+  }
 
   printf("Initiating the daemon...\n");
-  daemon_start(1);
+  daemon_start(0);
 
   return 0;
 }
 
-void sig_child (int sig_id) {
+/*
+ * Called from the `select` loop when SIGCHLD came in (see sigfd.h), never from a signal handler.
+*/
+void reap_children (void) {
   int pid;
   int status;
 
@@ -64,14 +92,18 @@ void sig_child (int sig_id) {
    * sent only when the child process terminates.
   */
   while ((pid = wait3(&status, WNOHANG, (struct rusage *) 0)) > 0) {
-    ;
+    stats_child_exit(pid, status);
   }
 }
 
+
 void daemon_start (int ignore_sig_child) {
   register int childpid, fd, log_fd;
 
-  if (getppid() == 1) {
+  /* 
+   * Started by a hot upgrade: no terminal to lose, and the descriptors we got (the listening socket) must stay open.
+  */
+  if (getppid() == 1 || upgrade_adopting()) {
     goto out;
   }
 
@@ -131,7 +163,7 @@ void daemon_start (int ignore_sig_child) {
   #endif 
 
   out:
-    for (fd = 0; fd < NOFILE; fd++) {
+    for (fd = 0; fd < NOFILE && !upgrade_adopting(); fd++) {
       close(fd);
     }
 
@@ -141,9 +173,13 @@ void daemon_start (int ignore_sig_child) {
 
     umask(0);
 
+    /* 
+     * Nobody will `wait` for the children, let the system reap them (an ignored SIGCHLD does that on BSD as well).
+     * We pass 0, the children are reaped in the `select` loop below.
+    */
     if (ignore_sig_child) {
       #ifdef SIGTSTP
-        signal(SIGCHLD, sig_child);
+        signal(SIGCHLD, SIG_IGN);
       #else 
         signal(SIGCLD, SIG_IGN);        /* System V */
       #endif  /* SIGTSTP */
@@ -173,47 +209,170 @@ void daemon_start (int ignore_sig_child) {
    * for standard output) as we have previously closed all other descriptor.
   */
   int new_log_fd = dup(log_fd);
-  
+
   int                 sockfd;
   int                 accepted_sock_fd;
   int                 client_sockaddr_size = sizeof(struct sockaddr_in);
   int                 concurrent_child_fd;
+  int                 stats_fd, max_fd;
+  fd_set              read_fds;
+  struct timespec     ready;
   struct sockaddr_in  any_addr, client_addr;
+  const char          *stats_name   = "str_echo";
+  int                 stats_dgram   = 0;
+  pid_t               new_daemon    = 0;
+  int                 status;
+  int                 sig_fd, signo;
+  const int           sigs[]        = { SIGCHLD, SIGHUP, SIGTERM, SIGUSR2 };
 
-  if ( (sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-    perror("socket error: failed to create a socket");
+  /*
+   * No signal handlers: SIGCHLD, SIGHUP (reopen the log), SIGTERM and SIGUSR2 (hot upgrade) are read in the loop.
+   * Before `log_init`, so the flusher thread starts with them blocked and the kernel can't hand them to it instead.
+  */
+  if ( (sig_fd = sigfd_open(sigs, sizeof(sigs) / sizeof(sigs[0]))) < 0) {
+    write_log(new_log_fd, "signal error: failed to route the signals to a descriptor\n");
+    return;
   }
 
-  any_addr.sin_family       = AF_INET;
-  any_addr.sin_port         = htons(6969);
-  any_addr.sin_addr.s_addr  = htonl(INADDR_ANY);
+  /* from here on `write_log` only queues the message, a thread writes them out (the children write synchronously). */
+  if (log_init() < 0) {
+    write_log(new_log_fd, "log error: can't start the log flusher, logging synchronously\n");
+  }
 
-  if ( bind(sockfd, (struct sockaddr *) &any_addr, sizeof(any_addr)) < 0) {
-    perror("bind error: failed to bind well known address with port 6969.");
+  /* only one service here, so it's index 0 in the stats block. */
+  if (stats_init(&stats_name, &stats_dgram, 1, stats_shm ? STATS_SHMKEY : IPC_PRIVATE, upgrade_adopting()) < 0) {
+    write_log(new_log_fd, "stats error: can't attach the shared memory segment, counters are local only\n");
   }
 
-  if ( listen(sockfd, 5) < 0) {
-    write_log(new_log_fd, "listen error: failed to listen to 5 concurrent sockets for the speicifed Internet address and port\n");
-    return;
+  /* after a hot upgrade the socket is already bound and listening, it's the one the old daemon used */
+  if ( (sockfd = upgrade_inherited("str_echo")) < 0) {
+    if ( (sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+      perror("socket error: failed to create a socket");
+    }
+
+    any_addr.sin_family       = AF_INET;
+    any_addr.sin_port         = htons(6969);
+    any_addr.sin_addr.s_addr  = htonl(INADDR_ANY);
+
+    if ( bind(sockfd, (struct sockaddr *) &any_addr, sizeof(any_addr)) < 0) {
+      perror("bind error: failed to bind well known address with port 6969.");
+    }
+
+    if ( listen(sockfd, 5) < 0) {
+      write_log(new_log_fd, "listen error: failed to listen to 5 concurrent sockets for the speicifed Internet address and port\n");
+      return;
+    }
   }
 
+  if ( (stats_fd = stats_listen(STATS_PATH)) < 0) {
+    write_log(new_log_fd, "stats error: can't create the stats socket\n");
+  }
+  max_fd = (stats_fd > sockfd) ? stats_fd : sockfd;
+  if (sig_fd > max_fd) {
+    max_fd = sig_fd;
+  }
+
+  if (upgrade_adopting()) {
+    write_log(new_log_fd, "upgrade: took over the listening socket\n");
+    upgrade_ready();
+  }
+
+  /*
+   * We used to block in `accept`, but now there's also the stats socket to look after, so wait on both with `select`.
+   * The stats request is answered right here, it's just a `write` of the counters.
+  */
   for (;;) {
+    FD_ZERO(&read_fds);
+    FD_SET(sockfd, &read_fds);
+    FD_SET(sig_fd, &read_fds);
+    if (stats_fd >= 0) {
+      FD_SET(stats_fd, &read_fds);
+    }
+    if (select(max_fd + 1, &read_fds, (fd_set *) 0, (fd_set *) 0, (struct timeval *) 0) < 0) {
+      if (errno == EINTR) {
+        continue;       /* self-pipe only, the signal is waiting in `sig_fd` */
+      }
+      write_log(new_log_fd, "select error: failed to wait for the sockets\n");
+      return;
+    }
+    stats_now(&ready);
+
+    if (FD_ISSET(sig_fd, &read_fds)) {
+      while ( (signo = sigfd_next(sig_fd)) > 0) {
+        if (signo == SIGCHLD) {
+          reap_children();
+        } else if (signo == SIGHUP) {
+          log_flush_sync();
+          if ( (fd = open(log_path, O_RDWR | O_APPEND | O_CREAT, 0666)) >= 0) {
+            dup2(fd, log_fd);
+            dup2(fd, new_log_fd);
+            close(fd);
+          }
+          write_log(new_log_fd, "SIGHUP: log file reopened\n");
+        } else if (signo == SIGTERM) {
+          write_log(new_log_fd, "SIGTERM: shutting down\n");
+          unlink(STATS_PATH);
+          exit(0);
+        } else if (signo == SIGUSR2) {
+          write_log(new_log_fd, "upgrade: starting the new binary\n");
+          log_flush_sync();
+          if ( (new_daemon = upgrade_start(saved_argv, start_dir, &stats_name, &sockfd, 1)) < 0) {
+            write_log(new_log_fd, "upgrade error: the new binary didn't come up, carrying on\n");
+          }
+        }
+      }
+      if (new_daemon > 0) {
+        break;
+      }
+    }
+
+    if (stats_fd >= 0 && FD_ISSET(stats_fd, &read_fds)) {
+      stats_serve(stats_fd);
+    }
+    if (!FD_ISSET(sockfd, &read_fds)) {
+      continue;
+    }
+
     if ( (accepted_sock_fd = accept(sockfd, (struct sockaddr *) &client_addr, (socklen_t *) &client_sockaddr_size)) < 0) {
       write_log(new_log_fd, "accept error: failed to accept any connection\n"); 
-      return;
+      stats_spawn_error(0);
+      continue;
     } else {
+      stats_accept(0);
       if ( (concurrent_child_fd = fork()) < 0) {
         write_log(new_log_fd, "fork error: failed to fork a child process to handle the client\n");
-        return;
+        stats_spawn_error(0);
+        close(accepted_sock_fd);    /* the client sees the connection closed, the next one may get a child */
+        continue;
       } else if (concurrent_child_fd == 0) {
         close(sockfd);
+        if (stats_fd >= 0) {
+          close(stats_fd);
+        }
+        sigfd_child(sig_fd);
         // write_log(new_log_fd, "Hello, TCP Daemon!\n");
         str_echo(accepted_sock_fd, new_log_fd);
         shutdown(accepted_sock_fd, SHUT_RDWR);
         exit(0);    /* For now, we won't do much, maybe later... */
       } else {
         close(accepted_sock_fd);
+        stats_spawn(0, concurrent_child_fd, &ready);
       }
     }
   }
+
+  /*
+   * The new daemon is accepting on the same socket. Stop accepting, let the clients we already have finish, then exit.
+  */
+  close(sockfd);
+  if (stats_fd >= 0) {
+    close(stats_fd);
+  }
+  while ( (concurrent_child_fd = waitpid(-1, &status, 0)) > 0 || errno == EINTR) {
+    if (concurrent_child_fd > 0) {
+      stats_child_exit(concurrent_child_fd, status);
+    }
+  }
+  write_log(new_log_fd, "upgrade: handed over, all clients done, exiting\n");
+  exit(0);
 }
@@ -11,4 +11,15 @@ int   writen    (register int fd, register char *ptr, register int nbytes);
 
 int   write_log (int logfd, const char *logmsg);
 
+/*
+ * write_log only formats the message into an in-memory ring, a background thread writes it out (see write_log.c).
+ * log_init:        start the flusher thread, call it after `daemon_start`. Returns 0 if OK, -1 if the thread couldn't 
+ *                  be created (the messages are then written synchronously).
+ * log_flush_sync:  write out everything in the ring now, for fatal errors (also called at `exit`).
+ * log_dropped:     messages lost because the ring was full.
+*/
+int             log_init        (void);
+void            log_flush_sync  (void);
+unsigned long   log_dropped     (void);
+
 #endif  /* UTILS_H */
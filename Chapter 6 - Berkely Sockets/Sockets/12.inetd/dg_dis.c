@@ -12,23 +12,18 @@ int main (int argc, char **argv) {
 
   int   n, clilen;
   char  mesg[MAXMESG];
+  int   timeout = idle_timeout();     /* seconds, 0 = run until told to quit */
 
   struct sockaddr_in pcli_addr;
   bzero(&pcli_addr, sizeof(struct sockaddr_in));
-  struct sockaddr_in first_client;
-  bzero(&first_client, sizeof(struct sockaddr_in));
-  clilen = sizeof(struct sockaddr_in);
-  int   msgcnt = 0;
 
+  /* "wait" mode, same as dg_echo: serve every client until idle for `timeout` seconds. */
   for (;;) {
-    n = recvfrom(0, mesg, MAXMESG, 0, (struct sockaddr *) &pcli_addr, (socklen_t *) &clilen);
-    if (msgcnt == 0) {
-      memcpy(&first_client, &pcli_addr, sizeof(first_client));
-    } else {
-      if (first_client.sin_port != pcli_addr.sin_port) {
-        continue;
-      }
+    if (timeout > 0 && wait_readable(0, timeout) == 0) {
+      break;      /* idle */
     }
+    clilen = sizeof(struct sockaddr_in);
+    n = recvfrom(0, mesg, MAXMESG, 0, (struct sockaddr *) &pcli_addr, (socklen_t *) &clilen);
 
     if (n < 0) {
       exit(EXIT_FAILURE);
@@ -51,7 +46,6 @@ int main (int argc, char **argv) {
       // perror("dg_echo: sendto error.");
       exit(EXIT_FAILURE);
     }
-    msgcnt++;
   }
 
   close(0);
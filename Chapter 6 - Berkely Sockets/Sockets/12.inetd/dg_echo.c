@@ -12,22 +12,22 @@ int main (int argc, char **argv) {
 
   int   n, clilen;
   char  mesg[MAXMESG];
+  int   timeout = idle_timeout();     /* seconds, 0 = run until told to quit */
 
   struct sockaddr_in pcli_addr;
-  struct sockaddr_in first_client;
   bzero(&pcli_addr, sizeof(struct sockaddr_in));
-  clilen = sizeof(struct sockaddr_in);
-  int   msgcnt = 0;
 
+  /*
+   * inetd runs us in "wait" mode: we own the socket (fd 0) until we exit, and every client that sends something 
+   * gets served by this one process. Once nobody has said anything for `timeout` seconds we exit, and inetd 
+   * goes back to watching the socket.
+  */
   for (;;) {
-    n = recvfrom(0, mesg, MAXMESG, 0, (struct sockaddr *) &pcli_addr, (socklen_t *) &clilen);
-    if (msgcnt == 0) {
-      memcpy(&first_client, &pcli_addr, sizeof(first_client));
-    } else {
-      if (first_client.sin_port != pcli_addr.sin_port) {
-        continue;
-      }
+    if (timeout > 0 && wait_readable(0, timeout) == 0) {
+      break;      /* idle */
     }
+    clilen = sizeof(struct sockaddr_in);
+    n = recvfrom(0, mesg, MAXMESG, 0, (struct sockaddr *) &pcli_addr, (socklen_t *) &clilen);
     if (n < 0) {
       exit(EXIT_FAILURE);
     }
@@ -42,7 +42,6 @@ int main (int argc, char **argv) {
       // perror("dg_echo: sendto error.");
       exit(EXIT_FAILURE);
     }
-    msgcnt++;
   }
 
   close(0);
@@ -0,0 +1,35 @@
+#include "utils.h"
+#include <sys/select.h>
+
+/*
+ * Helpers for the datagram services, which inetd runs in "wait" mode: one instance gets the bound socket and keeps
+ * it until it has been idle for a while, then exits so inetd watches the socket again.
+*/
+
+int idle_timeout (void) {
+  char  *val;
+
+  /* inetd only sets it for datagram services, make sure fd 0 really is the socket it talks about */
+  if ( (val = getenv("INETD_LISTEN_FDS")) == NULL || atoi(val) < 1) {
+    return 0;
+  }
+  if ( (val = getenv("INETD_IDLE_TIMEOUT")) == NULL) {
+    return 0;
+  }
+  return atoi(val);
+}
+
+int wait_readable (int fd, int seconds) {
+  fd_set          rset;
+  struct timeval  tv;
+  int             n;
+
+  do {
+    FD_ZERO(&rset);
+    FD_SET(fd, &rset);
+    tv.tv_sec   = seconds;
+    tv.tv_usec  = 0;
+  } while ( (n = select(fd + 1, &rset, (fd_set *) 0, (fd_set *) 0, &tv)) < 0 && errno == EINTR);
+
+  return n;
+}
@@ -1,3 +1,7 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* getopt and kill with -ansi */
+#endif
+
 /*
  * Some of the steps which are done by `inetd` will be described below. We'll first discuss how it functions for stream socket 
  * (or TCP), and later discuss how it will function for datagram socket (UDP). The steps described are taken from the text.
@@ -96,6 +100,9 @@
 */
 
 #include "utils.h"
+#include "stats.h"
+#include "upgrade.h"
+#include "sigfd.h"
 
 #include <sys/select.h>
 #include <sys/ioctl.h>
@@ -108,7 +115,11 @@
 
 #define   PATH_LEN  512
 
+#define   STATS_PATH    "/tmp/inetd.stats"      /* Unix domain socket where the counters can be read */
+#define   STATS_SHMKEY  ((key_t) 6969L)         /* shared memory key, used if started with `-m` */
+
 extern int errno;
+extern char **environ;
 
 /*
  * Surely, there's a better way to handle distinct services. But this is a naive approach due to my 
@@ -127,11 +138,13 @@ typedef struct services {
   pid_t                 child_pid;          /* process ID of the child process, used by datagram sockets */
 } services;
 
-int         udp_select_conn     = 0;        /* `select`ed for reading datagram sockets, need to make sure they aren't again set. */
-fd_set      read_sockfds;                   /* set of file descriptors, used by `select` */
+fd_set      read_sockfds;                   /* set of file descriptors, used by `select`, rebuilt every time */
 services    serv_arr[4];                    /* replacement for `inetd`'s way of reading from file, naive approach */
+int         dg_idle_timeout     = 0;        /* `-t`: seconds a datagram instance may sit idle before exiting, 0 = never */
 
-void sig_child        (int sig_id);
+void  reap_children   (void);
+pid_t spawn_service   (services *serv, int fd, const char *exec_path, int logfd);
+pid_t hot_upgrade     (char **argv, const char *cwd, int logfd);
 void daemon_start     (int ignore_sig_child);
 
 /*
@@ -150,20 +163,41 @@ void daemon_start     (int ignore_sig_child);
  * When the terminating command is received by the server, it closes the service and exits, 
  * making the service again "ready-to-read". The client won't know about this because of the 
  * connection-less property, so if it again sends a messsage to the client, the service is 
- * re-run. One more thing, the datagram service keeps track of the first client's port address,
- * so if other client attempts to write to the server, the server will neglect it.
+ * re-run. The same happens when the service was idle for the `-t` timeout. While the datagram 
+ * service runs it owns the socket and serves every client that writes to it.
 */
-int main (void) {
+int main (int argc, char **argv) {
 
   int                 logfd;                                            /* log file descriptor, as daemon can't use the terminal. */
   int                 accept_sockfd;                                    /* used by stream sockets */
   int                 pid;                                              /* used when `fork`ing */             
   int                 sockaddr_in_len = sizeof(struct sockaddr_in);     /* size of Internet address structure, 16 bytes*/
   int                 max_sockfd      = 0;                              /* used to keep track of highest file descriptor, used by `select` */
-  int                 clear_fd        = 0;                              /* used by datagram socket before service. */
-
-  /* basic chores */
-  FD_ZERO(&read_sockfds);
+  int                 opt, fd;
+  int                 sig_fd;                                           /* SIGCHLD, SIGHUP, SIGTERM and SIGUSR2 show up here */
+  int                 signo;
+  const int           sigs[]          = { SIGCHLD, SIGHUP, SIGTERM, SIGUSR2 };
+  pid_t               new_inetd       = 0;                              /* set once we handed the sockets over */
+  int                 status;
+  int                 stats_fd;                                         /* Unix domain socket for reading the counters */
+  int                 stats_shm       = 0;                              /* `-m`: also keep the counters in shared memory */
+  struct timespec     ready;                                            /* when `select` returned, for the spawn latency */
+  const char          *stats_names[ARR_ELE_CNT(serv_arr)];
+  int                 stats_dgram[ARR_ELE_CNT(serv_arr)];
+
+  while ( (opt = getopt(argc, argv, "mt:")) != -1) {
+    switch (opt) {
+      case 'm':
+        stats_shm = 1;
+        break;
+      case 't':
+        dg_idle_timeout = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-m] [-t idle-seconds]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
 
   /* For str_echo */
   serv_arr[0].sock_type     = 0;
@@ -200,15 +234,16 @@ int main (void) {
   cwd[path_len] = '/';          /* could add this to member `service` above, but this is better. */
   cwd[path_len + 1] = '\0';     /* extra secure :) */
 
-  daemon_start(1);
+  daemon_start(0);
   /* 
    * Set the current process group ID as the process ID of this process ID. (the new process group leader)
    * Removed the association with the controlling terminal.
    * Removed all the file descriptors (except fd 0, 1, and 2. They will be redirected once select returns a connection.)
    * Changed the current directory for process to "/"
    * Changed the umask to 0. (was probably 0022 before.)
-   * Activated the signal handler for SIGCHLD.
    * `errno` set to 0.
+   *
+   * The signals are routed to `sig_fd` below, and handled in the `select` loop along with the sockets.
   */
 
   const char *log_path = "./tmp/inetd.txt";
@@ -224,10 +259,54 @@ int main (void) {
     exit(EXIT_FAILURE);
   }
 
+  /*
+   * No signal handlers in the daemon: children exiting (SIGCHLD), log rotation (SIGHUP), shutdown (SIGTERM) and hot 
+   * upgrade (SIGUSR2) are all read from `sig_fd` in the main loop. See sigfd.h.
+   * This comes before `log_init`: a thread starts with its creator's signal mask, so the flusher thread gets them
+   * blocked too. Otherwise the kernel could deliver them to it, and they'd never show up on the signalfd.
+  */
+  if ( (sig_fd = sigfd_open(sigs, ARR_ELE_CNT(sigs))) < 0) {
+    write_log(logfd, "signal error: failed to route the signals to a descriptor\n");
+    exit(EXIT_FAILURE);
+  }
+  max_sockfd = sig_fd;
+
+  /* from here on `write_log` only queues the message, a thread writes them out. Must be after `daemon_start`. */
+  if (log_init() < 0) {
+    write_log(logfd, "log error: can't start the log flusher, logging synchronously\n");
+  }
+
+  /*
+   * Counters for every service (index `i` in the stats block is index `i` in serv_arr). This has to be done after
+   * `daemon_start` as the pid changed and all the descriptors were closed there.
+  */
+  for (int i = 0; i < (int) ARR_ELE_CNT(serv_arr); i++) {
+    stats_names[i] = serv_arr[i].service;
+    stats_dgram[i] = serv_arr[i].sock_type;
+  }
+  if (stats_init(stats_names, stats_dgram, ARR_ELE_CNT(serv_arr), stats_shm ? STATS_SHMKEY : IPC_PRIVATE,
+                 upgrade_adopting()) < 0) {
+    write_log(logfd, "stats error: can't attach the shared memory segment, counters are local only\n");
+  }
+  if ( (stats_fd = stats_listen(STATS_PATH)) < 0) {
+    write_log(logfd, "stats error: can't create the stats socket\n");
+  } else {
+    if (stats_fd > max_sockfd) {
+      max_sockfd = stats_fd;
+    }
+  }
+
   /*
    * Initialize all the sockets, bind them as well. `inetd` reads the file to do this, but I created a basic structure for this.
   */
   for (int i = 0; i < (int) ARR_ELE_CNT(serv_arr); i++) {
+    /* started by a hot upgrade, the socket is already created, bound (and listening) */
+    if ( (serv_arr[i].sockfd = upgrade_inherited(serv_arr[i].service)) >= 0) {
+      if (serv_arr[i].sockfd > max_sockfd) {
+        max_sockfd = serv_arr[i].sockfd;
+      }
+      continue;
+    }
     switch (serv_arr[i].sock_type) {
       case 0:   /* stream socket */
         if ( (serv_arr[i].sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
@@ -249,8 +328,6 @@ int main (void) {
         if (serv_arr[i].sockfd > max_sockfd) {
           max_sockfd = serv_arr[i].sockfd;
         }
-        /* set the socket for `select` */
-        FD_SET(serv_arr[i].sockfd, &read_sockfds);
         break;
       case 1:
         if ( (serv_arr[i].sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
@@ -268,21 +345,43 @@ int main (void) {
         if (serv_arr[i].sockfd > max_sockfd) {
           max_sockfd = serv_arr[i].sockfd;
         }
-        /* set the socket for `select` */
-        FD_SET(serv_arr[i].sockfd, &read_sockfds);
         break;
       default:
         exit(EXIT_FAILURE);
     }
   }
 
+  /*
+   * Children are reaped in the loop (`reap_children`), which clears `child_pid` of a datagram service whose instance
+   * exited. The read set is rebuilt from `serv_arr` before every wait, so the socket is re-armed exactly when its
+   * instance is gone.
+  */
+
+  /* everything is in place, if an old `inetd` is waiting for us it can go away now. */
+  if (upgrade_adopting()) {
+    write_log(logfd, "upgrade: took over the sockets\n");
+    upgrade_ready();
+  }
+
   for (;;) {
+    FD_ZERO(&read_sockfds);
+    FD_SET(sig_fd, &read_sockfds);
+    for (int j = 0; j < (int) ARR_ELE_CNT(serv_arr); j++) {
+      /* a datagram socket belongs to its instance while it runs ("wait" in inetd.conf) */
+      if (serv_arr[j].sock_type == 0 || serv_arr[j].child_pid == 0) {
+        FD_SET(serv_arr[j].sockfd, &read_sockfds);
+      }
+    }
+    if (stats_fd >= 0) {
+      FD_SET(stats_fd, &read_sockfds);
+    }
+
     /* 
      * Wait for any of the socket to become ready for reading, i.e., stream socket waits till a connection
      * is requested by the client, and datagram socket waits till the client sends a message to the socket.
     */
     if (select(max_sockfd + 1, &read_sockfds, (fd_set *) 0, (fd_set *) 0, (struct timeval *) 0) < 0) {
-      /* May be interrupted when a child process terminates. EINTR is returned in such case. */
+      /* only with the self-pipe (not Linux), the signal itself is waiting in `sig_fd`. */
       if (errno == EINTR) {
         continue;
       }
@@ -290,243 +389,291 @@ int main (void) {
       write_log(logfd, "select error: failed to select a socket available for reading\n");
       exit(EXIT_FAILURE);
     }
-    /* 
-     * cwd contains the current working directory, exec_path contains the path to the executable.
-     * The reason to have two of them is cause the program will later use `strlcat` to concatenate 
-     * the executable name to the path, and the program needs to handle multiple requests.
-    */
-    bzero(exec_path, sizeof(exec_path));
-    strlcpy(exec_path, cwd, sizeof(exec_path));
-    for (int i = 0; i < (int) ARR_ELE_CNT(serv_arr); i++) {
-      if (FD_ISSET(serv_arr[i].sockfd, &read_sockfds)) {
-        /* reached here if one of the socket is ready for reading. */
-        /*
-         * Some common things done by all of the connection:
-         *  
-         *  TCP:
-         *    1.  "zero" out the structure member `cli_addr` before sending it to `accept` (value-result).
-         *    2.  concatenate the executable file to the path.
-         *    3.  `fork` the process, the child process closes all the descriptor execpt for `accept`ed one,
-         *        use `dup2` to redirect the fd 0, 1, and 2 to `accept`ed socket, and close the `accept`ed socket.
-         *    4.  In the child process, use `execl` function to execute the executable.
-         *    5.  In the parent process, close the `accept`ed socket, and break from the loop. This loop is used to traverse through 
-         *        each socket descriptor and check if it's ready for reading. If one is found, we can break.
-         *
-         *  UDP:
-         *    1.  Copy the socket descriptor which is ready for reading into `clear_fd`
-         *    2.  Concatenate the executable to the path.
-         *    3.  `fork` the process, and in the child process, close all the descriptor execpt for `ready-to-read` socket descriptor.
-         *        Then `dup2` the socket descriptor to fd 0, 1, and 2, and then close it as well. Call the `execl` function to execute 
-         *        the server.
-         *    4.  In the parent process, keep track of the process ID of child process (in member `child_pid`). This is done to, a) clear
-         *        out the file descriptor as the datagram socket is not connection-oriented, and may only have one client, and b) use it 
-         *        to check if any recent child process which terminated, resembles the stored `child_pid`, to again set the socket for 
-         *        `ready-to-read`. `udp_select_conn` is used for similar purpose.
-         *    5.  break out of the loop.
-         *
-         * One final note: the second argument to `execl` function, which is the first argument to the executable, need not have any speicific 
-         * format, i.e. `./<prog-name>` or `<prog-name>`. It can be anything (afaik even random names). For simplicity, I chose the `<prog-name>`
-        */
-        if (serv_arr[i].sock_type == 0) {                                         /* stream socket */
-          if(strcmp(serv_arr[i].service, "str_echo") == 0) {                      /* str_echo */
-            bzero(&(serv_arr[i].cli_addr), sizeof(struct sockaddr_in));
-            if ( (accept_sockfd = accept(serv_arr[i].sockfd, (struct sockaddr *) &(serv_arr[i].cli_addr), (socklen_t *) &(serv_arr[i].cli_addr_len))) < 0) {
-              write_log(logfd, "accept error: failed to accept the connection request\n");
-              exit(EXIT_FAILURE);
-            }
-            strlcat(exec_path, serv_arr[i].service, sizeof(exec_path));
-            if ( (pid = fork()) < 0) {
-              write_log(logfd, "fork error: failed to fork the process\n"); 
-              exit(EXIT_FAILURE);
-            } else if (pid == 0) {              /* child process */
-              close(serv_arr[i].sockfd);
-              for (int i = 0; i < NOFILE; i++) {
-                if (accept_sockfd == i) {
-                  continue;
-                }
-                close(i);
-              }
-              dup2(accept_sockfd, 0);
-              dup2(accept_sockfd, 1);
-              dup2(accept_sockfd, 2);
-              close(accept_sockfd);
-
-              /*
-               * NOTE:
-               *  Rather than using the `execl` function, one can also use the simplified `execlp` function. This is because the 
-               *  function `execlp` function takes the `path` argument (a C-string) and if the string did not contain any forward 
-               *  slash (/), then the file would be searched using the PATH environment variable. On my system's manual page, the 
-               *  section for `execlp` function (along with `execvp` and `execvP` function) states that:
-               *  
-               *      ```
-               *      The functions execlp(), execvp(), and execvP() will duplicate the actions of the shell in searching for an 
-               *      executable file if the specified file name does not contain a slash “/” character.  For execlp() and execvp(), 
-               *      search path is the path specified in the environment by “PATH” variable.  If this variable is not specified, 
-               *      the default path is set according to the _PATH_DEFPATH definition in <paths.h>, which is set to “/usr/bin:/bin”.  
-               *      For execvP(), the search path is specified as an argument to the function.  In addition, certain errors are treated specially.
-               *      ```
-               *  
-               *  Under compatibility, the manual page also states that:
-               *
-               *      ```
-               *      Historically, the default path for the execlp() and execvp() functions was “:/bin:/usr/bin”.  This was changed 
-               *      to place the current directory last to enhance system security.
-               *      ```
-               *
-               *  So, replacing the call to `execlp` with the first argument as `serv_arr[i].service` will have identicial effect.
-              */
-              if (execl(exec_path, serv_arr[i].service, (char *) 0) < 0) {
-                write_log(logfd, "execl error: failed to execute the required program\n");
-                exit(EXIT_FAILURE);
-              }
-            } else {                            /* parent process */
-              close(accept_sockfd);     /* close the `accept`ed socket descriptor as the parent need not use it. */
-              break;
-            }
-          } else if (strcmp(serv_arr[i].service, "str_dis") == 0) {                 /* str_dis */
-            bzero(&(serv_arr[i].cli_addr), sizeof(struct sockaddr_in));
-            if ( (accept_sockfd = accept(serv_arr[i].sockfd, (struct sockaddr *) &(serv_arr[i].cli_addr), (socklen_t *) &(serv_arr[i].cli_addr_len))) < 0) {
-              write_log(logfd, "accept error: failed to accept the connection request\n");
-              exit(EXIT_FAILURE);
-            }
-            strlcat(exec_path, serv_arr[i].service, sizeof(exec_path));
-            if ( (pid = fork()) < 0) {
-              write_log(logfd, "fork error: failed to fork the process\n"); 
-              exit(EXIT_FAILURE);
-            } else if (pid == 0) {              /* child process */
-              close(serv_arr[i].sockfd);
-              for (int i = 0; i < NOFILE; i++) {
-                if (accept_sockfd == i) {
-                  continue;
-                }
-                close(i);     /* close all descriptor except one which was returned from `accept` */
-              }
-              dup2(accept_sockfd, 0);
-              dup2(accept_sockfd, 1);
-              dup2(accept_sockfd, 2);
-              close(accept_sockfd);
-
-              if (execl(exec_path, serv_arr[i].service, (char *) 0) < 0) {
-                write_log(logfd, "execl error: failed to execute the required program\n");
-                exit(EXIT_FAILURE);
-              }
-            } else {                            /* parent process */
-              close(accept_sockfd);     /* close the `accept`ed socket descriptor as the parent need not use it. */
-              break;
-            }
-          }
-        } else {                              /* datagram socket */
-          clear_fd = serv_arr[i].sockfd;
-          /* fork and execute the function */
-          if (strcmp(serv_arr[i].service, "dg_echo") == 0) {                        /* dg_echo */
-            strlcat(exec_path, serv_arr[i].service, sizeof(exec_path));
-            if ( (pid = fork()) < 0) {
-              write_log(logfd, "fork error: failed to fork the process\n"); 
-              exit(EXIT_FAILURE);
-            } else if ( pid == 0 ) {            /* child process */
-              /* clear out the other file descriptor */
-              for (int i = 0; i < NOFILE; i++) {
-                if (clear_fd == i) {
-                  continue;
-                }
-                close(i);
-              }
-              dup2(serv_arr[i].sockfd, 0);
-              dup2(serv_arr[i].sockfd, 1);
-              dup2(serv_arr[i].sockfd, 2);
-              close(serv_arr[i].sockfd);
-
-              if (execl(exec_path, serv_arr[i].service, (char *) 0) < 0) {
-                write_log(logfd, "execl error: failed to execute the required program\n");
-                exit(EXIT_FAILURE);
-              }
-            } else {                            /* parent process */
-              serv_arr[i].child_pid = pid;
-              udp_select_conn++;
-              break;
+    stats_now(&ready);
+
+    /* all the signals that came in since the last time, several SIGCHLDs may show up as one. */
+    if (FD_ISSET(sig_fd, &read_sockfds)) {
+      while ( (signo = sigfd_next(sig_fd)) > 0) {
+        switch (signo) {
+          case SIGCHLD:
+            reap_children();
+            break;
+          case SIGHUP:            /* log rotation: the old file was moved away, start a new one */
+            log_flush_sync();
+            if ( (fd = open(log_path, O_RDWR | O_APPEND | O_CREAT, 0666)) >= 0) {
+              dup2(fd, logfd);
+              close(fd);
             }
-          } else if (strcmp(serv_arr[i].service, "dg_dis") == 0) {                      /* dg_dis */
-            strlcat(exec_path, serv_arr[i].service, sizeof(exec_path));
-            if ( (pid = fork()) < 0) {
-              write_log(logfd, "fork error: failed to fork the process\n"); 
-              exit(EXIT_FAILURE);
-            } else if ( pid == 0 ) {            /* child process */
-              /* clear out the other file descriptor */
-              for (int i = 0; i < NOFILE; i++) {
-                if (clear_fd == i) {
-                  continue;
-                }
-                close(i);
+            write_log(logfd, "SIGHUP: log file reopened\n");
+            break;
+          case SIGTERM:
+            write_log(logfd, "SIGTERM: shutting down\n");
+            for (int i = 0; i < (int) ARR_ELE_CNT(serv_arr); i++) {
+              if (serv_arr[i].sock_type == 1 && serv_arr[i].child_pid > 0) {
+                kill(serv_arr[i].child_pid, SIGTERM);
               }
-              dup2(serv_arr[i].sockfd, 0);
-              dup2(serv_arr[i].sockfd, 1);
-              dup2(serv_arr[i].sockfd, 2);
-              close(serv_arr[i].sockfd);
-
-              if (execl(exec_path, serv_arr[i].service, (char *) 0) < 0) {
-                write_log(logfd, "execl error: failed to execute the required program\n");
-                exit(EXIT_FAILURE);
-              }
-            } else {                            /* parent process */
-              serv_arr[i].child_pid = pid;
-              udp_select_conn++;
-              break;
             }
-          }
+            unlink(STATS_PATH);
+            exit(EXIT_SUCCESS);
+          case SIGUSR2:
+            new_inetd = hot_upgrade(argv, cwd, logfd);
+            break;
         }
       }
+      if (new_inetd > 0) {
+        break;
+      }
+    }
+
+    /* someone wants the counters, this doesn't need a child process. */
+    if (stats_fd >= 0 && FD_ISSET(stats_fd, &read_sockfds)) {
+      stats_serve(stats_fd);
     }
-    /* NOTE: REACHES HERE AFTER GETTING THE `READY-TO-READ` SOCKET, AND `EXEC`S THE APPROPRIATE EXECUTABLE */
     /* 
-     * Obviously, there's a better way to handle this, but it is just a "will-do" solution.
-     * First, all the socket descriptor are again set. Then, if `udp_select_conn` is set (non-zero), 
-     * the program recently `exec`ed one of the datagram (UDP) service. Then, we again check which 
-     * service was used, and clear out the appropriate socket from reading by `select`.
+     * cwd contains the current working directory, exec_path contains the path to the executable.
+     * The reason to have two of them is cause the program will later use `strlcat` to concatenate 
+     * the executable name to the path, and the program needs to handle multiple requests.
     */
-    for (int j = 0; j < (int) ARR_ELE_CNT(serv_arr); j++) {
-      FD_SET(serv_arr[j].sockfd, &read_sockfds);
-    }
-    if (udp_select_conn) {
-      for (int k = 0; k < (int) ARR_ELE_CNT(serv_arr); k++) {
-        if (serv_arr[k].sock_type == 1 && serv_arr[k].child_pid != 0) {
-          FD_CLR(serv_arr[k].sockfd, &read_sockfds);
+    for (int i = 0; i < (int) ARR_ELE_CNT(serv_arr); i++) {
+      if (!FD_ISSET(serv_arr[i].sockfd, &read_sockfds)) {
+        continue;
+      }
+      bzero(exec_path, sizeof(exec_path));
+      strlcpy(exec_path, cwd, sizeof(exec_path));
+      strlcat(exec_path, serv_arr[i].service, sizeof(exec_path));
+      /* reached here if one of the socket is ready for reading. */
+      /*
+       * Some common things done by all of the connection:
+       *  
+       *  TCP ("nowait"):
+       *    1.  "zero" out the structure member `cli_addr` before sending it to `accept` (value-result).
+       *    2.  `fork` the process (`spawn_service`), the child process closes all the descriptor execpt for `accept`ed one,
+       *        use `dup2` to redirect the fd 0, 1, and 2 to `accept`ed socket, and close the `accept`ed socket.
+       *    3.  In the child process, use `execl` function to execute the executable.
+       *    4.  In the parent process, close the `accept`ed socket. One child per connection.
+       *
+       *  UDP ("wait"):
+       *    1.  `spawn_service` hands the bound datagram socket itself to the child as fd 0, 1, and 2. The child also gets
+       *        INETD_LISTEN_FDS=1 (the socket is fd 0) and INETD_IDLE_TIMEOUT=<seconds> in its environment.
+       *    2.  The child is a long-lived instance: it serves every client on the socket until it has been idle for
+       *        INETD_IDLE_TIMEOUT seconds (0 means never) or it is told to quit.
+       *    3.  In the parent process, keep track of the process ID of child process (in member `child_pid`). As long as it is
+       *        non-zero the socket is left out of the read set, the instance owns it. When the instance exits, the SIGCHLD
+       *        comes in on `sig_fd`, `reap_children` sets it back to 0, and the read set is rebuilt with the socket in it
+       *        for the next `select`. So a burst of datagrams costs one `fork` + `exec` for the whole lifetime of the
+       *        instance, not one per readiness event.
+      */
+      if (serv_arr[i].sock_type == 0) {                                         /* stream socket */
+        serv_arr[i].cli_addr_len = sizeof(struct sockaddr_in);
+        bzero(&(serv_arr[i].cli_addr), sizeof(struct sockaddr_in));
+        if ( (accept_sockfd = accept(serv_arr[i].sockfd, (struct sockaddr *) &(serv_arr[i].cli_addr), (socklen_t *) &(serv_arr[i].cli_addr_len))) < 0) {
+          write_log(logfd, "accept error: failed to accept the connection request\n");
+          stats_spawn_error(i);
+          continue;
+        }
+        stats_accept(i);
+        if ( (pid = spawn_service(&serv_arr[i], accept_sockfd, exec_path, logfd)) < 0) {
+          write_log(logfd, "fork error: failed to fork the process\n"); 
+          stats_spawn_error(i);
+          close(accept_sockfd);   /* the client sees the connection closed, the next one may get a child */
+          continue;
         }
+        close(accept_sockfd);     /* close the `accept`ed socket descriptor as the parent need not use it. */
+        stats_spawn(i, pid, &ready);
+      } else {                                                                  /* datagram socket */
+        stats_accept(i);
+        if ( (pid = spawn_service(&serv_arr[i], serv_arr[i].sockfd, exec_path, logfd)) < 0) {
+          write_log(logfd, "fork error: failed to fork the process\n"); 
+          stats_spawn_error(i);
+          continue;               /* the datagram stays queued, the next `select` tries again */
+        }
+        serv_arr[i].child_pid = pid;
+        stats_spawn(i, pid, &ready);
       }
     }
   }
 
-  /* NOT REACHABLE. */
-  
-  /* close all the descriptors and exit */
+  /*
+   * Only reached after a hot upgrade, the new `inetd` is accepting on the same sockets. Stop watching them, make the
+   * datagram instances let go of their socket (the new `inetd` starts its own, anything unread stays queued in the
+   * socket), and wait for the children we still have before going away.
+  */
   for (int i = 0; i < (int) ARR_ELE_CNT(serv_arr); i++) {
     close(serv_arr[i].sockfd);
+    if (serv_arr[i].sock_type == 1 && serv_arr[i].child_pid > 0) {
+      kill(serv_arr[i].child_pid, SIGTERM);
+    }
+  }
+  if (stats_fd >= 0) {
+    close(stats_fd);      /* the new one has bound the path again already */
+  }
+  while ( (pid = waitpid(-1, &status, 0)) > 0 || errno == EINTR) {
+    if (pid > 0) {
+      stats_child_exit(pid, status);
+    }
   }
+  write_log(logfd, "upgrade: all children done, exiting\n");
   exit(EXIT_SUCCESS);
 }
 
-void sig_child (int sig_id) {
-  int pid;
-  int status;
+/*
+ * Start a new `inetd` (the same binary, same arguments) with our sockets. Returns its pid if it took over, -1 if not, in
+ * which case we just carry on.
+*/
+pid_t hot_upgrade (char **argv, const char *cwd, int logfd) {
+  const char  *names[ARR_ELE_CNT(serv_arr)];
+  int         fds[ARR_ELE_CNT(serv_arr)];
+  pid_t       pid;
+  char        msg[LOG_MSG_LEN];
 
-  if (sig_id != SIGCHLD) {
-    return;
+  for (int i = 0; i < (int) ARR_ELE_CNT(serv_arr); i++) {
+    names[i]  = serv_arr[i].service;
+    fds[i]    = serv_arr[i].sockfd;
+  }
+
+  write_log(logfd, "upgrade: starting the new binary\n");
+  log_flush_sync();         /* the child closes our log, don't leave the message in its copy of the ring */
+  if ( (pid = upgrade_start(argv, cwd, names, fds, ARR_ELE_CNT(serv_arr))) < 0) {
+    write_log(logfd, "upgrade error: the new binary didn't come up, carrying on\n");
+    return -1;
+  }
+  snprintf(msg, sizeof(msg), "upgrade: pid %d took over, draining\n", (int) pid);
+  write_log(logfd, msg);
+
+  return pid;
+}
+
+/*
+ * The environment of a datagram instance: ours, with INETD_LISTEN_FDS=1 and INETD_IDLE_TIMEOUT=<seconds> (`timeout`,
+ * which the caller fills in) in place of any we were given. Only the array is allocated, the strings are ours.
+ * Returns NULL if `malloc` failed.
+*/
+static char **dg_environ (char *timeout) {
+  static char   listen_fds[] = "INETD_LISTEN_FDS=1";
+  char          **envp;
+  int           i, n = 0;
+
+  for (i = 0; environ[i] != NULL; i++) {
+    ;
   }
+  if ( (envp = (char **) malloc((i + 3) * sizeof(char *))) == NULL) {
+    return NULL;
+  }
+  for (i = 0; environ[i] != NULL; i++) {
+    if (strncmp(environ[i], "INETD_LISTEN_FDS=", 17) != 0 && strncmp(environ[i], "INETD_IDLE_TIMEOUT=", 19) != 0) {
+      envp[n++] = environ[i];
+    }
+  }
+  envp[n++] = listen_fds;
+  envp[n++] = timeout;
+  envp[n]   = NULL;
+
+  return envp;
+}
+
+/*
+ * Fork and exec the server for `serv`, with `fd` (the `accept`ed socket, or the datagram socket itself) as its fd 0, 1
+ * and 2. Every other descriptor is closed in the child. Returns the pid of the child to the parent, -1 if `fork` failed.
+ *
+ * The environment is put together before the `fork`: we have the log thread, and in the child of a threaded process
+ * only async-signal-safe calls are safe until the exec. `setenv` (it mallocs) isn't, `execve` is.
+*/
+pid_t spawn_service (services *serv, int fd, const char *exec_path, int logfd) {
+  pid_t     pid;
+  sigset_t  empty;
+  char      timeout[32], *argv[2], **envp = environ;
+
+  if (serv->sock_type == 1) {
+    snprintf(timeout, sizeof(timeout), "INETD_IDLE_TIMEOUT=%d", dg_idle_timeout);
+    if ( (envp = dg_environ(timeout)) == NULL) {
+      return -1;
+    }
+  }
+  argv[0] = serv->service;
+  argv[1] = (char *) 0;
+
+  if ( (pid = fork()) != 0) {
+    if (envp != environ) {
+      free(envp);
+    }
+    return pid;                         /* parent process (or error) */
+  }
+
+  /* child process */
+  for (int i = 0; i < NOFILE; i++) {
+    if (fd == i || logfd == i) {
+      continue;
+    }
+    close(i);     /* close all descriptor except the one the service uses (and the log, in case `execl` fails) */
+  }
+  dup2(fd, 0);
+  dup2(fd, 1);
+  dup2(fd, 2);
+  if (fd > 2) {
+    close(fd);
+  }
+
+  fcntl(logfd, F_SETFD, FD_CLOEXEC);    /* kept for the error below, the server doesn't get it */
+
+  /* the signal mask survives `exec`, don't leave SIGCHLD blocked in the server */
+  sigemptyset(&empty);
+  sigprocmask(SIG_SETMASK, &empty, (sigset_t *) 0);
+
+  /*
+   * NOTE:
+   *  Rather than using the `execl` function, one can also use the simplified `execlp` function. This is because the 
+   *  function `execlp` function takes the `path` argument (a C-string) and if the string did not contain any forward 
+   *  slash (/), then the file would be searched using the PATH environment variable. On my system's manual page, the 
+   *  section for `execlp` function (along with `execvp` and `execvP` function) states that:
+   *  
+   *      ```
+   *      The functions execlp(), execvp(), and execvP() will duplicate the actions of the shell in searching for an 
+   *      executable file if the specified file name does not contain a slash “/” character.  For execlp() and execvp(), 
+   *      search path is the path specified in the environment by “PATH” variable.  If this variable is not specified, 
+   *      the default path is set according to the _PATH_DEFPATH definition in <paths.h>, which is set to “/usr/bin:/bin”.  
+   *      For execvP(), the search path is specified as an argument to the function.  In addition, certain errors are treated specially.
+   *      ```
+   *  
+   *  Under compatibility, the manual page also states that:
+   *
+   *      ```
+   *      Historically, the default path for the execlp() and execvp() functions was “:/bin:/usr/bin”.  This was changed 
+   *      to place the current directory last to enhance system security.
+   *      ```
+   *
+   *  So, replacing the call to `execlp` with the first argument as `serv_arr[i].service` will have identicial effect.
+   *
+   *  It's `execve` now, the one that takes the environment as an argument: a datagram instance gets its own (dg_environ).
+  */
+  if (execve(exec_path, argv, envp) < 0) {
+    write_log(logfd, "execve error: failed to execute the required program\n");
+  }
+  exit(STATS_EXEC_FAILED);    /* the parent counts it as a spawn error when it reaps us (stats_child_exit) */
+}
+
+/*
+ * Called from the main loop when SIGCHLD came in.
+*/
+void reap_children (void) {
+  int pid;
+  int status;
 
   /* 
-   * Naive approach as we aren't really checking the status of the terminated/signalled child process. 
    * The `-1` argument indicates the we aren't looking for a specific child process, but rather any.
    * WNOHANG indicates that the `waitpid` be non-blocking call.
+   * The status only goes to the counters (see stats.c), we don't act on it.
+   *
+   * NOTE: Signals don't queue, so one SIGCHLD may stand for several dead children. Keep reaping until `waitpid`
+   *       says there's nothing left, else the other children stay zombies (and the counters never see them exit).
   */
   while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    stats_child_exit(pid, status);
     for (int i = 0; i < (int) ARR_ELE_CNT(serv_arr); i++) {
       if ( pid == serv_arr[i].child_pid ) {
-        FD_SET(serv_arr[i].sockfd, &read_sockfds);
-        udp_select_conn--;
-        serv_arr[i].child_pid = 0;
+        serv_arr[i].child_pid = 0;          /* the main loop puts the socket back in the read set */
         break;
       }
     }
-    break;
   }
 }
 
@@ -544,6 +691,14 @@ void daemon_start (int ignore_sig_child) {
     goto out;
   }
 
+  /*
+   * Started by a hot upgrade: the old `inetd` was a daemon already, so we have no controlling terminal and fd 0, 1 and
+   * 2 are "/dev/null". The other descriptors we got are the listening sockets, which must not be closed.
+  */
+  if (upgrade_adopting()) {
+    goto out;
+  }
+
   signal(SIGTTOU, SIG_IGN);     /* Ignore the signal generated if the process (in the background) attempts to write to control terminal */
   signal(SIGTTIN, SIG_IGN);     /* Ignore the signal generated if the process (in the background) attempts to read from control terminal */
   signal(SIGTSTP, SIG_IGN);     /* Ignore the signal genrated if process receives suspend key (CTRL-Z) or delayed suspend key (CTRL-Y) */
@@ -587,7 +742,7 @@ void daemon_start (int ignore_sig_child) {
   #endif 
 
   out:
-    for (fd = 0; fd < NOFILE; fd++) {
+    for (fd = 0; fd < NOFILE && !upgrade_adopting(); fd++) {
       close(fd);
     }
 
@@ -597,14 +752,22 @@ void daemon_start (int ignore_sig_child) {
 
     umask(0);
 
+    /*
+     * Nobody will `wait` for the children, let the system reap them. (An ignored SIGCHLD does that on both BSD and
+     * System V.) `inetd` passes 0 here as it reaps its children itself, see `reap_children`.
+    */
     if (ignore_sig_child) {
       #ifdef SIGTSTP
-        signal(SIGCHLD, sig_child);
+        signal(SIGCHLD, SIG_IGN);
       #else 
         signal(SIGCLD, SIG_IGN);        /* System V */
       #endif  /* SIGTSTP */
     }
 
+    if (upgrade_adopting()) {
+      return;
+    }
+
     /* Ensure that descriptor 0, 1, and 2 are not taken by sockets. */
     fd = open("/dev/null", O_RDWR);
     if (fd == 0) {
@@ -0,0 +1,141 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* signalfd, sigaction and sigset_t with -ansi */
+#endif
+
+#include "sigfd.h"
+
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#ifdef __linux__
+  #include <sys/signalfd.h>
+#endif
+
+#define   SIGFD_MAX   16
+
+static int  routed[SIGFD_MAX];      /* the signals we took over */
+static int  nrouted = 0;
+
+#ifdef __linux__
+
+int sigfd_open (const int *sigs, int n) {
+  sigset_t  mask;
+  int       i;
+
+  if (n > SIGFD_MAX) {
+    return -1;
+  }
+
+  sigemptyset(&mask);
+  for (i = 0; i < n; i++) {
+    sigaddset(&mask, sigs[i]);
+    routed[i] = sigs[i];
+  }
+  nrouted = n;
+
+  /* blocked, so they stay pending and the signalfd reports them, instead of being delivered */
+  if (sigprocmask(SIG_BLOCK, &mask, (sigset_t *) 0) < 0) {
+    return -1;
+  }
+
+  return signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+}
+
+int sigfd_next (int fd) {
+  struct signalfd_siginfo   info;
+  ssize_t                   n;
+
+  while ( (n = read(fd, &info, sizeof(info))) < 0 && errno == EINTR) {
+    ;
+  }
+  if (n < 0) {
+    return (errno == EAGAIN) ? 0 : -1;
+  }
+  if (n != sizeof(info)) {
+    return -1;
+  }
+
+  return (int) info.ssi_signo;
+}
+
+void sigfd_child (int fd) {
+  sigset_t  mask;
+  int       i;
+
+  close(fd);
+  sigemptyset(&mask);
+  for (i = 0; i < nrouted; i++) {
+    sigaddset(&mask, routed[i]);
+  }
+  sigprocmask(SIG_UNBLOCK, &mask, (sigset_t *) 0);
+}
+
+#else   /* self-pipe */
+
+static int  pipefd[2] = { -1, -1 };
+
+static void sigfd_handler (int signum) {
+  int           saved_errno = errno;
+  unsigned char c = (unsigned char) signum;
+
+  if (write(pipefd[1], &c, 1) != 1) {
+    ;       /* pipe full: there's plenty in it already to wake the loop up */
+  }
+  errno = saved_errno;
+}
+
+int sigfd_open (const int *sigs, int n) {
+  struct sigaction  act;
+  int               i;
+
+  if (n > SIGFD_MAX || pipe(pipefd) < 0) {
+    return -1;
+  }
+  for (i = 0; i < 2; i++) {
+    fcntl(pipefd[i], F_SETFL, fcntl(pipefd[i], F_GETFL) | O_NONBLOCK);
+    fcntl(pipefd[i], F_SETFD, FD_CLOEXEC);
+  }
+
+  memset(&act, 0, sizeof(act));
+  act.sa_handler  = sigfd_handler;
+  act.sa_flags    = SA_RESTART;
+  sigfillset(&act.sa_mask);         /* one handler at a time */
+  for (i = 0; i < n; i++) {
+    if (sigaction(sigs[i], &act, (struct sigaction *) 0) < 0) {
+      return -1;
+    }
+    routed[i] = sigs[i];
+  }
+  nrouted = n;
+
+  return pipefd[0];
+}
+
+int sigfd_next (int fd) {
+  unsigned char c;
+  ssize_t       n;
+
+  while ( (n = read(fd, &c, 1)) < 0 && errno == EINTR) {
+    ;
+  }
+  if (n < 0) {
+    return (errno == EAGAIN) ? 0 : -1;
+  }
+
+  return (n == 1) ? (int) c : -1;
+}
+
+void sigfd_child (int fd) {
+  int i;
+
+  close(fd);
+  close(pipefd[1]);
+  for (i = 0; i < nrouted; i++) {
+    signal(routed[i], SIG_DFL);
+  }
+}
+
+#endif  /* __linux__ */
@@ -0,0 +1,167 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* setenv, unsetenv, sigprocmask and kill with -ansi */
+#endif
+
+#include "upgrade.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/param.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+
+#define   FDS_ENV     "UPGRADE_FDS"
+#define   READY_ENV   "UPGRADE_READY_FD"
+
+/*
+ * Runs in the grandchild, never returns.
+*/
+static void exec_new (char **argv, const char *cwd, const char **names, const int *fds, int n, int readyfd) {
+  char      manifest[UPGRADE_MAX_FDS * 32];
+  char      num[16];
+  int       fd, i, keep, len = 0;
+  pid_t     self = getpid();
+  sigset_t  empty;
+
+  /* first thing on the pipe is who we are, so the old daemon can kill us if we never get ready */
+  if (write(readyfd, &self, sizeof(self)) != sizeof(self)) {
+    _exit(EXIT_FAILURE);
+  }
+
+  /* everything the old daemon had open (log file, `accept`ed sockets, ...) except what we pass on */
+  for (fd = 3; fd < NOFILE; fd++) {
+    keep = (fd == readyfd);
+    for (i = 0; i < n && !keep; i++) {
+      keep = (fds[i] == fd);
+    }
+    if (!keep) {
+      close(fd);
+    }
+  }
+
+  manifest[0] = '\0';
+  for (i = 0; i < n && len < (int) sizeof(manifest); i++) {
+    len += snprintf(manifest + len, sizeof(manifest) - len, "%s%s:%d", (i == 0) ? "" : ",", names[i], fds[i]);
+  }
+  snprintf(num, sizeof(num), "%d", readyfd);
+  setenv(FDS_ENV, manifest, 1);
+  setenv(READY_ENV, num, 1);
+
+  /* the signal mask and the working directory survive `exec`, put them back the way they were at the start */
+  sigemptyset(&empty);
+  sigprocmask(SIG_SETMASK, &empty, (sigset_t *) 0);
+  if (chdir(cwd) < 0) {
+    _exit(EXIT_FAILURE);
+  }
+
+  execv(argv[0], argv);
+  _exit(EXIT_FAILURE);
+}
+
+pid_t upgrade_start (char **argv, const char *cwd, const char **names, const int *fds, int n) {
+  int             pfd[2], rc;
+  pid_t           pid, newpid = -1;
+  char            c;
+  fd_set          rset;
+  struct timeval  tv;
+  time_t          deadline;
+
+  if (n > UPGRADE_MAX_FDS || pipe(pfd) < 0) {
+    return -1;
+  }
+
+  if ( (pid = fork()) < 0) {
+    close(pfd[0]);
+    close(pfd[1]);
+    return -1;
+  } else if (pid == 0) {
+    /* first child, only there so the new daemon isn't our child */
+    if ( (pid = fork()) != 0) {
+      _exit((pid < 0) ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+    close(pfd[0]);
+    exec_new(argv, cwd, names, fds, n, pfd[1]);
+  }
+
+  close(pfd[1]);
+  while (waitpid(pid, (int *) 0, 0) < 0 && errno == EINTR) {
+    ;       /* our SIGCHLD handler may have reaped it already, that's ECHILD and fine */
+  }
+
+  /* the pid, then one byte once it's ready. EOF before that means the `exec` or the start up failed. */
+  deadline = time((time_t *) 0) + UPGRADE_TIMEOUT;
+  if (read(pfd[0], &newpid, sizeof(newpid)) != sizeof(newpid)) {
+    close(pfd[0]);
+    return -1;
+  }
+  for (;;) {
+    if ( (tv.tv_sec = deadline - time((time_t *) 0)) <= 0) {
+      rc = 0;
+      break;
+    }
+    tv.tv_usec = 0;
+    FD_ZERO(&rset);
+    FD_SET(pfd[0], &rset);
+    if ( (rc = select(pfd[0] + 1, &rset, (fd_set *) 0, (fd_set *) 0, &tv)) < 0 && errno == EINTR) {
+      continue;
+    }
+    break;
+  }
+  if (rc <= 0 || read(pfd[0], &c, 1) != 1) {
+    kill(newpid, SIGKILL);          /* timed out (or it's already gone), roll back */
+    close(pfd[0]);
+    return -1;
+  }
+
+  close(pfd[0]);
+  return newpid;
+}
+
+int upgrade_adopting (void) {
+  return getenv(FDS_ENV) != NULL;
+}
+
+int upgrade_inherited (const char *name) {
+  const char  *p, *colon;
+  size_t      len = strlen(name);
+
+  if ( (p = getenv(FDS_ENV)) == NULL) {
+    return -1;
+  }
+
+  /* "name:fd,name:fd,..." */
+  while (*p != '\0') {
+    if ( (colon = strchr(p, ':')) == NULL) {
+      break;
+    }
+    if ((size_t) (colon - p) == len && strncmp(p, name, len) == 0) {
+      return atoi(colon + 1);
+    }
+    if ( (p = strchr(colon, ',')) == NULL) {
+      break;
+    }
+    p++;
+  }
+
+  return -1;
+}
+
+void upgrade_ready (void) {
+  char  *val;
+  int   fd;
+
+  if ( (val = getenv(READY_ENV)) != NULL) {
+    fd = atoi(val);
+    if (write(fd, "R", 1) != 1) {
+      ;       /* the old daemon gave up on us and will kill us anyway */
+    }
+    close(fd);
+  }
+  unsetenv(FDS_ENV);
+  unsetenv(READY_ENV);
+}
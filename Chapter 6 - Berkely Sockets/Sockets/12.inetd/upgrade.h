@@ -0,0 +1,49 @@
+#ifndef UPGRADE_H
+#define UPGRADE_H
+
+/*
+ * Hot upgrade for the daemons (`inetd` and `tcp_daemon`), started by sending SIGUSR2 to the running daemon.
+ *
+ * Restarting a daemon the usual way closes the listening sockets, and every client which connects before the new one
+ * has called `bind` and `listen` gets ECONNREFUSED. Here the sockets are never closed, they are inherited:
+ *    1.  The old daemon forks, the child forks again and exits (so the new daemon is not our child, we'll be waiting
+ *        for our own children later). The grandchild closes every descriptor except 0, 1, 2, the listening sockets and
+ *        the write end of a pipe, puts the list of sockets in the environment and `exec`s the binary again, with the
+ *        same arguments, from the directory the old one was started from.
+ *
+ *            UPGRADE_FDS=str_echo:4,dg_echo:5,str_dis:6,dg_dis:7
+ *            UPGRADE_READY_FD=8
+ *
+ *    2.  The new daemon finds UPGRADE_FDS, skips the `fork`s and the closing of descriptors in `daemon_start`, takes the
+ *        sockets over instead of creating them (`upgrade_inherited`) and, once it's in its `select` loop, writes one byte
+ *        to the pipe (`upgrade_ready`).
+ *    3.  The old daemon waits for that byte (UPGRADE_TIMEOUT seconds at most). It never stopped owning the sockets, so
+ *        connections that arrive meanwhile just sit in the listen queue. When the byte arrives, it closes its copies of
+ *        the sockets, waits for its children to finish and exits. If the pipe is closed without the byte (the `exec`
+ *        failed, the new one died) or the time is up, the new process is killed and the old one goes on as if nothing
+ *        happened.
+*/
+
+#include <sys/types.h>
+
+#define   UPGRADE_TIMEOUT     10        /* seconds the old daemon waits for the new one */
+#define   UPGRADE_MAX_FDS     8
+
+/*
+ * upgrade_start: Start the new binary (`argv` as given to `main`, `cwd` the directory the daemon was started from)
+ *                with the `n` sockets `fds` named `names`. Returns the pid of the new daemon once it is ready, or -1 if
+ *                it couldn't be started (nothing changed for the caller in that case).
+*/
+pid_t upgrade_start       (char **argv, const char *cwd, const char **names, const int *fds, int n);
+
+/*
+ * upgrade_adopting:  Non-zero if this process was started by `upgrade_start`.
+ * upgrade_inherited: The inherited socket for `name`, or -1 if there's none.
+ * upgrade_ready:     Tell the old daemon we're up. Also removes the variables from the environment, the servers we
+ *                    `exec` later have no business with them.
+*/
+int   upgrade_adopting    (void);
+int   upgrade_inherited   (const char *name);
+void  upgrade_ready       (void);
+
+#endif  /* UPGRADE_H */
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <strings.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 
@@ -26,4 +27,22 @@ int writen        (register int fd, register char *ptr, register int nbytes);
 
 int   write_log   (int logfd, const char *logmsg);
 
+/*
+ * idle_timeout:  seconds a datagram service may sit idle before it exits (INETD_IDLE_TIMEOUT), 0 means never.
+ * wait_readable: wait up to `seconds` for `fd` to become readable. Returns 1 if readable, 0 on timeout, -1 on error.
+*/
+int   idle_timeout  (void);
+int   wait_readable (int fd, int seconds);
+
+/*
+ * write_log only formats the message into an in-memory ring, a background thread writes it out (see write_log.c).
+ * log_init:        start the flusher thread, call it after `daemon_start`. Returns 0 if OK, -1 if the thread couldn't 
+ *                  be created (the messages are then written synchronously).
+ * log_flush_sync:  write out everything in the ring now, for fatal errors (also called at `exit`).
+ * log_dropped:     messages lost because the ring was full.
+*/
+int             log_init        (void);
+void            log_flush_sync  (void);
+unsigned long   log_dropped     (void);
+
 #endif
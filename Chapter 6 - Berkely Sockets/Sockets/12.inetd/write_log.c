@@ -1,22 +1,280 @@
+#ifdef __linux__
+#define _GNU_SOURCE         /* sigset_t, sigfillset and pthread_sigmask with -ansi */
+#endif
+
 #include "utils.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/uio.h>
+
+/*
+ * The old `write_log` did `getppid`, `getpid`, `sprintf`, `strlcat`, `strlen` and a `write` for every single message,
+ * and it is called on the accept path of the daemon. Now the message is only formatted into a slot of an in-memory ring
+ * (no system call at all, the pids are cached) and a background thread writes the slots out in batches with `writev`.
+ *
+ * Functionality:
+ *    1.  The ring has LOG_RING_SLOTS slots of LOG_MSG_LEN bytes. Every slot has a sequence number which tells whose
+ *        turn it is:
+ *          ->  seq == pos          the slot is free for the producer which reserved position `pos`.
+ *          ->  seq == pos + 1      the producer is done, the message can be written out.
+ *        The consumer gives the slot back by setting seq to pos + LOG_RING_SLOTS, which is the next position mapping
+ *        to the same slot.
+ *    2.  A producer (`write_log`) reserves a position by a compare-and-swap on `tail`. So any number of threads can log
+ *        without a lock. If the ring is full the message is dropped and counted, we never block the caller.
+ *    3.  The flusher thread wakes up every LOG_TICK_MS milliseconds. It writes when there are LOG_BATCH messages waiting
+ *        or the oldest one has waited LOG_FLUSH_MS milliseconds. Consecutive messages for the same descriptor go into
+ *        one `writev` (up to LOG_IOV of them), straight from the slots, no copying.
+ *    4.  `log_flush_sync` writes everything out from the calling thread. It is registered with `atexit`, so all the
+ *        `exit(EXIT_FAILURE)` paths flush before going away.
+ *    5.  Before `log_init` (and in a child after `fork`, which doesn't get the flusher thread) `write_log` flushes
+ *        synchronously, i.e. it behaves like the old one.
+ *
+ * NOTE: `fork` only copies the calling thread, so `log_init` must be called *after* `daemon_start`. The child of a fork
+ *       throws away what the parent still had in the ring (the parent will write those), see `log_atfork_child`.
+*/
+
+#define   LOG_RING_SLOTS    256         /* must be a power of 2 */
+#define   LOG_BATCH         32          /* flush as soon as this many messages are waiting */
+#define   LOG_TICK_MS       10          /* how often the flusher looks at the ring */
+#define   LOG_FLUSH_MS      50          /* no message waits longer than this (give or take a tick) */
+#define   LOG_IOV           64          /* messages in one `writev` */
+
+typedef struct {
+  unsigned long   seq;
+  int             fd;
+  int             len;
+  char            msg[LOG_MSG_LEN];
+} log_slot;
+
+static struct {
+  log_slot        slot[LOG_RING_SLOTS];
+  unsigned long   tail;             /* next position to reserve, producers */
+  unsigned long   head;             /* next position to write out, consumer (under `lock`), flusher peeks at it */
+  unsigned long   dropped;          /* messages lost because the ring was full */
+  unsigned long   dropped_seen;     /* how many of those were already reported in the log */
+  int             last_fd;          /* where to report the drops */
+} ring;
+
+static pthread_mutex_t  lock            = PTHREAD_MUTEX_INITIALIZER;  /* only one consumer at a time */
+static int              flusher_running = 0;
+static int              initialized     = 0;
+static pid_t            cached_pid;
+static pid_t            cached_ppid;
+
+static void ring_reset (void) {
+  int i;
+
+  for (i = 0; i < LOG_RING_SLOTS; i++) {
+    ring.slot[i].seq = i;
+  }
+  ring.head         = 0;
+  ring.tail         = 0;
+  ring.dropped      = 0;
+  ring.dropped_seen = 0;
+}
+
+static void cache_pids (void) {
+  cached_pid  = getpid();
+  cached_ppid = getppid();
+}
+
+/*
+ * Write out at most LOG_IOV messages with one `writev`. Must hold `lock`.
+ * Returns the number of messages written out.
+*/
+static int flush_batch (void) {
+  struct iovec    iov[LOG_IOV];
+  unsigned long   pos = ring.head;
+  log_slot        *s;
+  int             n, i, fd = -1;
+
+  for (n = 0; n < LOG_IOV; n++) {
+    s = &ring.slot[(pos + n) & (LOG_RING_SLOTS - 1)];
+    if (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != pos + n + 1) {
+      break;          /* not written yet (or nothing there) */
+    }
+    if (n > 0 && s->fd != fd) {
+      break;          /* different log file, next batch */
+    }
+    fd              = s->fd;
+    iov[n].iov_base = s->msg;
+    iov[n].iov_len  = s->len;
+  }
+
+  if (n == 0) {
+    return 0;
+  }
+
+  if (writev(fd, iov, n) < 0) {
+    ;               /* nowhere to report it, the log file *is* where we report things */
+  }
+  ring.last_fd = fd;
+
+  /* hand the slots back to the producers */
+  for (i = 0; i < n; i++) {
+    s = &ring.slot[(pos + i) & (LOG_RING_SLOTS - 1)];
+    __atomic_store_n(&s->seq, pos + i + LOG_RING_SLOTS, __ATOMIC_RELEASE);
+  }
+  __atomic_store_n(&ring.head, pos + n, __ATOMIC_RELAXED);
+
+  return n;
+}
+
+/*
+ * Must hold `lock`.
+*/
+static void flush_all (void) {
+  unsigned long   dropped;
+  char            msg[LOG_MSG_LEN];
+  int             len;
+
+  while (flush_batch() > 0) {
+    ;
+  }
+
+  dropped = __atomic_load_n(&ring.dropped, __ATOMIC_RELAXED);
+  if (dropped != ring.dropped_seen && ring.last_fd > 0) {
+    len = snprintf(msg, sizeof(msg), "fd: %2d parent pid: %5d child pid: %5d message: log ring full, %lu message(s) dropped\n",
+                   ring.last_fd, (int) cached_ppid, (int) cached_pid, dropped - ring.dropped_seen);
+    if (write(ring.last_fd, msg, len) != len) {
+      ;
+    }
+    ring.dropped_seen = dropped;
+  }
+}
+
+static void *flusher (void *arg) {
+  struct timespec   tick;
+  unsigned long     pending;
+  int               waited = 0;       /* ticks since we first saw something in the ring */
+  sigset_t          all;
+
+  (void) arg;
+
+  /* signals are for the main thread (a signal blocked there but not here would be delivered here instead) */
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, (sigset_t *) 0);
+
+  tick.tv_sec   = 0;
+  tick.tv_nsec  = LOG_TICK_MS * 1000000L;
+
+  for (;;) {
+    nanosleep(&tick, (struct timespec *) 0);
+
+    pending = __atomic_load_n(&ring.tail, __ATOMIC_RELAXED) - __atomic_load_n(&ring.head, __ATOMIC_RELAXED);
+    if (pending == 0) {
+      waited = 0;
+      continue;
+    }
+    if (pending < LOG_BATCH && ++waited * LOG_TICK_MS < LOG_FLUSH_MS) {
+      continue;
+    }
+
+    pthread_mutex_lock(&lock);
+    flush_all();
+    pthread_mutex_unlock(&lock);
+    waited = 0;
+  }
+
+  return (void *) 0;
+}
+
+/*
+ * Runs in the child right after `fork`. The flusher thread didn't come along, the pids changed, and whatever is in the
+ * ring belongs to the parent. The lock may have been held by the parent's flusher at the time of the fork, so it's
+ * re-initialized rather than unlocked.
+*/
+static void log_atfork_child (void) {
+  pthread_mutex_init(&lock, (pthread_mutexattr_t *) 0);
+  flusher_running = 0;
+  cache_pids();
+  ring_reset();
+}
+
+static void log_setup (void) {
+  if (initialized) {
+    return;
+  }
+  initialized = 1;
+  cache_pids();
+  ring_reset();
+  pthread_atfork((void (*)(void)) 0, (void (*)(void)) 0, log_atfork_child);
+  atexit(log_flush_sync);
+}
+
+int log_init (void) {
+  pthread_t tid;
+
+  log_setup();
+  cache_pids();       /* `daemon_start` forked since the first message, maybe */
+
+  if (flusher_running) {
+    return 0;
+  }
+  if (pthread_create(&tid, (pthread_attr_t *) 0, flusher, (void *) 0) != 0) {
+    return -1;          /* `write_log` keeps working synchronously */
+  }
+  pthread_detach(tid);
+  flusher_running = 1;
+
+  return 0;
+}
+
+void log_flush_sync (void) {
+  pthread_mutex_lock(&lock);
+  flush_all();
+  pthread_mutex_unlock(&lock);
+}
+
+unsigned long log_dropped (void) {
+  return __atomic_load_n(&ring.dropped, __ATOMIC_RELAXED);
+}
 
 int write_log (int logfd, const char *logmsg) {
-  char  message[LOG_MSG_LEN];
-  int   logmsg_len = strlen(logmsg);
-  int   final_msg_len;
+  unsigned long   pos, seq;
+  long            diff;
+  log_slot        *s;
+  int             len;
 
-  sprintf(message, "fd: %2d parent pid: %5d child pid: %5d message: ", logfd, getppid(), getpid());
+  log_setup();
 
-  strlcat(message, logmsg, LOG_MSG_LEN);
-  final_msg_len = strlen(message);
+  /* reserve a slot */
+  pos = __atomic_load_n(&ring.tail, __ATOMIC_RELAXED);
+  for (;;) {
+    s     = &ring.slot[pos & (LOG_RING_SLOTS - 1)];
+    seq   = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+    diff  = (long) (seq - pos);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&ring.tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+      /* someone else took it, `pos` now holds the new tail */
+    } else if (diff < 0) {
+      __atomic_add_fetch(&ring.dropped, 1, __ATOMIC_RELAXED);       /* full, the flusher is behind */
+      return 0;
+    } else {
+      pos = __atomic_load_n(&ring.tail, __ATOMIC_RELAXED);
+    }
+  }
+
+  /* same format as before, truncated to LOG_MSG_LEN like the old `strlcat` did */
+  len = snprintf(s->msg, LOG_MSG_LEN, "fd: %2d parent pid: %5d child pid: %5d message: %s",
+                 logfd, (int) cached_ppid, (int) cached_pid, logmsg);
+  if (len >= LOG_MSG_LEN) {
+    len = LOG_MSG_LEN - 1;
+  }
+  s->fd   = logfd;
+  s->len  = len;
+  __atomic_store_n(&s->seq, pos + 1, __ATOMIC_RELEASE);       /* publish */
 
-  if (write(logfd, message, final_msg_len) != final_msg_len) {
-    fprintf(stderr, "write error: failed to write to the log file");
-    return -1;
+  if (!flusher_running) {
+    log_flush_sync();
   }
 
-  return final_msg_len;
+  return len;
 }
@@ -0,0 +1,91 @@
+/*
+ * Copy standard input to standard output, using asynchronous I/O, same as async_io.c. The difference is how SIGIO 
+ * is waited for.
+ *
+ * In async_io.c the handler sets `sigflag`, and the main loop blocks SIGIO, checks the flag and `sigsuspend`s. That 
+ * works, but every SIGIO runs a handler, any slow call in the loop can come back with EINTR, and the flag/mask dance has
+ * to be just right or a signal that comes in between the check and the `sigsuspend` is lost until the next one.
+ *
+ * Here SIGIO goes through `sigfd_open` (sigfd.c): on Linux it stays blocked and is read from a `signalfd`, elsewhere the
+ * handler only writes a byte to a pipe. Either way we get a descriptor that becomes readable when SIGIO arrives, and we
+ * just `select` on it. Nothing interrupts the loop.
+ *
+ * Functionality:
+ *    1.  Route SIGIO to `sig_fd`.
+ *    2.  Make the standard input non-blocking, owned by us (F_SETOWN) and asynchronous (FASYNC / O_ASYNC), so the 
+ *        kernel sends SIGIO when there's something to read.
+ *    3.  Wait for `sig_fd` to become readable, drain it (several SIGIOs may have been merged into one), then read the
+ *        standard input until it says EAGAIN. Since the signals merge, reading just once per SIGIO could leave data 
+ *        behind with no signal coming for it.
+*/
+
+#include <sys/select.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "sigfd.h"
+
+#define BUFFSIZE    4096
+
+int main (void) {
+
+  int         n, sig_fd, signo, flags;
+  char        buff[BUFFSIZE];
+  fd_set      rset;
+  const int   sigs[] = { SIGIO };
+
+  /* before FASYNC is set, so the first SIGIO can't be delivered the default way (which terminates us) */
+  if ( (sig_fd = sigfd_open(sigs, 1)) < 0) {
+    perror("sigfd_open error");
+    return (-1);
+  }
+
+  if (fcntl(0, F_SETOWN, getpid()) < 0) {
+    perror("F_SETOWN error");
+    return (-1);
+  }
+  if ( (flags = fcntl(0, F_GETFL)) < 0) {
+    perror("F_GETFL error");
+    return (-1);
+  }
+  if (fcntl(0, F_SETFL, flags | FASYNC | O_NONBLOCK) < 0) {
+    perror("F_SETFL error");
+    return (-1);
+  }
+
+  for (;;) {
+    FD_ZERO(&rset);
+    FD_SET(sig_fd, &rset);
+    if (select(sig_fd + 1, &rset, (fd_set *) 0, (fd_set *) 0, (struct timeval *) 0) < 0) {
+      if (errno == EINTR) {
+        continue;       /* only with the self-pipe */
+      }
+      perror("select error");
+      return (-1);
+    }
+
+    while ( (signo = sigfd_next(sig_fd)) > 0) {
+      ;                 /* only SIGIO is routed, how many of them doesn't matter */
+    }
+
+    for (;;) {
+      if ( (n = read(0, buff, BUFFSIZE)) > 0) {
+        if (write(1, buff, n) != n) {
+          perror("write error");
+          return (-1);
+        }
+      } else if (n == 0) {
+        fcntl(0, F_SETFL, flags);       /* the terminal is shared with the shell, put it back */
+        return (0);                     /* EOF */
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;                          /* all read, wait for the next SIGIO */
+      } else if (errno != EINTR) {
+        perror("read error");
+        return (-1);
+      }
+    }
+  }
+}